@@ -56,7 +56,7 @@ int main() {
   geometry cube = geo_cuboid(1.0, 1.0, 1.0);
 
   // upload vertex data to the gpu
-  cube_vbuf = ral_buffer_create(64 * 36, cube.vertex_data);
+  cube_vbuf = ral_buffer_create(vertex_desc_stride(&cube.vertex_format) * cube.vertex_count, cube.vertex_data);
 
   while (!app_should_exit()) {
     glfwPollEvents();
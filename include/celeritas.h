@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -113,7 +114,26 @@ void _cel_push_error(int error_code);
 
 // --- Memory facilities: Allocators, helpers
 
-// TODO: Arenas
+// Arena
+// Inspired by https://nullprogram.com/blog/2023/09/27/
+typedef struct arena {
+  char* begin;
+  char* curr;
+  char* end;
+} arena;
+
+typedef struct arena_save {
+  arena* arena;
+  char* savepoint;
+} arena_save;
+
+arena arena_create(void* backing_buffer, size_t capacity);
+void* arena_alloc(arena* a, size_t size);
+void* arena_alloc_align(arena* a, size_t size, size_t align);
+void arena_free_all(arena* a);
+void arena_free_storage(arena* a);
+arena_save arena_savepoint(arena* a);
+void arena_rewind(arena_save savepoint);
 
 // Pool
 typedef struct void_pool_header void_pool_header;  // TODO: change name of this
@@ -162,6 +182,31 @@ u32 void_pool_insert(void_pool* pool, void* item);
     return (Name##_handle){ .raw = raw_handle };                                     \
   }
 
+// --- Jobs
+
+#define MAX_JOB_THREADS 16
+
+/** @brief processes items `[start, end)`. `worker_idx` is 0 for the calling thread and unique per thread otherwise so
+           it can be used to index per-thread scratch data sized by `job_system_thread_count()` */
+typedef void (*job_range_fn)(void* ctx, u32 start, u32 end, u32 worker_idx);
+
+/** @brief spawns `worker_count` worker threads. Pass 0 to use one less than the number of cores. */
+bool job_system_init(u32 worker_count);
+void job_system_shutdown();
+/** @brief how many threads can run jobs, including the calling thread */
+u32 job_system_thread_count();
+/** @brief splits `count` items into chunks of `chunk_size` and runs them across the job system, blocking until all
+           chunks are done. Runs serially on the calling thread if the job system isn't running or when nested. */
+void jobs_parallel_for(u32 count, u32 chunk_size, job_range_fn fn, void* ctx);
+
+// --- Hashing
+
+#define HASH_SEED 0xcbf29ce484222325ull
+
+/** @brief 64-bit FNV-1a. Chain calls by passing the previous result as `seed` */
+u64 hash_bytes(const void* data, size_t len, u64 seed);
+u64 hash_str(const char* str, u64 seed);  // NULL hashes like the empty string
+
 // --- Strings
 
 // --- Logging
@@ -255,6 +300,51 @@ typedef struct transform {
   bool is_dirty;
 } transform;
 
+/** @brief Three dimensional axis-aligned bounding box */
+typedef struct bbox_3d {
+  vec3 min;
+  vec3 max;
+} bbox_3d;
+
+/** @brief Plane in the form `dot(normal, p) + distance = 0` */
+typedef struct plane {
+  vec3 normal;
+  f32 distance;
+} plane;
+
+/** @brief Structure-of-arrays storage for many transforms. Each component lives in its own contiguous array so the
+           batched functions below can process 8 transforms per SIMD iteration. Capacity is always a multiple of
+           `SIMD_WIDTH` and unused lanes are zeroed. */
+typedef struct transform_soa {
+  f32* pos_x;
+  f32* pos_y;
+  f32* pos_z;
+  f32* rot_x;
+  f32* rot_y;
+  f32* rot_z;
+  f32* rot_w;
+  f32* scale_x;
+  f32* scale_y;
+  f32* scale_z;
+  size_t count;
+  size_t capacity;
+} transform_soa;
+
+// SIMD lane types. We use the GCC/Clang vector extensions so the same code lowers to SSE/AVX on x86 and NEON on arm64
+#define SIMD_WIDTH 8
+typedef f32 f32x4 __attribute__((vector_size(16)));
+typedef f32 f32x8 __attribute__((vector_size(32)));
+typedef i32 i32x8 __attribute__((vector_size(32)));
+typedef f32 f32x4_unaligned __attribute__((vector_size(16), aligned(4)));
+typedef f32 f32x8_unaligned __attribute__((vector_size(32), aligned(4)));
+
+// macros rather than functions so that wide vectors are never passed by value across an ABI boundary
+#define f32x4_load(ptr) (*(const f32x4_unaligned*)(ptr))
+#define f32x4_store(ptr, v) (*(f32x4_unaligned*)(ptr) = (v))
+#define f32x8_load(ptr) (*(const f32x8_unaligned*)(ptr))
+#define f32x8_store(ptr, v) (*(f32x8_unaligned*)(ptr) = (v))
+#define f32x8_splat(s) ((f32x8){ 0 } + (f32)(s))
+
 _Static_assert(alignof(vec3) == 4, "vec3 is 4 byte aligned");
 _Static_assert(sizeof(vec3) == 12, "vec3 is 12 bytes so has no padding");
 _Static_assert(alignof(vec4) == 4, "vec4 is 4 byte aligned");
@@ -293,6 +383,25 @@ mat4 mat4_look_at(vec3 position, vec3 target, vec3 up);
 inlined transform transform_create(vec3 pos, quat rot, vec3 scale);
 mat4 transform_to_mat(transform* tf);
 
+// batched transform functions
+transform_soa transform_soa_create(size_t capacity);
+void transform_soa_destroy(transform_soa* tfs);
+void transform_soa_reserve(transform_soa* tfs, size_t capacity);
+/** @brief appends a transform, growing the storage if needed, and returns its index */
+size_t transform_soa_push(transform_soa* tfs, transform tf);
+void transform_soa_set(transform_soa* tfs, size_t idx, transform tf);
+transform transform_soa_get(const transform_soa* tfs, size_t idx);
+
+/** @brief equivalent to calling `transform_to_mat` on the first `n` transforms */
+void transforms_to_mats(const transform_soa* tfs, mat4* out, size_t n);
+/** @brief `out[i] = lhs[i] * rhs[i]`. For world matrices pass the locals as `lhs` and parents as `rhs`.
+           `out` may alias either input. */
+void mat4_mult_batch(const mat4* lhs, const mat4* rhs, mat4* out, size_t n);
+/** @brief transforms `n` points (w = 1) by `m`. `out` may alias `in`. */
+void mat4_transform_points(mat4 m, const vec3* in, vec3* out, size_t n);
+/** @brief transforms `n` direction vectors (w = 0) by `m`. `out` may alias `in`. */
+void mat4_transform_vectors(mat4 m, const vec3* in, vec3* out, size_t n);
+
 // helpers
 
 #define vec3(x, y, z) ((vec3){ x, y, z })
@@ -317,10 +426,13 @@ DEFINE_HANDLE(compute_pipeline_handle);
 
 #define MAX_VERTEX_ATTRIBUTES 16
 #define MAX_SHADER_BINDINGS 16
+#define MAX_UNIFORM_SLOTS 4
+#define MAX_FRAMES_IN_FLIGHT 2
 
 // Backend-specific structs
 typedef struct gpu_swapchain gpu_swapchain;
 typedef struct gpu_encoder gpu_encoder;  // Render command encoder
+typedef struct gpu_parallel_encoder gpu_parallel_encoder;  // Render pass recorded as several secondary streams
 typedef struct gpu_compute_encoder gpu_compute_encoder;
 typedef struct gpu_buffer gpu_buffer;
 typedef struct gpu_texture gpu_texture;
@@ -357,6 +469,13 @@ typedef enum vertex_attrib_type {
   ATTR_I32x2,
   ATTR_I32x3,
   ATTR_I32x4,
+  // packed formats written by `geo_quantise`, the shader unpacks them
+  ATTR_U16x4_NORM,  // position relative to the mesh AABB, `w` is 1
+  ATTR_I16x2_NORM,  // octahedral direction
+  ATTR_I8x2_NORM,   // octahedral direction at lower precision
+  ATTR_F16x2,
+  ATTR_U8x4,
+  ATTR_U8x4_NORM,
 } vertex_attrib_type;
 
 typedef struct vertex_desc {
@@ -366,9 +485,35 @@ typedef struct vertex_desc {
   u32 padding;
 } vertex_desc;
 
+u32 vertex_attrib_size(vertex_attrib_type type);
+/** @brief bytes per vertex: the attributes packed back to back plus `padding` */
+u32 vertex_desc_stride(const vertex_desc* desc);
+
+typedef enum index_format { INDEX_FORMAT_U32, INDEX_FORMAT_U16 } index_format;
+
+u32 index_format_size(index_format format);
+
 // Some default formats
 vertex_desc static_3d_vertex_format();
 
+/** @brief what an attribute holds, which decides how `geo_quantise` packs it */
+typedef enum vertex_semantic {
+  VERTEX_SEMANTIC_OTHER,  // copied as is
+  VERTEX_SEMANTIC_POSITION,
+  VERTEX_SEMANTIC_NORMAL,
+  VERTEX_SEMANTIC_TANGENT,  // a 4th component is the bitangent sign
+  VERTEX_SEMANTIC_TEX_COORD,
+  VERTEX_SEMANTIC_JOINTS,
+  VERTEX_SEMANTIC_WEIGHTS,
+} vertex_semantic;
+
+typedef struct vertex_quantise_desc {
+  vertex_semantic semantics[MAX_VERTEX_ATTRIBUTES];  // one per attribute of the geometry's current format
+  bool low_precision_directions;                    // 2x8 bit normals and tangents rather than 2x16
+} vertex_quantise_desc;
+
+vertex_quantise_desc static_3d_quantise_desc();
+
 typedef enum shader_binding_type {
   BINDING_BYTES,
   BINDING_BUFFER,
@@ -435,8 +580,12 @@ typedef struct render_pass_desc {
 // --- RAL Functions
 
 // Resources
+/** @brief creates a CPU-writable buffer. `data` may be NULL to leave the contents uninitialised */
 buf_handle ral_buffer_create(u64 size, const void* data);
 void ral_buffer_destroy(buf_handle handle);
+void ral_buffer_upload(buf_handle handle, u64 offset, u64 size, const void* data);
+/** @brief CPU pointer to the start of the buffer, valid for the buffer's lifetime */
+void* ral_buffer_mapped(buf_handle handle);
 
 tex_handle ral_texture_create(texture_desc desc, bool create_view, const void* data);
 tex_handle ral_texture_load_from_file(const char* filepath);
@@ -452,6 +601,15 @@ void ral_encoder_finish(gpu_encoder* enc);
 void ral_encoder_submit(gpu_encoder* enc);
 void ral_encoder_finish_and_submit(gpu_encoder* enc);
 
+/** @brief begins a render pass whose commands are recorded into secondary streams, possibly from several threads */
+gpu_parallel_encoder* ral_parallel_render_encoder(render_pass_desc rpass_desc);
+/** @brief creates `count` secondary encoders. They execute in array order no matter which thread records them or
+           when, so results are deterministic. Each has its own bind state and must only be used by one thread at a
+           time. The array is owned by `penc` */
+gpu_encoder** ral_parallel_encoder_streams(gpu_parallel_encoder* penc, u32 count);
+/** @brief ends every stream, merges them in order and submits. Frees `penc` and its streams */
+void ral_parallel_encoder_finish_and_submit(gpu_parallel_encoder* penc);
+
 pipeline_handle ral_gfx_pipeline_create(gfx_pipeline_desc desc);
 void ral_gfx_pipeline_destroy(pipeline_handle handle);
 
@@ -461,9 +619,396 @@ void ral_compute_pipeline_destroy(compute_pipeline_handle handle);
 // Encoding
 void ral_encode_bind_pipeline(gpu_encoder* enc, pipeline_handle pipeline);
 void ral_encode_set_vertex_buf(gpu_encoder* enc, buf_handle vbuf);
-void ral_encode_set_index_buf(gpu_encoder* enc, buf_handle ibuf);
+/** @brief binds vertices that start `offset` bytes into `vbuf`, e.g. a mesh suballocated from a `gpu_heap` */
+void ral_encode_set_vertex_buf_offset(gpu_encoder* enc, buf_handle vbuf, u64 offset);
+void ral_encode_set_index_buf(gpu_encoder* enc, buf_handle ibuf, index_format format);
 void ral_encode_set_texture(gpu_encoder* enc, tex_handle texture, u32 slot);
+/** @brief binds `buf` at `offset` as the uniform block in `slot` for the given stages. Rebinding the same buffer at a
+           new offset only updates the offset, which is what makes suballocated uniforms cheap */
+void ral_encode_set_uniforms(gpu_encoder* enc, buf_handle buf, u64 offset, u32 slot, shader_stage stages);
 void ral_encode_draw_tris(gpu_encoder* enc, size_t start, size_t count);
+/** @brief binds per-instance vertex data, read with a per-instance step rate in the vertex shader */
+void ral_encode_set_instance_buf(gpu_encoder* enc, buf_handle buf, u64 offset);
+void ral_encode_draw_tris_instanced(gpu_encoder* enc, size_t start, size_t count, u32 instance_count,
+                                    u32 first_instance);
+/** @brief draws indices from the buffer bound with `ral_encode_set_index_buf`. `first_index` is in indices */
+void ral_encode_draw_indexed_tris_instanced(gpu_encoder* enc, u32 first_index, u32 index_count, u32 instance_count,
+                                            u32 first_instance);
+
+/** @brief GPU-readable arguments for one indexed draw, laid out like VkDrawIndexedIndirectCommand and
+           MTLDrawIndexedPrimitivesIndirectArguments */
+typedef struct draw_indexed_indirect_args {
+  u32 index_count;
+  u32 instance_count;
+  u32 first_index;
+  i32 base_vertex;
+  u32 first_instance;
+} draw_indexed_indirect_args;
+
+/** @brief issues `draw_count` indexed draws whose arguments are read from `args_buf` starting at `offset`, `stride`
+           bytes apart. Uses the index buffer bound with `ral_encode_set_index_buf` */
+void ral_encode_multi_draw_indexed_indirect(gpu_encoder* enc, buf_handle args_buf, u64 offset, u32 draw_count,
+                                            u32 stride);
+
+// Redundant state filtering
+
+/** @brief per-encoder counters of binds forwarded to the backend vs. dropped because the state was already bound */
+typedef struct gpu_encoder_stats {
+  u32 binds_issued;
+  u32 binds_elided;
+} gpu_encoder_stats;
+
+/** @brief shadow copy of the state an encoder currently has bound. Backends embed one in their encoder and check it
+           before forwarding a bind so repeated binds of the same resource never reach the graphics API */
+typedef struct gpu_bind_state {
+  u32 valid;  // one bit per slot. a clear bit means unknown, so the next bind to that slot always goes through
+  pipeline_handle pipeline;
+  buf_handle vertex_buf;
+  u64 vertex_offset;
+  buf_handle index_buf;
+  buf_handle instance_buf;
+  u64 instance_offset;
+  tex_handle textures[MAX_SHADER_BINDINGS];
+  buf_handle uniform_bufs[MAX_UNIFORM_SLOTS];
+  u64 uniform_offsets[MAX_UNIFORM_SLOTS];
+  shader_stage uniform_stages[MAX_UNIFORM_SLOTS];  // stages that have uniform_bufs[i] bound at uniform_offsets[i]
+  gpu_encoder_stats stats;
+} gpu_bind_state;
+
+typedef enum gpu_bind_action {
+  BIND_ELIDE,        // already bound, skip
+  BIND_FULL,         // bind the resource
+  BIND_OFFSET_ONLY,  // same buffer is bound, only move its offset
+} gpu_bind_action;
+
+/** @brief forget everything that is bound, e.g. when a new pass starts. Stats are kept */
+void gpu_bind_state_invalidate(gpu_bind_state* state);
+// Each of these records the bind and returns true if it has to be issued to the backend
+bool gpu_bind_state_pipeline(gpu_bind_state* state, pipeline_handle pipeline);
+gpu_bind_action gpu_bind_state_vertex_buf(gpu_bind_state* state, buf_handle vbuf, u64 offset);
+bool gpu_bind_state_index_buf(gpu_bind_state* state, buf_handle ibuf);
+bool gpu_bind_state_instance_buf(gpu_bind_state* state, buf_handle buf, u64 offset);
+bool gpu_bind_state_texture(gpu_bind_state* state, tex_handle texture, u32 slot);
+/** @brief a slot is only elided or moved by offset if every stage in `stages` already has the buffer bound */
+gpu_bind_action gpu_bind_state_uniforms(gpu_bind_state* state, buf_handle buf, u64 offset, u32 slot,
+                                        shader_stage stages);
+
+// Per-frame uniform ring
+
+/** @brief A persistently mapped buffer split into one region per frame in flight. Uniforms for a frame are
+           bump-allocated from that frame's region and bound by offset, so per-draw cost is a pointer bump plus a
+           write into mapped memory. Allocation is lock-free so parallel recorders can share one ring. */
+typedef struct uniform_ring {
+  buf_handle buffer;
+  u8* mapped;
+  u64 frame_size;  // bytes per frame region
+  u32 alignment;   // minimum offset alignment for uniform binds on the backend
+  u32 frame_index;
+  _Atomic u64 head;  // bytes used in the current region
+} uniform_ring;
+
+/** @brief a block of mapped memory inside the ring and the buffer offset to bind it at. `ptr` is NULL if full */
+typedef struct uniform_alloc {
+  void* ptr;
+  u64 offset;
+} uniform_alloc;
+
+uniform_ring uniform_ring_create(u64 frame_size, u32 alignment);
+void uniform_ring_destroy(uniform_ring* ring);
+/** @brief starts writing into the region for `frame_index`. The caller must know the GPU is done with it, which holds
+           as long as we don't run more than MAX_FRAMES_IN_FLIGHT frames ahead */
+void uniform_ring_begin_frame(uniform_ring* ring, u32 frame_index);
+uniform_alloc uniform_ring_alloc(uniform_ring* ring, u64 size);
+/** @brief copies `size` bytes in and returns the offset to bind, or UINT64_MAX if the ring is full */
+u64 uniform_ring_push(uniform_ring* ring, const void* data, u64 size);
+/** @brief Allocates `count` elements in one go with each element padded out to the bind alignment. Element `i` lives
+           at `ptr + i * stride` and binds at `offset + i * stride`. */
+uniform_alloc uniform_ring_alloc_array(uniform_ring* ring, u64 elem_size, u32 count, u64* out_stride);
+/** @brief Writes many draws' uniforms at once. `data` is `count` elements of `elem_size` packed tightly; if that size
+           is already aligned this is a single memcpy. */
+uniform_alloc uniform_ring_push_array(uniform_ring* ring, const void* data, u64 elem_size, u32 count,
+                                      u64* out_stride);
+
+gpu_encoder_stats ral_encoder_stats(gpu_encoder* enc);
+/** @brief stats summed over all streams */
+gpu_encoder_stats ral_parallel_encoder_stats(gpu_parallel_encoder* penc);
+
+// Shader data cache
+
+/** @brief called when a cached backend object is evicted or invalidated so the backend can free it */
+typedef void (*shader_data_release_fn)(u64 payload, void* user_data);
+
+typedef struct shader_data_cache_entry {
+  u64 key;  // 0 means empty
+  u64 payload;
+  u64 last_used_frame;
+  u32 refs[MAX_SHADER_BINDINGS];  // raw handles of the buffers/textures the entry points at
+  u16 texture_refs;               // bit set if refs[i] is a texture rather than a buffer
+  u16 ref_count;
+} shader_data_cache_entry;
+
+/** @brief Maps the resources bound by a `shader_data_layout` to a backend object that binds them (a descriptor set, an
+           argument buffer...) so identical bindings reuse one object across draws and frames. Entries that go unused
+           age out least-recently-used first, and destroying a resource drops every entry that references it. */
+typedef struct shader_data_cache {
+  shader_data_cache_entry* entries;
+  u32 capacity;  // power of two
+  u32 count;
+  shader_data_release_fn release;
+  void* user_data;
+  u64 hits;
+  u64 misses;
+  u64 evictions;
+} shader_data_cache;
+
+shader_data_cache shader_data_cache_create(u32 capacity, shader_data_release_fn release, void* user_data);
+void shader_data_cache_destroy(shader_data_cache* cache);
+/** @brief hashes what a layout binds: binding types, stages and buffer/texture handles. Inline bytes only contribute
+           their size as their contents go through the uniform ring rather than the cached object */
+u64 shader_data_layout_hash(const shader_data_layout* layout);
+/** @brief looks up a layout by its hash, marking the entry used on `frame` */
+bool shader_data_cache_get(shader_data_cache* cache, const shader_data_layout* layout, u64 hash, u64 frame,
+                           u64* out_payload);
+/** @brief Inserts the backend object for a layout. When the table is full the least recently used entry that the GPU
+           can no longer be reading (older than MAX_FRAMES_IN_FLIGHT) is evicted; returns false if there is none */
+bool shader_data_cache_put(shader_data_cache* cache, const shader_data_layout* layout, u64 hash, u64 frame,
+                           u64 payload);
+/** @brief evicts entries not used in the last `max_age` frames. Call once per frame */
+void shader_data_cache_trim(shader_data_cache* cache, u64 frame, u32 max_age);
+void shader_data_cache_invalidate_buffer(shader_data_cache* cache, buf_handle buf);
+void shader_data_cache_invalidate_texture(shader_data_cache* cache, tex_handle tex);
+
+// Pipeline cache
+
+#define PIPELINE_CACHE_DIR "build/pipeline_cache"
+#define MAX_CACHED_PIPELINES 256
+
+typedef struct pipeline_cache_entry {
+  u64 key;
+  gfx_pipeline_desc desc;  // owned copy of the hashed fields, checked on every hash hit
+  pipeline_handle handle;
+  u32 ref_count;
+} pipeline_cache_entry;
+
+/** @brief Lets backends hand out one pipeline per distinct `gfx_pipeline_desc`. Shared handles are ref counted so a
+           destroy only really destroys once the last user lets go */
+typedef struct pipeline_dedup {
+  pipeline_cache_entry entries[MAX_CACHED_PIPELINES];
+  u32 count;
+  u32 hits;
+} pipeline_dedup;
+
+/** @brief hashes everything that affects the compiled pipeline: vertex layout, shader sources, entry points and
+           stages. Debug labels are left out so identically configured pipelines match */
+u64 gfx_pipeline_desc_hash(const gfx_pipeline_desc* desc);
+/** @brief on a hit (same hash and the same hashed fields) takes another reference to the existing pipeline */
+bool pipeline_dedup_acquire(pipeline_dedup* dedup, const gfx_pipeline_desc* desc, u64 hash,
+                            pipeline_handle* out_handle);
+void pipeline_dedup_insert(pipeline_dedup* dedup, const gfx_pipeline_desc* desc, u64 hash, pipeline_handle handle);
+/** @brief drops a reference. Returns true if the backend should now destroy the pipeline */
+bool pipeline_dedup_release(pipeline_dedup* dedup, pipeline_handle handle);
+
+/** @brief path of the on-disk cache file a backend keeps for a pipeline hash, e.g. a Metal binary archive */
+void pipeline_cache_path(u64 hash, const char* extension, char* out_path, size_t out_len);
+/** @brief creates PIPELINE_CACHE_DIR. Call before writing a cache file */
+void pipeline_cache_make_dir();
+
+// GPU memory sub-allocation
+
+/* Offset allocator: a two-level segregated fit (TLSF) allocator that hands out ranges of an abstract address space.
+   Free ranges live in 256 size bins (32 top-level bins, each split into 8 linear sub-bins) with a bitmask per level,
+   so both allocation and free are O(1). It only does bookkeeping so it can sit on top of any backing memory. */
+
+#define OFFSET_ALLOC_TOP_BINS 32
+#define OFFSET_ALLOC_BINS_PER_LEAF 8
+#define OFFSET_ALLOC_LEAF_BINS (OFFSET_ALLOC_TOP_BINS * OFFSET_ALLOC_BINS_PER_LEAF)
+#define OFFSET_ALLOC_NO_SPACE UINT32_MAX
+
+typedef struct offset_allocator_node offset_allocator_node;
+
+typedef struct offset_alloc {
+  u32 offset;    // OFFSET_ALLOC_NO_SPACE on failure
+  u32 metadata;  // node index, needed to free
+} offset_alloc;
+
+typedef struct offset_allocator {
+  u32 size;
+  u32 max_allocs;
+  u32 free_storage;
+  u32 used_bins_top;
+  u8 used_bins[OFFSET_ALLOC_TOP_BINS];
+  u32 bin_indices[OFFSET_ALLOC_LEAF_BINS];  // head of each bin's free list
+  offset_allocator_node* nodes;
+  u32* free_nodes;
+  u32 free_node_count;
+} offset_allocator;
+
+typedef struct offset_allocator_stats {
+  u32 total_free;
+  u32 largest_free;
+  u32 free_region_count;
+  f32 fragmentation;  // 1 - largest_free / total_free. 0 when all free space is one contiguous range
+} offset_allocator_stats;
+
+/** @brief manages `[0, size)`. `max_allocs` bounds the number of live allocations plus free ranges */
+offset_allocator offset_allocator_create(u32 size, u32 max_allocs);
+void offset_allocator_destroy(offset_allocator* allocator);
+offset_alloc offset_allocator_alloc(offset_allocator* allocator, u32 size);
+/** @brief frees and merges with free neighbours */
+void offset_allocator_free(offset_allocator* allocator, offset_alloc allocation);
+offset_allocator_stats offset_allocator_get_stats(const offset_allocator* allocator);
+
+#define GPU_HEAP_MAX_BLOCKS 32
+
+typedef struct gpu_heap_block {
+  buf_handle buffer;
+  offset_allocator allocator;  // in units of the heap alignment
+} gpu_heap_block;
+
+/** @brief Suballocates buffers out of a few large GPU buffers so e.g. every mesh doesn't become its own allocation.
+           The RAL only exposes one (CPU visible) memory type, if more get added use one heap per type. Textures aren't
+           placed in it as the RAL has no way to create a texture inside an existing allocation */
+typedef struct gpu_heap {
+  gpu_heap_block blocks[GPU_HEAP_MAX_BLOCKS];
+  u32 block_count;
+  u64 block_size;
+  u32 alignment;
+  u32 max_allocs_per_block;
+} gpu_heap;
+
+typedef struct gpu_suballoc {
+  buf_handle buffer;
+  u64 offset;
+  u64 size;
+  u32 block;     // UINT32_MAX if allocation failed
+  u32 metadata;  // allocator node
+} gpu_suballoc;
+
+typedef struct gpu_heap_stats {
+  u32 block_count;
+  u64 reserved_bytes;
+  u64 free_bytes;
+  u64 largest_free;
+  f32 fragmentation;  // worst block
+} gpu_heap_stats;
+
+gpu_heap gpu_heap_create(u64 block_size, u32 alignment, u32 max_allocs_per_block);
+void gpu_heap_destroy(gpu_heap* heap);
+/** @brief Allocates from the first block with room, creating a block if none has. Requests bigger than a block get a
+           block of their own */
+gpu_suballoc gpu_heap_alloc(gpu_heap* heap, u64 size);
+void gpu_heap_free(gpu_heap* heap, gpu_suballoc allocation);
+gpu_heap_stats gpu_heap_get_stats(const gpu_heap* heap);
+
+// Staging uploads
+
+typedef enum gpu_copy_kind { COPY_BUFFER_TO_BUFFER, COPY_BUFFER_TO_TEXTURE } gpu_copy_kind;
+
+/** @brief one copy out of a staging buffer */
+typedef struct gpu_copy_region {
+  gpu_copy_kind kind;
+  u64 src_offset;
+  u64 size;
+  buf_handle dst_buf;
+  u64 dst_offset;
+  tex_handle dst_tex;
+  u32 width, height, bytes_per_row;  // textures only
+} gpu_copy_region;
+
+typedef void (*gpu_copies_done_fn)(void* user_data, u64 batch_id);
+
+/** @brief Records every copy into one command buffer and submits it without waiting. `done` is called once the GPU
+           has finished, possibly from another thread */
+void ral_submit_copies(buf_handle staging, const gpu_copy_region* regions, u32 count, gpu_copies_done_fn done,
+                       void* user_data, u64 batch_id);
+
+#define UPLOAD_QUEUE_MAX_PENDING 4096
+#define UPLOAD_QUEUE_MAX_BATCHES 16
+
+typedef u64 upload_ticket;  // 0 means the upload couldn't be queued
+
+typedef struct upload_batch {
+  upload_ticket last_ticket;
+  u64 ring_end;      // staging bytes before this point can be reused once the batch is done
+  atomic_uint done;  // written by the completion callback
+} upload_batch;
+
+/** @brief Streams data to the GPU through a staging ring buffer. Enqueueing copies the data in straight away so the
+           caller can free it. `upload_queue_flush` submits the queued copies, up to the per-frame byte budget, as a
+           single command buffer and `upload_queue_poll` notices finished batches without ever blocking. The queue is
+           handed to the completion callback so it mustn't move while uploads are in flight */
+typedef struct upload_queue {
+  buf_handle staging;
+  u8* mapped;
+  u64 capacity;
+  u64 head;  // bytes ever written, the ring position is head % capacity
+  u64 tail;  // bytes ever released
+  u64 frame_budget;
+  gpu_copy_region* pending;  // FIFO, tickets are consecutive from `pending_first_ticket`
+  u64* pending_ring_ends;
+  u32 pending_count;
+  upload_ticket pending_first_ticket;
+  upload_batch batches[UPLOAD_QUEUE_MAX_BATCHES];
+  u32 batch_first;
+  u32 batch_count;
+  upload_ticket completed_ticket;
+} upload_queue;
+
+/** @brief `frame_budget` caps the bytes submitted per flush, 0 for no cap */
+upload_queue upload_queue_create(u64 staging_size, u64 frame_budget);
+void upload_queue_destroy(upload_queue* queue);
+upload_ticket upload_queue_buffer(upload_queue* queue, buf_handle dst, u64 dst_offset, const void* data, u64 size);
+/** @brief uploads a whole 2D texture; `data` is tightly packed rows */
+upload_ticket upload_queue_texture(upload_queue* queue, tex_handle dst, u32 width, u32 height, u32 bytes_per_pixel,
+                                   const void* data);
+/** @brief submits queued copies (at least one, then as many as fit the budget). Returns how many were submitted */
+u32 upload_queue_flush(upload_queue* queue);
+/** @brief retires finished batches and frees their staging space */
+void upload_queue_poll(upload_queue* queue);
+bool upload_queue_is_complete(const upload_queue* queue, upload_ticket ticket);
+
+// Deferred destruction
+
+#define DEFERRED_DESTROY_CAPACITY 4096  // power of two
+
+typedef enum gpu_resource_kind {
+  GPU_RESOURCE_BUFFER,
+  GPU_RESOURCE_TEXTURE,
+  GPU_RESOURCE_PIPELINE,
+} gpu_resource_kind;
+
+typedef struct deferred_destroy_cell {
+  _Atomic u64 sequence;  // tells producers and the consumer whose turn the cell is
+  u64 frame;
+  gpu_resource_kind kind;
+  u32 handle;
+} deferred_destroy_cell;
+
+/** @brief A bounded lock-free queue of resources waiting for the GPU to finish with them. Any thread can push;
+           each entry is stamped with the frame it was destroyed in. One thread (the one that owns the backend)
+           collects entries whose frame has retired */
+typedef struct deferred_destroy_queue {
+  deferred_destroy_cell cells[DEFERRED_DESTROY_CAPACITY];
+  _Atomic u64 enqueue_pos;
+  u64 dequeue_pos;  // only touched by the collecting thread
+  _Atomic u64 current_frame;
+} deferred_destroy_queue;
+
+typedef void (*deferred_destroy_fn)(gpu_resource_kind kind, u32 handle, void* user_data);
+
+void deferred_destroy_init(deferred_destroy_queue* queue);
+/** @brief safe from any thread. Returns false if the queue is full */
+bool deferred_destroy_push(deferred_destroy_queue* queue, gpu_resource_kind kind, u32 handle);
+/** @brief sets the frame stamped on entries pushed from now on */
+void deferred_destroy_begin_frame(deferred_destroy_queue* queue, u64 frame);
+/** @brief destroys everything pushed in or before `completed_frame`. Only call from one thread. Returns the count */
+u32 deferred_destroy_collect(deferred_destroy_queue* queue, u64 completed_frame, deferred_destroy_fn destroy,
+                             void* user_data);
+
+/** @brief destroy once the GPU has finished every frame that could still be using the resource. Any thread */
+void ral_buffer_destroy_deferred(buf_handle handle);
+void ral_texture_destroy_deferred(tex_handle handle);
+void ral_gfx_pipeline_destroy_deferred(pipeline_handle handle);
 
 // Backend lifecycle
 void ral_backend_init(const char* window_name, struct GLFWwindow* window);
@@ -488,27 +1033,117 @@ DEFINE_HANDLE(mesh_handle);
 DEFINE_HANDLE(material_handle);
 DEFINE_HANDLE(model_handle);
 
+#define MAX_MESH_LODS 8
+
+/** @brief one level of detail: a range of the geometry's indices over the same vertices as every other level */
+typedef struct mesh_lod {
+  u32 first_index;
+  u32 index_count;
+  f32 error;  // deviation from the full detail level, relative to the bounding sphere radius
+} mesh_lod;
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+/** @brief a small cluster of triangles, contiguous in the geometry's indices */
+typedef struct meshlet {
+  u32 first_index;
+  u16 vertex_count;
+  u16 triangle_count;
+} meshlet;
+
+/** @brief Meshlets plus their object-space bounds in SoA form so they can be culled 8 at a time. The bound arrays
+           are padded to a multiple of `SIMD_WIDTH`. Backfacing clusters are found with the normal cone: the cluster
+           is entirely backfacing when `dot(center - eye, cone_axis) >= cone_cutoff * |center - eye| + radius` */
+typedef struct meshlet_set {
+  meshlet* meshlets;
+  u32 count;
+  f32* center_x;
+  f32* center_y;
+  f32* center_z;
+  f32* radius;
+  f32* cone_axis_x;
+  f32* cone_axis_y;
+  f32* cone_axis_z;
+  f32* cone_cutoff;  // 1 when the normals spread too far for the cone to ever cull
+} meshlet_set;
+
 typedef struct geometry {
   vertex_desc vertex_format;
   void* vertex_data;
+  u32 vertex_count;
   bool has_indices;  // When this is false indexed drawing is not used
-  u32_darray* indices;
+  index_format index_format;
+  void* indices;  // `u32`s or `u16`s depending on `index_format`
+  u32 index_count;  // across every level of detail
+  mesh_lod lods[MAX_MESH_LODS];  // finest first
+  u32 lod_count;                 // 0 when the geometry is a single level covering all of its indices
+  meshlet_set meshlets;          // covering the full detail level, empty until `geo_build_meshlets`
+  // `geo_quantise` stores positions in [0, 1] across the AABB, the object-space position is `offset + q * scale`.
+  // Zero scale means positions aren't quantised
+  vec3 position_offset;
+  vec3 position_scale;
 } geometry;
 
+/** @brief the draw range of a level, clamped to the coarsest available. Non-indexed geometry counts vertices */
+mesh_lod geo_lod(const geometry* geo, u32 level);
+
 typedef u32 joint_idx;
+#define MAX_JOINTS 256  // `geo_quantise` packs joint indices into a byte
+#define JOINT_NO_PARENT UINT32_MAX
+#define ARMATURE_NEVER_EVALUATED UINT64_MAX
+
+/** @brief A skeleton as flat arrays in parent-before-child order, sorted once by `armature_create`, so a pose is
+           evaluated in one linear pass. Animation writes `local_pose` and `armatures_evaluate_poses` turns it into
+           a skinning palette once per frame, which every pass drawing the skeleton then shares */
 typedef struct armature {
+  joint_idx* parents;  // `JOINT_NO_PARENT` for roots, otherwise an earlier joint
+  transform_soa local_pose;
+  mat4* inverse_bind;
+  mat4* model_pose;  // joint to armature space as of the last evaluation
+  u32 joint_count;
+  u64 evaluated_frame;
+  u32 palette_offset;  // where the last evaluation put this armature's palette in the frame's `skinning_palettes`
 } armature;
 
+/** @brief Sorts the joints so parents come before children, keeping siblings in their original order.
+    @param joint_remap optional, receives the sorted index of each input joint so vertex joint indices and animation
+           targets can be rewritten to match */
+armature armature_create(const joint_idx* parents, const transform* bind_pose, const mat4* inverse_bind,
+                         u32 joint_count, joint_idx* joint_remap);
+void armature_destroy(armature* arm);
+
 /** @brief Mesh data that has been uploaded to GPU and is ready to be rendered each frame
            Gets stored in a pool */
 typedef struct mesh {
   buf_handle vertex_buffer;
   buf_handle index_buffer;
+  u64 vertex_offset;  // byte offsets into the buffers, non-zero when they are suballocated from a `gpu_heap`
+  u64 index_offset;
   // todo: material?
   geometry geo;  // the originating mesh data
   const armature* skinning_data;
 } mesh;
 
+typedef enum render_ent_flag {
+  REND_ENT_CASTS_SHADOWS = 1 << 0,
+  REND_ENT_VISIBLE = 1 << 1,
+  REND_ENT_TRANSPARENT = 1 << 2,
+} render_ent_flag;
+typedef u32 render_ent_flags;
+
+/** @brief A renderable 'thing' */
+typedef struct render_ent {
+  mesh_handle mesh;
+  material_handle material;
+  /** If NULL, no armature and the mesh is static geometry, else it is to be skinned */
+  armature* armature;
+  mat4 affine;
+  bbox_3d bounding_box;  // local space
+  render_ent_flags flags;
+  u8 lod;  // level of detail picked by `render_ents_select_lods`, kept between frames for its hysteresis
+} render_ent;
+
 typedef struct draw_mesh_cmd {
   mesh_handle mesh;
   mat4 transform;
@@ -529,6 +1164,71 @@ geometry geo_ico_sphere(f32 radius, f32 n_subdivisions);
 void geo_scale_uniform(geometry* geo, f32 scale);
 void geo_scale_xyz(geometry* geo, vec3 scale_xyz);
 
+// --- Mesh optimisation
+
+#define VERTEX_CACHE_SIZE 16  // post-transform cache size that the reordering targets and the stats simulate
+
+typedef struct mesh_opt_stats {
+  u32 vertices_before;
+  u32 vertices_after;
+  u64 bytes_before;  // vertex plus index data
+  u64 bytes_after;
+  f32 acmr_before;  // average cache miss ratio: vertex shader invocations per triangle, 0.5 at best and 3 at worst
+  f32 acmr_after;
+} mesh_opt_stats;
+
+/** @brief Import-time optimisation, in place. Merges duplicate vertices and generates indices, reorders triangles
+           for the post-transform cache (Tipsify) and then whole clusters of them to cut overdraw, reorders vertices
+           into first-use order for fetch locality and drops to 16-bit indices when there are few enough vertices.
+           The overdraw pass needs a float position as the first attribute and is skipped otherwise.
+           `vertex_data` and `indices` must be malloc'd, like the `geo_*` generators do, as they are replaced */
+mesh_opt_stats geo_optimise(geometry* geo);
+
+/** @brief simulates a FIFO post-transform cache. `indices` may be NULL for non-indexed triangles */
+f32 mesh_acmr(const u32* indices, u32 index_count, u32 cache_size);
+
+/** @brief reorders triangles for the post-transform cache only, `dst` must not alias `indices` */
+void mesh_optimise_vertex_cache(u32* dst, const u32* indices, u32 index_count, u32 vertex_count);
+
+// --- Level of detail generation
+
+typedef struct lod_chain_desc {
+  u32 level_count;                // including the full detail level, at most `MAX_MESH_LODS`
+  f32 triangle_ratio;             // each level aims for this fraction of the previous level's triangles
+  f32 max_error[MAX_MESH_LODS];   // per level, relative to the bounding sphere radius. Zero means unlimited
+  f32 attribute_weight;           // how much a collapse that changes non-position float attributes costs
+} lod_chain_desc;
+
+/** @brief Builds a chain of simplified levels with quadric error metrics (Garland and Heckbert). Collapses move a
+           vertex onto a neighbour so every level reuses the full detail vertices and only adds indices. Vertices on
+           open borders or attribute seams are never moved, which keeps outlines and UV islands intact. Levels stop
+           once one can't meet its triangle target within its error limit. Run `geo_optimise` first, the geometry
+           must be indexed with a float position as its first attribute and its `indices` malloc'd */
+void geo_generate_lods(geometry* geo, const lod_chain_desc* desc);
+
+// --- Meshlets
+
+/** @brief Splits the full detail level into meshlets of at most `MESHLET_MAX_VERTICES` vertices and
+           `MESHLET_MAX_TRIANGLES` triangles and reorders its triangles so each meshlet is a contiguous index range.
+           Meshlets grow greedily across shared edges, preferring triangles that add the fewest vertices and then the
+           ones closest to the meshlet, which keeps them compact and their normal cones tight. Needs indices and a
+           float position as the first attribute */
+void geo_build_meshlets(geometry* geo);
+void meshlet_set_destroy(meshlet_set* set);
+
+// --- Vertex quantisation
+
+/** @brief Repacks the vertices into compact attribute formats, in place. Positions become 16-bit unorm across the
+           AABB, normals and tangents octahedral snorm pairs, tex coords half floats, joints u8 and weights unorm8
+           renormalised to sum to 1. A tangent's bitangent sign moves into the sign of its second component, whose
+           magnitude is remapped to [0, 1]. Conversion runs 8 vertices at a time. Run it last at import, the other
+           `geo_*` passes expect float positions, and `vertex_data` must be malloc'd as it is replaced */
+void geo_quantise(geometry* geo, const vertex_quantise_desc* desc);
+
+/** @brief the unit vector a pair of octahedral components encodes, what shaders do to unpack normals */
+vec3 oct_decode(f32 x, f32 y);
+f32 f16_to_f32(u16 half);
+
 // --- Renderer
 
 // void renderer_init(renderer* rend);
@@ -546,10 +1246,562 @@ typedef struct camera {
 /** @brief calculates the view and projection matrices for a camera  */
 mat4 camera_view_proj(camera camera, f32 lens_height, f32 lens_width, mat4* out_view, mat4* out_proj);
 
+// --- Culling
+
+typedef struct frustum {
+  plane planes[6];  // left, right, bottom, top, near, far. normals point inwards
+} frustum;
+
+/** @brief extracts normalised frustum planes from a combined view-projection matrix e.g. from `camera_view_proj` */
+frustum frustum_from_view_proj(mat4 view_proj);
+
+/** @brief a camera or shadow view that objects get culled against */
+typedef struct cull_view {
+  frustum frustum;
+  render_ent_flags required_flags;  // e.g. `REND_ENT_CASTS_SHADOWS` for shadow views. ignored if bounds have no flags
+} cull_view;
+
+/** @brief World-space bounding volumes in SoA form so they can be tested 8 at a time.
+           Arrays are padded to a multiple of `SIMD_WIDTH`. The `extent_*` arrays (AABB half sizes) and `flags` are
+           optional; when NULL only the bounding spheres are tested. */
+typedef struct cull_bounds_soa {
+  f32* center_x;
+  f32* center_y;
+  f32* center_z;
+  f32* radius;
+  f32* extent_x;
+  f32* extent_y;
+  f32* extent_z;
+  render_ent_flags* flags;
+  u32 count;
+} cull_bounds_soa;
+
+typedef struct cull_result {
+  u32* visible_indices;  // allocated on the frame arena
+  u32 n_visible;
+  u32 n_culled;
+} cull_result;
+
+/** @brief builds world-space bounds for each entity from its local `bounding_box` and `affine` */
+cull_bounds_soa cull_bounds_from_render_ents(const render_ent* entities, u32 entity_count, arena* frame_arena);
+/** @brief writes the world-space bounds of one entity into slot `i`. `b` must have extents and flags */
+void cull_bounds_write_render_ent(cull_bounds_soa* b, u32 i, const render_ent* ent);
+/** @brief builds world-space bounding spheres from draw commands */
+cull_bounds_soa cull_bounds_from_draw_cmds(const draw_mesh_cmd* cmds, u32 cmd_count, arena* frame_arena);
+
+/** @brief Tests every bound against all views in one pass, split into parallel chunks over the job system.
+           Writes one `cull_result` per view into `out_results` with indices in ascending order. */
+void frustum_cull(const cull_bounds_soa* bounds, const cull_view* views, u32 view_count, arena* frame_arena,
+                  cull_result* out_results);
+
+// --- Occlusion culling
+
+#define OCCLUSION_TILE_SIZE 8
+#define MAX_OCCLUDERS 64
+
+/** @brief Occluder triangles in object space. Can be an authored low-poly proxy or CPU-side mesh positions. */
+typedef struct occluder_mesh {
+  const vec3* positions;
+  u32 vertex_count;
+  const u32* indices;  // NULL = non-indexed triangle list
+  u32 index_count;
+  mat4 affine;
+} occluder_mesh;
+
+/** @brief Low resolution software depth buffer with a hierarchical level holding the farthest depth of each tile */
+typedef struct occlusion_buffer {
+  u32 width, height;  // width must be a multiple of `SIMD_WIDTH`, both a multiple of `OCCLUSION_TILE_SIZE`
+  u32 tiles_x, tiles_y;
+  f32* depth;           // nearest occluder depth per pixel, 0 = near plane, 1 = far/empty
+  f32* tile_max_depth;  // farthest depth in each tile
+  mat4 view_proj;
+  // scratch storage for screen-space triangles, reused between frames
+  void* tris;
+  u32 tri_count;
+  u32 tri_capacity;
+} occlusion_buffer;
+
+occlusion_buffer occlusion_buffer_create(u32 width, u32 height);
+void occlusion_buffer_destroy(occlusion_buffer* ob);
+
+/** @brief picks up to `max_occluders` of the `candidates` (indices into `bounds`) with the largest angular size that
+           are at least `min_angular_size` (bounding radius / view depth). Returns the number written to `out_indices`,
+           largest first. */
+u32 occlusion_select_occluders(const cull_bounds_soa* bounds, const u32* candidates, u32 candidate_count,
+                               mat4 view_proj, f32 min_angular_size, u32* out_indices, u32 max_occluders);
+
+/** @brief clears the buffer and rasterises the occluders into it in parallel screen bands */
+void occlusion_rasterize(occlusion_buffer* ob, mat4 view_proj, const occluder_mesh* occluders, u32 occluder_count);
+
+/** @brief returns true if any part of the world-space box could be visible */
+bool occlusion_test_aabb(const occlusion_buffer* ob, bbox_3d world_box);
+
+/** @brief removes occluded entries from a frustum `cull_result` in place, keeping the order. Bounds must have
+           extents. */
+void occlusion_cull(const occlusion_buffer* ob, const cull_bounds_soa* bounds, arena* frame_arena,
+                    cull_result* result);
+
+// --- Cluster culling
+
+typedef struct index_range {
+  u32 first_index;
+  u32 index_count;
+} index_range;
+
+typedef struct meshlet_cull_result {
+  index_range* ranges;  // into the geometry's indices in meshlet order with neighbouring meshlets merged
+  u32 range_count;
+  u32 n_visible;  // meshlets
+  u32 n_frustum_culled;
+  u32 n_backface_culled;
+  u32 n_occlusion_culled;
+} meshlet_cull_result;
+
+/** @brief Culls one instance's meshlets against the frustum, their normal cones and optionally an occlusion buffer.
+           Bounds are tested 8 at a time in object space, with the frustum brought into object space once per call,
+           and chunks of meshlets run in parallel over the job system. The cone test is skipped when `affine` scales
+           unevenly as the cones don't survive that. Ranges are allocated on the frame arena.
+    @param ob NULL skips occlusion culling */
+meshlet_cull_result meshlet_cull(const meshlet_set* set, mat4 affine, const frustum* frustum, vec3 eye,
+                                 const occlusion_buffer* ob, arena* frame_arena);
+
+// --- Level of detail selection
+
+/** @brief Picks the coarsest level whose error, projected from the bounding sphere's screen size, stays under
+           `max_error_px` pixels. A level only changes once the error moves `hysteresis` (a fraction) past the limit
+           so objects near a boundary don't flicker between levels.
+    @param bounds world-space bounds indexed like `entities`, e.g. the ones the view was culled with
+    @param meshes mesh storage indexed by `mesh_handle.raw` */
+void render_ents_select_lods(render_ent* entities, const cull_bounds_soa* bounds, const cull_result* visible,
+                             const mesh* meshes, camera cam, f32 viewport_height, f32 max_error_px, f32 hysteresis);
+
+// --- Render world
+
+DEFINE_HANDLE(render_proxy);
+
+/** @brief Retained set of renderables. Proxies are added once per mesh instance and then only touched when
+           something about them changes; edits go on a dirty list and `render_world_update` refreshes just those
+           proxies' culling bounds. Storage is split by consumer: `bounds` is the SoA culling data `frustum_cull`
+           reads directly, `ents` the per-draw records the render queue gathers from. Both are dense and share
+           indices, so cull results index straight into `ents` */
+typedef struct render_world {
+  render_ent* ents;
+  cull_bounds_soa bounds;
+  u32 count;
+  u32 capacity;
+  u32* dense_to_proxy;
+  u8* dirty_flags;  // dense, set while the proxy is on the dirty list
+  // sparse, indexed by handle
+  u32* proxy_to_dense;  // dense index for live handles, next free handle for free ones
+  u32 proxy_count;
+  u32 proxy_capacity;
+  u32 free_proxy;
+  render_proxy* dirty;
+  u32 dirty_count;
+} render_world;
+
+render_world render_world_create(u32 capacity);
+void render_world_destroy(render_world* world);
+
+render_proxy render_world_add(render_world* world, render_ent ent);
+void render_world_remove(render_world* world, render_proxy proxy);
+bool render_world_contains(const render_world* world, render_proxy proxy);
+void render_world_set_transform(render_world* world, render_proxy proxy, mat4 affine);
+void render_world_set_material(render_world* world, render_proxy proxy, material_handle material);
+/** @brief e.g. toggle `REND_ENT_VISIBLE`, which views can require in their `cull_view.required_flags` */
+void render_world_set_flags(render_world* world, render_proxy proxy, render_ent_flags flags);
+const render_ent* render_world_get(const render_world* world, render_proxy proxy);
+
+/** @brief refreshes the culling bounds of every proxy edited since the last update */
+void render_world_update(render_world* world);
+
+// --- Render queue
+
+/*
+  64-bit sort keys, most significant bits first. Sorting the keys ascending gives draw order.
+
+  opaque:      | view (4) | 0 | pipeline (11) | material (16) | mesh (16) | lod (3) | depth (13)          |
+  transparent: | view (4) | 1 | inverted depth (21) | pipeline (11) | material (16) | mesh (8) | lod (3) |
+
+  Opaque items sort front-to-back within a mesh and level of detail, transparent ones back-to-front.
+*/
+#define SORT_KEY_MAX_VIEWS 16
+#define SORT_KEY_MAX_PIPELINES 2048
+#define SORT_KEY_MAX_LODS 8
+_Static_assert(MAX_MESH_LODS <= SORT_KEY_MAX_LODS, "every level of detail needs its own sort key");
+
+/** @param depth normalised view depth in [0, 1], values outside get clamped */
+u64 sort_key_opaque(u32 view, u32 pipeline, u32 material, u32 mesh, u32 lod, f32 depth);
+/** @param depth normalised view depth in [0, 1], values outside get clamped */
+u64 sort_key_transparent(u32 view, u32 pipeline, u32 material, u32 mesh, u32 lod, f32 depth);
+
+/** @brief sort keys plus the index of the item (e.g. a `render_ent`) each one refers to, allocated on the frame
+           arena */
+typedef struct render_queue {
+  u64* keys;
+  u32* items;
+  u32 count;
+  u32 capacity;
+} render_queue;
+
+render_queue render_queue_create(arena* frame_arena, u32 capacity);
+void render_queue_push(render_queue* queue, u64 key, u32 item);
+
+/** @brief pushes the visible entities of one view with keys derived from their mesh, level of detail, material,
+           pipeline (static vs skinned), `REND_ENT_TRANSPARENT` flag and view depth between `near_z` and `far_z` */
+void render_queue_push_ents(render_queue* queue, const render_ent* entities, const cull_result* visible, u32 view,
+                            camera cam, f32 near_z, f32 far_z);
+
+/** @brief Sorts keys ascending (stable) with an LSD radix sort over 8-bit digits. Passes where every key shares the
+           same digit are skipped. Large queues build histograms and scatter in parallel over the job system. */
+void render_queue_sort(render_queue* queue, arena* frame_arena);
+
+// --- Skinning
+
+#define SKINNING_PALETTE_SLOT (MAX_UNIFORM_SLOTS - 1)  // uniform slot skinned vertex shaders read their palette from
+
+typedef struct skinning_palettes {
+  mat4* matrices;  // `inverse_bind * model_pose` for each evaluated armature's joints, back to back
+  u32 count;
+} skinning_palettes;
+
+/** @brief Pose evaluation stage, run once per frame before any pass records draws. Finds the distinct armatures
+           among `entities` and evaluates each exactly once however many entities share it, spreading skeletons across
+           the job system, and packs their palettes into one array on the frame arena. Upload that once into the frame's
+           region of a `per_frame_buffer`; skinned batches in the shadow and main passes alike bind it at their
+           armature's `palette_offset` */
+skinning_palettes armatures_evaluate_poses(const render_ent* entities, u32 count, u64 frame, arena* frame_arena);
+
+// --- Instancing
+
+/** @brief per-instance vertex data, matches the layout the instanced vertex shaders read at buffer slot 1 */
+typedef struct instance_data {
+  mat4 affine;
+  vec4 colour;
+} instance_data;
+
+/** @brief a run of sorted items sharing a mesh, material and pipeline that can be drawn with one instanced draw */
+typedef struct draw_batch {
+  mesh_handle mesh;
+  material_handle material;
+  u32 lod;
+  u32 pipeline;  // pipeline index from the sort key
+  u32 first_instance;
+  u32 instance_count;
+  u32 first_joint;  // into the frame's `skinning_palettes`
+  u32 joint_count;  // 0 for static meshes
+} draw_batch;
+
+typedef struct draw_batch_list {
+  draw_batch* batches;
+  u32 batch_count;
+  instance_data* instances;  // in draw order, referenced by `first_instance`
+  u32 instance_count;
+} draw_batch_list;
+
+/** @brief Walks a sorted queue and merges consecutive items with the same mesh and material into batches. Skinned
+           entities each get their own batch as they need their own joint palette. `colours` is optional and indexed
+           like `entities`; NULL gives white. Everything is allocated on the frame arena. */
+draw_batch_list render_queue_build_batches(const render_queue* queue, const render_ent* entities, const vec4* colours,
+                                           arena* frame_arena);
+
+#define MATERIAL_UNIFORM_SLOT (MAX_UNIFORM_SLOTS - 2)  // uniform slot material parameters are read from
+#define MAX_MATERIAL_TEXTURES 8
+
+/** @brief what drawing with a material binds: its parameter block (e.g. pushed to a `uniform_ring`) and textures in
+           slots `0..texture_count-1` */
+typedef struct material_binding {
+  bool has_uniforms;
+  buf_handle uniforms;
+  u64 uniform_offset;
+  tex_handle textures[MAX_MATERIAL_TEXTURES];
+  u32 texture_count;
+} material_binding;
+
+/** @brief A buffer holding `MAX_FRAMES_IN_FLIGHT` regions of `frame_size` bytes. Each frame uploads into and binds
+           only its own region so recording a frame never overwrites data the GPU may still be reading */
+typedef struct per_frame_buffer {
+  buf_handle buffer;
+  u64 frame_size;
+} per_frame_buffer;
+
+/** @brief Uploads the instance data into this frame's region and emits one instanced draw per batch, binding each
+           batch's material. Consecutive batches with the same material only bind it once.
+    @param meshes mesh storage indexed by `mesh_handle.raw` e.g. the backing buffer of the mesh pool
+    @param materials indexed by `material_handle.raw`
+    @param pipelines pipelines indexed by the pipeline index in the sort key
+    @param palettes the frame's `skinning_palettes` uploaded into its own region, only bound when a batch is skinned */
+void draw_batches_encode(gpu_encoder* enc, const draw_batch_list* list, const mesh* meshes,
+                         const material_binding* materials, const pipeline_handle* pipelines,
+                         per_frame_buffer instances, u32 frame_index, per_frame_buffer palettes);
+
+/** @brief Like `draw_batches_encode` but splits the batches into contiguous chunks and records each chunk into its
+           own secondary stream of `penc` on the job system. Streams are created in chunk order so the GPU sees the
+           same order as the serial path. Small lists use a single stream. */
+void draw_batches_encode_parallel(gpu_parallel_encoder* penc, const draw_batch_list* list, const mesh* meshes,
+                                  const material_binding* materials, const pipeline_handle* pipelines,
+                                  per_frame_buffer instances, u32 frame_index, per_frame_buffer palettes);
+
+// --- Render graph
+
+/* Passes declare which resources they read and write. `render_graph_compile` orders them, culls passes whose output
+   nobody consumes, works out how long each transient resource lives, packs transient resources with disjoint lifetimes
+   into shared memory blocks and derives the state transitions (barriers) between passes. Compiling touches no GPU
+   state so it can be exercised entirely on the CPU. */
+
+#define RG_MAX_PASSES 64
+#define RG_MAX_RESOURCES 128
+#define RG_MAX_PASS_ACCESSES 16
+#define RG_MAX_BARRIERS (RG_MAX_PASSES * RG_MAX_PASS_ACCESSES + RG_MAX_RESOURCES)
+
+DEFINE_HANDLE(rg_resource);
+
+typedef enum rg_resource_kind { RG_RESOURCE_TEXTURE, RG_RESOURCE_BUFFER } rg_resource_kind;
+
+/** @brief how a pass uses a resource. This is also the state the resource must be in while the pass runs */
+typedef enum rg_state {
+  RG_STATE_UNDEFINED,  // contents don't matter, e.g. before first use of a transient
+  RG_STATE_COLOUR_TARGET,
+  RG_STATE_DEPTH_TARGET,
+  RG_STATE_DEPTH_READ,
+  RG_STATE_SHADER_READ,
+  RG_STATE_SHADER_WRITE,  // storage image/buffer
+  RG_STATE_VERTEX_READ,
+  RG_STATE_COPY_SRC,
+  RG_STATE_COPY_DST,
+  RG_STATE_PRESENT,
+  RG_STATE_COUNT
+} rg_state;
+
+typedef struct rg_resource_desc {
+  const char* label;
+  rg_resource_kind kind;
+  u64 size;  // bytes of backing memory. for textures e.g. width * height * bytes per pixel
+  texture_desc texture;
+} rg_resource_desc;
+
+typedef struct render_graph render_graph;
+typedef void (*rg_execute_fn)(const render_graph* graph, u32 pass, void* user_data);
+
+/** @brief a state transition to issue before a pass (or after the last pass for `final_barriers`) */
+typedef struct rg_barrier {
+  rg_resource resource;
+  rg_state before;
+  rg_state after;
+  bool aliasing;  // memory was last used by a different resource so its contents are garbage
+} rg_barrier;
+
+typedef struct rg_stats {
+  u32 pass_count;
+  u32 culled_pass_count;
+  u32 barrier_count;
+  u32 memory_block_count;
+  u64 transient_bytes;  // what the transients would need without aliasing
+  u64 aliased_bytes;    // what they need packed into shared blocks
+} rg_stats;
+
+/** @brief Creates an empty graph on the arena. Nothing is freed individually, rewind the arena to drop it */
+render_graph* render_graph_create(arena* a);
+/** @brief a resource owned by the graph. It only exists between its first and last use and may share memory */
+rg_resource rg_create_resource(render_graph* graph, rg_resource_desc desc);
+/** @brief A resource that lives outside the graph e.g. the swapchain image. Passes that write it are never culled
+           and it gets transitioned to `final_state` once the graph has run */
+rg_resource rg_import_resource(render_graph* graph, rg_resource_desc desc, rg_state initial_state,
+                               rg_state final_state);
+
+/** @brief adds a pass. Passes run in an order consistent with their resource dependencies; ties keep the order
+           passes were added in */
+u32 rg_add_pass(render_graph* graph, const char* label, rg_execute_fn execute, void* user_data);
+void rg_pass_read(render_graph* graph, u32 pass, rg_resource res, rg_state state);
+void rg_pass_write(render_graph* graph, u32 pass, rg_resource res, rg_state state);
+/** @brief keep this pass even if nothing reads what it writes, e.g. readbacks or debug captures */
+void rg_pass_set_side_effects(render_graph* graph, u32 pass);
+
+/** @brief Orders and culls passes, computes lifetimes, aliasing and barriers. Returns false on a dependency cycle */
+bool render_graph_compile(render_graph* graph);
+/** @brief runs the surviving passes' callbacks in execution order */
+void render_graph_execute(const render_graph* graph);
+
+// Compiled results
+u32 rg_execution_order(const render_graph* graph, const u32** out_passes);
+bool rg_pass_culled(const render_graph* graph, u32 pass);
+const rg_barrier* rg_pass_barriers(const render_graph* graph, u32 pass, u32* out_count);
+const rg_barrier* rg_final_barriers(const render_graph* graph, u32* out_count);
+/** @brief which shared memory block a transient lives in, or UINT32_MAX for imported/unused resources */
+u32 rg_resource_memory_block(const render_graph* graph, rg_resource res);
+/** @brief first and last position in the execution order that uses `res`. false if no surviving pass uses it */
+bool rg_resource_lifetime(const render_graph* graph, rg_resource res, u32* out_first, u32* out_last);
+u64 rg_memory_block_size(const render_graph* graph, u32 block);
+rg_stats rg_get_stats(const render_graph* graph);
+
+// --- Indirect draws
+
+/** @brief a run of indirect draws that share a pipeline and material and so go out as one multi-draw call */
+typedef struct indirect_draw_segment {
+  u32 pipeline;
+  material_handle material;
+  u32 first_draw;
+  u32 draw_count;
+} indirect_draw_segment;
+
+typedef struct indirect_draw_stream {
+  draw_indexed_indirect_args* args;
+  u32 draw_count;
+  indirect_draw_segment* segments;
+  u32 segment_count;
+  buf_handle vertex_buffer;  // shared by every mesh in the stream
+  buf_handle index_buffer;
+  index_format index_format;
+  const instance_data* draw_data;  // per-instance table, indexed by `first_instance + instance id`
+  u32 draw_data_count;
+} indirect_draw_stream;
+
+/** @brief Writes one indirect draw per batch. Every mesh must be indexed with the same index format and live in the
+           same vertex and index buffers
+           (e.g. one `gpu_heap` block each) with `vertex_stride` bytes per vertex, so their offsets become a first
+           index and base vertex. Skinned batches need their own palette binding so draw them directly instead.
+           Allocates on the frame arena */
+indirect_draw_stream indirect_draws_build(const draw_batch_list* list, const mesh* meshes, u32 vertex_stride,
+                                          arena* frame_arena);
+/** @brief Uploads the arguments and draw data into this frame's regions, binds the shared buffers once and issues
+           one multi-draw per segment after binding its pipeline and material (see `draw_batches_encode`) */
+void indirect_draws_encode(gpu_encoder* enc, const indirect_draw_stream* stream, const material_binding* materials,
+                           const pipeline_handle* pipelines, per_frame_buffer args, per_frame_buffer draw_data,
+                           u32 frame_index);
+
 // TODO: Filament PBR model
 
 // --- Scene / Transform Hierarchy
 
+DEFINE_HANDLE(scene_node);
+#define SCENE_NODE_NONE ((scene_node){ UINT32_MAX })
+#define SCENE_NO_PARENT UINT32_MAX
+
+typedef enum scene_node_flags {
+  SCENE_NODE_LOCAL_DIRTY = 1 << 0,  // local transform changed since the last propagation
+  SCENE_NODE_WORLD_DIRTY = 1 << 1,  // moved to another parent since the last propagation
+  SCENE_NODE_REMOVED = 1 << 2,      // waiting to be compacted away
+  SCENE_NODE_MARKED = 1 << 3,       // scratch bit used while walking a subtree
+} scene_node_flags;
+
+/** @brief Retained transform hierarchy stored as flat arrays in parent-before-child (topological) order.
+           Nodes are addressed through stable handles that map to a dense index. Adding appends, removing flags the
+           subtree and it goes away in a stable compaction once enough of the tree is dead.
+           Edits push the node onto a dirty list so propagation only revisits subtrees below a change. */
+typedef struct scene_tree {
+  // dense, indexed by position in the topological order
+  u32* parents;  // dense index of the parent or `SCENE_NO_PARENT`
+  u32* first_child;
+  u32* next_sibling;
+  u8* flags;  // `scene_node_flags`, padded to `SIMD_WIDTH` with zeroes
+  transform_soa locals;
+  mat4* local_mats;
+  mat4* world_mats;
+  u32* dense_to_node;
+  u32 count;
+  u32 capacity;
+  u32 removed_count;
+  // sparse, indexed by handle
+  u32* node_to_dense;  // dense index for live handles, next free handle for free ones
+  u32 node_count;
+  u32 node_capacity;
+  u32 free_node;
+  // dense indices edited since the last propagation
+  u32* dirty;
+  u32 dirty_count;
+  u32* frontier[2];  // scratch for splitting dirty subtrees across workers
+  /** @brief nodes whose world matrix changed in the last propagation, in no particular order */
+  scene_node* changed;
+  u32 changed_count;
+} scene_tree;
+
+scene_tree scene_tree_create(u32 capacity);
+void scene_tree_destroy(scene_tree* tree);
+
+/** @brief adds a node as the last child of `parent` (`SCENE_NODE_NONE` for a root) */
+scene_node scene_tree_add(scene_tree* tree, scene_node parent, transform local);
+/** @brief removes a node and everything below it */
+void scene_tree_remove(scene_tree* tree, scene_node node);
+/** @brief moves a subtree under a new parent. Cheap when the parent already comes first in the order, otherwise the
+           subtree is relocated to the end of the arrays */
+void scene_tree_set_parent(scene_tree* tree, scene_node node, scene_node parent);
+bool scene_tree_contains(const scene_tree* tree, scene_node node);
+scene_node scene_tree_parent(const scene_tree* tree, scene_node node);
+
+void scene_tree_set_local(scene_tree* tree, scene_node node, transform local);
+transform scene_tree_local(const scene_tree* tree, scene_node node);
+/** @brief world matrix as of the last `scene_tree_propagate` */
+mat4 scene_tree_world(const scene_tree* tree, scene_node node);
+
+/** @brief Rebuilds local matrices for edited nodes and world matrices for every subtree below an edit, spreading
+           independent subtrees across the job system, and fills `changed`. Compacts away removed nodes once they
+           make up a large part of the tree */
+void scene_tree_propagate(scene_tree* tree);
+
+/** @brief pushes the world matrices in `tree->changed` to the proxies drawn for those nodes.
+    @param node_proxies indexed by `scene_node.raw`, entries that aren't valid proxies are skipped */
+void render_world_apply_scene_changes(render_world* world, const scene_tree* tree, const render_proxy* node_proxies,
+                                      u32 node_proxy_count);
+
+// --- Spatial queries
+
+#define AABB_TREE_NULL UINT32_MAX
+
+typedef enum aabb_node_flags {
+  AABB_NODE_ENLARGED = 1 << 0,  // grown by a move and waiting for `aabb_tree_refit` to tighten it
+} aabb_node_flags;
+
+typedef struct aabb_tree_node {
+  bbox_3d box;  // fattened by the tree's margin for leaves
+  u64 user_data;
+  u32 parent;  // next free node while on the free list
+  u32 child1;
+  u32 child2;  // `AABB_TREE_NULL` for leaves
+  u16 height;  // 0 for leaves
+  u16 flags;
+} aabb_tree_node;
+
+/** @brief Dynamic bounding volume hierarchy over fat AABBs. Leaves are proxies returned by `aabb_tree_insert`,
+           picked by a surface area heuristic and kept in shape with tree rotations. Small moves stay inside the fat
+           box and cost nothing, larger ones grow the ancestors straight away (so queries stay correct) and get
+           tightened in one batched `aabb_tree_refit` */
+typedef struct aabb_tree {
+  aabb_tree_node* nodes;
+  u32 root;
+  u32 node_count;
+  u32 node_capacity;
+  u32 free_list;
+  u32 proxy_count;
+  f32 margin;
+} aabb_tree;
+
+/** @brief return false to stop the query early */
+typedef bool (*aabb_query_fn)(void* user, u32 proxy, u64 user_data);
+/** @brief called for each proxy whose fat box the ray enters before `max_t`. Return the new `max_t`, e.g. the hit
+           distance to only look for closer hits, 0 to stop or the current `max_t` to keep going */
+typedef f32 (*aabb_ray_fn)(void* user, u32 proxy, u64 user_data, f32 max_t);
+
+aabb_tree aabb_tree_create(u32 capacity, f32 margin);
+void aabb_tree_destroy(aabb_tree* tree);
+
+u32 aabb_tree_insert(aabb_tree* tree, bbox_3d box, u64 user_data);
+void aabb_tree_remove(aabb_tree* tree, u32 proxy);
+/** @brief returns true if the box left its fat box and the tree had to grow */
+bool aabb_tree_move(aabb_tree* tree, u32 proxy, bbox_3d box);
+/** @brief tightens and rotates every node grown by moves since the last refit. Call once per frame */
+void aabb_tree_refit(aabb_tree* tree);
+
+u64 aabb_tree_user_data(const aabb_tree* tree, u32 proxy);
+bbox_3d aabb_tree_fat_box(const aabb_tree* tree, u32 proxy);
+u32 aabb_tree_height(const aabb_tree* tree);
+
+void aabb_tree_query_aabb(const aabb_tree* tree, bbox_3d box, aabb_query_fn fn, void* user);
+void aabb_tree_query_sphere(const aabb_tree* tree, vec3 center, f32 radius, aabb_query_fn fn, void* user);
+/** @brief once a node is entirely inside the frustum its whole subtree is reported without further plane tests */
+void aabb_tree_query_frustum(const aabb_tree* tree, const frustum* f, aabb_query_fn fn, void* user);
+/** @brief `direction` need not be normalised, `max_t` is in multiples of it */
+void aabb_tree_ray_cast(const aabb_tree* tree, vec3 origin, vec3 direction, f32 max_t, aabb_ray_fn fn, void* user);
+
 // --- Gameplay
 
 // --- Game and model data
@@ -588,6 +1840,61 @@ typedef struct animation_spline {
   keyframes frames;
 } animation_spline;
 
+/** @brief One animated property in structure-of-arrays form: the key times plus an array per component, so
+           sampling reads contiguous floats. Translation and scale have 3 components, rotation 4 (xyzw) and weights
+           up to 4. Cubic spline tracks also keep each key's in and out tangents, like glTF does */
+typedef struct animation_track {
+  keyframe_kind kind;
+  interpolation interpolation;
+  joint_idx target;  // joint for transform tracks, unused for weights
+  u32 key_count;
+  u32 component_count;
+  f32* times;  // ascending
+  f32* values[4];
+  f32* in_tangents[4];  // cubic only
+  f32* out_tangents[4];
+} animation_track;
+
+typedef struct animation_clip {
+  const char* name;
+  animation_track* tracks;
+  u32 track_count;
+  f32 duration;
+} animation_clip;
+
+/** @brief Copies glTF style interleaved output data into a track. `values` holds `component_count` floats per key,
+           or for cubic splines an in tangent, value and out tangent per key in that order */
+animation_track animation_track_create(keyframe_kind kind, interpolation interp, joint_idx target,
+                                       u32 component_count, const f32* times, const f32* values, u32 key_count);
+void animation_track_destroy(animation_track* track);
+
+/** @brief the last key at or before `t`, 0 when `t` is before the first key. Looks a few keys ahead of `cursor`
+           first, which is all forward playback ever needs, and binary searches otherwise */
+u32 animation_track_seek(const animation_track* track, u32 cursor, f32 t);
+
+/** @brief Playback state for one clip instance. Tracks keep a cursor on their current key between samples so the
+           cost per track is amortised O(1) while playing forwards */
+typedef struct animation_player {
+  const animation_clip* clip;
+  u32* cursors;
+  f32* outputs[4];  // sampled components per track, padded to `SIMD_WIDTH`
+  f32 time;
+  bool looping;
+  bool nlerp_rotations;  // skip the slerp correction, cheaper but lags slerp more as keys get further apart
+} animation_player;
+
+animation_player animation_player_create(const animation_clip* clip, bool looping);
+void animation_player_destroy(animation_player* player);
+/** @brief moves the playhead, wrapping around the clip's duration when looping and clamping to it otherwise */
+void animation_player_advance(animation_player* player, f32 delta_time);
+/** @brief Evaluates every track at the playhead into `outputs`. Keys are found per track, then the interpolation
+           runs 8 tracks at a time: step and linear as lerps, cubic splines as Hermite curves and linear rotations as
+           an nlerp with Zeux Kapoulkine's slerp approximating correction. Scratch comes from the frame arena */
+void animation_player_sample(animation_player* player, arena* frame_arena);
+/** @brief writes sampled translation, rotation and scale tracks into the armature's local pose. Weights tracks
+           are left in `outputs` for whatever blends morph targets */
+void animation_player_apply(const animation_player* player, armature* arm);
+
 // Compute shader approach so we only need one kind of vertex format
 
 // --- Input
@@ -0,0 +1,502 @@
+/* Dynamic AABB tree for spatial queries. Follows the structure of Box2D's b2DynamicTree: fat leaves, surface area
+   heuristic insertion and local tree rotations instead of AVL balancing */
+
+#include <celeritas.h>
+
+#define AABB_QUERY_STACK_SIZE 256  // grows on the heap past this
+
+// --- Boxes
+
+static bbox_3d box_union(bbox_3d a, bbox_3d b) {
+  return (bbox_3d){ .min = vec3(fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z)),
+                    .max = vec3(fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z)) };
+}
+
+static bool box_contains(bbox_3d outer, bbox_3d inner) {
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+         inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+static bool box_overlaps(bbox_3d a, bbox_3d b) {
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y &&
+         a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+/** @brief half the surface area, which is all the heuristic needs */
+static f32 box_area(bbox_3d b) {
+  f32 dx = b.max.x - b.min.x, dy = b.max.y - b.min.y, dz = b.max.z - b.min.z;
+  return dx * dy + dy * dz + dz * dx;
+}
+
+// --- Node storage
+
+static bool is_leaf(const aabb_tree_node* node) { return node->child1 == AABB_TREE_NULL; }
+
+static void link_free_nodes(aabb_tree* tree, u32 first) {
+  for (u32 i = first; i < tree->node_capacity - 1; i++) {
+    tree->nodes[i].parent = i + 1;
+    tree->nodes[i].height = UINT16_MAX;  // marks it free
+  }
+  tree->nodes[tree->node_capacity - 1].parent = AABB_TREE_NULL;
+  tree->nodes[tree->node_capacity - 1].height = UINT16_MAX;
+  tree->free_list = first;
+}
+
+aabb_tree aabb_tree_create(u32 capacity, f32 margin) {
+  aabb_tree tree = { .root = AABB_TREE_NULL, .margin = margin };
+  // a tree with n leaves has n - 1 internal nodes
+  tree.node_capacity = capacity > 0 ? capacity * 2 : 16;
+  tree.nodes = calloc(tree.node_capacity, sizeof(aabb_tree_node));
+  assert(tree.nodes);
+  link_free_nodes(&tree, 0);
+  return tree;
+}
+
+void aabb_tree_destroy(aabb_tree* tree) {
+  free(tree->nodes);
+  *tree = (aabb_tree){ .root = AABB_TREE_NULL };
+}
+
+static u32 node_alloc(aabb_tree* tree) {
+  if (tree->free_list == AABB_TREE_NULL) {
+    u32 old_capacity = tree->node_capacity;
+    tree->node_capacity *= 2;
+    tree->nodes = realloc(tree->nodes, sizeof(aabb_tree_node) * tree->node_capacity);
+    assert(tree->nodes);
+    link_free_nodes(tree, old_capacity);
+  }
+  u32 idx = tree->free_list;
+  tree->free_list = tree->nodes[idx].parent;
+  tree->nodes[idx] = (aabb_tree_node){ .parent = AABB_TREE_NULL, .child1 = AABB_TREE_NULL, .child2 = AABB_TREE_NULL };
+  tree->node_count++;
+  return idx;
+}
+
+static void node_free(aabb_tree* tree, u32 idx) {
+  tree->nodes[idx].parent = tree->free_list;
+  tree->nodes[idx].height = UINT16_MAX;
+  tree->free_list = idx;
+  tree->node_count--;
+}
+
+static void node_refit(aabb_tree* tree, u32 idx) {
+  aabb_tree_node* n = &tree->nodes[idx];
+  const aabb_tree_node* c1 = &tree->nodes[n->child1];
+  const aabb_tree_node* c2 = &tree->nodes[n->child2];
+  n->box = box_union(c1->box, c2->box);
+  n->height = 1 + (c1->height > c2->height ? c1->height : c2->height);
+}
+
+// --- Rotations
+
+/** @brief Swaps `child` of `parent` with `grandchild`, a child of `parent`'s other child `aunt`, so `aunt` ends up
+           holding `child` and the grandchild's sibling */
+static void swap_down(aabb_tree* tree, u32 parent, u32 child, u32 aunt, u32 grandchild) {
+  aabb_tree_node* p = &tree->nodes[parent];
+  aabb_tree_node* a = &tree->nodes[aunt];
+  if (p->child1 == child) p->child1 = grandchild;
+  else p->child2 = grandchild;
+  if (a->child1 == grandchild) a->child1 = child;
+  else a->child2 = child;
+  tree->nodes[child].parent = aunt;
+  tree->nodes[grandchild].parent = parent;
+  // `parent` is already flagged if anything below it is, but `aunt` may not be yet
+  a->flags |= tree->nodes[child].flags & AABB_NODE_ENLARGED;
+  node_refit(tree, aunt);
+  node_refit(tree, parent);
+}
+
+/** @brief Swaps two grandchildren of `parent` that sit under different children */
+static void swap_cousins(aabb_tree* tree, u32 parent, u32 b, u32 d, u32 c, u32 f) {
+  aabb_tree_node* nb = &tree->nodes[b];
+  aabb_tree_node* nc = &tree->nodes[c];
+  if (nb->child1 == d) nb->child1 = f;
+  else nb->child2 = f;
+  if (nc->child1 == f) nc->child1 = d;
+  else nc->child2 = d;
+  tree->nodes[d].parent = c;
+  tree->nodes[f].parent = b;
+  nc->flags |= tree->nodes[d].flags & AABB_NODE_ENLARGED;
+  nb->flags |= tree->nodes[f].flags & AABB_NODE_ENLARGED;
+  node_refit(tree, b);
+  node_refit(tree, c);
+  node_refit(tree, parent);
+}
+
+/** @brief Tries the local rotations at a node and applies whichever most reduces the summed area of the internal
+           nodes below it (see Box2D's b2RotateNodes and "Fast, Effective BVH Updates for Animated Scenes") */
+static void rotate(aabb_tree* tree, u32 ia) {
+  aabb_tree_node* a = &tree->nodes[ia];
+  if (a->height < 2) return;
+
+  u32 ib = a->child1, ic = a->child2;
+  const aabb_tree_node* b = &tree->nodes[ib];
+  const aabb_tree_node* c = &tree->nodes[ic];
+
+  if (b->height == 0 || c->height == 0) {
+    // one side is a leaf so the only moves are swapping it with a grandchild on the other side
+    u32 leaf = b->height == 0 ? ib : ic;
+    u32 other = b->height == 0 ? ic : ib;
+    const aabb_tree_node* o = &tree->nodes[other];
+    bbox_3d leaf_box = tree->nodes[leaf].box;
+    f32 base = box_area(o->box);
+    f32 cost1 = box_area(box_union(leaf_box, tree->nodes[o->child2].box));  // leaf takes child1's place
+    f32 cost2 = box_area(box_union(leaf_box, tree->nodes[o->child1].box));
+    if (base <= cost1 && base <= cost2) return;
+    swap_down(tree, ia, leaf, other, cost1 < cost2 ? o->child1 : o->child2);
+    return;
+  }
+
+  u32 id = b->child1, ie = b->child2, i_f = c->child1, ig = c->child2;
+  bbox_3d bd = tree->nodes[id].box, be = tree->nodes[ie].box;
+  bbox_3d bf = tree->nodes[i_f].box, bg = tree->nodes[ig].box;
+  f32 area_b = box_area(b->box), area_c = box_area(c->box);
+
+  enum { ROT_NONE, ROT_BF, ROT_BG, ROT_CD, ROT_CE, ROT_DF, ROT_DG } best = ROT_NONE;
+  f32 best_cost = area_b + area_c;
+  f32 costs[] = {
+    [ROT_BF] = area_b + box_area(box_union(b->box, bg)),  // b swaps with f, c becomes (b, g)
+    [ROT_BG] = area_b + box_area(box_union(b->box, bf)),
+    [ROT_CD] = area_c + box_area(box_union(c->box, be)),
+    [ROT_CE] = area_c + box_area(box_union(c->box, bd)),
+    [ROT_DF] = box_area(box_union(bf, be)) + box_area(box_union(bd, bg)),  // b becomes (f, e), c becomes (d, g)
+    [ROT_DG] = box_area(box_union(bg, be)) + box_area(box_union(bf, bd)),
+  };
+  for (u32 r = ROT_BF; r <= ROT_DG; r++) {
+    if (costs[r] < best_cost) {
+      best_cost = costs[r];
+      best = r;
+    }
+  }
+
+  switch (best) {
+    case ROT_NONE:
+      break;
+    case ROT_BF:
+      swap_down(tree, ia, ib, ic, i_f);
+      break;
+    case ROT_BG:
+      swap_down(tree, ia, ib, ic, ig);
+      break;
+    case ROT_CD:
+      swap_down(tree, ia, ic, ib, id);
+      break;
+    case ROT_CE:
+      swap_down(tree, ia, ic, ib, ie);
+      break;
+    case ROT_DF:
+      swap_cousins(tree, ia, ib, id, ic, i_f);
+      break;
+    case ROT_DG:
+      swap_cousins(tree, ia, ib, id, ic, ig);
+      break;
+  }
+}
+
+// --- Insertion and removal
+
+/** @brief Walks down towards the cheapest sibling. At each node it compares making a new parent right here against
+           the lower bound of descending into either child, charging every level for how much it would grow */
+static u32 find_best_sibling(const aabb_tree* tree, bbox_3d leaf_box) {
+  u32 idx = tree->root;
+  while (!is_leaf(&tree->nodes[idx])) {
+    const aabb_tree_node* n = &tree->nodes[idx];
+    f32 area = box_area(n->box);
+    f32 combined = box_area(box_union(n->box, leaf_box));
+    f32 cost_here = 2.0f * combined;
+    f32 inherited = 2.0f * (combined - area);
+
+    f32 child_cost[2];
+    u32 children[2] = { n->child1, n->child2 };
+    for (u32 c = 0; c < 2; c++) {
+      const aabb_tree_node* child = &tree->nodes[children[c]];
+      f32 grown = box_area(box_union(child->box, leaf_box));
+      child_cost[c] = (is_leaf(child) ? grown : grown - box_area(child->box)) + inherited;
+    }
+
+    if (cost_here < child_cost[0] && cost_here < child_cost[1]) break;
+    idx = child_cost[0] < child_cost[1] ? children[0] : children[1];
+  }
+  return idx;
+}
+
+/** @brief refits and rotates every ancestor of `idx` */
+static void walk_up(aabb_tree* tree, u32 idx) {
+  while (idx != AABB_TREE_NULL) {
+    node_refit(tree, idx);
+    rotate(tree, idx);
+    idx = tree->nodes[idx].parent;
+  }
+}
+
+static void insert_leaf(aabb_tree* tree, u32 leaf) {
+  if (tree->root == AABB_TREE_NULL) {
+    tree->root = leaf;
+    tree->nodes[leaf].parent = AABB_TREE_NULL;
+    return;
+  }
+
+  u32 sibling = find_best_sibling(tree, tree->nodes[leaf].box);
+  u32 old_parent = tree->nodes[sibling].parent;
+  u32 new_parent = node_alloc(tree);
+  aabb_tree_node* p = &tree->nodes[new_parent];
+  p->parent = old_parent;
+  p->child1 = sibling;
+  p->child2 = leaf;
+  // an enlarged sibling still needs refitting, and the refit only walks down through flagged nodes
+  p->flags = tree->nodes[sibling].flags & AABB_NODE_ENLARGED;
+  tree->nodes[sibling].parent = new_parent;
+  tree->nodes[leaf].parent = new_parent;
+
+  if (old_parent == AABB_TREE_NULL) {
+    tree->root = new_parent;
+  } else if (tree->nodes[old_parent].child1 == sibling) {
+    tree->nodes[old_parent].child1 = new_parent;
+  } else {
+    tree->nodes[old_parent].child2 = new_parent;
+  }
+  walk_up(tree, new_parent);
+}
+
+static void remove_leaf(aabb_tree* tree, u32 leaf) {
+  if (leaf == tree->root) {
+    tree->root = AABB_TREE_NULL;
+    return;
+  }
+
+  u32 parent = tree->nodes[leaf].parent;
+  u32 grandparent = tree->nodes[parent].parent;
+  u32 sibling = tree->nodes[parent].child1 == leaf ? tree->nodes[parent].child2 : tree->nodes[parent].child1;
+  node_free(tree, parent);
+
+  // the sibling takes the parent's place
+  tree->nodes[sibling].parent = grandparent;
+  if (grandparent == AABB_TREE_NULL) {
+    tree->root = sibling;
+    return;
+  }
+  if (tree->nodes[grandparent].child1 == parent) {
+    tree->nodes[grandparent].child1 = sibling;
+  } else {
+    tree->nodes[grandparent].child2 = sibling;
+  }
+  walk_up(tree, grandparent);
+}
+
+static bbox_3d fatten(bbox_3d box, f32 margin) {
+  return (bbox_3d){ .min = vec3(box.min.x - margin, box.min.y - margin, box.min.z - margin),
+                    .max = vec3(box.max.x + margin, box.max.y + margin, box.max.z + margin) };
+}
+
+u32 aabb_tree_insert(aabb_tree* tree, bbox_3d box, u64 user_data) {
+  u32 proxy = node_alloc(tree);
+  tree->nodes[proxy].box = fatten(box, tree->margin);
+  tree->nodes[proxy].user_data = user_data;
+  insert_leaf(tree, proxy);
+  tree->proxy_count++;
+  return proxy;
+}
+
+void aabb_tree_remove(aabb_tree* tree, u32 proxy) {
+  assert(proxy < tree->node_capacity && is_leaf(&tree->nodes[proxy]));
+  remove_leaf(tree, proxy);
+  node_free(tree, proxy);
+  tree->proxy_count--;
+}
+
+bool aabb_tree_move(aabb_tree* tree, u32 proxy, bbox_3d box) {
+  assert(proxy < tree->node_capacity && is_leaf(&tree->nodes[proxy]));
+  if (box_contains(tree->nodes[proxy].box, box)) return false;
+
+  bbox_3d fat = fatten(box, tree->margin);
+  tree->nodes[proxy].box = fat;
+
+  // Grow ancestors only as far as needed to keep queries correct, the refit tightens them again. Flags go all the
+  // way up so the refit can find its way down, and inserts and rotations flag the new parent of any flagged node
+  // they move
+  bool growing = true;
+  for (u32 idx = tree->nodes[proxy].parent; idx != AABB_TREE_NULL; idx = tree->nodes[idx].parent) {
+    aabb_tree_node* n = &tree->nodes[idx];
+    growing = growing && !box_contains(n->box, fat);
+    if (growing) n->box = box_union(n->box, fat);
+    n->flags |= AABB_NODE_ENLARGED;
+  }
+  return true;
+}
+
+void aabb_tree_refit(aabb_tree* tree) {
+  if (tree->root == AABB_TREE_NULL || !(tree->nodes[tree->root].flags & AABB_NODE_ENLARGED)) return;
+
+  // gather the enlarged nodes parents first then fix them up in reverse, so children are always done first
+  u32* order = malloc(sizeof(u32) * tree->node_capacity);
+  assert(order);
+  u32 count = 0, next = 0;
+  order[count++] = tree->root;
+  while (next < count) {
+    const aabb_tree_node* n = &tree->nodes[order[next++]];
+    u32 children[2] = { n->child1, n->child2 };
+    for (u32 c = 0; c < 2; c++) {
+      const aabb_tree_node* child = &tree->nodes[children[c]];
+      if (!is_leaf(child) && (child->flags & AABB_NODE_ENLARGED)) order[count++] = children[c];
+    }
+  }
+  while (count-- > 0) {
+    u32 idx = order[count];
+    tree->nodes[idx].flags &= ~AABB_NODE_ENLARGED;
+    node_refit(tree, idx);
+    rotate(tree, idx);
+  }
+  free(order);
+}
+
+u64 aabb_tree_user_data(const aabb_tree* tree, u32 proxy) { return tree->nodes[proxy].user_data; }
+
+bbox_3d aabb_tree_fat_box(const aabb_tree* tree, u32 proxy) { return tree->nodes[proxy].box; }
+
+u32 aabb_tree_height(const aabb_tree* tree) {
+  return tree->root == AABB_TREE_NULL ? 0 : tree->nodes[tree->root].height;
+}
+
+// --- Queries
+
+typedef struct query_stack {
+  u64* items;
+  u32 count;
+  u32 capacity;
+  u64 local[AABB_QUERY_STACK_SIZE];
+} query_stack;
+
+static void stack_init(query_stack* s) {
+  s->items = s->local;
+  s->count = 0;
+  s->capacity = AABB_QUERY_STACK_SIZE;
+}
+
+static void stack_push(query_stack* s, u64 value) {
+  if (s->count == s->capacity) {
+    u64* grown = malloc(sizeof(u64) * s->capacity * 2);
+    assert(grown);
+    memcpy(grown, s->items, sizeof(u64) * s->count);
+    if (s->items != s->local) free(s->items);
+    s->items = grown;
+    s->capacity *= 2;
+  }
+  s->items[s->count++] = value;
+}
+
+static void stack_release(query_stack* s) {
+  if (s->items != s->local) free(s->items);
+}
+
+void aabb_tree_query_aabb(const aabb_tree* tree, bbox_3d box, aabb_query_fn fn, void* user) {
+  if (tree->root == AABB_TREE_NULL) return;
+  query_stack stack;
+  stack_init(&stack);
+  stack_push(&stack, tree->root);
+
+  while (stack.count > 0) {
+    u32 idx = (u32)stack.items[--stack.count];
+    const aabb_tree_node* n = &tree->nodes[idx];
+    if (!box_overlaps(n->box, box)) continue;
+    if (is_leaf(n)) {
+      if (!fn(user, idx, n->user_data)) break;
+    } else {
+      stack_push(&stack, n->child1);
+      stack_push(&stack, n->child2);
+    }
+  }
+  stack_release(&stack);
+}
+
+void aabb_tree_query_sphere(const aabb_tree* tree, vec3 center, f32 radius, aabb_query_fn fn, void* user) {
+  if (tree->root == AABB_TREE_NULL) return;
+  query_stack stack;
+  stack_init(&stack);
+  stack_push(&stack, tree->root);
+  f32 radius_sq = radius * radius;
+
+  while (stack.count > 0) {
+    u32 idx = (u32)stack.items[--stack.count];
+    const aabb_tree_node* n = &tree->nodes[idx];
+    // squared distance from the centre to the closest point on the box
+    f32 dx = fmaxf(fmaxf(n->box.min.x - center.x, 0.0f), center.x - n->box.max.x);
+    f32 dy = fmaxf(fmaxf(n->box.min.y - center.y, 0.0f), center.y - n->box.max.y);
+    f32 dz = fmaxf(fmaxf(n->box.min.z - center.z, 0.0f), center.z - n->box.max.z);
+    if (dx * dx + dy * dy + dz * dz > radius_sq) continue;
+    if (is_leaf(n)) {
+      if (!fn(user, idx, n->user_data)) break;
+    } else {
+      stack_push(&stack, n->child1);
+      stack_push(&stack, n->child2);
+    }
+  }
+  stack_release(&stack);
+}
+
+#define FRUSTUM_ALL_PLANES 0x3f
+
+void aabb_tree_query_frustum(const aabb_tree* tree, const frustum* f, aabb_query_fn fn, void* user) {
+  if (tree->root == AABB_TREE_NULL) return;
+  query_stack stack;
+  stack_init(&stack);
+  // low half is the node, high half the planes the node's parent still straddles
+  stack_push(&stack, tree->root | ((u64)FRUSTUM_ALL_PLANES << 32));
+
+  while (stack.count > 0) {
+    u64 entry = stack.items[--stack.count];
+    u32 idx = (u32)entry;
+    u32 planes = (u32)(entry >> 32);
+    const aabb_tree_node* n = &tree->nodes[idx];
+
+    vec3 c = vec3((n->box.min.x + n->box.max.x) * 0.5f, (n->box.min.y + n->box.max.y) * 0.5f,
+                  (n->box.min.z + n->box.max.z) * 0.5f);
+    vec3 e = vec3(n->box.max.x - c.x, n->box.max.y - c.y, n->box.max.z - c.z);
+    bool outside = false;
+    for (u32 p = 0; p < 6 && !outside; p++) {
+      if (!(planes & (1u << p))) continue;
+      const plane* pl = &f->planes[p];
+      f32 dist = vec3_dot(pl->normal, c) + pl->distance;
+      f32 radius = e.x * fabsf(pl->normal.x) + e.y * fabsf(pl->normal.y) + e.z * fabsf(pl->normal.z);
+      outside = dist < -radius;
+      if (dist >= radius) planes &= ~(1u << p);  // entirely in front, children needn't test it again
+    }
+    if (outside) continue;
+
+    if (is_leaf(n)) {
+      if (!fn(user, idx, n->user_data)) break;
+    } else {
+      stack_push(&stack, n->child1 | ((u64)planes << 32));
+      stack_push(&stack, n->child2 | ((u64)planes << 32));
+    }
+  }
+  stack_release(&stack);
+}
+
+void aabb_tree_ray_cast(const aabb_tree* tree, vec3 origin, vec3 direction, f32 max_t, aabb_ray_fn fn, void* user) {
+  if (tree->root == AABB_TREE_NULL) return;
+  query_stack stack;
+  stack_init(&stack);
+  stack_push(&stack, tree->root);
+  // infinities for axis-parallel rays fall out of the slab test correctly
+  vec3 inv = vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+  while (stack.count > 0 && max_t > 0.0f) {
+    u32 idx = (u32)stack.items[--stack.count];
+    const aabb_tree_node* n = &tree->nodes[idx];
+
+    f32 tx1 = (n->box.min.x - origin.x) * inv.x, tx2 = (n->box.max.x - origin.x) * inv.x;
+    f32 ty1 = (n->box.min.y - origin.y) * inv.y, ty2 = (n->box.max.y - origin.y) * inv.y;
+    f32 tz1 = (n->box.min.z - origin.z) * inv.z, tz2 = (n->box.max.z - origin.z) * inv.z;
+    f32 t_enter = fmaxf(fmaxf(fminf(tx1, tx2), fminf(ty1, ty2)), fmaxf(fminf(tz1, tz2), 0.0f));
+    f32 t_exit = fminf(fminf(fmaxf(tx1, tx2), fmaxf(ty1, ty2)), fminf(fmaxf(tz1, tz2), max_t));
+    if (t_enter > t_exit) continue;
+
+    if (is_leaf(n)) {
+      max_t = fn(user, idx, n->user_data, max_t);
+    } else {
+      stack_push(&stack, n->child1);
+      stack_push(&stack, n->child2);
+    }
+  }
+  stack_release(&stack);
+}
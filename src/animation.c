@@ -0,0 +1,257 @@
+/* Keyframe animation: SoA tracks, cursor-cached key lookup and interpolation batched across tracks */
+
+#include <celeritas.h>
+
+#define CURSOR_LOOKAHEAD 4  // keys scanned forwards from the cursor before giving up and binary searching
+
+// see `vertex_quantise.c`
+#define f32x8_select(mask, a, b) ((f32x8)(((i32x8)(a) & (mask)) | ((i32x8)(b) & ~(mask))))
+#define f32x8_abs(v) ((f32x8)((i32x8)(v) & 0x7FFFFFFF))
+
+static u32 simd_round_up_u32(u32 n) { return (n + SIMD_WIDTH - 1) & ~(u32)(SIMD_WIDTH - 1); }
+
+animation_track animation_track_create(keyframe_kind kind, interpolation interp, joint_idx target,
+                                       u32 component_count, const f32* times, const f32* values, u32 key_count) {
+  assert(key_count > 0 && component_count > 0 && component_count <= 4);
+  animation_track track = {
+    .kind = kind,
+    .interpolation = interp,
+    .target = target,
+    .key_count = key_count,
+    .component_count = component_count,
+    .times = malloc(sizeof(f32) * key_count),
+  };
+  assert(track.times);
+  memcpy(track.times, times, sizeof(f32) * key_count);
+
+  bool cubic = interp == Interpolation_Cubic;
+  u32 stride = cubic ? component_count * 3 : component_count;
+  u32 value_offset = cubic ? component_count : 0;  // skip past the in tangent
+  for (u32 c = 0; c < component_count; c++) {
+    track.values[c] = malloc(sizeof(f32) * key_count);
+    assert(track.values[c]);
+    for (u32 k = 0; k < key_count; k++) track.values[c][k] = values[k * stride + value_offset + c];
+    if (!cubic) continue;
+    track.in_tangents[c] = malloc(sizeof(f32) * key_count);
+    track.out_tangents[c] = malloc(sizeof(f32) * key_count);
+    assert(track.in_tangents[c] && track.out_tangents[c]);
+    for (u32 k = 0; k < key_count; k++) {
+      track.in_tangents[c][k] = values[k * stride + c];
+      track.out_tangents[c][k] = values[k * stride + component_count * 2 + c];
+    }
+  }
+  return track;
+}
+
+void animation_track_destroy(animation_track* track) {
+  free(track->times);
+  for (u32 c = 0; c < 4; c++) {
+    free(track->values[c]);
+    free(track->in_tangents[c]);
+    free(track->out_tangents[c]);
+  }
+  *track = (animation_track){ 0 };
+}
+
+u32 animation_track_seek(const animation_track* track, u32 cursor, f32 t) {
+  const f32* times = track->times;
+  u32 last = track->key_count - 1;
+  if (cursor > last || times[cursor] > t) cursor = 0;  // went backwards, e.g. a loop wrapped around
+
+  for (u32 step = 0; step < CURSOR_LOOKAHEAD; step++) {
+    if (cursor == last || times[cursor + 1] > t) return cursor;
+    cursor++;
+  }
+
+  // the answer is in [cursor, last]
+  u32 lo = cursor, hi = last;
+  while (lo < hi) {
+    u32 mid = lo + (hi - lo + 1) / 2;
+    if (times[mid] <= t) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  return lo;
+}
+
+// --- Playback
+
+animation_player animation_player_create(const animation_clip* clip, bool looping) {
+  animation_player player = { .clip = clip, .looping = looping };
+  u32 padded = simd_round_up_u32(clip->track_count > 0 ? clip->track_count : 1);
+  player.cursors = calloc(padded, sizeof(u32));
+  assert(player.cursors);
+  for (u32 c = 0; c < 4; c++) {
+    player.outputs[c] = aligned_alloc(32, sizeof(f32) * padded);
+    assert(player.outputs[c]);
+    memset(player.outputs[c], 0, sizeof(f32) * padded);
+  }
+  return player;
+}
+
+void animation_player_destroy(animation_player* player) {
+  free(player->cursors);
+  for (u32 c = 0; c < 4; c++) free(player->outputs[c]);
+  *player = (animation_player){ 0 };
+}
+
+void animation_player_advance(animation_player* player, f32 delta_time) {
+  f32 duration = player->clip->duration;
+  f32 time = player->time + delta_time;
+  if (player->looping && duration > 0.0f) {
+    time = fmodf(time, duration);
+    if (time < 0.0f) time += duration;
+  } else {
+    time = time < 0.0f ? 0.0f : time > duration ? duration : time;
+  }
+  player->time = time;
+}
+
+/** @brief the two keys either side of the playhead for every track, laid out so 8 tracks interpolate at once */
+typedef struct sample_lanes {
+  f32* from[4];
+  f32* to[4];
+  f32* out_tangent[4];  // of `from`, zero unless cubic
+  f32* in_tangent[4];   // of `to`
+  f32* alpha;
+  f32* interval;  // seconds between the two keys, tangents are per second
+  i32* cubic;     // lane masks
+  i32* rotation;
+} sample_lanes;
+
+static void gather_track(sample_lanes* lanes, u32 i, const animation_track* track, u32 k0, f32 t) {
+  u32 k1 = k0 + 1 < track->key_count ? k0 + 1 : k0;
+  f32 t0 = track->times[k0], t1 = track->times[k1];
+  // before the first key or after the last one the end key is held
+  f32 alpha = k1 > k0 && t > t0 ? (t - t0) / (t1 - t0) : 0.0f;
+  alpha = alpha > 1.0f ? 1.0f : alpha;
+  if (track->interpolation == Interpolation_Step) alpha = 0.0f;
+
+  lanes->alpha[i] = alpha;
+  lanes->interval[i] = t1 - t0;
+  lanes->cubic[i] = track->interpolation == Interpolation_Cubic ? -1 : 0;
+  lanes->rotation[i] = track->kind == Keyframe_Rotation ? -1 : 0;
+  for (u32 c = 0; c < track->component_count; c++) {
+    lanes->from[c][i] = track->values[c][k0];
+    lanes->to[c][i] = track->values[c][k1];
+    if (track->interpolation == Interpolation_Cubic) {
+      lanes->out_tangent[c][i] = track->out_tangents[c][k0];
+      lanes->in_tangent[c][i] = track->in_tangents[c][k1];
+    }
+  }
+}
+
+static void interpolate_lanes(const sample_lanes* lanes, f32* const outputs[4], u32 start, bool nlerp_rotations) {
+  f32x8 a = f32x8_load(&lanes->alpha[start]);
+  f32x8 dt = f32x8_load(&lanes->interval[start]);
+  i32x8 cubic = *(const i32x8*)&lanes->cubic[start];
+  i32x8 rotation = *(const i32x8*)&lanes->rotation[start];
+
+  f32x8 from[4], to[4];
+  for (u32 c = 0; c < 4; c++) {
+    from[c] = f32x8_load(&lanes->from[c][start]);
+    to[c] = f32x8_load(&lanes->to[c][start]);
+  }
+
+  // linear: q and -q are the same rotation so flip `to` onto the shorter arc
+  f32x8 dot = from[0] * to[0] + from[1] * to[1] + from[2] * to[2] + from[3] * to[3];
+  i32x8 flip = rotation & ~cubic & (dot < 0.0f);
+  f32x8 lerp_a = a;
+  if (!nlerp_rotations) {
+    // "Approximating slerp" (Kapoulkine): bend the nlerp parameter so the angle advances at slerp's constant rate
+    f32x8 d = f32x8_abs(dot);
+    f32x8 k_a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+    f32x8 k_b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+    f32x8 centred = a - 0.5f;
+    f32x8 k = k_a * centred * centred + k_b;
+    lerp_a = f32x8_select(rotation, a + a * centred * (a - 1.0f) * k, a);
+  }
+  f32x8 w_to = f32x8_select(flip, -lerp_a, lerp_a);
+
+  // cubic: Hermite basis with the tangents scaled by the key interval
+  f32x8 a2 = a * a, a3 = a2 * a;
+  f32x8 h00 = 2.0f * a3 - 3.0f * a2 + 1.0f;
+  f32x8 h10 = (a3 - 2.0f * a2 + a) * dt;
+  f32x8 h01 = 3.0f * a2 - 2.0f * a3;
+  f32x8 h11 = (a3 - a2) * dt;
+
+  f32x8 zero = f32x8_splat(0.0f);
+  f32x8 w0 = f32x8_select(cubic, h00, 1.0f - lerp_a);
+  f32x8 w1 = f32x8_select(cubic, h10, zero);
+  f32x8 w2 = f32x8_select(cubic, h01, w_to);
+  f32x8 w3 = f32x8_select(cubic, h11, zero);
+
+  f32x8 out[4];
+  for (u32 c = 0; c < 4; c++) {
+    f32x8 out_tangent = f32x8_load(&lanes->out_tangent[c][start]);
+    f32x8 in_tangent = f32x8_load(&lanes->in_tangent[c][start]);
+    out[c] = w0 * from[c] + w1 * out_tangent + w2 * to[c] + w3 * in_tangent;
+  }
+
+  // rotations come out of both paths slightly short of unit length
+  f32x8 len_sq = out[0] * out[0] + out[1] * out[1] + out[2] * out[2] + out[3] * out[3];
+  // the vector extensions have no sqrt, a plain loop over the lanes gets vectorised instead
+  f32 inv_len[SIMD_WIDTH];
+  for (u32 l = 0; l < SIMD_WIDTH; l++) inv_len[l] = len_sq[l] > 0.0f ? 1.0f / sqrtf(len_sq[l]) : 1.0f;
+  f32x8 scale = f32x8_select(rotation, f32x8_load(inv_len), f32x8_splat(1.0f));
+  for (u32 c = 0; c < 4; c++) f32x8_store(&outputs[c][start], out[c] * scale);
+}
+
+void animation_player_sample(animation_player* player, arena* frame_arena) {
+  const animation_clip* clip = player->clip;
+  u32 padded = simd_round_up_u32(clip->track_count > 0 ? clip->track_count : 1);
+
+  sample_lanes lanes;
+  for (u32 c = 0; c < 4; c++) {
+    lanes.from[c] = arena_alloc(frame_arena, sizeof(f32) * padded);
+    lanes.to[c] = arena_alloc(frame_arena, sizeof(f32) * padded);
+    lanes.out_tangent[c] = arena_alloc(frame_arena, sizeof(f32) * padded);
+    lanes.in_tangent[c] = arena_alloc(frame_arena, sizeof(f32) * padded);
+  }
+  lanes.alpha = arena_alloc(frame_arena, sizeof(f32) * padded);
+  lanes.interval = arena_alloc(frame_arena, sizeof(f32) * padded);
+  lanes.cubic = arena_alloc_align(frame_arena, sizeof(i32) * padded, 32);
+  lanes.rotation = arena_alloc_align(frame_arena, sizeof(i32) * padded, 32);
+
+  for (u32 i = 0; i < clip->track_count; i++) {
+    const animation_track* track = &clip->tracks[i];
+    player->cursors[i] = animation_track_seek(track, player->cursors[i], player->time);
+    gather_track(&lanes, i, track, player->cursors[i], player->time);
+  }
+  for (u32 start = 0; start < clip->track_count; start += SIMD_WIDTH) {
+    interpolate_lanes(&lanes, player->outputs, start, player->nlerp_rotations);
+  }
+}
+
+void animation_player_apply(const animation_player* player, armature* arm) {
+  transform_soa* pose = &arm->local_pose;
+  for (u32 i = 0; i < player->clip->track_count; i++) {
+    const animation_track* track = &player->clip->tracks[i];
+    u32 j = track->target;
+    switch (track->kind) {
+      case Keyframe_Translation:
+        assert(j < arm->joint_count);
+        pose->pos_x[j] = player->outputs[0][i];
+        pose->pos_y[j] = player->outputs[1][i];
+        pose->pos_z[j] = player->outputs[2][i];
+        break;
+      case Keyframe_Rotation:
+        assert(j < arm->joint_count);
+        pose->rot_x[j] = player->outputs[0][i];
+        pose->rot_y[j] = player->outputs[1][i];
+        pose->rot_z[j] = player->outputs[2][i];
+        pose->rot_w[j] = player->outputs[3][i];
+        break;
+      case Keyframe_Scale:
+        assert(j < arm->joint_count);
+        pose->scale_x[j] = player->outputs[0][i];
+        pose->scale_y[j] = player->outputs[1][i];
+        pose->scale_z[j] = player->outputs[2][i];
+        break;
+      case Keyframe_Weights:
+        break;
+    }
+  }
+}
@@ -0,0 +1,108 @@
+/* Skeletons and the pose evaluation stage that turns their local poses into skinning palettes once per frame */
+
+#include <celeritas.h>
+
+armature armature_create(const joint_idx* parents, const transform* bind_pose, const mat4* inverse_bind,
+                         u32 joint_count, joint_idx* joint_remap) {
+  assert(joint_count > 0 && joint_count <= MAX_JOINTS);
+
+  // children grouped by parent with a counting sort, roots under the extra slot at `joint_count`
+  u32 child_offsets[MAX_JOINTS + 2] = { 0 };
+  joint_idx children[MAX_JOINTS];
+  for (u32 j = 0; j < joint_count; j++) {
+    u32 parent = parents[j] == JOINT_NO_PARENT ? joint_count : parents[j];
+    assert(parent <= joint_count && parent != j);
+    child_offsets[parent + 1]++;
+  }
+  for (u32 p = 0; p <= joint_count; p++) child_offsets[p + 1] += child_offsets[p];
+  u32 fill[MAX_JOINTS + 1];
+  memcpy(fill, child_offsets, sizeof(u32) * (joint_count + 1));
+  for (u32 j = 0; j < joint_count; j++) {
+    u32 parent = parents[j] == JOINT_NO_PARENT ? joint_count : parents[j];
+    children[fill[parent]++] = j;
+  }
+
+  // breadth first from the roots so every parent is placed before its children
+  joint_idx order[MAX_JOINTS];
+  joint_idx remap[MAX_JOINTS];
+  u32 placed = 0;
+  for (u32 c = child_offsets[joint_count]; c < child_offsets[joint_count + 1]; c++) order[placed++] = children[c];
+  for (u32 next = 0; next < placed; next++) {
+    u32 j = order[next];
+    remap[j] = next;
+    for (u32 c = child_offsets[j]; c < child_offsets[j + 1]; c++) order[placed++] = children[c];
+  }
+  assert(placed == joint_count);  // anything left over is part of a cycle
+
+  armature arm = {
+    .parents = malloc(sizeof(joint_idx) * joint_count),
+    .local_pose = transform_soa_create(joint_count),
+    .inverse_bind = malloc(sizeof(mat4) * joint_count),
+    .model_pose = malloc(sizeof(mat4) * joint_count),
+    .joint_count = joint_count,
+    .evaluated_frame = ARMATURE_NEVER_EVALUATED,
+  };
+  assert(arm.parents && arm.inverse_bind && arm.model_pose);
+  for (u32 i = 0; i < joint_count; i++) {
+    u32 j = order[i];
+    arm.parents[i] = parents[j] == JOINT_NO_PARENT ? JOINT_NO_PARENT : remap[parents[j]];
+    transform_soa_push(&arm.local_pose, bind_pose[j]);
+    arm.inverse_bind[i] = inverse_bind[j];
+  }
+  if (joint_remap) memcpy(joint_remap, remap, sizeof(joint_idx) * joint_count);
+  return arm;
+}
+
+void armature_destroy(armature* arm) {
+  free(arm->parents);
+  transform_soa_destroy(&arm->local_pose);
+  free(arm->inverse_bind);
+  free(arm->model_pose);
+  *arm = (armature){ 0 };
+}
+
+// --- Pose evaluation
+
+typedef struct pose_job_ctx {
+  armature** armatures;
+  mat4* palettes;
+} pose_job_ctx;
+
+static void evaluate_pose(armature* arm, mat4* palette) {
+  transforms_to_mats(&arm->local_pose, arm->model_pose, arm->joint_count);
+  // parents are always earlier so each one is final by the time its children read it
+  for (u32 j = 0; j < arm->joint_count; j++) {
+    if (arm->parents[j] != JOINT_NO_PARENT) {
+      arm->model_pose[j] = mat4_mult(arm->model_pose[j], arm->model_pose[arm->parents[j]]);
+    }
+  }
+  mat4_mult_batch(arm->inverse_bind, arm->model_pose, palette, arm->joint_count);
+}
+
+static void evaluate_poses(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  pose_job_ctx* ctx = data;
+  for (u32 i = start; i < end; i++) {
+    armature* arm = ctx->armatures[i];
+    evaluate_pose(arm, ctx->palettes + arm->palette_offset);
+  }
+}
+
+skinning_palettes armatures_evaluate_poses(const render_ent* entities, u32 count, u64 frame, arena* frame_arena) {
+  armature** unique = arena_alloc(frame_arena, sizeof(armature*) * (count > 0 ? count : 1));
+  u32 unique_count = 0, joint_total = 0;
+  for (u32 i = 0; i < count; i++) {
+    armature* arm = entities[i].armature;
+    if (!arm || arm->evaluated_frame == frame) continue;
+    arm->evaluated_frame = frame;
+    arm->palette_offset = joint_total;
+    joint_total += arm->joint_count;
+    unique[unique_count++] = arm;
+  }
+
+  skinning_palettes palettes = { .count = joint_total };
+  palettes.matrices = arena_alloc(frame_arena, sizeof(mat4) * (joint_total > 0 ? joint_total : 1));
+  pose_job_ctx ctx = { .armatures = unique, .palettes = palettes.matrices };
+  jobs_parallel_for(unique_count, 1, evaluate_poses, &ctx);
+  return palettes;
+}
@@ -29,6 +29,17 @@ struct gpu_swapchain {
 struct gpu_encoder {
   id<MTLCommandBuffer> cmd_buffer;
   id<MTLRenderCommandEncoder> cmd_encoder;
+  buf_handle index_buffer;  // Metal takes the index buffer at draw time rather than binding it
+  index_format index_format;
+  gpu_bind_state bound;
+};
+
+struct gpu_parallel_encoder {
+  id<MTLCommandBuffer> cmd_buffer;
+  id<MTLParallelRenderCommandEncoder> cmd_encoder;
+  gpu_encoder* streams;
+  gpu_encoder** stream_ptrs;
+  u32 stream_count;
 };
 
 typedef struct metal_pipeline {
@@ -62,6 +73,11 @@ typedef struct metal_context {
   buf_pool bufpool;
   tex_pool texpool;
   pipeline_pool psopool; // pso = pipeline state object
+  pipeline_dedup pipelines;
+
+  deferred_destroy_queue deferred;
+  u64 frame_index;
+  _Atomic u64 completed_frame;  // written from command buffer completion handlers
 } metal_context;
 
 static metal_context ctx;
@@ -103,6 +119,7 @@ void ral_backend_init(const char* window_name, struct GLFWwindow* window) {
 
   metal_pipeline* pipeline_storage = malloc(sizeof(metal_pipeline) * 100);
   ctx.psopool = pipeline_pool_create(pipeline_storage, 100, sizeof(metal_pipeline));
+  deferred_destroy_init(&ctx.deferred);
 
   TRACE("create default metal lib");
   NSError* nserr = 0x0;
@@ -116,18 +133,76 @@ void ral_backend_init(const char* window_name, struct GLFWwindow* window) {
   INFO("Successfully initialised Metal RAL backend");
 }
 
+static void metal_destroy_resource(gpu_resource_kind kind, u32 handle, void* user_data) {
+  (void)user_data;
+  switch (kind) {
+    case GPU_RESOURCE_BUFFER:
+      ral_buffer_destroy((buf_handle){ .raw = handle });
+      break;
+    case GPU_RESOURCE_TEXTURE:
+      ral_texture_destroy((tex_handle){ .raw = handle });
+      break;
+    case GPU_RESOURCE_PIPELINE:
+      ral_gfx_pipeline_destroy((pipeline_handle){ .raw = handle });
+      break;
+  }
+}
+
+static void metal_destroy_deferred(gpu_resource_kind kind, u32 handle) {
+  if (!deferred_destroy_push(&ctx.deferred, kind, handle)) {
+    ERROR("Deferred destruction queue is full, leaking resource");
+  }
+}
+
+void ral_buffer_destroy_deferred(buf_handle handle) { metal_destroy_deferred(GPU_RESOURCE_BUFFER, handle.raw); }
+void ral_texture_destroy_deferred(tex_handle handle) { metal_destroy_deferred(GPU_RESOURCE_TEXTURE, handle.raw); }
+void ral_gfx_pipeline_destroy_deferred(pipeline_handle handle) {
+  metal_destroy_deferred(GPU_RESOURCE_PIPELINE, handle.raw);
+}
+
+/** @brief lets deferred destruction know when the frame this command buffer belongs to is done on the GPU */
+static void metal_track_frame(id<MTLCommandBuffer> cmd_buffer) {
+  u64 frame = ctx.frame_index;
+  [cmd_buffer addCompletedHandler:^(id<MTLCommandBuffer> cb) {
+    (void)cb;
+    atomic_store_explicit(&ctx.completed_frame, frame, memory_order_release);
+  }];
+}
+
 void ral_backend_shutdown() {
-  // no-op
+  // every submit waits for completion so nothing is in flight any more
+  deferred_destroy_collect(&ctx.deferred, UINT64_MAX, metal_destroy_resource, NULL);
 }
 
 buf_handle ral_buffer_create(u64 size, const void *data) {
   buf_handle handle;
   metal_buffer* buffer = buf_pool_alloc(&ctx.bufpool, &handle);
-  buffer->id = [ctx.device newBufferWithBytes:data length:size options:MTLResourceStorageModeShared];
+  if (data) {
+    buffer->id = [ctx.device newBufferWithBytes:data length:size options:MTLResourceStorageModeShared];
+  } else {
+    buffer->id = [ctx.device newBufferWithLength:size options:MTLResourceStorageModeShared];
+  }
 
   return handle;
 }
 
+void* ral_buffer_mapped(buf_handle handle) {
+  metal_buffer* buffer = buf_pool_get(&ctx.bufpool, handle);
+  return [buffer->id contents];
+}
+
+void ral_buffer_destroy(buf_handle handle) {
+  metal_buffer* buffer = buf_pool_get(&ctx.bufpool, handle);
+  [buffer->id release];
+  buf_pool_dealloc(&ctx.bufpool, handle);
+}
+
+void ral_buffer_upload(buf_handle handle, u64 offset, u64 size, const void* data) {
+  metal_buffer* buffer = buf_pool_get(&ctx.bufpool, handle);
+  assert(offset + size <= [buffer->id length]);
+  memcpy((u8*)[buffer->id contents] + offset, data, size);
+}
+
 tex_handle ral_texture_create(texture_desc desc, bool create_view, const void *data) {
   tex_handle handle;
   metal_texture* texture = tex_pool_alloc(&ctx.texpool, &handle);
@@ -139,16 +214,61 @@ tex_handle ral_texture_create(texture_desc desc, bool create_view, const void *d
 
   texture->id = [ctx.device newTextureWithDescriptor:texture_descriptor];
 
-  MTLRegion region = MTLRegionMake2D(0, 0, desc.width, desc.height);
-  u32 bytes_per_row = 4 * desc.width;
-
-  [texture->id replaceRegion:region mipmapLevel:0  withBytes:data bytesPerRow:bytes_per_row];
+  // NULL data leaves the texture to be filled later, e.g. through an upload queue
+  if (data) {
+    MTLRegion region = MTLRegionMake2D(0, 0, desc.width, desc.height);
+    u32 bytes_per_row = 4 * desc.width;
+    [texture->id replaceRegion:region mipmapLevel:0  withBytes:data bytesPerRow:bytes_per_row];
+  }
 
   [texture_descriptor release];
 
   return handle;
 }
 
+void ral_submit_copies(buf_handle staging, const gpu_copy_region* regions, u32 count, gpu_copies_done_fn done,
+                       void* user_data, u64 batch_id) {
+  metal_buffer* src = buf_pool_get(&ctx.bufpool, staging);
+  id<MTLCommandBuffer> cmd_buffer = [ctx.command_queue commandBuffer];
+  id<MTLBlitCommandEncoder> blit = [cmd_buffer blitCommandEncoder];
+
+  for (u32 i = 0; i < count; i++) {
+    const gpu_copy_region* r = &regions[i];
+    if (r->kind == COPY_BUFFER_TO_BUFFER) {
+      metal_buffer* dst = buf_pool_get(&ctx.bufpool, r->dst_buf);
+      [blit copyFromBuffer:src->id
+              sourceOffset:r->src_offset
+                  toBuffer:dst->id
+         destinationOffset:r->dst_offset
+                      size:r->size];
+    } else {
+      metal_texture* dst = tex_pool_get(&ctx.texpool, r->dst_tex);
+      [blit copyFromBuffer:src->id
+                 sourceOffset:r->src_offset
+            sourceBytesPerRow:r->bytes_per_row
+          sourceBytesPerImage:r->bytes_per_row * r->height
+                   sourceSize:MTLSizeMake(r->width, r->height, 1)
+                    toTexture:dst->id
+             destinationSlice:0
+             destinationLevel:0
+            destinationOrigin:MTLOriginMake(0, 0, 0)];
+    }
+  }
+  [blit endEncoding];
+
+  [cmd_buffer addCompletedHandler:^(id<MTLCommandBuffer> cb) {
+    (void)cb;
+    done(user_data, batch_id);
+  }];
+  [cmd_buffer commit];
+}
+
+void ral_texture_destroy(tex_handle handle) {
+  metal_texture* texture = tex_pool_get(&ctx.texpool, handle);
+  [texture->id release];
+  tex_pool_dealloc(&ctx.texpool, handle);
+}
+
 tex_handle ral_texture_load_from_file(const char* filepath) {
   texture_desc desc;
 
@@ -162,9 +282,14 @@ tex_handle ral_texture_load_from_file(const char* filepath) {
 }
 
 pipeline_handle ral_gfx_pipeline_create(gfx_pipeline_desc desc) {
-  TRACE("creating graphics pipeline");
-
+  u64 hash = gfx_pipeline_desc_hash(&desc);
   pipeline_handle handle;
+  if (pipeline_dedup_acquire(&ctx.pipelines, &desc, hash, &handle)) {
+    TRACE("reusing identical graphics pipeline");
+    return handle;
+  }
+
+  TRACE("creating graphics pipeline");
   metal_pipeline* p = pipeline_pool_alloc(&ctx.psopool, &handle);
 
   @autoreleasepool {
@@ -178,8 +303,8 @@ pipeline_handle ral_gfx_pipeline_create(gfx_pipeline_desc desc) {
     assert(fragment_func);
 
     NSError* err = 0x0;
+    // alloc/init and new* results are owned by us, the autorelease pool doesn't release them
     MTLRenderPipelineDescriptor* pld = [[MTLRenderPipelineDescriptor alloc] init];
-    // in auto release pool so dont need to call release()
 
     [pld setLabel:@"Pipeline"];
     [pld setVertexFunction:vertex_func];
@@ -188,18 +313,47 @@ pipeline_handle ral_gfx_pipeline_create(gfx_pipeline_desc desc) {
     pld.colorAttachments[0].blendingEnabled = YES;
     assert(pld);
 
+    // binary archives let warm starts skip compiling the shaders for this pipeline
+    char path[256];
+    pipeline_cache_path(hash, "metalbin", path, sizeof(path));
+    NSURL* archive_url = [NSURL fileURLWithPath:[NSString stringWithUTF8String:path]];
+    bool warm = [[NSFileManager defaultManager] fileExistsAtPath:[archive_url path]];
+    MTLBinaryArchiveDescriptor* archive_desc = [[MTLBinaryArchiveDescriptor alloc] init];
+    if (warm) archive_desc.url = archive_url;
+    id<MTLBinaryArchive> archive = [ctx.device newBinaryArchiveWithDescriptor:archive_desc error:&err];
+    if (archive) {
+      if (!warm) [archive addRenderPipelineFunctionsWithDescriptor:pld error:&err];
+      pld.binaryArchives = @[ archive ];
+    }
+
     id<MTLRenderPipelineState> pso = [ctx.device newRenderPipelineStateWithDescriptor:pld error:&err];
     assert(pso);
     p->pso = pso;
+
+    if (archive && !warm) {
+      pipeline_cache_make_dir();
+      if (![archive serializeToURL:archive_url error:&err]) WARN("Couldn't write pipeline binary archive");
+    }
+    [archive release];
+    [archive_desc release];
+    [pld release];
+    [vertex_func release];
+    [fragment_func release];
   }
 
+  pipeline_dedup_insert(&ctx.pipelines, &desc, hash, handle);
   return handle;
 }
 
-gpu_encoder* ral_render_encoder(render_pass_desc rpass_desc) {
-  id<MTLCommandBuffer> buffer = [ctx.command_queue commandBuffer];
+void ral_gfx_pipeline_destroy(pipeline_handle handle) {
+  if (!pipeline_dedup_release(&ctx.pipelines, handle)) return;
+  metal_pipeline* p = pipeline_pool_get(&ctx.psopool, handle);
+  [p->pso release];
+  pipeline_pool_dealloc(&ctx.psopool, handle);
+}
 
-  // create renderpass descriptor
+static MTLRenderPassDescriptor* metal_render_pass(render_pass_desc rpass_desc) {
+  (void)rpass_desc;
   MTLRenderPassDescriptor* rpd = [[MTLRenderPassDescriptor alloc] init];
   MTLRenderPassColorAttachmentDescriptor* cd = rpd.colorAttachments[0];
   [cd setTexture:ctx.surface.texture];
@@ -207,10 +361,14 @@ gpu_encoder* ral_render_encoder(render_pass_desc rpass_desc) {
   MTLClearColor clearColor = MTLClearColorMake(41.0f/255.0f, 42.0f/255.0f, 48.0f/255.0f, 1.0);
   [cd setClearColor:clearColor];
   [cd setStoreAction:MTLStoreActionStore];
+  return rpd;
+}
 
-  id<MTLRenderCommandEncoder> encoder = [buffer renderCommandEncoderWithDescriptor:rpd];
+gpu_encoder* ral_render_encoder(render_pass_desc rpass_desc) {
+  id<MTLCommandBuffer> buffer = [ctx.command_queue commandBuffer];
+  id<MTLRenderCommandEncoder> encoder = [buffer renderCommandEncoderWithDescriptor:metal_render_pass(rpass_desc)];
 
-  gpu_encoder* enc = malloc(sizeof(gpu_encoder));
+  gpu_encoder* enc = calloc(1, sizeof(gpu_encoder));
   enc->cmd_buffer = buffer;
   enc->cmd_encoder = encoder;
 
@@ -220,21 +378,121 @@ gpu_encoder* ral_render_encoder(render_pass_desc rpass_desc) {
 void ral_encoder_finish_and_submit(gpu_encoder* enc) {
   [enc->cmd_encoder  endEncoding];
   [enc->cmd_buffer presentDrawable:ctx.surface];
+  metal_track_frame(enc->cmd_buffer);
   [enc->cmd_buffer commit];
   [enc->cmd_buffer waitUntilCompleted];
 }
 
+gpu_parallel_encoder* ral_parallel_render_encoder(render_pass_desc rpass_desc) {
+  gpu_parallel_encoder* penc = calloc(1, sizeof(gpu_parallel_encoder));
+  penc->cmd_buffer = [ctx.command_queue commandBuffer];
+  penc->cmd_encoder = [penc->cmd_buffer parallelRenderCommandEncoderWithDescriptor:metal_render_pass(rpass_desc)];
+  return penc;
+}
+
+gpu_encoder** ral_parallel_encoder_streams(gpu_parallel_encoder* penc, u32 count) {
+  assert(penc->stream_count == 0);  // streams are created once per pass so their order is fixed up front
+  penc->streams = calloc(count, sizeof(gpu_encoder));
+  penc->stream_ptrs = calloc(count, sizeof(gpu_encoder*));
+  penc->stream_count = count;
+  // Metal executes sub-encoders in creation order, so create them all here on the submitting thread
+  for (u32 i = 0; i < count; i++) {
+    penc->streams[i].cmd_buffer = penc->cmd_buffer;
+    penc->streams[i].cmd_encoder = [penc->cmd_encoder renderCommandEncoder];
+    penc->stream_ptrs[i] = &penc->streams[i];
+  }
+  return penc->stream_ptrs;
+}
+
+gpu_encoder_stats ral_parallel_encoder_stats(gpu_parallel_encoder* penc) {
+  gpu_encoder_stats total = { 0 };
+  for (u32 i = 0; i < penc->stream_count; i++) {
+    total.binds_issued += penc->streams[i].bound.stats.binds_issued;
+    total.binds_elided += penc->streams[i].bound.stats.binds_elided;
+  }
+  return total;
+}
+
+void ral_parallel_encoder_finish_and_submit(gpu_parallel_encoder* penc) {
+  for (u32 i = 0; i < penc->stream_count; i++) {
+    [penc->streams[i].cmd_encoder endEncoding];
+  }
+  [penc->cmd_encoder endEncoding];
+  [penc->cmd_buffer presentDrawable:ctx.surface];
+  metal_track_frame(penc->cmd_buffer);
+  [penc->cmd_buffer commit];
+  [penc->cmd_buffer waitUntilCompleted];
+
+  free(penc->streams);
+  free(penc->stream_ptrs);
+  free(penc);
+}
+
+gpu_encoder_stats ral_encoder_stats(gpu_encoder* enc) { return enc->bound.stats; }
+
 void ral_encode_bind_pipeline(gpu_encoder *enc, pipeline_handle pipeline) {
+  if (!gpu_bind_state_pipeline(&enc->bound, pipeline)) return;
   metal_pipeline* p = pipeline_pool_get(&ctx.psopool, pipeline);
   [enc->cmd_encoder setRenderPipelineState:p->pso];
 }
 
-void ral_encode_set_vertex_buf(gpu_encoder *enc, buf_handle vbuf) {
-  metal_buffer* b = buf_pool_get(&ctx.bufpool, vbuf);
-  [enc->cmd_encoder setVertexBuffer:b->id offset:0 atIndex:0 ];
+void ral_encode_set_vertex_buf(gpu_encoder *enc, buf_handle vbuf) { ral_encode_set_vertex_buf_offset(enc, vbuf, 0); }
+
+void ral_encode_set_vertex_buf_offset(gpu_encoder* enc, buf_handle vbuf, u64 offset) {
+  switch (gpu_bind_state_vertex_buf(&enc->bound, vbuf, offset)) {
+    case BIND_ELIDE:
+      return;
+    case BIND_OFFSET_ONLY:
+      // meshes sharing a heap block only move the offset
+      [enc->cmd_encoder setVertexBufferOffset:offset atIndex:0];
+      return;
+    case BIND_FULL: {
+      metal_buffer* b = buf_pool_get(&ctx.bufpool, vbuf);
+      [enc->cmd_encoder setVertexBuffer:b->id offset:offset atIndex:0];
+      return;
+    }
+  }
+}
+
+static MTLIndexType mtl_index_type(index_format format) {
+  return format == INDEX_FORMAT_U16 ? MTLIndexTypeUInt16 : MTLIndexTypeUInt32;
+}
+
+void ral_encode_set_index_buf(gpu_encoder* enc, buf_handle ibuf, index_format format) {
+  // the format goes with the draw as well so it's kept even when the bind itself is redundant
+  enc->index_format = format;
+  // nothing reaches Metal here but it still shows up in the stats so backends compare like for like
+  if (!gpu_bind_state_index_buf(&enc->bound, ibuf)) return;
+  enc->index_buffer = ibuf;
+}
+
+void ral_encode_set_instance_buf(gpu_encoder* enc, buf_handle buf, u64 offset) {
+  if (!gpu_bind_state_instance_buf(&enc->bound, buf, offset)) return;
+  metal_buffer* b = buf_pool_get(&ctx.bufpool, buf);
+  [enc->cmd_encoder setVertexBuffer:b->id offset:offset atIndex:1];
+}
+
+void ral_encode_set_uniforms(gpu_encoder* enc, buf_handle buf, u64 offset, u32 slot, shader_stage stages) {
+  // slots 0 and 1 hold vertex and instance data so uniform blocks start after them
+  NSUInteger index = 2 + slot;
+  switch (gpu_bind_state_uniforms(&enc->bound, buf, offset, slot, stages)) {
+    case BIND_ELIDE:
+      return;
+    case BIND_OFFSET_ONLY:
+      if (stages & STAGE_VERTEX) [enc->cmd_encoder setVertexBufferOffset:offset atIndex:index];
+      if (stages & STAGE_FRAGMENT) [enc->cmd_encoder setFragmentBufferOffset:offset atIndex:index];
+      return;
+    case BIND_FULL: {
+      metal_buffer* b = buf_pool_get(&ctx.bufpool, buf);
+      if (stages & STAGE_VERTEX) [enc->cmd_encoder setVertexBuffer:b->id offset:offset atIndex:index];
+      if (stages & STAGE_FRAGMENT) [enc->cmd_encoder setFragmentBuffer:b->id offset:offset atIndex:index];
+      return;
+    }
+  }
 }
 
 void ral_encode_set_texture(gpu_encoder* enc, tex_handle texture, u32 slot) {
+  if (!gpu_bind_state_texture(&enc->bound, texture, slot)) return;
   metal_texture* t = tex_pool_get(&ctx.texpool, texture);
   [enc->cmd_encoder setFragmentTexture:t->id atIndex:slot];
 }
@@ -244,7 +502,50 @@ void ral_encode_draw_tris(gpu_encoder* enc, size_t start, size_t count) {
   [enc->cmd_encoder drawPrimitives:tri_primitive vertexStart:start vertexCount:count];
 }
 
-void ral_frame_start() {}
+void ral_encode_draw_tris_instanced(gpu_encoder* enc, size_t start, size_t count, u32 instance_count,
+                                    u32 first_instance) {
+  [enc->cmd_encoder drawPrimitives:MTLPrimitiveTypeTriangle
+                       vertexStart:start
+                       vertexCount:count
+                     instanceCount:instance_count
+                      baseInstance:first_instance];
+}
+
+void ral_encode_draw_indexed_tris_instanced(gpu_encoder* enc, u32 first_index, u32 index_count, u32 instance_count,
+                                            u32 first_instance) {
+  metal_buffer* ibuf = buf_pool_get(&ctx.bufpool, enc->index_buffer);
+  [enc->cmd_encoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                               indexCount:index_count
+                                indexType:mtl_index_type(enc->index_format)
+                              indexBuffer:ibuf->id
+                        indexBufferOffset:first_index * index_format_size(enc->index_format)
+                            instanceCount:instance_count
+                               baseVertex:0
+                             baseInstance:first_instance];
+}
+
+void ral_encode_multi_draw_indexed_indirect(gpu_encoder* enc, buf_handle args_buf, u64 offset, u32 draw_count,
+                                            u32 stride) {
+  metal_buffer* args = buf_pool_get(&ctx.bufpool, args_buf);
+  metal_buffer* ibuf = buf_pool_get(&ctx.bufpool, enc->index_buffer);
+  // Metal's render encoder only takes one indirect draw per call (true multi-draw needs indirect command buffers) but
+  // each of these is cheap as the arguments already live on the GPU
+  for (u32 i = 0; i < draw_count; i++) {
+    [enc->cmd_encoder drawIndexedPrimitives:MTLPrimitiveTypeTriangle
+                                  indexType:mtl_index_type(enc->index_format)
+                                indexBuffer:ibuf->id
+                          indexBufferOffset:0
+                             indirectBuffer:args->id
+                       indirectBufferOffset:offset + (u64)i * stride];
+  }
+}
+
+void ral_frame_start() {
+  ctx.frame_index++;
+  deferred_destroy_begin_frame(&ctx.deferred, ctx.frame_index);
+  u64 completed = atomic_load_explicit(&ctx.completed_frame, memory_order_acquire);
+  deferred_destroy_collect(&ctx.deferred, completed, metal_destroy_resource, NULL);
+}
 
 void ral_frame_draw(scoped_draw_commands draw_fn) {
   @autoreleasepool {
@@ -0,0 +1,149 @@
+/* Records the batches and indirect draw streams built by the render queue into command encoders */
+
+#include <celeritas.h>
+
+#define ENCODE_CHUNKS_PER_THREAD 2
+#define ENCODE_MIN_BATCHES_PER_STREAM 256
+
+// --- Instancing
+
+static u64 per_frame_offset(per_frame_buffer buf, u32 frame_index) {
+  return (u64)(frame_index % MAX_FRAMES_IN_FLIGHT) * buf.frame_size;
+}
+
+static void encode_material(gpu_encoder* enc, const material_binding* material) {
+  if (material->has_uniforms) {
+    ral_encode_set_uniforms(enc, material->uniforms, material->uniform_offset, MATERIAL_UNIFORM_SLOT,
+                            STAGE_VERTEX | STAGE_FRAGMENT);
+  }
+  for (u32 t = 0; t < material->texture_count; t++) {
+    ral_encode_set_texture(enc, material->textures[t], t);
+  }
+}
+
+typedef struct batch_encode_ctx {
+  gpu_encoder** streams;
+  u32 chunk_size;
+  const draw_batch_list* list;
+  const mesh* meshes;
+  const material_binding* materials;
+  const pipeline_handle* pipelines;
+  buf_handle instance_buf;
+  u64 instance_offset;
+  per_frame_buffer palettes;
+  u64 palette_offset;
+} batch_encode_ctx;
+
+static void encode_batch_range(gpu_encoder* enc, const batch_encode_ctx* ctx, u32 start, u32 end) {
+  // redundant binds between batches are dropped by the encoder
+  ral_encode_set_instance_buf(enc, ctx->instance_buf, ctx->instance_offset);
+  const material_binding* bound_material = NULL;
+  for (u32 i = start; i < end; i++) {
+    const draw_batch* batch = &ctx->list->batches[i];
+    const mesh* m = &ctx->meshes[batch->mesh.raw];
+
+    ral_encode_bind_pipeline(enc, ctx->pipelines[batch->pipeline]);
+    const material_binding* material = &ctx->materials[batch->material.raw];
+    if (material != bound_material) {
+      encode_material(enc, material);
+      bound_material = material;
+    }
+    if (batch->joint_count > 0) {
+      // every skinned batch shares the one palette upload so this is usually just an offset change
+      assert((u64)(batch->first_joint + batch->joint_count) * sizeof(mat4) <= ctx->palettes.frame_size);
+      ral_encode_set_uniforms(enc, ctx->palettes.buffer, ctx->palette_offset + (u64)batch->first_joint * sizeof(mat4),
+                              SKINNING_PALETTE_SLOT, STAGE_VERTEX);
+    }
+
+    ral_encode_set_vertex_buf_offset(enc, m->vertex_buffer, m->vertex_offset);
+    if (m->geo.has_indices) {
+      mesh_lod lod = geo_lod(&m->geo, batch->lod);
+      u32 first_index = (u32)(m->index_offset / index_format_size(m->geo.index_format)) + lod.first_index;
+      ral_encode_set_index_buf(enc, m->index_buffer, m->geo.index_format);
+      ral_encode_draw_indexed_tris_instanced(enc, first_index, lod.index_count, batch->instance_count,
+                                             batch->first_instance);
+    } else {
+      ral_encode_draw_tris_instanced(enc, 0, m->geo.vertex_count, batch->instance_count, batch->first_instance);
+    }
+  }
+}
+
+// uploads this frame's instances and fills in everything the batch encoders share
+static batch_encode_ctx batch_encode_begin(const draw_batch_list* list, const mesh* meshes,
+                                           const material_binding* materials, const pipeline_handle* pipelines,
+                                           per_frame_buffer instances, u32 frame_index, per_frame_buffer palettes) {
+  u64 upload_size = sizeof(instance_data) * list->instance_count;
+  assert(upload_size <= instances.frame_size);
+  batch_encode_ctx ctx = { .list = list,
+                           .meshes = meshes,
+                           .materials = materials,
+                           .pipelines = pipelines,
+                           .instance_buf = instances.buffer,
+                           .instance_offset = per_frame_offset(instances, frame_index),
+                           .palettes = palettes,
+                           .palette_offset = per_frame_offset(palettes, frame_index) };
+  ral_buffer_upload(instances.buffer, ctx.instance_offset, upload_size, list->instances);
+  return ctx;
+}
+
+void draw_batches_encode(gpu_encoder* enc, const draw_batch_list* list, const mesh* meshes,
+                         const material_binding* materials, const pipeline_handle* pipelines,
+                         per_frame_buffer instances, u32 frame_index, per_frame_buffer palettes) {
+  if (list->batch_count == 0) return;
+  batch_encode_ctx ctx = batch_encode_begin(list, meshes, materials, pipelines, instances, frame_index, palettes);
+  encode_batch_range(enc, &ctx, 0, list->batch_count);
+}
+
+static void encode_batch_chunk(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  batch_encode_ctx* ctx = data;
+  encode_batch_range(ctx->streams[start / ctx->chunk_size], ctx, start, end);
+}
+
+void draw_batches_encode_parallel(gpu_parallel_encoder* penc, const draw_batch_list* list, const mesh* meshes,
+                                  const material_binding* materials, const pipeline_handle* pipelines,
+                                  per_frame_buffer instances, u32 frame_index, per_frame_buffer palettes) {
+  u32 count = list->batch_count;
+  if (count == 0) return;
+  batch_encode_ctx ctx = batch_encode_begin(list, meshes, materials, pipelines, instances, frame_index, palettes);
+
+  // a few chunks per thread so uneven batches still balance, but never so small that stream overhead dominates
+  u32 target_chunks = job_system_thread_count() * ENCODE_CHUNKS_PER_THREAD;
+  u32 chunk_size = (count + target_chunks - 1) / target_chunks;
+  if (chunk_size < ENCODE_MIN_BATCHES_PER_STREAM) chunk_size = ENCODE_MIN_BATCHES_PER_STREAM;
+  u32 stream_count = (count + chunk_size - 1) / chunk_size;
+
+  ctx.streams = ral_parallel_encoder_streams(penc, stream_count);
+  ctx.chunk_size = chunk_size;
+  jobs_parallel_for(count, chunk_size, encode_batch_chunk, &ctx);
+}
+
+// --- Indirect draws
+
+void indirect_draws_encode(gpu_encoder* enc, const indirect_draw_stream* stream, const material_binding* materials,
+                           const pipeline_handle* pipelines, per_frame_buffer args, per_frame_buffer draw_data,
+                           u32 frame_index) {
+  if (stream->draw_count == 0) return;
+
+  u64 args_size = sizeof(draw_indexed_indirect_args) * stream->draw_count;
+  u64 data_size = sizeof(instance_data) * stream->draw_data_count;
+  assert(args_size <= args.frame_size && data_size <= draw_data.frame_size);
+  u64 args_offset = per_frame_offset(args, frame_index);
+  u64 data_offset = per_frame_offset(draw_data, frame_index);
+  ral_buffer_upload(args.buffer, args_offset, args_size, stream->args);
+  ral_buffer_upload(draw_data.buffer, data_offset, data_size, stream->draw_data);
+
+  ral_encode_set_vertex_buf(enc, stream->vertex_buffer);
+  ral_encode_set_index_buf(enc, stream->index_buffer, stream->index_format);
+  ral_encode_set_instance_buf(enc, draw_data.buffer, data_offset);
+  for (u32 i = 0; i < stream->segment_count; i++) {
+    const indirect_draw_segment* segment = &stream->segments[i];
+    ral_encode_bind_pipeline(enc, pipelines[segment->pipeline]);
+    if (i == 0 || segment->material.raw != stream->segments[i - 1].material.raw) {
+      encode_material(enc, &materials[segment->material.raw]);
+    }
+    ral_encode_multi_draw_indexed_indirect(enc, args.buffer,
+                                           args_offset + sizeof(draw_indexed_indirect_args) * segment->first_draw,
+                                           segment->draw_count, sizeof(draw_indexed_indirect_args));
+  }
+}
@@ -1 +1,187 @@
 /* Implements frustum culling in the reference renderer */
+
+#include <celeritas.h>
+
+#define CULL_CHUNK_SIZE 1024  // must be a multiple of SIMD_WIDTH
+
+static plane plane_normalised(f32 a, f32 b, f32 c, f32 d) {
+  f32 len = sqrtf(a * a + b * b + c * c);
+  return (plane){ .normal = vec3(a / len, b / len, c / len), .distance = d / len };
+}
+
+frustum frustum_from_view_proj(mat4 view_proj) {
+  // We use row vectors (clip = p * view_proj) so each clip-space coordinate is a dot product with a *column*
+  const f32* m = view_proj.data;
+  f32 col[4][4];
+  for (u32 c = 0; c < 4; c++) {
+    col[c][0] = m[c];
+    col[c][1] = m[4 + c];
+    col[c][2] = m[8 + c];
+    col[c][3] = m[12 + c];
+  }
+
+  frustum f;
+  for (u32 i = 0; i < 3; i++) {
+    // -w <= x,y,z <= w  =>  w + x >= 0 and w - x >= 0
+    f.planes[i * 2] = plane_normalised(col[3][0] + col[i][0], col[3][1] + col[i][1], col[3][2] + col[i][2],
+                                       col[3][3] + col[i][3]);
+    f.planes[i * 2 + 1] = plane_normalised(col[3][0] - col[i][0], col[3][1] - col[i][1], col[3][2] - col[i][2],
+                                           col[3][3] - col[i][3]);
+  }
+  return f;
+}
+
+static size_t cull_padded_count(u32 count) { return ((size_t)count + SIMD_WIDTH - 1) & ~((size_t)SIMD_WIDTH - 1); }
+
+static f32* cull_alloc_lanes(arena* a, u32 count) {
+  // arena_alloc zeroes so padding lanes are degenerate spheres at the origin and never get reported
+  return arena_alloc_align(a, cull_padded_count(count) * sizeof(f32), 32);
+}
+
+void cull_bounds_write_render_ent(cull_bounds_soa* b, u32 i, const render_ent* ent) {
+  const f32* m = ent->affine.data;
+  vec3 lo = ent->bounding_box.min, hi = ent->bounding_box.max;
+  f32 cx = (lo.x + hi.x) * 0.5f, cy = (lo.y + hi.y) * 0.5f, cz = (lo.z + hi.z) * 0.5f;
+  f32 ex = (hi.x - lo.x) * 0.5f, ey = (hi.y - lo.y) * 0.5f, ez = (hi.z - lo.z) * 0.5f;
+
+  // world-space AABB of the transformed box (Arvo's method: extents go through |M|)
+  f32 wex = ex * fabsf(m[0]) + ey * fabsf(m[4]) + ez * fabsf(m[8]);
+  f32 wey = ex * fabsf(m[1]) + ey * fabsf(m[5]) + ez * fabsf(m[9]);
+  f32 wez = ex * fabsf(m[2]) + ey * fabsf(m[6]) + ez * fabsf(m[10]);
+
+  b->center_x[i] = cx * m[0] + cy * m[4] + cz * m[8] + m[12];
+  b->center_y[i] = cx * m[1] + cy * m[5] + cz * m[9] + m[13];
+  b->center_z[i] = cx * m[2] + cy * m[6] + cz * m[10] + m[14];
+  b->extent_x[i] = wex;
+  b->extent_y[i] = wey;
+  b->extent_z[i] = wez;
+  b->radius[i] = sqrtf(wex * wex + wey * wey + wez * wez);
+  b->flags[i] = ent->flags;
+}
+
+cull_bounds_soa cull_bounds_from_render_ents(const render_ent* entities, u32 entity_count, arena* frame_arena) {
+  cull_bounds_soa b = { .count = entity_count };
+  b.center_x = cull_alloc_lanes(frame_arena, entity_count);
+  b.center_y = cull_alloc_lanes(frame_arena, entity_count);
+  b.center_z = cull_alloc_lanes(frame_arena, entity_count);
+  b.radius = cull_alloc_lanes(frame_arena, entity_count);
+  b.extent_x = cull_alloc_lanes(frame_arena, entity_count);
+  b.extent_y = cull_alloc_lanes(frame_arena, entity_count);
+  b.extent_z = cull_alloc_lanes(frame_arena, entity_count);
+  b.flags = arena_alloc(frame_arena, cull_padded_count(entity_count) * sizeof(render_ent_flags));
+
+  for (u32 i = 0; i < entity_count; i++) {
+    cull_bounds_write_render_ent(&b, i, &entities[i]);
+  }
+  return b;
+}
+
+cull_bounds_soa cull_bounds_from_draw_cmds(const draw_mesh_cmd* cmds, u32 cmd_count, arena* frame_arena) {
+  cull_bounds_soa b = { .count = cmd_count };
+  b.center_x = cull_alloc_lanes(frame_arena, cmd_count);
+  b.center_y = cull_alloc_lanes(frame_arena, cmd_count);
+  b.center_z = cull_alloc_lanes(frame_arena, cmd_count);
+  b.radius = cull_alloc_lanes(frame_arena, cmd_count);
+  b.flags = arena_alloc(frame_arena, cull_padded_count(cmd_count) * sizeof(render_ent_flags));
+
+  for (u32 i = 0; i < cmd_count; i++) {
+    const draw_mesh_cmd* cmd = &cmds[i];
+    const f32* m = cmd->transform.data;
+    vec3 c = cmd->bounding_sphere_center;
+    // scale the radius by the largest axis scale so non-uniform scales stay conservative
+    f32 sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    f32 sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    f32 sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+    f32 max_scale_sq = sx > sy ? (sx > sz ? sx : sz) : (sy > sz ? sy : sz);
+
+    b.center_x[i] = c.x * m[0] + c.y * m[4] + c.z * m[8] + m[12];
+    b.center_y[i] = c.x * m[1] + c.y * m[5] + c.z * m[9] + m[13];
+    b.center_z[i] = c.x * m[2] + c.y * m[6] + c.z * m[10] + m[14];
+    b.radius[i] = cmd->bounding_sphere_radius * sqrtf(max_scale_sq);
+    b.flags[i] = cmd->cast_shadows ? REND_ENT_CASTS_SHADOWS : 0;
+  }
+  return b;
+}
+
+typedef struct cull_job_ctx {
+  const cull_bounds_soa* bounds;
+  const cull_view* views;
+  u32 view_count;
+  u32** scratch_indices;  // [view][bound] - each chunk writes into its own slice starting at the chunk start
+  u32* chunk_counts;      // [chunk][view]
+} cull_job_ctx;
+
+static void cull_chunk(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  cull_job_ctx* ctx = data;
+  const cull_bounds_soa* b = ctx->bounds;
+  u32 chunk = start / CULL_CHUNK_SIZE;
+  u32* counts = &ctx->chunk_counts[chunk * ctx->view_count];
+
+  for (u32 i = start; i < end; i += SIMD_WIDTH) {
+    f32x8 cx = f32x8_load(&b->center_x[i]);
+    f32x8 cy = f32x8_load(&b->center_y[i]);
+    f32x8 cz = f32x8_load(&b->center_z[i]);
+    f32x8 neg_r = -f32x8_load(&b->radius[i]);
+    f32x8 ex = { 0 }, ey = { 0 }, ez = { 0 };
+    if (b->extent_x) {
+      ex = f32x8_load(&b->extent_x[i]);
+      ey = f32x8_load(&b->extent_y[i]);
+      ez = f32x8_load(&b->extent_z[i]);
+    }
+    u32 lanes = end - i < SIMD_WIDTH ? end - i : SIMD_WIDTH;
+
+    for (u32 v = 0; v < ctx->view_count; v++) {
+      const cull_view* view = &ctx->views[v];
+      i32x8 visible = (i32x8){ -1, -1, -1, -1, -1, -1, -1, -1 };
+
+      for (u32 p = 0; p < 6; p++) {
+        const plane* pl = &view->frustum.planes[p];
+        f32x8 dist = cx * pl->normal.x + cy * pl->normal.y + cz * pl->normal.z + pl->distance;
+        visible &= dist >= neg_r;
+        if (b->extent_x) {
+          // projected radius of the box onto the plane normal
+          f32 ax = fabsf(pl->normal.x), ay = fabsf(pl->normal.y), az = fabsf(pl->normal.z);
+          visible &= dist >= -(ex * ax + ey * ay + ez * az);
+        }
+      }
+
+      u32* out = &ctx->scratch_indices[v][start];
+      for (u32 l = 0; l < lanes; l++) {
+        bool flags_ok = !b->flags || (b->flags[i + l] & view->required_flags) == view->required_flags;
+        if (visible[l] && flags_ok) {
+          out[counts[v]++] = i + l;
+        }
+      }
+    }
+  }
+}
+
+void frustum_cull(const cull_bounds_soa* bounds, const cull_view* views, u32 view_count, arena* frame_arena,
+                  cull_result* out_results) {
+  u32 count = bounds->count;
+  u32 chunk_count = (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+
+  cull_job_ctx ctx = { .bounds = bounds, .views = views, .view_count = view_count };
+  ctx.scratch_indices = arena_alloc(frame_arena, sizeof(u32*) * view_count);
+  ctx.chunk_counts = arena_alloc(frame_arena, sizeof(u32) * (chunk_count > 0 ? chunk_count : 1) * view_count);
+  for (u32 v = 0; v < view_count; v++) {
+    // make space for if all ents are visible
+    ctx.scratch_indices[v] = arena_alloc(frame_arena, sizeof(u32) * (count > 0 ? count : 1));
+  }
+
+  jobs_parallel_for(count, CULL_CHUNK_SIZE, cull_chunk, &ctx);
+
+  // compact each chunk's survivors down so the per-view lists are contiguous and in ascending order
+  for (u32 v = 0; v < view_count; v++) {
+    u32* indices = ctx.scratch_indices[v];
+    u32 n_visible = 0;
+    for (u32 c = 0; c < chunk_count; c++) {
+      u32 n = ctx.chunk_counts[c * view_count + v];
+      memmove(&indices[n_visible], &indices[c * CULL_CHUNK_SIZE], n * sizeof(u32));
+      n_visible += n;
+    }
+    out_results[v] = (cull_result){ .visible_indices = indices, .n_visible = n_visible, .n_culled = count - n_visible };
+    assert(out_results[v].n_visible + out_results[v].n_culled == count);
+  }
+}
@@ -7,6 +7,54 @@ typedef struct static_3d_vert {
   vec2 pad;
 } static_3d_vert;
 
+u32 vertex_attrib_size(vertex_attrib_type type) {
+  switch (type) {
+    case ATTR_F32:
+    case ATTR_U32:
+    case ATTR_I32:
+      return 4;
+    case ATTR_F32x2:
+    case ATTR_U32x2:
+    case ATTR_I32x2:
+      return 8;
+    case ATTR_F32x3:
+    case ATTR_U32x3:
+    case ATTR_I32x3:
+      return 12;
+    case ATTR_F32x4:
+    case ATTR_U32x4:
+    case ATTR_I32x4:
+      return 16;
+    case ATTR_I8x2_NORM:
+      return 2;
+    case ATTR_I16x2_NORM:
+    case ATTR_F16x2:
+    case ATTR_U8x4:
+    case ATTR_U8x4_NORM:
+      return 4;
+    case ATTR_U16x4_NORM:
+      return 8;
+  }
+  return 0;
+}
+
+u32 vertex_desc_stride(const vertex_desc* desc) {
+  u32 stride = desc->padding;
+  for (u32 i = 0; i < desc->attribute_count; i++) {
+    stride += vertex_attrib_size(desc->attributes[i]);
+  }
+  return stride;
+}
+
+u32 index_format_size(index_format format) { return format == INDEX_FORMAT_U16 ? sizeof(u16) : sizeof(u32); }
+
+mesh_lod geo_lod(const geometry* geo, u32 level) {
+  if (geo->lod_count == 0) {
+    return (mesh_lod){ .index_count = geo->has_indices ? geo->index_count : geo->vertex_count };
+  }
+  return geo->lods[level < geo->lod_count ? level : geo->lod_count - 1];
+}
+
 vertex_desc static_3d_vertex_format() {
   vertex_desc desc;
   desc.label = "Static 3D Vertex";
@@ -14,11 +62,17 @@ vertex_desc static_3d_vertex_format() {
   desc.attributes[1] = ATTR_F32x4;  // normal
   desc.attributes[2] = ATTR_F32x2;  // tex coord
   desc.attribute_count = 3;
-  desc.padding = 16;  // 16 bytes padding
+  desc.padding = 8;  // `static_3d_vert.pad`
 
   return desc;
 }
 
+vertex_quantise_desc static_3d_quantise_desc() {
+  return (vertex_quantise_desc){
+    .semantics = { VERTEX_SEMANTIC_POSITION, VERTEX_SEMANTIC_NORMAL, VERTEX_SEMANTIC_TEX_COORD },
+  };
+}
+
 geometry geo_cuboid(f32 x_scale, f32 y_scale, f32 z_scale) {
   vec4 BACK_BOT_LEFT = (vec4){ 0, 0, 0, 0 };
   vec4 BACK_BOT_RIGHT = (vec4){ 1, 0, 0, 0 };
@@ -30,7 +84,7 @@ geometry geo_cuboid(f32 x_scale, f32 y_scale, f32 z_scale) {
   vec4 FRONT_TOP_RIGHT = (vec4){ 1, 1, 1, 0 };
 
   // allocate the data
-  static_3d_vert* vertices = malloc(36 * 64);
+  static_3d_vert* vertices = malloc(36 * sizeof(static_3d_vert));
 
   vertices[0] = (static_3d_vert){ .pos = BACK_TOP_RIGHT, .norm = (v3tov4(VEC3_NEG_Z)), .uv = { 0, 0 } };
   vertices[1] = (static_3d_vert){ .pos = BACK_BOT_LEFT, .norm = v3tov4(VEC3_NEG_Z), .uv = { 0, 1 } };
@@ -79,7 +133,10 @@ geometry geo_cuboid(f32 x_scale, f32 y_scale, f32 z_scale) {
   vertices[34] = (static_3d_vert){ .pos = FRONT_BOT_LEFT, .norm = v3tov4(VEC3_NEG_X), .uv = { 0, 0 } };
   vertices[35] = (static_3d_vert){ .pos = FRONT_TOP_LEFT, .norm = v3tov4(VEC3_NEG_X), .uv = { 0, 0 } };
 
-  return (geometry){
-    .vertex_format = static_3d_vertex_format(), .vertex_data = vertices, .has_indices = false, .indices = NULL
-  };
+  return (geometry){ .vertex_format = static_3d_vertex_format(),
+                     .vertex_data = vertices,
+                     .vertex_count = 36,
+                     .has_indices = false,
+                     .indices = NULL,
+                     .index_count = 0 };
 }
\ No newline at end of file
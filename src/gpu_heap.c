@@ -0,0 +1,75 @@
+/* GPU heap: a growing set of large buffers, each sub-allocated by its own offset allocator */
+
+#include <celeritas.h>
+
+NAMESPACED_LOGGER(gpu_heap);
+
+static u32 heap_units(const gpu_heap* heap, u64 bytes) {
+  return (u32)((bytes + heap->alignment - 1) / heap->alignment);
+}
+
+gpu_heap gpu_heap_create(u64 block_size, u32 alignment, u32 max_allocs_per_block) {
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+  assert(block_size / alignment <= UINT32_MAX);
+  return (gpu_heap){ .block_size = block_size, .alignment = alignment, .max_allocs_per_block = max_allocs_per_block };
+}
+
+void gpu_heap_destroy(gpu_heap* heap) {
+  for (u32 i = 0; i < heap->block_count; i++) {
+    ral_buffer_destroy(heap->blocks[i].buffer);
+    offset_allocator_destroy(&heap->blocks[i].allocator);
+  }
+  heap->block_count = 0;
+}
+
+static gpu_suballoc gpu_heap_alloc_in(gpu_heap* heap, u32 block, u32 units, u64 size) {
+  offset_alloc a = offset_allocator_alloc(&heap->blocks[block].allocator, units);
+  if (a.offset == OFFSET_ALLOC_NO_SPACE) return (gpu_suballoc){ .block = UINT32_MAX };
+  return (gpu_suballoc){ .buffer = heap->blocks[block].buffer,
+                         .offset = (u64)a.offset * heap->alignment,
+                         .size = size,
+                         .block = block,
+                         .metadata = a.metadata };
+}
+
+gpu_suballoc gpu_heap_alloc(gpu_heap* heap, u64 size) {
+  u32 units = heap_units(heap, size);
+  for (u32 i = 0; i < heap->block_count; i++) {
+    if (heap->blocks[i].allocator.free_storage < units) continue;
+    gpu_suballoc s = gpu_heap_alloc_in(heap, i, units, size);
+    if (s.block != UINT32_MAX) return s;
+  }
+
+  if (heap->block_count == GPU_HEAP_MAX_BLOCKS) {
+    ERROR("GPU heap is out of blocks");
+    return (gpu_suballoc){ .block = UINT32_MAX };
+  }
+  u64 block_bytes = size > heap->block_size ? (u64)units * heap->alignment : heap->block_size;
+  u32 block = heap->block_count++;
+  heap->blocks[block].buffer = ral_buffer_create(block_bytes, NULL);
+  heap->blocks[block].allocator = offset_allocator_create(heap_units(heap, block_bytes), heap->max_allocs_per_block);
+  TRACE("GPU heap grew a new block");
+  return gpu_heap_alloc_in(heap, block, units, size);
+}
+
+void gpu_heap_free(gpu_heap* heap, gpu_suballoc allocation) {
+  assert(allocation.block < heap->block_count);
+  offset_allocator_free(&heap->blocks[allocation.block].allocator,
+                        (offset_alloc){ .offset = (u32)(allocation.offset / heap->alignment),
+                                        .metadata = allocation.metadata });
+}
+
+gpu_heap_stats gpu_heap_get_stats(const gpu_heap* heap) {
+  gpu_heap_stats stats = { .block_count = heap->block_count };
+  for (u32 i = 0; i < heap->block_count; i++) {
+    const offset_allocator* a = &heap->blocks[i].allocator;
+    offset_allocator_stats s = offset_allocator_get_stats(a);
+    stats.reserved_bytes += (u64)a->size * heap->alignment;
+    stats.free_bytes += (u64)s.total_free * heap->alignment;
+    if ((u64)s.largest_free * heap->alignment > stats.largest_free) {
+      stats.largest_free = (u64)s.largest_free * heap->alignment;
+    }
+    if (s.fragmentation > stats.fragmentation) stats.fragmentation = s.fragmentation;
+  }
+  return stats;
+}
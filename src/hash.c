@@ -0,0 +1,25 @@
+/* Non-cryptographic hashing for cache keys */
+
+#include <celeritas.h>
+
+#define FNV_PRIME 0x100000001b3ull
+
+u64 hash_bytes(const void* data, size_t len, u64 seed) {
+  const u8* bytes = data;
+  u64 h = seed;
+  for (size_t i = 0; i < len; i++) {
+    h ^= bytes[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+u64 hash_str(const char* str, u64 seed) {
+  u64 h = seed;
+  if (!str) return h;
+  for (; *str; str++) {
+    h ^= (u8)*str;
+    h *= FNV_PRIME;
+  }
+  return h;
+}
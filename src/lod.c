@@ -0,0 +1,422 @@
+/* Levels of detail: quadric error simplification at import and screen-size selection per frame */
+
+#include <celeritas.h>
+
+#define VERTEX_NONE UINT32_MAX
+#define LOD_MIN_REDUCTION 0.95f  // a level keeping more of the previous level's triangles than this isn't worth it
+
+// --- Quadrics
+
+/** @brief the symmetric 4x4 matrix of summed squared plane distances, plus the area it was weighted by */
+typedef struct quadric {
+  f32 a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+  f32 weight;
+} quadric;
+
+static void quadric_add_plane(quadric* q, vec3 n, f32 d, f32 w) {
+  q->a2 += n.x * n.x * w;
+  q->ab += n.x * n.y * w;
+  q->ac += n.x * n.z * w;
+  q->ad += n.x * d * w;
+  q->b2 += n.y * n.y * w;
+  q->bc += n.y * n.z * w;
+  q->bd += n.y * d * w;
+  q->c2 += n.z * n.z * w;
+  q->cd += n.z * d * w;
+  q->d2 += d * d * w;
+  q->weight += w;
+}
+
+static void quadric_add(quadric* q, const quadric* r) {
+  q->a2 += r->a2;
+  q->ab += r->ab;
+  q->ac += r->ac;
+  q->ad += r->ad;
+  q->b2 += r->b2;
+  q->bc += r->bc;
+  q->bd += r->bd;
+  q->c2 += r->c2;
+  q->cd += r->cd;
+  q->d2 += r->d2;
+  q->weight += r->weight;
+}
+
+/** @brief area-weighted mean squared distance from `p` to the planes */
+static f32 quadric_error(const quadric* q, vec3 p) {
+  f32 rx = q->a2 * p.x + q->ab * p.y + q->ac * p.z + q->ad;
+  f32 ry = q->ab * p.x + q->b2 * p.y + q->bc * p.z + q->bd;
+  f32 rz = q->ac * p.x + q->bc * p.y + q->c2 * p.z + q->cd;
+  f32 e = p.x * rx + p.y * ry + p.z * rz + q->ad * p.x + q->bd * p.y + q->cd * p.z + q->d2;
+  return q->weight > 0.0f ? fabsf(e) / q->weight : 0.0f;
+}
+
+// --- Simplification
+
+typedef struct simplifier {
+  u32* indices;  // the current level
+  u32 index_count;
+  vec3* source_normals;  // per triangle of the current level, the normal of the full detail triangle it came from
+  u32 vertex_count;
+  vec3* positions;
+  u32* canonical;  // the first vertex at each position, seams split one position into several vertices
+  u8* locked;      // per canonical vertex: on an open border, a seam or a non-manifold edge
+  quadric* quadrics;  // per canonical vertex
+  f32* attributes;    // `attribute_count` floats per vertex following the position
+  u32 attribute_count;
+  f32 attribute_weight;
+  f32 inv_radius_sq;
+  f32 max_cost;  // largest collapse so far, in squared relative error
+  // per pass scratch
+  u32* offsets;
+  u32* adjacency;
+  u32* collapse_to;
+  u8* touched;
+} simplifier;
+
+typedef struct collapse {
+  u32 from, to;
+  f32 cost;
+} collapse;
+
+static int cmp_collapse_cost(const void* a, const void* b) {
+  const collapse* x = a;
+  const collapse* y = b;
+  if (x->cost != y->cost) return x->cost < y->cost ? -1 : 1;
+  return x->from < y->from ? -1 : (x->from > y->from);
+}
+
+static u32 table_size_for(u32 count) {
+  u32 size = 16;
+  while (size < count * 2) size *= 2;
+  return size;
+}
+
+static void find_canonical_positions(simplifier* s) {
+  u32 table_size = table_size_for(s->vertex_count);
+  u32* table = malloc(sizeof(u32) * table_size);
+  assert(table);
+  memset(table, 0xFF, sizeof(u32) * table_size);
+  for (u32 v = 0; v < s->vertex_count; v++) {
+    u32 slot = (u32)hash_bytes(&s->positions[v], sizeof(vec3), HASH_SEED) & (table_size - 1);
+    while (table[slot] != VERTEX_NONE && memcmp(&s->positions[table[slot]], &s->positions[v], sizeof(vec3)) != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    if (table[slot] == VERTEX_NONE) table[slot] = v;
+    s->canonical[v] = table[slot];
+    // a second vertex at the same position means attributes differ across it
+    if (s->canonical[v] != v) s->locked[s->canonical[v]] = 1;
+  }
+  free(table);
+}
+
+/** @brief locks the ends of every edge that isn't matched by exactly one opposite edge */
+static void lock_borders(simplifier* s) {
+  u32 table_size = table_size_for(s->index_count);
+  u64* keys = malloc(sizeof(u64) * table_size);
+  u32* counts = calloc(table_size, sizeof(u32));
+  assert(keys && counts);
+  memset(keys, 0xFF, sizeof(u64) * table_size);
+
+  for (u32 pass = 0; pass < 2; pass++) {
+    for (u32 i = 0; i < s->index_count; i++) {
+      u32 a = s->canonical[s->indices[i]];
+      u32 b = s->canonical[s->indices[i - i % 3 + (i + 1) % 3]];
+      // first pass counts directed edges, the second looks each one's opposite up
+      u64 key = pass == 0 ? ((u64)a << 32 | b) : ((u64)b << 32 | a);
+      u32 slot = (u32)hash_bytes(&key, sizeof(key), HASH_SEED) & (table_size - 1);
+      while (keys[slot] != UINT64_MAX && keys[slot] != key) slot = (slot + 1) & (table_size - 1);
+      if (pass == 0) {
+        keys[slot] = key;
+        counts[slot]++;
+      } else if (keys[slot] != key || counts[slot] != 1) {
+        s->locked[a] = 1;
+        s->locked[b] = 1;
+      }
+    }
+  }
+  free(keys);
+  free(counts);
+}
+
+static void simplifier_init(simplifier* s, const geometry* geo, const u32* indices, u32 index_count,
+                            f32 attribute_weight) {
+  u32 stride = vertex_desc_stride(&geo->vertex_format);
+  *s = (simplifier){ .index_count = index_count, .vertex_count = geo->vertex_count,
+                     .attribute_weight = attribute_weight };
+  s->indices = malloc(sizeof(u32) * index_count);
+  s->source_normals = malloc(sizeof(vec3) * (index_count / 3));
+  s->positions = malloc(sizeof(vec3) * s->vertex_count);
+  s->canonical = malloc(sizeof(u32) * s->vertex_count);
+  s->locked = calloc(s->vertex_count, 1);
+  s->quadrics = calloc(s->vertex_count, sizeof(quadric));
+  s->offsets = malloc(sizeof(u32) * (s->vertex_count + 1));
+  s->adjacency = malloc(sizeof(u32) * index_count);
+  s->collapse_to = malloc(sizeof(u32) * s->vertex_count);
+  s->touched = malloc(s->vertex_count);
+  assert(s->indices && s->source_normals && s->positions && s->canonical && s->locked && s->quadrics && s->offsets &&
+         s->adjacency && s->collapse_to && s->touched);
+  memcpy(s->indices, indices, sizeof(u32) * index_count);
+
+  const u8* vertices = geo->vertex_data;
+  for (u32 v = 0; v < s->vertex_count; v++) memcpy(&s->positions[v], vertices + (u64)v * stride, sizeof(vec3));
+
+  // attributes only count when everything after the position is made of floats
+  const vertex_desc* desc = &geo->vertex_format;
+  u32 attribute_bytes = 0;
+  bool all_floats = true;
+  for (u32 a = 1; a < desc->attribute_count; a++) {
+    vertex_attrib_type t = desc->attributes[a];
+    all_floats &= t == ATTR_F32 || t == ATTR_F32x2 || t == ATTR_F32x3 || t == ATTR_F32x4;
+    attribute_bytes += vertex_attrib_size(t);
+  }
+  if (all_floats && attribute_bytes > 0 && attribute_weight > 0.0f) {
+    u32 offset = vertex_attrib_size(desc->attributes[0]);
+    s->attribute_count = attribute_bytes / sizeof(f32);
+    s->attributes = malloc(attribute_bytes * s->vertex_count);
+    assert(s->attributes);
+    for (u32 v = 0; v < s->vertex_count; v++) {
+      memcpy(s->attributes + (u64)v * s->attribute_count, vertices + (u64)v * stride + offset, attribute_bytes);
+    }
+  }
+
+  // errors are kept relative to the sphere around the bounding box, like the culling bounds
+  vec3 lo = s->positions[0], hi = s->positions[0];
+  for (u32 v = 1; v < s->vertex_count; v++) {
+    vec3 p = s->positions[v];
+    lo = vec3(fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z));
+    hi = vec3(fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z));
+  }
+  f32 radius = vec3_len(vec3_sub(hi, lo)) * 0.5f;
+  s->inv_radius_sq = radius > 0.0f ? 1.0f / (radius * radius) : 1.0f;
+
+  find_canonical_positions(s);
+  lock_borders(s);
+
+  for (u32 t = 0; t < index_count / 3; t++) {
+    vec3 p0 = s->positions[indices[t * 3 + 0]];
+    vec3 p1 = s->positions[indices[t * 3 + 1]];
+    vec3 p2 = s->positions[indices[t * 3 + 2]];
+    vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+    f32 len = vec3_len(n);
+    s->source_normals[t] = n;
+    if (len == 0.0f) continue;
+    n = vec3_mult(n, 1.0f / len);
+    f32 d = -vec3_dot(n, p0);
+    for (u32 c = 0; c < 3; c++) quadric_add_plane(&s->quadrics[s->canonical[indices[t * 3 + c]]], n, d, len * 0.5f);
+  }
+}
+
+static void simplifier_destroy(simplifier* s) {
+  free(s->indices);
+  free(s->source_normals);
+  free(s->positions);
+  free(s->canonical);
+  free(s->locked);
+  free(s->quadrics);
+  free(s->attributes);
+  free(s->offsets);
+  free(s->adjacency);
+  free(s->collapse_to);
+  free(s->touched);
+}
+
+static void build_adjacency(simplifier* s) {
+  memset(s->offsets, 0, sizeof(u32) * (s->vertex_count + 1));
+  for (u32 i = 0; i < s->index_count; i++) s->offsets[s->indices[i] + 1]++;
+  for (u32 v = 0; v < s->vertex_count; v++) s->offsets[v + 1] += s->offsets[v];
+  for (u32 i = 0; i < s->index_count; i++) s->adjacency[s->offsets[s->indices[i]]++] = i / 3;
+  for (u32 v = s->vertex_count; v > 0; v--) s->offsets[v] = s->offsets[v - 1];
+  s->offsets[0] = 0;
+}
+
+/** @brief squared relative error of moving `from` onto `to` */
+static f32 collapse_cost(const simplifier* s, u32 from, u32 to) {
+  quadric q = s->quadrics[s->canonical[from]];
+  quadric_add(&q, &s->quadrics[s->canonical[to]]);
+  f32 cost = quadric_error(&q, s->positions[to]) * s->inv_radius_sq;
+  if (s->attributes) {
+    const f32* a = s->attributes + (u64)from * s->attribute_count;
+    const f32* b = s->attributes + (u64)to * s->attribute_count;
+    f32 diff = 0.0f;
+    for (u32 i = 0; i < s->attribute_count; i++) diff += (a[i] - b[i]) * (a[i] - b[i]);
+    cost += s->attribute_weight * diff;
+  }
+  return cost;
+}
+
+/** @brief Would moving `from` onto `to` turn any surviving triangle around `from` over? Checked against the full
+           detail surface as well since small turns add up over the rounds. Also refuses when a neighbour already
+           moved this round, as the triangles here would be checked against its old position */
+static bool collapse_flips(const simplifier* s, u32 from, u32 to) {
+  u32 to_pos = s->canonical[to];
+  for (u32 a = s->offsets[from]; a < s->offsets[from + 1]; a++) {
+    const u32* tri = &s->indices[s->adjacency[a] * 3];
+    u32 c = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+    u32 v1 = tri[(c + 1) % 3], v2 = tri[(c + 2) % 3];
+    if (s->collapse_to[v1] != v1 || s->collapse_to[v2] != v2) return true;
+    if (s->canonical[v1] == to_pos || s->canonical[v2] == to_pos) continue;  // collapses away
+    vec3 p1 = s->positions[v1], p2 = s->positions[v2];
+    vec3 before = vec3_cross(vec3_sub(p1, s->positions[from]), vec3_sub(p2, s->positions[from]));
+    vec3 after = vec3_cross(vec3_sub(p1, s->positions[to]), vec3_sub(p2, s->positions[to]));
+    vec3 source = s->source_normals[s->adjacency[a]];
+    // anything near perpendicular to the original surface is a fin even if it technically still faces outwards
+    if (vec3_dot(before, after) <= 0.0f || vec3_dot(source, after) <= 0.25f * vec3_len(source) * vec3_len(after)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/** @brief One round of collapses, cheapest first. Each collapse locks its neighbourhood for the rest of the round so
+           costs and flip checks stay valid without re-evaluating anything. Returns how many collapses happened */
+static u32 simplify_pass(simplifier* s, u32 target_tris, f32 max_cost, collapse* candidates) {
+  build_adjacency(s);
+
+  u32 candidate_count = 0;
+  for (u32 v = 0; v < s->vertex_count; v++) {
+    if (s->locked[s->canonical[v]] || s->offsets[v] == s->offsets[v + 1]) continue;
+    collapse best = { .from = v, .to = VERTEX_NONE, .cost = max_cost };
+    for (u32 a = s->offsets[v]; a < s->offsets[v + 1]; a++) {
+      const u32* tri = &s->indices[s->adjacency[a] * 3];
+      for (u32 c = 0; c < 3; c++) {
+        if (tri[c] == v) continue;
+        f32 cost = collapse_cost(s, v, tri[c]);
+        if (cost <= best.cost) {
+          best.to = tri[c];
+          best.cost = cost;
+        }
+      }
+    }
+    if (best.to != VERTEX_NONE) candidates[candidate_count++] = best;
+  }
+  qsort(candidates, candidate_count, sizeof(collapse), cmp_collapse_cost);
+
+  for (u32 v = 0; v < s->vertex_count; v++) s->collapse_to[v] = v;
+  memset(s->touched, 0, s->vertex_count);
+  u32 tri_count = s->index_count / 3;
+  u32 collapses = 0;
+  for (u32 i = 0; i < candidate_count && tri_count > target_tris; i++) {
+    u32 from = candidates[i].from, to = candidates[i].to;
+    if (s->touched[s->canonical[from]] || s->touched[s->canonical[to]]) continue;
+    if (collapse_flips(s, from, to)) continue;
+
+    for (u32 a = s->offsets[from]; a < s->offsets[from + 1]; a++) {
+      const u32* tri = &s->indices[s->adjacency[a] * 3];
+      bool degenerates = false;
+      for (u32 c = 0; c < 3; c++) {
+        s->touched[s->canonical[tri[c]]] = 1;
+        degenerates |= s->canonical[tri[c]] == s->canonical[to];
+      }
+      tri_count -= degenerates;
+    }
+    s->collapse_to[from] = to;
+    quadric_add(&s->quadrics[s->canonical[to]], &s->quadrics[s->canonical[from]]);
+    if (candidates[i].cost > s->max_cost) s->max_cost = candidates[i].cost;
+    collapses++;
+  }
+
+  // apply the round and drop the triangles that lost an edge
+  u32 out = 0;
+  for (u32 t = 0; t < s->index_count / 3; t++) {
+    u32 a = s->collapse_to[s->indices[t * 3 + 0]];
+    u32 b = s->collapse_to[s->indices[t * 3 + 1]];
+    u32 c = s->collapse_to[s->indices[t * 3 + 2]];
+    u32 pa = s->canonical[a], pb = s->canonical[b], pc = s->canonical[c];
+    if (pa == pb || pb == pc || pa == pc) continue;
+    s->source_normals[out / 3] = s->source_normals[t];
+    s->indices[out++] = a;
+    s->indices[out++] = b;
+    s->indices[out++] = c;
+  }
+  s->index_count = out;
+  return collapses;
+}
+
+static void simplify_to(simplifier* s, u32 target_tris, f32 max_cost) {
+  collapse* candidates = malloc(sizeof(collapse) * s->vertex_count);
+  assert(candidates);
+  while (s->index_count / 3 > target_tris) {
+    if (simplify_pass(s, target_tris, max_cost, candidates) == 0) break;
+  }
+  free(candidates);
+}
+
+void geo_generate_lods(geometry* geo, const lod_chain_desc* desc) {
+  assert(geo->has_indices && geo->lod_count == 0);
+  assert(desc->level_count >= 1 && desc->level_count <= MAX_MESH_LODS);
+  assert(geo->vertex_format.attribute_count > 0 &&
+         (geo->vertex_format.attributes[0] == ATTR_F32x3 || geo->vertex_format.attributes[0] == ATTR_F32x4));
+
+  u32 base_count = geo->index_count;
+  u32* levels = malloc(sizeof(u32) * base_count * desc->level_count);  // every level is at most the full size
+  assert(levels);
+  for (u32 i = 0; i < base_count; i++) {
+    levels[i] = geo->index_format == INDEX_FORMAT_U16 ? ((const u16*)geo->indices)[i] : ((const u32*)geo->indices)[i];
+  }
+  geo->lods[0] = (mesh_lod){ .first_index = 0, .index_count = base_count, .error = 0.0f };
+  geo->lod_count = 1;
+  u32 total = base_count;
+
+  simplifier s;
+  simplifier_init(&s, geo, levels, base_count, desc->attribute_weight);
+  for (u32 level = 1; level < desc->level_count; level++) {
+    u32 prev_tris = geo->lods[level - 1].index_count / 3;
+    f32 max_error = desc->max_error[level];
+    simplify_to(&s, (u32)((f32)prev_tris * desc->triangle_ratio), max_error > 0.0f ? max_error * max_error : INFINITY);
+
+    u32 tris = s.index_count / 3;
+    if (tris == 0 || (f32)tris > (f32)prev_tris * LOD_MIN_REDUCTION) break;
+    mesh_optimise_vertex_cache(levels + total, s.indices, s.index_count, s.vertex_count);
+    geo->lods[level] = (mesh_lod){ .first_index = total, .index_count = s.index_count, .error = sqrtf(s.max_cost) };
+    geo->lod_count++;
+    total += s.index_count;
+  }
+  simplifier_destroy(&s);
+
+  // every level shares the vertices so the index format can't change
+  free(geo->indices);
+  if (geo->index_format == INDEX_FORMAT_U16) {
+    u16* narrow = malloc(sizeof(u16) * total);
+    assert(narrow);
+    for (u32 i = 0; i < total; i++) narrow[i] = (u16)levels[i];
+    free(levels);
+    geo->indices = narrow;
+  } else {
+    geo->indices = realloc(levels, sizeof(u32) * total);
+  }
+  geo->index_count = total;
+}
+
+// --- Selection
+
+void render_ents_select_lods(render_ent* entities, const cull_bounds_soa* bounds, const cull_result* visible,
+                             const mesh* meshes, camera cam, f32 viewport_height, f32 max_error_px, f32 hysteresis) {
+  // pixels covered by one world unit at unit distance
+  f32 pixels_per_unit = viewport_height * 0.5f / tanf(cam.fov * 0.5f);
+  f32 refine_above = max_error_px * (1.0f + hysteresis);
+  f32 coarsen_below = max_error_px * (1.0f - hysteresis);
+
+  for (u32 i = 0; i < visible->n_visible; i++) {
+    u32 idx = visible->visible_indices[i];
+    render_ent* ent = &entities[idx];
+    const geometry* geo = &meshes[ent->mesh.raw].geo;
+    if (geo->lod_count <= 1) {
+      ent->lod = 0;
+      continue;
+    }
+
+    vec3 center = vec3(bounds->center_x[idx], bounds->center_y[idx], bounds->center_z[idx]);
+    f32 radius = bounds->radius[idx];
+    f32 dist = vec3_len(vec3_sub(center, cam.position));
+    if (dist <= radius) {
+      ent->lod = 0;  // inside the sphere everything is as close as it gets
+      continue;
+    }
+    f32 radius_px = radius * pixels_per_unit / dist;
+
+    u32 lod = ent->lod < geo->lod_count ? ent->lod : geo->lod_count - 1;
+    while (lod > 0 && geo->lods[lod].error * radius_px > refine_above) lod--;
+    while (lod + 1 < geo->lod_count && geo->lods[lod + 1].error * radius_px <= coarsen_below) lod++;
+    ent->lod = (u8)lod;
+  }
+}
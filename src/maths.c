@@ -3,11 +3,94 @@
 vec3 vec3_create(f32 x, f32 y, f32 z) { return (vec3){ x, y, z }; }
 
 vec3 vec3_add(vec3 u, vec3 v) { return (vec3){ .x = u.x + v.x, .y = u.y + v.y, .z = u.z + v.z }; }
+vec3 vec3_sub(vec3 u, vec3 v) { return (vec3){ .x = u.x - v.x, .y = u.y - v.y, .z = u.z - v.z }; }
+vec3 vec3_mult(vec3 u, f32 s) { return (vec3){ .x = u.x * s, .y = u.y * s, .z = u.z * s }; }
+vec3 vec3_div(vec3 u, f32 s) { return (vec3){ .x = u.x / s, .y = u.y / s, .z = u.z / s }; }
+f32 vec3_len(vec3 a) { return sqrtf(a.x * a.x + a.y * a.y + a.z * a.z); }
+vec3 vec3_negate(vec3 a) { return (vec3){ -a.x, -a.y, -a.z }; }
+vec3 vec3_normalise(vec3 a) { return vec3_div(a, vec3_len(a)); }
+f32 vec3_dot(vec3 a, vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+vec3 vec3_cross(vec3 a, vec3 b) {
+  return (vec3){ .x = a.y * b.z - a.z * b.y, .y = a.z * b.x - a.x * b.z, .z = a.x * b.y - a.y * b.x };
+}
 
 vec4 vec4_create(f32 x, f32 y, f32 z, f32 w) { return (vec4){ x, y, z, w }; }
 
+quat quat_ident() { return (quat){ .x = 0.0, .y = 0.0, .z = 0.0, .w = 1.0 }; }
+
+static f32 quat_dot(quat a, quat b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+static quat quat_normalise(quat q) {
+  f32 len = sqrtf(quat_dot(q, q));
+  return (quat){ q.x / len, q.y / len, q.z / len, q.w / len };
+}
+
+quat quat_from_axis_angle(vec3 axis, f32 angle, bool normalise) {
+  f32 s = sinf(0.5f * angle), c = cosf(0.5f * angle);
+  quat q = { s * axis.x, s * axis.y, s * axis.z, c };
+  return normalise ? quat_normalise(q) : q;
+}
+
+quat quat_slerp(quat a, quat b, f32 percentage) {
+  quat q0 = quat_normalise(a), q1 = quat_normalise(b);
+  f32 dot = quat_dot(q0, q1);
+  // q and -q are the same rotation, flip one so we take the shorter arc
+  if (dot < 0.0f) {
+    q1 = (quat){ -q1.x, -q1.y, -q1.z, -q1.w };
+    dot = -dot;
+  }
+  // nearly parallel, sin(theta_0) is too small to divide by so normalised lerp is both safe and accurate
+  if (dot > 0.9995f) {
+    return quat_normalise((quat){ q0.x + (q1.x - q0.x) * percentage, q0.y + (q1.y - q0.y) * percentage,
+                                  q0.z + (q1.z - q0.z) * percentage, q0.w + (q1.w - q0.w) * percentage });
+  }
+  f32 theta_0 = acosf(dot);  // angle between the inputs
+  f32 theta = theta_0 * percentage;
+  f32 sin_theta = sinf(theta), sin_theta_0 = sinf(theta_0);
+  f32 s0 = cosf(theta) - dot * sin_theta / sin_theta_0;  // == sin(theta_0 - theta) / sin(theta_0)
+  f32 s1 = sin_theta / sin_theta_0;
+  return (quat){ q0.x * s0 + q1.x * s1, q0.y * s0 + q1.y * s1, q0.z * s0 + q1.z * s1, q0.w * s0 + q1.w * s1 };
+}
+
 mat4 mat4_ident() { return (mat4){ .data = { 1.0, 0., 0., 0., 0., 1., 0., 0., 0., 0., 1., 0., 0., 0., 0., 1.0 } }; }
 
+mat4 mat4_translation(vec3 position) {
+  mat4 out_matrix = mat4_ident();
+  out_matrix.data[12] = position.x;
+  out_matrix.data[13] = position.y;
+  out_matrix.data[14] = position.z;
+  return out_matrix;
+}
+
+mat4 mat4_scale(vec3 scale) {
+  mat4 out_matrix = mat4_ident();
+  out_matrix.data[0] = scale.x;
+  out_matrix.data[5] = scale.y;
+  out_matrix.data[10] = scale.z;
+  return out_matrix;
+}
+
+mat4 mat4_rotation(quat rotation) {
+  mat4 out_matrix = mat4_ident();
+  f32 x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+  // s = 2 / |q|^2 gives the same result as normalising first but without a square root
+  f32 s = 2.0f / (x * x + y * y + z * z + w * w);
+
+  out_matrix.data[0] = 1.0f - s * (y * y + z * z);
+  out_matrix.data[1] = s * (x * y - z * w);
+  out_matrix.data[2] = s * (x * z + y * w);
+
+  out_matrix.data[4] = s * (x * y + z * w);
+  out_matrix.data[5] = 1.0f - s * (x * x + z * z);
+  out_matrix.data[6] = s * (y * z - x * w);
+
+  out_matrix.data[8] = s * (x * z - y * w);
+  out_matrix.data[9] = s * (y * z + x * w);
+  out_matrix.data[10] = 1.0f - s * (x * x + y * y);
+
+  return out_matrix;
+}
+
 mat4 mat4_mult(mat4 lhs, mat4 rhs) {
   mat4 out_matrix = mat4_ident();
 
@@ -39,5 +122,194 @@ mat4 mat4_perspective(f32 fov_radians, f32 aspect_ratio, f32 near_z, f32 far_z)
 }
 
 mat4 mat4_look_at(vec3 position, vec3 target, vec3 up) {
-  // TODO
-}
\ No newline at end of file
+  vec3 z_axis = vec3_normalise(vec3_sub(target, position));
+  vec3 x_axis = vec3_normalise(vec3_cross(z_axis, up));
+  vec3 y_axis = vec3_cross(x_axis, z_axis);
+
+  mat4 out_matrix;
+  out_matrix.data[0] = x_axis.x;
+  out_matrix.data[1] = y_axis.x;
+  out_matrix.data[2] = -z_axis.x;
+  out_matrix.data[3] = 0;
+  out_matrix.data[4] = x_axis.y;
+  out_matrix.data[5] = y_axis.y;
+  out_matrix.data[6] = -z_axis.y;
+  out_matrix.data[7] = 0;
+  out_matrix.data[8] = x_axis.z;
+  out_matrix.data[9] = y_axis.z;
+  out_matrix.data[10] = -z_axis.z;
+  out_matrix.data[11] = 0;
+  out_matrix.data[12] = -vec3_dot(x_axis, position);
+  out_matrix.data[13] = -vec3_dot(y_axis, position);
+  out_matrix.data[14] = vec3_dot(z_axis, position);
+  out_matrix.data[15] = 1.0f;
+
+  return out_matrix;
+}
+
+// --- Transforms
+
+transform transform_create(vec3 pos, quat rot, vec3 scale) {
+  return (transform){ .position = pos, .rotation = rot, .scale = scale, .is_dirty = true };
+}
+
+mat4 transform_to_mat(transform* tf) {
+  mat4 scale = mat4_scale(tf->scale);
+  mat4 rotation = mat4_rotation(tf->rotation);
+  mat4 translation = mat4_translation(tf->position);
+  return mat4_mult(mat4_mult(scale, rotation), translation);
+}
+
+// --- Batched transforms
+
+#define TRANSFORM_SOA_COMPONENTS 10
+
+static size_t simd_round_up(size_t n) { return (n + SIMD_WIDTH - 1) & ~((size_t)SIMD_WIDTH - 1); }
+
+transform_soa transform_soa_create(size_t capacity) {
+  transform_soa tfs = { 0 };
+  transform_soa_reserve(&tfs, capacity);
+  return tfs;
+}
+
+void transform_soa_destroy(transform_soa* tfs) {
+  free(tfs->pos_x);  // all components share the one allocation
+  *tfs = (transform_soa){ 0 };
+}
+
+void transform_soa_reserve(transform_soa* tfs, size_t capacity) {
+  capacity = simd_round_up(capacity > 0 ? capacity : SIMD_WIDTH);
+  if (capacity <= tfs->capacity) return;
+
+  // one block for all components, each array starting on a 32 byte boundary
+  f32* block = aligned_alloc(32, capacity * TRANSFORM_SOA_COMPONENTS * sizeof(f32));
+  assert(block);
+  memset(block, 0, capacity * TRANSFORM_SOA_COMPONENTS * sizeof(f32));
+
+  f32** arrays[TRANSFORM_SOA_COMPONENTS] = { &tfs->pos_x, &tfs->pos_y, &tfs->pos_z,   &tfs->rot_x,   &tfs->rot_y,
+                                             &tfs->rot_z, &tfs->rot_w, &tfs->scale_x, &tfs->scale_y, &tfs->scale_z };
+  f32* old_block = tfs->pos_x;
+  for (u32 c = 0; c < TRANSFORM_SOA_COMPONENTS; c++) {
+    f32* dst = block + c * capacity;
+    if (old_block) memcpy(dst, *arrays[c], tfs->count * sizeof(f32));
+    *arrays[c] = dst;
+  }
+  free(old_block);
+  tfs->capacity = capacity;
+}
+
+size_t transform_soa_push(transform_soa* tfs, transform tf) {
+  if (tfs->count == tfs->capacity) {
+    transform_soa_reserve(tfs, tfs->capacity * 2);
+  }
+  size_t idx = tfs->count++;
+  transform_soa_set(tfs, idx, tf);
+  return idx;
+}
+
+void transform_soa_set(transform_soa* tfs, size_t idx, transform tf) {
+  assert(idx < tfs->count);
+  tfs->pos_x[idx] = tf.position.x;
+  tfs->pos_y[idx] = tf.position.y;
+  tfs->pos_z[idx] = tf.position.z;
+  tfs->rot_x[idx] = tf.rotation.x;
+  tfs->rot_y[idx] = tf.rotation.y;
+  tfs->rot_z[idx] = tf.rotation.z;
+  tfs->rot_w[idx] = tf.rotation.w;
+  tfs->scale_x[idx] = tf.scale.x;
+  tfs->scale_y[idx] = tf.scale.y;
+  tfs->scale_z[idx] = tf.scale.z;
+}
+
+transform transform_soa_get(const transform_soa* tfs, size_t idx) {
+  assert(idx < tfs->count);
+  return (transform){ .position = vec3(tfs->pos_x[idx], tfs->pos_y[idx], tfs->pos_z[idx]),
+                      .rotation = vec4(tfs->rot_x[idx], tfs->rot_y[idx], tfs->rot_z[idx], tfs->rot_w[idx]),
+                      .scale = vec3(tfs->scale_x[idx], tfs->scale_y[idx], tfs->scale_z[idx]),
+                      .is_dirty = false };
+}
+
+void transforms_to_mats(const transform_soa* tfs, mat4* out, size_t n) {
+  assert(n <= tfs->count);
+  // storage is padded to SIMD_WIDTH so the final partial batch can be loaded safely, we just don't write it all out
+  for (size_t i = 0; i < n; i += SIMD_WIDTH) {
+    f32x8 x = f32x8_load(&tfs->rot_x[i]);
+    f32x8 y = f32x8_load(&tfs->rot_y[i]);
+    f32x8 z = f32x8_load(&tfs->rot_z[i]);
+    f32x8 w = f32x8_load(&tfs->rot_w[i]);
+    f32x8 sx = f32x8_load(&tfs->scale_x[i]);
+    f32x8 sy = f32x8_load(&tfs->scale_y[i]);
+    f32x8 sz = f32x8_load(&tfs->scale_z[i]);
+
+    f32x8 len_sq = x * x + y * y + z * z + w * w;
+    // zeroed padding lanes would divide by zero, give them the identity rotation instead
+    len_sq = len_sq + (f32x8)((i32x8)(len_sq == 0.0f) & (i32x8)f32x8_splat(1.0f));
+    f32x8 s = 2.0f / len_sq;
+
+    f32x8 xx = x * x, yy = y * y, zz = z * z;
+    f32x8 xy = x * y, xz = x * z, yz = y * z;
+    f32x8 xw = x * w, yw = y * w, zw = z * w;
+
+    // rows of the upper 3x3 with the scale folded in (see `mat4_rotation` and `transform_to_mat`)
+    f32x8 m[9] = {
+      sx * (1.0f - s * (yy + zz)), sx * (s * (xy - zw)),        sx * (s * (xz + yw)),
+      sy * (s * (xy + zw)),        sy * (1.0f - s * (xx + zz)), sy * (s * (yz - xw)),
+      sz * (s * (xz - yw)),        sz * (s * (yz + xw)),        sz * (1.0f - s * (xx + yy)),
+    };
+    f32x8 tx = f32x8_load(&tfs->pos_x[i]);
+    f32x8 ty = f32x8_load(&tfs->pos_y[i]);
+    f32x8 tz = f32x8_load(&tfs->pos_z[i]);
+
+    size_t lanes = n - i < SIMD_WIDTH ? n - i : SIMD_WIDTH;
+    for (size_t l = 0; l < lanes; l++) {
+      f32* d = out[i + l].data;
+      d[0] = m[0][l], d[1] = m[1][l], d[2] = m[2][l], d[3] = 0.0f;
+      d[4] = m[3][l], d[5] = m[4][l], d[6] = m[5][l], d[7] = 0.0f;
+      d[8] = m[6][l], d[9] = m[7][l], d[10] = m[8][l], d[11] = 0.0f;
+      d[12] = tx[l], d[13] = ty[l], d[14] = tz[l], d[15] = 1.0f;
+    }
+  }
+}
+
+void mat4_mult_batch(const mat4* lhs, const mat4* rhs, mat4* out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    // each output row is a linear combination of the rows of rhs, which is a natural 4-wide operation
+    f32x4 r0 = f32x4_load(&rhs[i].data[0]);
+    f32x4 r1 = f32x4_load(&rhs[i].data[4]);
+    f32x4 r2 = f32x4_load(&rhs[i].data[8]);
+    f32x4 r3 = f32x4_load(&rhs[i].data[12]);
+    f32x4 a[4] = { f32x4_load(&lhs[i].data[0]), f32x4_load(&lhs[i].data[4]), f32x4_load(&lhs[i].data[8]),
+                   f32x4_load(&lhs[i].data[12]) };
+    for (u32 row = 0; row < 4; row++) {
+      f32x4 res = a[row][0] * r0 + a[row][1] * r1 + a[row][2] * r2 + a[row][3] * r3;
+      f32x4_store(&out[i].data[row * 4], res);
+    }
+  }
+}
+
+static void mat4_transform_vec3s(mat4 m, const vec3* in, vec3* out, size_t n, f32 w) {
+  const f32* d = m.data;
+  f32x8 tx = f32x8_splat(d[12] * w), ty = f32x8_splat(d[13] * w), tz = f32x8_splat(d[14] * w);
+
+  for (size_t i = 0; i < n; i += SIMD_WIDTH) {
+    size_t lanes = n - i < SIMD_WIDTH ? n - i : SIMD_WIDTH;
+    f32x8 x = { 0 }, y = { 0 }, z = { 0 };
+    for (size_t l = 0; l < lanes; l++) {
+      x[l] = in[i + l].x, y[l] = in[i + l].y, z[l] = in[i + l].z;
+    }
+
+    f32x8 ox = x * d[0] + y * d[4] + z * d[8] + tx;
+    f32x8 oy = x * d[1] + y * d[5] + z * d[9] + ty;
+    f32x8 oz = x * d[2] + y * d[6] + z * d[10] + tz;
+
+    for (size_t l = 0; l < lanes; l++) {
+      out[i + l] = vec3(ox[l], oy[l], oz[l]);
+    }
+  }
+}
+
+void mat4_transform_points(mat4 m, const vec3* in, vec3* out, size_t n) { mat4_transform_vec3s(m, in, out, n, 1.0f); }
+
+void mat4_transform_vectors(mat4 m, const vec3* in, vec3* out, size_t n) {
+  mat4_transform_vec3s(m, in, out, n, 0.0f);
+}
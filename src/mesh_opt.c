@@ -0,0 +1,337 @@
+/* Import-time mesh optimisation: merge duplicate vertices, then order triangles for the post-transform cache and
+   overdraw and vertices for fetch locality. None of this runs per frame so it allocates freely */
+
+#include <celeritas.h>
+
+#define VERTEX_NONE UINT32_MAX
+#define MAX_U16_VERTICES 0xFFFF  // 0xFFFF itself stays free as the primitive restart index
+
+f32 mesh_acmr(const u32* indices, u32 index_count, u32 cache_size) {
+  u32 tri_count = index_count / 3;
+  if (tri_count == 0) return 0.0f;
+  assert(cache_size > 0 && cache_size <= 64);
+
+  u32 fifo[64];
+  u32 head = 0, filled = 0, misses = 0;
+  for (u32 i = 0; i < tri_count * 3; i++) {
+    u32 v = indices ? indices[i] : i;
+    bool hit = false;
+    for (u32 c = 0; c < filled && !hit; c++) hit = fifo[c] == v;
+    if (hit) continue;
+    misses++;
+    fifo[head] = v;
+    head = (head + 1) % cache_size;
+    if (filled < cache_size) filled++;
+  }
+  return (f32)misses / (f32)tri_count;
+}
+
+// --- Vertex deduplication
+
+/** @brief writes the unique vertex each vertex maps to into `remap`, numbered in order of first occurrence */
+static u32 dedup_vertices(u32* remap, const u8* vertices, u32 vertex_count, u32 stride) {
+  u32 table_size = 16;
+  while (table_size < vertex_count * 2) table_size *= 2;
+  u32* table = malloc(sizeof(u32) * table_size);  // holds the first vertex seen with those bytes
+  assert(table);
+  memset(table, 0xFF, sizeof(u32) * table_size);
+
+  u32 unique = 0;
+  for (u32 v = 0; v < vertex_count; v++) {
+    const u8* vert = vertices + (u64)v * stride;
+    u32 slot = (u32)hash_bytes(vert, stride, HASH_SEED) & (table_size - 1);
+    // linear probing, the table is never more than half full
+    while (table[slot] != VERTEX_NONE && memcmp(vertices + (u64)table[slot] * stride, vert, stride) != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    if (table[slot] == VERTEX_NONE) {
+      table[slot] = v;
+      remap[v] = unique++;
+    } else {
+      remap[v] = remap[table[slot]];
+    }
+  }
+  free(table);
+  return unique;
+}
+
+// --- Vertex cache ordering
+
+/** @brief Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw").
+           Emits the triangles around one fanning vertex at a time, moving on to a neighbour that will still be in
+           the cache afterwards. Every point where it has to jump somewhere cold starts a new cluster, which the
+           overdraw pass is then free to reorder. Returns the cluster count */
+static u32 order_for_vertex_cache(u32* dst, const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size,
+                                  u32* cluster_starts) {
+  u32 tri_count = index_count / 3;
+  u32* offsets = malloc(sizeof(u32) * (vertex_count + 1));
+  u32* adjacency = malloc(sizeof(u32) * index_count);
+  u32* live = calloc(vertex_count, sizeof(u32));  // triangles not yet emitted that use each vertex
+  u32* cache_time = calloc(vertex_count, sizeof(u32));
+  u8* emitted = calloc(tri_count, 1);
+  u32* dead_end = malloc(sizeof(u32) * index_count);
+  u32* candidates = malloc(sizeof(u32) * index_count);
+  assert(offsets && adjacency && live && cache_time && emitted && dead_end && candidates);
+
+  // vertex -> triangles, filled by bumping each offset and shifting them back down afterwards
+  for (u32 i = 0; i < index_count; i++) live[indices[i]]++;
+  offsets[0] = 0;
+  for (u32 v = 0; v < vertex_count; v++) offsets[v + 1] = offsets[v] + live[v];
+  for (u32 i = 0; i < index_count; i++) adjacency[offsets[indices[i]]++] = i / 3;
+  for (u32 v = vertex_count; v > 0; v--) offsets[v] = offsets[v - 1];
+  offsets[0] = 0;
+
+  u32 time = cache_size + 1;  // starting past zero so no vertex begins in the cache
+  u32 dead_end_count = 0, cursor = 0, out = 0, cluster_count = 0;
+  while (cursor < vertex_count && live[cursor] == 0) cursor++;
+  u32 fan = cursor < vertex_count ? cursor : VERTEX_NONE;
+  cluster_starts[cluster_count++] = 0;
+
+  while (fan != VERTEX_NONE) {
+    u32 candidate_count = 0;
+    for (u32 a = offsets[fan]; a < offsets[fan + 1]; a++) {
+      u32 t = adjacency[a];
+      if (emitted[t]) continue;
+      emitted[t] = 1;
+      for (u32 c = 0; c < 3; c++) {
+        u32 v = indices[t * 3 + c];
+        dst[out++] = v;
+        dead_end[dead_end_count++] = v;
+        candidates[candidate_count++] = v;
+        live[v]--;
+        if (time - cache_time[v] > cache_size) cache_time[v] = time++;
+      }
+    }
+
+    // prefer the oldest neighbour that stays cached while its remaining triangles go out
+    u32 next = VERTEX_NONE;
+    i32 best = -1;
+    for (u32 c = 0; c < candidate_count; c++) {
+      u32 v = candidates[c];
+      if (live[v] == 0) continue;
+      u32 age = time - cache_time[v];
+      i32 priority = age + 2 * live[v] <= cache_size ? (i32)age : 0;
+      if (priority > best) {
+        best = priority;
+        next = v;
+      }
+    }
+
+    if (next == VERTEX_NONE) {
+      // dead end: try recently emitted vertices, then fall back to input order
+      while (dead_end_count > 0 && next == VERTEX_NONE) {
+        u32 v = dead_end[--dead_end_count];
+        if (live[v] > 0) next = v;
+      }
+      while (next == VERTEX_NONE && cursor < vertex_count) {
+        if (live[cursor] > 0) next = cursor;
+        cursor++;
+      }
+      if (next != VERTEX_NONE && time - cache_time[next] > cache_size) cluster_starts[cluster_count++] = out / 3;
+    }
+    fan = next;
+  }
+  assert(out == tri_count * 3);
+
+  free(offsets);
+  free(adjacency);
+  free(live);
+  free(cache_time);
+  free(emitted);
+  free(dead_end);
+  free(candidates);
+  return cluster_count;
+}
+
+void mesh_optimise_vertex_cache(u32* dst, const u32* indices, u32 index_count, u32 vertex_count) {
+  u32* cluster_starts = malloc(sizeof(u32) * (index_count / 3 + 1));
+  assert(cluster_starts);
+  order_for_vertex_cache(dst, indices, index_count, vertex_count, VERTEX_CACHE_SIZE, cluster_starts);
+  free(cluster_starts);
+}
+
+// --- Overdraw ordering
+
+typedef struct cluster_sort_key {
+  f32 key;
+  u32 cluster;
+} cluster_sort_key;
+
+static int cmp_cluster_key_desc(const void* a, const void* b) {
+  const cluster_sort_key* x = a;
+  const cluster_sort_key* y = b;
+  if (x->key != y->key) return x->key > y->key ? -1 : 1;
+  return x->cluster < y->cluster ? -1 : (x->cluster > y->cluster);
+}
+
+static vec3 vertex_position(const u8* vertices, u32 stride, u32 v) {
+  f32 p[3];
+  memcpy(p, vertices + (u64)v * stride, sizeof(p));
+  return vec3(p[0], p[1], p[2]);
+}
+
+/** @brief Draws clusters that face away from the middle of the mesh first as they tend to occlude the rest. A
+           simplification of the paper's sort: no further splitting of clusters and no view-dependent passes */
+static void order_clusters_for_overdraw(u32* dst, const u32* indices, const u32* cluster_starts, u32 cluster_count,
+                                        const u8* vertices, u32 stride) {
+  vec3* centroids = malloc(sizeof(vec3) * cluster_count);
+  vec3* normals = malloc(sizeof(vec3) * cluster_count);
+  cluster_sort_key* keys = malloc(sizeof(cluster_sort_key) * cluster_count);
+  assert(centroids && normals && keys);
+
+  vec3 mesh_centroid = VEC3_ZERO;
+  f32 mesh_area = 0.0f;
+  for (u32 c = 0; c < cluster_count; c++) {
+    vec3 centroid = VEC3_ZERO;
+    vec3 normal = VEC3_ZERO;
+    f32 area = 0.0f;
+    for (u32 t = cluster_starts[c]; t < cluster_starts[c + 1]; t++) {
+      vec3 p0 = vertex_position(vertices, stride, indices[t * 3 + 0]);
+      vec3 p1 = vertex_position(vertices, stride, indices[t * 3 + 1]);
+      vec3 p2 = vertex_position(vertices, stride, indices[t * 3 + 2]);
+      vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+      f32 tri_area = vec3_len(n) * 0.5f;
+      vec3 tri_centroid = vec3_mult(vec3_add(vec3_add(p0, p1), p2), 1.0f / 3.0f);
+      centroid = vec3_add(centroid, vec3_mult(tri_centroid, tri_area));
+      normal = vec3_add(normal, n);
+      area += tri_area;
+    }
+    mesh_centroid = vec3_add(mesh_centroid, centroid);
+    mesh_area += area;
+    centroids[c] = area > 0.0f ? vec3_mult(centroid, 1.0f / area) : centroid;
+    normals[c] = normal;
+  }
+  if (mesh_area > 0.0f) mesh_centroid = vec3_mult(mesh_centroid, 1.0f / mesh_area);
+
+  for (u32 c = 0; c < cluster_count; c++) {
+    f32 len = vec3_len(normals[c]);
+    f32 facing = len > 0.0f ? vec3_dot(vec3_sub(centroids[c], mesh_centroid), normals[c]) / len : 0.0f;
+    keys[c] = (cluster_sort_key){ .key = facing, .cluster = c };
+  }
+  qsort(keys, cluster_count, sizeof(cluster_sort_key), cmp_cluster_key_desc);
+
+  u32 out = 0;
+  for (u32 k = 0; k < cluster_count; k++) {
+    u32 c = keys[k].cluster;
+    u32 count = (cluster_starts[c + 1] - cluster_starts[c]) * 3;
+    memcpy(dst + out, indices + cluster_starts[c] * 3, sizeof(u32) * count);
+    out += count;
+  }
+
+  free(centroids);
+  free(normals);
+  free(keys);
+}
+
+// --- Vertex fetch ordering
+
+/** @brief renumbers vertices in order of first use, dropping unreferenced ones. Returns the new vertex count */
+static u32 order_for_vertex_fetch(u8* dst, u32* indices, u32 index_count, const u8* vertices, u32 vertex_count,
+                                  u32 stride, u32* remap) {
+  memset(remap, 0xFF, sizeof(u32) * vertex_count);
+  u32 next = 0;
+  for (u32 i = 0; i < index_count; i++) {
+    u32 v = indices[i];
+    if (remap[v] == VERTEX_NONE) {
+      remap[v] = next++;
+      memcpy(dst + (u64)remap[v] * stride, vertices + (u64)v * stride, stride);
+    }
+    indices[i] = remap[v];
+  }
+  return next;
+}
+
+// --- Pipeline
+
+static bool has_float_position(const vertex_desc* desc) {
+  return desc->attribute_count > 0 && (desc->attributes[0] == ATTR_F32x3 || desc->attributes[0] == ATTR_F32x4);
+}
+
+static u64 geometry_bytes(const geometry* geo, u32 stride) {
+  u64 bytes = (u64)geo->vertex_count * stride;
+  if (geo->has_indices) bytes += (u64)geo->index_count * index_format_size(geo->index_format);
+  return bytes;
+}
+
+mesh_opt_stats geo_optimise(geometry* geo) {
+  u32 stride = vertex_desc_stride(&geo->vertex_format);
+  u32 index_count = geo->has_indices ? geo->index_count : geo->vertex_count;
+  assert(stride > 0 && index_count % 3 == 0);
+  // levels of detail and meshlets are built from the optimised mesh, not the other way round
+  assert(geo->lod_count == 0 && geo->meshlets.count == 0);
+
+  mesh_opt_stats stats = { .vertices_before = geo->vertex_count, .bytes_before = geometry_bytes(geo, stride) };
+  if (index_count == 0) {
+    stats.vertices_after = stats.vertices_before;
+    stats.bytes_after = stats.bytes_before;
+    return stats;
+  }
+
+  // everything below works on 32-bit indices, non-indexed meshes get the implicit 0..n
+  u32* indices = malloc(sizeof(u32) * index_count);
+  u32* scratch = malloc(sizeof(u32) * index_count);
+  assert(indices && scratch);
+  for (u32 i = 0; i < index_count; i++) {
+    if (!geo->has_indices) {
+      indices[i] = i;
+    } else if (geo->index_format == INDEX_FORMAT_U16) {
+      indices[i] = ((const u16*)geo->indices)[i];
+    } else {
+      indices[i] = ((const u32*)geo->indices)[i];
+    }
+  }
+  stats.acmr_before = mesh_acmr(indices, index_count, VERTEX_CACHE_SIZE);
+
+  u32* remap = malloc(sizeof(u32) * geo->vertex_count);
+  assert(remap);
+  u32 unique_count = dedup_vertices(remap, geo->vertex_data, geo->vertex_count, stride);
+  u8* unique = malloc((u64)unique_count * stride);
+  assert(unique);
+  for (u32 v = 0; v < geo->vertex_count; v++) {
+    memcpy(unique + (u64)remap[v] * stride, (const u8*)geo->vertex_data + (u64)v * stride, stride);
+  }
+  for (u32 i = 0; i < index_count; i++) indices[i] = remap[indices[i]];
+
+  u32 tri_count = index_count / 3;
+  u32* cluster_starts = malloc(sizeof(u32) * (tri_count + 1));
+  assert(cluster_starts);
+  u32 cluster_count =
+      order_for_vertex_cache(scratch, indices, index_count, unique_count, VERTEX_CACHE_SIZE, cluster_starts);
+  cluster_starts[cluster_count] = tri_count;
+  if (has_float_position(&geo->vertex_format)) {
+    order_clusters_for_overdraw(indices, scratch, cluster_starts, cluster_count, unique, stride);
+  } else {
+    memcpy(indices, scratch, sizeof(u32) * index_count);
+  }
+  free(cluster_starts);
+
+  u8* vertices = malloc((u64)unique_count * stride);
+  assert(vertices);
+  u32 vertex_count = order_for_vertex_fetch(vertices, indices, index_count, unique, unique_count, stride, remap);
+  free(unique);
+  free(remap);
+  stats.acmr_after = mesh_acmr(indices, index_count, VERTEX_CACHE_SIZE);
+
+  free(geo->vertex_data);
+  free(geo->indices);
+  geo->vertex_data = vertices;
+  geo->vertex_count = vertex_count;
+  geo->has_indices = true;
+  geo->index_count = index_count;
+  if (vertex_count <= MAX_U16_VERTICES) {
+    u16* narrow = malloc(sizeof(u16) * index_count);
+    assert(narrow);
+    for (u32 i = 0; i < index_count; i++) narrow[i] = (u16)indices[i];
+    free(indices);
+    geo->index_format = INDEX_FORMAT_U16;
+    geo->indices = narrow;
+  } else {
+    geo->index_format = INDEX_FORMAT_U32;
+    geo->indices = indices;
+  }
+  free(scratch);
+
+  stats.vertices_after = geo->vertex_count;
+  stats.bytes_after = geometry_bytes(geo, stride);
+  return stats;
+}
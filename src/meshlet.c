@@ -0,0 +1,390 @@
+/* Meshlets: clusters of ~100 triangles with their own bounds so huge meshes can be culled piecewise on the CPU */
+
+#include <celeritas.h>
+
+#define MESHLET_CULL_CHUNK 256  // must be a multiple of SIMD_WIDTH
+#define CONE_MIN_SPREAD 0.1f    // normals spreading past ~84 degrees from the axis make the cone useless
+#define VERTEX_NONE UINT32_MAX
+
+static u32 simd_round_up_u32(u32 n) { return (n + SIMD_WIDTH - 1) & ~(u32)(SIMD_WIDTH - 1); }
+
+static f32* alloc_lanes(u32 count) {
+  u32 padded = simd_round_up_u32(count > 0 ? count : 1);
+  f32* lanes = aligned_alloc(32, sizeof(f32) * padded);
+  assert(lanes);
+  memset(lanes, 0, sizeof(f32) * padded);
+  return lanes;
+}
+
+void meshlet_set_destroy(meshlet_set* set) {
+  free(set->meshlets);
+  free(set->center_x);
+  free(set->center_y);
+  free(set->center_z);
+  free(set->radius);
+  free(set->cone_axis_x);
+  free(set->cone_axis_y);
+  free(set->cone_axis_z);
+  free(set->cone_cutoff);
+  *set = (meshlet_set){ 0 };
+}
+
+// --- Building
+
+typedef struct meshlet_builder {
+  const u32* indices;
+  const vec3* positions;
+  u32* offsets;
+  u32* adjacency;
+  u8* assigned;       // per triangle
+  u32* vertex_stamp;  // meshlet that last took each vertex, plus one
+  u32* tri_stamp;     // meshlet whose candidate list last took each triangle, plus one
+  u32* candidates;
+  u32 candidate_count;
+  u32* out;  // reordered indices
+  u32 out_count;
+  // the meshlet being built
+  u32 stamp;
+  u32 vertex_count;
+  u32 triangle_count;
+  vec3 centroid_sum;
+} meshlet_builder;
+
+static vec3 triangle_centroid(const meshlet_builder* b, u32 t) {
+  vec3 sum = vec3_add(vec3_add(b->positions[b->indices[t * 3]], b->positions[b->indices[t * 3 + 1]]),
+                      b->positions[b->indices[t * 3 + 2]]);
+  return vec3_mult(sum, 1.0f / 3.0f);
+}
+
+static u32 new_vertices(const meshlet_builder* b, u32 t) {
+  u32 n = 0;
+  for (u32 c = 0; c < 3; c++) n += b->vertex_stamp[b->indices[t * 3 + c]] != b->stamp;
+  return n;
+}
+
+static void add_triangle(meshlet_builder* b, u32 t) {
+  b->assigned[t] = 1;
+  for (u32 c = 0; c < 3; c++) {
+    u32 v = b->indices[t * 3 + c];
+    b->out[b->out_count++] = v;
+    if (b->vertex_stamp[v] == b->stamp) continue;
+    b->vertex_stamp[v] = b->stamp;
+    b->vertex_count++;
+    // everything sharing the new vertex becomes a candidate
+    for (u32 a = b->offsets[v]; a < b->offsets[v + 1]; a++) {
+      u32 n = b->adjacency[a];
+      if (b->assigned[n] || b->tri_stamp[n] == b->stamp) continue;
+      b->tri_stamp[n] = b->stamp;
+      b->candidates[b->candidate_count++] = n;
+    }
+  }
+  b->triangle_count++;
+  b->centroid_sum = vec3_add(b->centroid_sum, triangle_centroid(b, t));
+}
+
+/** @brief the candidate that adds the fewest vertices, closest to the meshlet's centroid on ties */
+static u32 best_candidate(meshlet_builder* b) {
+  vec3 centroid = vec3_mult(b->centroid_sum, 1.0f / (f32)b->triangle_count);
+  u32 best = VERTEX_NONE, best_new = 4;
+  f32 best_dist = INFINITY;
+  for (u32 i = 0; i < b->candidate_count;) {
+    u32 t = b->candidates[i];
+    if (b->assigned[t]) {
+      b->candidates[i] = b->candidates[--b->candidate_count];
+      continue;
+    }
+    u32 added = new_vertices(b, t);
+    if (b->vertex_count + added <= MESHLET_MAX_VERTICES) {
+      vec3 d = vec3_sub(triangle_centroid(b, t), centroid);
+      f32 dist = vec3_dot(d, d);
+      if (added < best_new || (added == best_new && dist < best_dist)) {
+        best = t;
+        best_new = added;
+        best_dist = dist;
+      }
+    }
+    i++;
+  }
+  return best;
+}
+
+static void write_meshlet_bounds(meshlet_set* set, u32 m, const u32* indices, const vec3* positions) {
+  const meshlet* ml = &set->meshlets[m];
+  const u32* tri = indices + ml->first_index;
+
+  vec3 lo = positions[tri[0]], hi = lo;
+  for (u32 i = 1; i < ml->triangle_count * 3u; i++) {
+    vec3 p = positions[tri[i]];
+    lo = vec3(fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z));
+    hi = vec3(fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z));
+  }
+  vec3 center = vec3_mult(vec3_add(lo, hi), 0.5f);
+  f32 radius_sq = 0.0f;
+  for (u32 i = 0; i < ml->triangle_count * 3u; i++) {
+    vec3 d = vec3_sub(positions[tri[i]], center);
+    radius_sq = fmaxf(radius_sq, vec3_dot(d, d));
+  }
+
+  vec3 axis = VEC3_ZERO;
+  for (u32 t = 0; t < ml->triangle_count; t++) {
+    vec3 p0 = positions[tri[t * 3]], p1 = positions[tri[t * 3 + 1]], p2 = positions[tri[t * 3 + 2]];
+    vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+    f32 len = vec3_len(n);
+    if (len > 0.0f) axis = vec3_add(axis, vec3_mult(n, 1.0f / len));
+  }
+  f32 axis_len = vec3_len(axis);
+  f32 cutoff = 1.0f;
+  if (axis_len > 0.0f) {
+    axis = vec3_mult(axis, 1.0f / axis_len);
+    f32 min_dot = 1.0f;
+    for (u32 t = 0; t < ml->triangle_count; t++) {
+      vec3 p0 = positions[tri[t * 3]], p1 = positions[tri[t * 3 + 1]], p2 = positions[tri[t * 3 + 2]];
+      vec3 n = vec3_cross(vec3_sub(p1, p0), vec3_sub(p2, p0));
+      f32 len = vec3_len(n);
+      if (len > 0.0f) min_dot = fminf(min_dot, vec3_dot(axis, n) / len);
+    }
+    // sine of the spread, i.e. the cosine of the widest angle the view direction can make with the axis
+    if (min_dot > CONE_MIN_SPREAD) cutoff = sqrtf(1.0f - min_dot * min_dot);
+  }
+
+  set->center_x[m] = center.x;
+  set->center_y[m] = center.y;
+  set->center_z[m] = center.z;
+  set->radius[m] = sqrtf(radius_sq);
+  set->cone_axis_x[m] = axis.x;
+  set->cone_axis_y[m] = axis.y;
+  set->cone_axis_z[m] = axis.z;
+  set->cone_cutoff[m] = cutoff;
+}
+
+void geo_build_meshlets(geometry* geo) {
+  assert(geo->has_indices);
+  assert(geo->vertex_format.attribute_count > 0 &&
+         (geo->vertex_format.attributes[0] == ATTR_F32x3 || geo->vertex_format.attributes[0] == ATTR_F32x4));
+  meshlet_set_destroy(&geo->meshlets);
+
+  u32 index_count = geo_lod(geo, 0).index_count;
+  u32 tri_count = index_count / 3;
+  u32 vertex_count = geo->vertex_count;
+  u32 stride = vertex_desc_stride(&geo->vertex_format);
+
+  u32* indices = malloc(sizeof(u32) * index_count);
+  vec3* positions = malloc(sizeof(vec3) * vertex_count);
+  assert(indices && positions);
+  for (u32 i = 0; i < index_count; i++) {
+    indices[i] = geo->index_format == INDEX_FORMAT_U16 ? ((const u16*)geo->indices)[i] : ((const u32*)geo->indices)[i];
+  }
+  for (u32 v = 0; v < vertex_count; v++) {
+    memcpy(&positions[v], (const u8*)geo->vertex_data + (u64)v * stride, sizeof(vec3));
+  }
+
+  meshlet_builder b = { .indices = indices, .positions = positions };
+  b.offsets = calloc(vertex_count + 1, sizeof(u32));
+  b.adjacency = malloc(sizeof(u32) * index_count);
+  b.assigned = calloc(tri_count, 1);
+  b.vertex_stamp = calloc(vertex_count, sizeof(u32));
+  b.tri_stamp = calloc(tri_count, sizeof(u32));
+  b.candidates = malloc(sizeof(u32) * index_count);
+  b.out = malloc(sizeof(u32) * index_count);
+  assert(b.offsets && b.adjacency && b.assigned && b.vertex_stamp && b.tri_stamp && b.candidates && b.out);
+
+  for (u32 i = 0; i < index_count; i++) b.offsets[indices[i] + 1]++;
+  for (u32 v = 0; v < vertex_count; v++) b.offsets[v + 1] += b.offsets[v];
+  for (u32 i = 0; i < index_count; i++) b.adjacency[b.offsets[indices[i]]++] = i / 3;
+  for (u32 v = vertex_count; v > 0; v--) b.offsets[v] = b.offsets[v - 1];
+  b.offsets[0] = 0;
+
+  // worst case every meshlet is a lone triangle
+  meshlet* meshlets = malloc(sizeof(meshlet) * (tri_count > 0 ? tri_count : 1));
+  assert(meshlets);
+  u32 meshlet_count = 0, cursor = 0;
+  while (b.out_count < index_count) {
+    // seed in input order, which after `geo_optimise` is already spatially coherent
+    while (b.assigned[cursor]) cursor++;
+    b.stamp = meshlet_count + 1;
+    b.vertex_count = 0;
+    b.triangle_count = 0;
+    b.candidate_count = 0;
+    b.centroid_sum = VEC3_ZERO;
+    u32 first_index = b.out_count;
+
+    add_triangle(&b, cursor);
+    while (b.triangle_count < MESHLET_MAX_TRIANGLES) {
+      u32 next = best_candidate(&b);
+      if (next == VERTEX_NONE) break;
+      add_triangle(&b, next);
+    }
+    meshlets[meshlet_count++] = (meshlet){ .first_index = first_index,
+                                           .vertex_count = (u16)b.vertex_count,
+                                           .triangle_count = (u16)b.triangle_count };
+  }
+
+  meshlet_set* set = &geo->meshlets;
+  set->meshlets = realloc(meshlets, sizeof(meshlet) * (meshlet_count > 0 ? meshlet_count : 1));
+  set->count = meshlet_count;
+  f32** lanes[] = { &set->center_x,    &set->center_y,    &set->center_z,    &set->radius,
+                    &set->cone_axis_x, &set->cone_axis_y, &set->cone_axis_z, &set->cone_cutoff };
+  for (u32 l = 0; l < sizeof(lanes) / sizeof(lanes[0]); l++) *lanes[l] = alloc_lanes(meshlet_count);
+  for (u32 m = 0; m < meshlet_count; m++) write_meshlet_bounds(set, m, b.out, positions);
+
+  // the full detail level comes first so writing it back leaves any coarser levels alone
+  for (u32 i = 0; i < index_count; i++) {
+    if (geo->index_format == INDEX_FORMAT_U16) {
+      ((u16*)geo->indices)[i] = (u16)b.out[i];
+    } else {
+      ((u32*)geo->indices)[i] = b.out[i];
+    }
+  }
+
+  free(indices);
+  free(positions);
+  free(b.offsets);
+  free(b.adjacency);
+  free(b.assigned);
+  free(b.vertex_stamp);
+  free(b.tri_stamp);
+  free(b.candidates);
+  free(b.out);
+}
+
+// --- Culling
+
+typedef struct meshlet_cull_ctx {
+  const meshlet_set* set;
+  const f32* m;        // the instance's affine
+  plane planes[6];     // object space, not normalised
+  f32 plane_scale[6];  // lengths of the object-space plane normals
+  bool cone_test;
+  vec3 eye;  // object space
+  const occlusion_buffer* ob;
+  u32* scratch;       // each chunk writes its survivors from its own start
+  u32* chunk_counts;  // [chunk][visible, frustum, backface, occlusion]
+} meshlet_cull_ctx;
+
+static bool occluded(const meshlet_cull_ctx* ctx, u32 i) {
+  const meshlet_set* s = ctx->set;
+  const f32* m = ctx->m;
+  f32 cx = s->center_x[i], cy = s->center_y[i], cz = s->center_z[i], r = s->radius[i];
+  // world box around the transformed sphere
+  f32 ex = r * (fabsf(m[0]) + fabsf(m[4]) + fabsf(m[8]));
+  f32 ey = r * (fabsf(m[1]) + fabsf(m[5]) + fabsf(m[9]));
+  f32 ez = r * (fabsf(m[2]) + fabsf(m[6]) + fabsf(m[10]));
+  vec3 c = vec3(cx * m[0] + cy * m[4] + cz * m[8] + m[12], cx * m[1] + cy * m[5] + cz * m[9] + m[13],
+                cx * m[2] + cy * m[6] + cz * m[10] + m[14]);
+  bbox_3d box = { .min = vec3(c.x - ex, c.y - ey, c.z - ez), .max = vec3(c.x + ex, c.y + ey, c.z + ez) };
+  return !occlusion_test_aabb(ctx->ob, box);
+}
+
+static void meshlet_cull_chunk(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  meshlet_cull_ctx* ctx = data;
+  const meshlet_set* s = ctx->set;
+  u32* counts = &ctx->chunk_counts[(start / MESHLET_CULL_CHUNK) * 4];
+  u32* out = &ctx->scratch[start];
+
+  for (u32 i = start; i < end; i += SIMD_WIDTH) {
+    f32x8 cx = f32x8_load(&s->center_x[i]);
+    f32x8 cy = f32x8_load(&s->center_y[i]);
+    f32x8 cz = f32x8_load(&s->center_z[i]);
+    f32x8 r = f32x8_load(&s->radius[i]);
+
+    i32x8 in_frustum = (i32x8){ -1, -1, -1, -1, -1, -1, -1, -1 };
+    for (u32 p = 0; p < 6; p++) {
+      const plane* pl = &ctx->planes[p];
+      f32x8 dist = cx * pl->normal.x + cy * pl->normal.y + cz * pl->normal.z + pl->distance;
+      in_frustum &= dist >= -(r * ctx->plane_scale[p]);
+    }
+
+    i32x8 backfacing = { 0 };
+    if (ctx->cone_test) {
+      // dot(d, axis) >= cutoff * |d| + r, squared to stay clear of a vector sqrt. Both sides are non-negative
+      f32x8 dx = cx - ctx->eye.x, dy = cy - ctx->eye.y, dz = cz - ctx->eye.z;
+      f32x8 along = dx * f32x8_load(&s->cone_axis_x[i]) + dy * f32x8_load(&s->cone_axis_y[i]) +
+                    dz * f32x8_load(&s->cone_axis_z[i]) - r;
+      f32x8 cutoff = f32x8_load(&s->cone_cutoff[i]);
+      backfacing = (along >= 0.0f) & (along * along >= cutoff * cutoff * (dx * dx + dy * dy + dz * dz));
+    }
+
+    u32 lanes = end - i < SIMD_WIDTH ? end - i : SIMD_WIDTH;
+    for (u32 l = 0; l < lanes; l++) {
+      if (!in_frustum[l]) {
+        counts[1]++;
+      } else if (backfacing[l]) {
+        counts[2]++;
+      } else if (ctx->ob && occluded(ctx, i + l)) {
+        counts[3]++;
+      } else {
+        out[counts[0]++] = i + l;
+      }
+    }
+  }
+}
+
+/** @brief true when the upper 3x3 is a rotation times a uniform scale, writing the squared scale */
+static bool affine_is_similarity(const f32* m, f32* out_scale_sq) {
+  f32 sx = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+  f32 sy = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+  f32 sz = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+  f32 xy = m[0] * m[4] + m[1] * m[5] + m[2] * m[6];
+  f32 xz = m[0] * m[8] + m[1] * m[9] + m[2] * m[10];
+  f32 yz = m[4] * m[8] + m[5] * m[9] + m[6] * m[10];
+  f32 tolerance = sx * 1e-3f;
+  *out_scale_sq = sx;
+  return sx > 0.0f && fabsf(sy - sx) <= tolerance && fabsf(sz - sx) <= tolerance && fabsf(xy) <= tolerance &&
+         fabsf(xz) <= tolerance && fabsf(yz) <= tolerance;
+}
+
+meshlet_cull_result meshlet_cull(const meshlet_set* set, mat4 affine, const frustum* frustum, vec3 eye,
+                                 const occlusion_buffer* ob, arena* frame_arena) {
+  meshlet_cull_result result = { 0 };
+  u32 count = set->count;
+  result.ranges = arena_alloc(frame_arena, sizeof(index_range) * (count > 0 ? count : 1));
+  if (count == 0) return result;
+
+  const f32* m = affine.data;
+  meshlet_cull_ctx ctx = { .set = set, .m = m, .ob = ob };
+  // row vectors: world = p.x * row0 + p.y * row1 + p.z * row2 + row3, so each plane folds into object space
+  for (u32 p = 0; p < 6; p++) {
+    const plane* pl = &frustum->planes[p];
+    vec3 n = pl->normal;
+    vec3 local = vec3(n.x * m[0] + n.y * m[1] + n.z * m[2], n.x * m[4] + n.y * m[5] + n.z * m[6],
+                      n.x * m[8] + n.y * m[9] + n.z * m[10]);
+    ctx.planes[p] = (plane){ .normal = local, .distance = n.x * m[12] + n.y * m[13] + n.z * m[14] + pl->distance };
+    // a sphere maps to an ellipsoid whose reach along the plane normal is exactly r * |local normal|
+    ctx.plane_scale[p] = vec3_len(local);
+  }
+
+  f32 scale_sq;
+  ctx.cone_test = affine_is_similarity(m, &scale_sq);
+  if (ctx.cone_test) {
+    vec3 d = vec3(eye.x - m[12], eye.y - m[13], eye.z - m[14]);
+    ctx.eye = vec3((d.x * m[0] + d.y * m[1] + d.z * m[2]) / scale_sq, (d.x * m[4] + d.y * m[5] + d.z * m[6]) / scale_sq,
+                   (d.x * m[8] + d.y * m[9] + d.z * m[10]) / scale_sq);
+  }
+
+  u32 chunk_count = (count + MESHLET_CULL_CHUNK - 1) / MESHLET_CULL_CHUNK;
+  ctx.scratch = arena_alloc(frame_arena, sizeof(u32) * count);
+  ctx.chunk_counts = arena_alloc(frame_arena, sizeof(u32) * 4 * chunk_count);
+  jobs_parallel_for(count, MESHLET_CULL_CHUNK, meshlet_cull_chunk, &ctx);
+
+  // chunks hold ascending meshlets so walking them in order merges ranges that touch across chunk edges too
+  index_range* current = NULL;
+  for (u32 c = 0; c < chunk_count; c++) {
+    const u32* counts = &ctx.chunk_counts[c * 4];
+    result.n_visible += counts[0];
+    result.n_frustum_culled += counts[1];
+    result.n_backface_culled += counts[2];
+    result.n_occlusion_culled += counts[3];
+    for (u32 i = 0; i < counts[0]; i++) {
+      const meshlet* ml = &set->meshlets[ctx.scratch[c * MESHLET_CULL_CHUNK + i]];
+      u32 index_count = ml->triangle_count * 3u;
+      if (current && current->first_index + current->index_count == ml->first_index) {
+        current->index_count += index_count;
+      } else {
+        current = &result.ranges[result.range_count++];
+        *current = (index_range){ .first_index = ml->first_index, .index_count = index_count };
+      }
+    }
+  }
+  return result;
+}
@@ -0,0 +1,277 @@
+/* Software occlusion culling: rasterise a handful of big occluders into a small depth buffer on the CPU and reject
+   anything whose screen-space bounds are entirely behind them before it reaches command encoding */
+
+#include <celeritas.h>
+
+#define OCCLUSION_NEAR_W 1e-4f  // triangles/boxes with a vertex this close to the eye plane are treated conservatively
+
+typedef struct occ_tri {
+  f32 x[3], y[3], z[3];
+  i32 min_y, max_y;  // inclusive pixel rows
+} occ_tri;
+
+occlusion_buffer occlusion_buffer_create(u32 width, u32 height) {
+  assert(width % SIMD_WIDTH == 0 && width % OCCLUSION_TILE_SIZE == 0 && height % OCCLUSION_TILE_SIZE == 0);
+  occlusion_buffer ob = { .width = width, .height = height };
+  ob.tiles_x = width / OCCLUSION_TILE_SIZE;
+  ob.tiles_y = height / OCCLUSION_TILE_SIZE;
+  ob.depth = malloc(sizeof(f32) * width * height);
+  ob.tile_max_depth = malloc(sizeof(f32) * ob.tiles_x * ob.tiles_y);
+  for (u32 i = 0; i < width * height; i++) ob.depth[i] = 1.0f;
+  for (u32 i = 0; i < ob.tiles_x * ob.tiles_y; i++) ob.tile_max_depth[i] = 1.0f;
+  ob.view_proj = mat4_ident();
+  return ob;
+}
+
+void occlusion_buffer_destroy(occlusion_buffer* ob) {
+  free(ob->depth);
+  free(ob->tile_max_depth);
+  free(ob->tris);
+  *ob = (occlusion_buffer){ 0 };
+}
+
+u32 occlusion_select_occluders(const cull_bounds_soa* bounds, const u32* candidates, u32 candidate_count,
+                               mat4 view_proj, f32 min_angular_size, u32* out_indices, u32 max_occluders) {
+  assert(max_occluders <= MAX_OCCLUDERS);
+  const f32* m = view_proj.data;
+  f32 sizes[MAX_OCCLUDERS];
+  u32 n = 0;
+
+  for (u32 c = 0; c < candidate_count; c++) {
+    u32 idx = candidates[c];
+    // clip-space w is the view depth for a perspective projection
+    f32 w = bounds->center_x[idx] * m[3] + bounds->center_y[idx] * m[7] + bounds->center_z[idx] * m[11] + m[15];
+    if (w <= bounds->radius[idx]) continue;  // camera is inside or very near it, can't rasterise it safely
+    f32 size = bounds->radius[idx] / w;
+    if (size < min_angular_size) continue;
+
+    // insertion into a small sorted list, largest first
+    u32 pos = n < max_occluders ? n : max_occluders;
+    while (pos > 0 && sizes[pos - 1] < size) pos--;
+    if (pos >= max_occluders) continue;
+    u32 last = n < max_occluders ? n : max_occluders - 1;
+    for (u32 j = last; j > pos; j--) {
+      sizes[j] = sizes[j - 1];
+      out_indices[j] = out_indices[j - 1];
+    }
+    sizes[pos] = size;
+    out_indices[pos] = idx;
+    if (n < max_occluders) n++;
+  }
+  return n;
+}
+
+// projects a world-space point to (pixel x, pixel y, depth [0, 1]). returns false if it is too close to the eye
+static bool occlusion_project(const occlusion_buffer* ob, const f32* m, vec3 p, f32* out_x, f32* out_y, f32* out_z) {
+  f32 cx = p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12];
+  f32 cy = p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13];
+  f32 cz = p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14];
+  f32 cw = p.x * m[3] + p.y * m[7] + p.z * m[11] + m[15];
+  if (cw < OCCLUSION_NEAR_W) return false;
+  f32 inv_w = 1.0f / cw;
+  *out_x = (cx * inv_w * 0.5f + 0.5f) * (f32)ob->width;
+  *out_y = (0.5f - cy * inv_w * 0.5f) * (f32)ob->height;
+  *out_z = cz * inv_w * 0.5f + 0.5f;
+  return true;
+}
+
+static occ_tri* occlusion_push_tri(occlusion_buffer* ob) {
+  if (ob->tri_count == ob->tri_capacity) {
+    ob->tri_capacity = ob->tri_capacity ? ob->tri_capacity * 2 : 1024;
+    ob->tris = realloc(ob->tris, sizeof(occ_tri) * ob->tri_capacity);
+  }
+  return &((occ_tri*)ob->tris)[ob->tri_count++];
+}
+
+static void occlusion_setup_tris(occlusion_buffer* ob, const occluder_mesh* occ) {
+  mat4 mvp = mat4_mult(occ->affine, ob->view_proj);
+  const f32* m = mvp.data;
+  u32 n_indices = occ->indices ? occ->index_count : occ->vertex_count;
+
+  for (u32 i = 0; i + 2 < n_indices; i += 3) {
+    occ_tri t;
+    bool ok = true;
+    for (u32 v = 0; v < 3 && ok; v++) {
+      u32 vi = occ->indices ? occ->indices[i + v] : i + v;
+      // dropping a triangle that crosses the near plane only makes culling less aggressive, never wrong
+      ok = occlusion_project(ob, m, occ->positions[vi], &t.x[v], &t.y[v], &t.z[v]);
+    }
+    if (!ok) continue;
+
+    f32 min_y = fminf(t.y[0], fminf(t.y[1], t.y[2]));
+    f32 max_y = fmaxf(t.y[0], fmaxf(t.y[1], t.y[2]));
+    t.min_y = (i32)fmaxf(0.0f, floorf(min_y));
+    t.max_y = (i32)fminf((f32)ob->height - 1, ceilf(max_y));
+    if (t.min_y > t.max_y) continue;
+    *occlusion_push_tri(ob) = t;
+  }
+}
+
+static void occlusion_raster_tri_rows(occlusion_buffer* ob, const occ_tri* t, i32 row_start, i32 row_end) {
+  // edge functions e_i(x, y) = a_i * x + b_i * y + c_i, positive inside for counter-clockwise winding
+  f32 x0 = t->x[0], y0 = t->y[0], x1 = t->x[1], y1 = t->y[1], x2 = t->x[2], y2 = t->y[2];
+  f32 area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+  if (fabsf(area) < 1e-8f) return;
+  f32 sign = area > 0.0f ? 1.0f : -1.0f;  // occluders are rasterised two-sided
+  f32 inv_area = 1.0f / fabsf(area);
+
+  f32 a0 = (y1 - y2) * sign, b0 = (x2 - x1) * sign, c0 = (x1 * y2 - x2 * y1) * sign;
+  f32 a1 = (y2 - y0) * sign, b1 = (x0 - x2) * sign, c1 = (x2 * y0 - x0 * y2) * sign;
+  f32 a2 = (y0 - y1) * sign, b2 = (x1 - x0) * sign, c2 = (x0 * y1 - x1 * y0) * sign;
+  f32 dz1 = (t->z[1] - t->z[0]) * inv_area, dz2 = (t->z[2] - t->z[0]) * inv_area;
+
+  i32 min_x = (i32)fmaxf(0.0f, floorf(fminf(x0, fminf(x1, x2))));
+  i32 max_x = (i32)fminf((f32)ob->width - 1, ceilf(fmaxf(x0, fmaxf(x1, x2))));
+  if (min_x > max_x) return;
+  min_x &= ~(SIMD_WIDTH - 1);  // keep loads/stores within the row and lane aligned
+
+  f32x8 lane_offsets = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+  i32 y_begin = t->min_y > row_start ? t->min_y : row_start;
+  i32 y_end = t->max_y < row_end - 1 ? t->max_y : row_end - 1;
+
+  for (i32 y = y_begin; y <= y_end; y++) {
+    f32 py = (f32)y + 0.5f;
+    f32* row = &ob->depth[(size_t)y * ob->width];
+    for (i32 x = min_x; x <= max_x; x += SIMD_WIDTH) {
+      f32x8 px = lane_offsets + (f32)x;
+      f32x8 e0 = px * a0 + (b0 * py + c0);
+      f32x8 e1 = px * a1 + (b1 * py + c1);
+      f32x8 e2 = px * a2 + (b2 * py + c2);
+      i32x8 inside = (e0 >= 0.0f) & (e1 >= 0.0f) & (e2 >= 0.0f);
+      f32x8 z = e1 * dz1 + e2 * dz2 + t->z[0];
+      f32x8 current = f32x8_load(&row[x]);
+      i32x8 closer = inside & (z < current);
+      // branchless select: keep the nearer depth where covered
+      f32x8 result = (f32x8)(((i32x8)z & closer) | ((i32x8)current & ~closer));
+      f32x8_store(&row[x], result);
+    }
+  }
+}
+
+typedef struct occlusion_band_ctx {
+  occlusion_buffer* ob;
+} occlusion_band_ctx;
+
+// each job owns whole rows of tiles so no two threads ever touch the same pixels
+static void occlusion_raster_band(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  occlusion_buffer* ob = ((occlusion_band_ctx*)data)->ob;
+  i32 row_start = (i32)(start * OCCLUSION_TILE_SIZE);
+  i32 row_end = (i32)(end * OCCLUSION_TILE_SIZE);
+
+  for (i32 y = row_start; y < row_end; y++) {
+    f32* row = &ob->depth[(size_t)y * ob->width];
+    for (u32 x = 0; x < ob->width; x++) row[x] = 1.0f;
+  }
+
+  const occ_tri* tris = ob->tris;
+  for (u32 i = 0; i < ob->tri_count; i++) {
+    if (tris[i].max_y < row_start || tris[i].min_y >= row_end) continue;
+    occlusion_raster_tri_rows(ob, &tris[i], row_start, row_end);
+  }
+
+  // build the hierarchical level for this band
+  for (u32 ty = start; ty < end; ty++) {
+    for (u32 tx = 0; tx < ob->tiles_x; tx++) {
+      f32x8 tile_max = f32x8_splat(0.0f);
+      for (u32 y = 0; y < OCCLUSION_TILE_SIZE; y++) {
+        f32x8 d = f32x8_load(&ob->depth[(size_t)(ty * OCCLUSION_TILE_SIZE + y) * ob->width + tx * OCCLUSION_TILE_SIZE]);
+        tile_max = (f32x8)(((i32x8)d & (d > tile_max)) | ((i32x8)tile_max & ~(d > tile_max)));
+      }
+      f32 max_depth = 0.0f;
+      for (u32 l = 0; l < OCCLUSION_TILE_SIZE; l++) max_depth = fmaxf(max_depth, tile_max[l]);
+      ob->tile_max_depth[ty * ob->tiles_x + tx] = max_depth;
+    }
+  }
+}
+
+_Static_assert(OCCLUSION_TILE_SIZE == SIMD_WIDTH, "tile rows are reduced with a single SIMD load");
+
+void occlusion_rasterize(occlusion_buffer* ob, mat4 view_proj, const occluder_mesh* occluders, u32 occluder_count) {
+  ob->view_proj = view_proj;
+  ob->tri_count = 0;
+  for (u32 i = 0; i < occluder_count; i++) {
+    occlusion_setup_tris(ob, &occluders[i]);
+  }
+
+  occlusion_band_ctx ctx = { .ob = ob };
+  jobs_parallel_for(ob->tiles_y, 1, occlusion_raster_band, &ctx);
+}
+
+bool occlusion_test_aabb(const occlusion_buffer* ob, bbox_3d box) {
+  const f32* m = ob->view_proj.data;
+  f32 min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY, min_z = INFINITY;
+
+  for (u32 c = 0; c < 8; c++) {
+    vec3 corner = vec3(c & 1 ? box.max.x : box.min.x, c & 2 ? box.max.y : box.min.y, c & 4 ? box.max.z : box.min.z);
+    f32 x, y, z;
+    if (!occlusion_project(ob, m, corner, &x, &y, &z)) {
+      return true;  // straddles the eye plane
+    }
+    min_x = fminf(min_x, x), max_x = fmaxf(max_x, x);
+    min_y = fminf(min_y, y), max_y = fmaxf(max_y, y);
+    min_z = fminf(min_z, z);
+  }
+  if (min_z <= 0.0f) return true;
+
+  i32 x0 = (i32)fmaxf(0.0f, floorf(min_x)), x1 = (i32)fminf((f32)ob->width - 1, floorf(max_x));
+  i32 y0 = (i32)fmaxf(0.0f, floorf(min_y)), y1 = (i32)fminf((f32)ob->height - 1, floorf(max_y));
+  if (x0 > x1 || y0 > y1) return false;  // entirely off-screen, the frustum test should have caught this
+
+  for (i32 ty = y0 / OCCLUSION_TILE_SIZE; ty <= y1 / OCCLUSION_TILE_SIZE; ty++) {
+    for (i32 tx = x0 / OCCLUSION_TILE_SIZE; tx <= x1 / OCCLUSION_TILE_SIZE; tx++) {
+      // coarse reject: everything in this tile is in front of the box
+      if (ob->tile_max_depth[ty * ob->tiles_x + tx] < min_z) continue;
+
+      // fine test of just the pixels the box covers within this tile
+      i32 py0 = ty * OCCLUSION_TILE_SIZE > y0 ? ty * OCCLUSION_TILE_SIZE : y0;
+      i32 py1 = (ty + 1) * OCCLUSION_TILE_SIZE - 1 < y1 ? (ty + 1) * OCCLUSION_TILE_SIZE - 1 : y1;
+      i32 px0 = tx * OCCLUSION_TILE_SIZE > x0 ? tx * OCCLUSION_TILE_SIZE : x0;
+      i32 px1 = (tx + 1) * OCCLUSION_TILE_SIZE - 1 < x1 ? (tx + 1) * OCCLUSION_TILE_SIZE - 1 : x1;
+      for (i32 py = py0; py <= py1; py++) {
+        for (i32 px = px0; px <= px1; px++) {
+          if (ob->depth[(size_t)py * ob->width + px] >= min_z) return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+typedef struct occlusion_cull_ctx {
+  const occlusion_buffer* ob;
+  const cull_bounds_soa* bounds;
+  const u32* indices;
+  bool* keep;
+} occlusion_cull_ctx;
+
+static void occlusion_cull_chunk(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  occlusion_cull_ctx* ctx = data;
+  const cull_bounds_soa* b = ctx->bounds;
+  for (u32 i = start; i < end; i++) {
+    u32 idx = ctx->indices[i];
+    vec3 c = vec3(b->center_x[idx], b->center_y[idx], b->center_z[idx]);
+    vec3 e = vec3(b->extent_x[idx], b->extent_y[idx], b->extent_z[idx]);
+    bbox_3d box = { .min = vec3(c.x - e.x, c.y - e.y, c.z - e.z), .max = vec3(c.x + e.x, c.y + e.y, c.z + e.z) };
+    ctx->keep[i] = occlusion_test_aabb(ctx->ob, box);
+  }
+}
+
+void occlusion_cull(const occlusion_buffer* ob, const cull_bounds_soa* bounds, arena* frame_arena,
+                    cull_result* result) {
+  assert(bounds->extent_x);
+  u32 count = result->n_visible;
+  if (count == 0) return;
+
+  occlusion_cull_ctx ctx = { .ob = ob, .bounds = bounds, .indices = result->visible_indices };
+  ctx.keep = arena_alloc(frame_arena, sizeof(bool) * count);
+  jobs_parallel_for(count, 256, occlusion_cull_chunk, &ctx);
+
+  u32 n_visible = 0;
+  for (u32 i = 0; i < count; i++) {
+    if (ctx.keep[i]) result->visible_indices[n_visible++] = result->visible_indices[i];
+  }
+  result->n_culled += count - n_visible;
+  result->n_visible = n_visible;
+}
@@ -0,0 +1,201 @@
+/* A TLSF offset allocator: hands out ranges of an abstract address space and never touches the memory itself, so it
+   runs and is tested entirely on the CPU. `gpu_heap.c` builds GPU buffer sub-allocation on top of it.
+   The bin layout follows Sebastian Aaltonen's OffsetAllocator https://github.com/sebbbi/OffsetAllocator */
+
+#include <celeritas.h>
+
+#define NODE_UNUSED UINT32_MAX
+
+// Sizes map to bins like a tiny float: 3 bits of mantissa and 5 of exponent
+#define MANTISSA_BITS 3
+#define MANTISSA_VALUE (1 << MANTISSA_BITS)
+#define MANTISSA_MASK (MANTISSA_VALUE - 1)
+
+struct offset_allocator_node {
+  u32 offset;
+  u32 size;
+  u32 bin_prev;
+  u32 bin_next;
+  u32 neighbour_prev;  // address order
+  u32 neighbour_next;
+  bool used;
+};
+
+static u32 size_to_bin(u32 size, bool round_up) {
+  if (size < MANTISSA_VALUE) return size;
+  u32 highest_bit = 31 - __builtin_clz(size);
+  u32 mantissa_start = highest_bit - MANTISSA_BITS;
+  u32 exponent = mantissa_start + 1;
+  u32 mantissa = (size >> mantissa_start) & MANTISSA_MASK;
+  if (round_up && (size & ((1u << mantissa_start) - 1))) mantissa++;
+  // adding rather than or-ing lets a mantissa overflow carry into the exponent
+  return (exponent << MANTISSA_BITS) + mantissa;
+}
+
+static u32 lowest_set_bit_from(u32 mask, u32 start) {
+  if (start >= 32) return NODE_UNUSED;
+  u32 after = mask & ~((1u << start) - 1);
+  return after ? (u32)__builtin_ctz(after) : NODE_UNUSED;
+}
+
+static u32 offset_allocator_insert_free(offset_allocator* a, u32 size, u32 offset) {
+  u32 bin = size_to_bin(size, false);
+  u32 top = bin / OFFSET_ALLOC_BINS_PER_LEAF, leaf = bin % OFFSET_ALLOC_BINS_PER_LEAF;
+  if (a->bin_indices[bin] == NODE_UNUSED) {
+    a->used_bins[top] |= 1 << leaf;
+    a->used_bins_top |= 1u << top;
+  }
+
+  assert(a->free_node_count > 0);
+  u32 head = a->bin_indices[bin];
+  u32 idx = a->free_nodes[--a->free_node_count];
+  a->nodes[idx] = (offset_allocator_node){ .offset = offset,
+                                           .size = size,
+                                           .bin_prev = NODE_UNUSED,
+                                           .bin_next = head,
+                                           .neighbour_prev = NODE_UNUSED,
+                                           .neighbour_next = NODE_UNUSED,
+                                           .used = false };
+  if (head != NODE_UNUSED) a->nodes[head].bin_prev = idx;
+  a->bin_indices[bin] = idx;
+  a->free_storage += size;
+  return idx;
+}
+
+static void offset_allocator_remove_free(offset_allocator* a, u32 idx) {
+  offset_allocator_node* node = &a->nodes[idx];
+  if (node->bin_prev != NODE_UNUSED) {
+    a->nodes[node->bin_prev].bin_next = node->bin_next;
+    if (node->bin_next != NODE_UNUSED) a->nodes[node->bin_next].bin_prev = node->bin_prev;
+  } else {
+    // head of its bin
+    u32 bin = size_to_bin(node->size, false);
+    a->bin_indices[bin] = node->bin_next;
+    if (node->bin_next != NODE_UNUSED) a->nodes[node->bin_next].bin_prev = NODE_UNUSED;
+    if (a->bin_indices[bin] == NODE_UNUSED) {
+      u32 top = bin / OFFSET_ALLOC_BINS_PER_LEAF, leaf = bin % OFFSET_ALLOC_BINS_PER_LEAF;
+      a->used_bins[top] &= ~(1 << leaf);
+      if (a->used_bins[top] == 0) a->used_bins_top &= ~(1u << top);
+    }
+  }
+  a->free_nodes[a->free_node_count++] = idx;
+  a->free_storage -= node->size;
+}
+
+offset_allocator offset_allocator_create(u32 size, u32 max_allocs) {
+  offset_allocator a = { .size = size, .max_allocs = max_allocs };
+  a.nodes = malloc(sizeof(offset_allocator_node) * max_allocs);
+  a.free_nodes = malloc(sizeof(u32) * max_allocs);
+  for (u32 i = 0; i < OFFSET_ALLOC_LEAF_BINS; i++) a.bin_indices[i] = NODE_UNUSED;
+  // popped from the back so node 0 gets used first
+  for (u32 i = 0; i < max_allocs; i++) a.free_nodes[i] = max_allocs - i - 1;
+  a.free_node_count = max_allocs;
+  offset_allocator_insert_free(&a, size, 0);
+  return a;
+}
+
+void offset_allocator_destroy(offset_allocator* allocator) {
+  free(allocator->nodes);
+  free(allocator->free_nodes);
+  *allocator = (offset_allocator){ 0 };
+}
+
+offset_alloc offset_allocator_alloc(offset_allocator* a, u32 size) {
+  offset_alloc fail = { .offset = OFFSET_ALLOC_NO_SPACE, .metadata = NODE_UNUSED };
+  // the remainder of a split needs a node
+  if (size == 0 || a->free_node_count == 0) return fail;
+
+  // round up so any range in the chosen bin is big enough
+  u32 min_bin = size_to_bin(size, true);
+  u32 min_top = min_bin / OFFSET_ALLOC_BINS_PER_LEAF, min_leaf = min_bin % OFFSET_ALLOC_BINS_PER_LEAF;
+  if (min_top >= OFFSET_ALLOC_TOP_BINS) return fail;
+
+  u32 top = min_top;
+  u32 leaf = NODE_UNUSED;
+  if (a->used_bins_top & (1u << top)) leaf = lowest_set_bit_from(a->used_bins[top], min_leaf);
+  if (leaf == NODE_UNUSED) {
+    top = lowest_set_bit_from(a->used_bins_top, min_top + 1);
+    if (top == NODE_UNUSED) return fail;
+    leaf = __builtin_ctz(a->used_bins[top]);
+  }
+
+  u32 bin = top * OFFSET_ALLOC_BINS_PER_LEAF + leaf;
+  u32 idx = a->bin_indices[bin];
+  offset_allocator_node* node = &a->nodes[idx];
+  u32 total = node->size;
+  node->size = size;
+  node->used = true;
+
+  a->bin_indices[bin] = node->bin_next;
+  if (node->bin_next != NODE_UNUSED) a->nodes[node->bin_next].bin_prev = NODE_UNUSED;
+  a->free_storage -= total;
+  if (a->bin_indices[bin] == NODE_UNUSED) {
+    a->used_bins[top] &= ~(1 << leaf);
+    if (a->used_bins[top] == 0) a->used_bins_top &= ~(1u << top);
+  }
+
+  u32 remainder = total - size;
+  if (remainder > 0) {
+    u32 rest = offset_allocator_insert_free(a, remainder, node->offset + size);
+    node = &a->nodes[idx];
+    if (node->neighbour_next != NODE_UNUSED) a->nodes[node->neighbour_next].neighbour_prev = rest;
+    a->nodes[rest].neighbour_prev = idx;
+    a->nodes[rest].neighbour_next = node->neighbour_next;
+    node->neighbour_next = rest;
+  }
+
+  return (offset_alloc){ .offset = node->offset, .metadata = idx };
+}
+
+void offset_allocator_free(offset_allocator* a, offset_alloc allocation) {
+  assert(allocation.metadata < a->max_allocs);
+  u32 idx = allocation.metadata;
+  offset_allocator_node* node = &a->nodes[idx];
+  assert(node->used);
+
+  u32 offset = node->offset;
+  u32 size = node->size;
+
+  if (node->neighbour_prev != NODE_UNUSED && !a->nodes[node->neighbour_prev].used) {
+    offset_allocator_node* prev = &a->nodes[node->neighbour_prev];
+    offset = prev->offset;
+    size += prev->size;
+    u32 prev_idx = node->neighbour_prev;
+    node->neighbour_prev = prev->neighbour_prev;
+    offset_allocator_remove_free(a, prev_idx);
+  }
+  if (node->neighbour_next != NODE_UNUSED && !a->nodes[node->neighbour_next].used) {
+    offset_allocator_node* next = &a->nodes[node->neighbour_next];
+    size += next->size;
+    u32 next_idx = node->neighbour_next;
+    node->neighbour_next = next->neighbour_next;
+    offset_allocator_remove_free(a, next_idx);
+  }
+
+  u32 neighbour_prev = node->neighbour_prev;
+  u32 neighbour_next = node->neighbour_next;
+  node->used = false;
+  a->free_nodes[a->free_node_count++] = idx;
+
+  u32 merged = offset_allocator_insert_free(a, size, offset);
+  if (neighbour_next != NODE_UNUSED) {
+    a->nodes[merged].neighbour_next = neighbour_next;
+    a->nodes[neighbour_next].neighbour_prev = merged;
+  }
+  if (neighbour_prev != NODE_UNUSED) {
+    a->nodes[merged].neighbour_prev = neighbour_prev;
+    a->nodes[neighbour_prev].neighbour_next = merged;
+  }
+}
+
+offset_allocator_stats offset_allocator_get_stats(const offset_allocator* a) {
+  offset_allocator_stats stats = { .total_free = a->free_storage };
+  for (u32 bin = 0; bin < OFFSET_ALLOC_LEAF_BINS; bin++) {
+    for (u32 i = a->bin_indices[bin]; i != NODE_UNUSED; i = a->nodes[i].bin_next) {
+      stats.free_region_count++;
+      if (a->nodes[i].size > stats.largest_free) stats.largest_free = a->nodes[i].size;
+    }
+  }
+  stats.fragmentation = stats.total_free ? 1.0f - (f32)stats.largest_free / (f32)stats.total_free : 0.0f;
+  return stats;
+}
@@ -0,0 +1,494 @@
+/* Backend-agnostic parts of the RAL */
+
+#include <celeritas.h>
+#include <sys/stat.h>
+#if defined(CEL_PLATFORM_WINDOWS)
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+NAMESPACED_LOGGER(ral);
+
+// --- Redundant state filtering
+
+enum {
+  BIND_SLOT_PIPELINE = 1 << 0,
+  BIND_SLOT_VERTEX_BUF = 1 << 1,
+  BIND_SLOT_INDEX_BUF = 1 << 2,
+  BIND_SLOT_INSTANCE_BUF = 1 << 3,
+  BIND_SLOT_TEXTURE_0 = 1 << 4,  // textures take the next MAX_SHADER_BINDINGS bits
+  BIND_SLOT_UNIFORM_0 = 1 << (4 + MAX_SHADER_BINDINGS),  // then MAX_UNIFORM_SLOTS bits of uniform blocks
+};
+_Static_assert(4 + MAX_SHADER_BINDINGS + MAX_UNIFORM_SLOTS <= 32, "bind slots must fit in gpu_bind_state.valid");
+
+static bool bind_state_check(gpu_bind_state* state, u32 slot_bit, bool same) {
+  if ((state->valid & slot_bit) && same) {
+    state->stats.binds_elided++;
+    return false;
+  }
+  state->valid |= slot_bit;
+  state->stats.binds_issued++;
+  return true;
+}
+
+void gpu_bind_state_invalidate(gpu_bind_state* state) { state->valid = 0; }
+
+bool gpu_bind_state_pipeline(gpu_bind_state* state, pipeline_handle pipeline) {
+  bool same = state->pipeline.raw == pipeline.raw;
+  state->pipeline = pipeline;
+  return bind_state_check(state, BIND_SLOT_PIPELINE, same);
+}
+
+gpu_bind_action gpu_bind_state_vertex_buf(gpu_bind_state* state, buf_handle vbuf, u64 offset) {
+  bool same_buf = (state->valid & BIND_SLOT_VERTEX_BUF) && state->vertex_buf.raw == vbuf.raw;
+  if (!bind_state_check(state, BIND_SLOT_VERTEX_BUF, same_buf && state->vertex_offset == offset)) return BIND_ELIDE;
+  state->vertex_buf = vbuf;
+  state->vertex_offset = offset;
+  return same_buf ? BIND_OFFSET_ONLY : BIND_FULL;
+}
+
+bool gpu_bind_state_index_buf(gpu_bind_state* state, buf_handle ibuf) {
+  bool same = state->index_buf.raw == ibuf.raw;
+  state->index_buf = ibuf;
+  return bind_state_check(state, BIND_SLOT_INDEX_BUF, same);
+}
+
+bool gpu_bind_state_instance_buf(gpu_bind_state* state, buf_handle buf, u64 offset) {
+  bool same = state->instance_buf.raw == buf.raw && state->instance_offset == offset;
+  state->instance_buf = buf;
+  state->instance_offset = offset;
+  return bind_state_check(state, BIND_SLOT_INSTANCE_BUF, same);
+}
+
+bool gpu_bind_state_texture(gpu_bind_state* state, tex_handle texture, u32 slot) {
+  assert(slot < MAX_SHADER_BINDINGS);
+  bool same = state->textures[slot].raw == texture.raw;
+  state->textures[slot] = texture;
+  return bind_state_check(state, BIND_SLOT_TEXTURE_0 << slot, same);
+}
+
+gpu_bind_action gpu_bind_state_uniforms(gpu_bind_state* state, buf_handle buf, u64 offset, u32 slot,
+                                        shader_stage stages) {
+  assert(slot < MAX_UNIFORM_SLOTS);
+  u32 slot_bit = BIND_SLOT_UNIFORM_0 << slot;
+  bool same_buf = (state->valid & slot_bit) && state->uniform_bufs[slot].raw == buf.raw;
+  // a stage that never had the buffer bound can't just have its offset moved
+  bool covered = same_buf && (state->uniform_stages[slot] & stages) == stages;
+  bool same_offset = state->uniform_offsets[slot] == offset;
+  if (!bind_state_check(state, slot_bit, covered && same_offset)) return BIND_ELIDE;
+
+  // stages left out of this bind keep the old offset, so they only stay recorded if it didn't move
+  state->uniform_stages[slot] = same_buf && same_offset ? state->uniform_stages[slot] | stages : stages;
+  state->uniform_bufs[slot] = buf;
+  state->uniform_offsets[slot] = offset;
+  return covered ? BIND_OFFSET_ONLY : BIND_FULL;
+}
+
+// --- Per-frame uniform ring
+
+static u64 align_up(u64 value, u64 alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+uniform_ring uniform_ring_create(u64 frame_size, u32 alignment) {
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+  frame_size = align_up(frame_size, alignment);
+  buf_handle buffer = ral_buffer_create(frame_size * MAX_FRAMES_IN_FLIGHT, NULL);
+  return (uniform_ring){ .buffer = buffer,
+                         .mapped = ral_buffer_mapped(buffer),
+                         .frame_size = frame_size,
+                         .alignment = alignment,
+                         .frame_index = 0,
+                         .head = 0 };
+}
+
+void uniform_ring_destroy(uniform_ring* ring) {
+  ral_buffer_destroy(ring->buffer);
+  *ring = (uniform_ring){ 0 };
+}
+
+void uniform_ring_begin_frame(uniform_ring* ring, u32 frame_index) {
+  ring->frame_index = frame_index % MAX_FRAMES_IN_FLIGHT;
+  atomic_store_explicit(&ring->head, 0, memory_order_relaxed);
+}
+
+uniform_alloc uniform_ring_alloc(uniform_ring* ring, u64 size) {
+  u64 aligned = align_up(size, ring->alignment);
+  u64 start = atomic_fetch_add_explicit(&ring->head, aligned, memory_order_relaxed);
+  if (start + aligned > ring->frame_size) {
+    // only the allocation that crosses the end reports it, the ones after it start past the end
+    if (start <= ring->frame_size) {
+      WARN("Uniform ring out of space (%llu bytes per frame)", (unsigned long long)ring->frame_size);
+    }
+    return (uniform_alloc){ .ptr = NULL, .offset = 0 };
+  }
+  u64 offset = (u64)ring->frame_index * ring->frame_size + start;
+  return (uniform_alloc){ .ptr = ring->mapped + offset, .offset = offset };
+}
+
+u64 uniform_ring_push(uniform_ring* ring, const void* data, u64 size) {
+  uniform_alloc a = uniform_ring_alloc(ring, size);
+  if (!a.ptr) return UINT64_MAX;
+  memcpy(a.ptr, data, size);
+  return a.offset;
+}
+
+uniform_alloc uniform_ring_alloc_array(uniform_ring* ring, u64 elem_size, u32 count, u64* out_stride) {
+  u64 stride = align_up(elem_size, ring->alignment);
+  *out_stride = stride;
+  return uniform_ring_alloc(ring, stride * count);
+}
+
+uniform_alloc uniform_ring_push_array(uniform_ring* ring, const void* data, u64 elem_size, u32 count,
+                                      u64* out_stride) {
+  uniform_alloc a = uniform_ring_alloc_array(ring, elem_size, count, out_stride);
+  if (!a.ptr) return a;
+  if (*out_stride == elem_size) {
+    memcpy(a.ptr, data, elem_size * count);
+  } else {
+    for (u32 i = 0; i < count; i++) {
+      memcpy((u8*)a.ptr + i * *out_stride, (const u8*)data + i * elem_size, elem_size);
+    }
+  }
+  return a;
+}
+
+// --- Shader data cache
+
+#define SHADER_DATA_CACHE_MAX_LOAD(cap) ((cap) / 4 * 3)
+
+static u32 shader_data_refs(const shader_data_layout* layout, u32* refs, u16* texture_refs) {
+  u32 n = 0;
+  *texture_refs = 0;
+  for (size_t i = 0; i < layout->binding_count; i++) {
+    const shader_binding* b = &layout->bindings[i];
+    switch (b->binding_type) {
+      case BINDING_BUFFER:
+      case BINDING_BUFFER_ARRAY:
+        refs[n++] = b->data.buffer.handle.raw;
+        break;
+      case BINDING_TEXTURE:
+      case BINDING_TEXTURE_ARRAY:
+        *texture_refs |= 1 << n;
+        refs[n++] = b->data.texture.handle.raw;
+        break;
+      default:
+        break;
+    }
+  }
+  return n;
+}
+
+u64 shader_data_layout_hash(const shader_data_layout* layout) {
+  u64 h = HASH_SEED;
+  for (size_t i = 0; i < layout->binding_count; i++) {
+    const shader_binding* b = &layout->bindings[i];
+    u32 header[2] = { b->binding_type, b->visibility };
+    h = hash_bytes(header, sizeof(header), h);
+    switch (b->binding_type) {
+      case BINDING_BYTES:
+        h = hash_bytes(&b->data.bytes.size, sizeof(b->data.bytes.size), h);
+        break;
+      case BINDING_BUFFER:
+      case BINDING_BUFFER_ARRAY:
+        h = hash_bytes(&b->data.buffer.handle.raw, sizeof(u32), h);
+        break;
+      case BINDING_TEXTURE:
+      case BINDING_TEXTURE_ARRAY:
+        h = hash_bytes(&b->data.texture.handle.raw, sizeof(u32), h);
+        break;
+      default:
+        break;
+    }
+  }
+  return h ? h : 1;  // 0 marks an empty slot
+}
+
+shader_data_cache shader_data_cache_create(u32 capacity, shader_data_release_fn release, void* user_data) {
+  u32 cap = 16;
+  while (cap < capacity) cap <<= 1;
+  return (shader_data_cache){ .entries = calloc(cap, sizeof(shader_data_cache_entry)),
+                              .capacity = cap,
+                              .release = release,
+                              .user_data = user_data };
+}
+
+void shader_data_cache_destroy(shader_data_cache* cache) {
+  for (u32 i = 0; i < cache->capacity; i++) {
+    if (cache->entries[i].key && cache->release) cache->release(cache->entries[i].payload, cache->user_data);
+  }
+  free(cache->entries);
+  *cache = (shader_data_cache){ 0 };
+}
+
+/** @brief releases slot `i` and backward-shifts the rest of its probe run so lookups never need tombstones. Whatever
+           lands in `i` afterwards still needs looking at if the caller is scanning */
+static void shader_data_cache_remove_at(shader_data_cache* cache, u32 i) {
+  u32 mask = cache->capacity - 1;
+  if (cache->release) cache->release(cache->entries[i].payload, cache->user_data);
+  cache->count--;
+
+  u32 hole = i;
+  for (u32 j = (i + 1) & mask; cache->entries[j].key; j = (j + 1) & mask) {
+    u32 home = cache->entries[j].key & mask;
+    // leave the entry where it is if its home slot lies cyclically within (hole, j]
+    bool stays = hole <= j ? (home > hole && home <= j) : (home > hole || home <= j);
+    if (!stays) {
+      cache->entries[hole] = cache->entries[j];
+      hole = j;
+    }
+  }
+  cache->entries[hole].key = 0;
+}
+
+static bool shader_data_entry_matches(const shader_data_cache_entry* e, const u32* refs, u32 ref_count,
+                                      u16 texture_refs) {
+  return e->ref_count == ref_count && e->texture_refs == texture_refs &&
+         memcmp(e->refs, refs, sizeof(u32) * ref_count) == 0;
+}
+
+bool shader_data_cache_get(shader_data_cache* cache, const shader_data_layout* layout, u64 hash, u64 frame,
+                           u64* out_payload) {
+  u32 refs[MAX_SHADER_BINDINGS];
+  u16 texture_refs;
+  u32 ref_count = shader_data_refs(layout, refs, &texture_refs);
+
+  u32 mask = cache->capacity - 1;
+  for (u32 i = hash & mask; cache->entries[i].key; i = (i + 1) & mask) {
+    shader_data_cache_entry* e = &cache->entries[i];
+    if (e->key == hash && shader_data_entry_matches(e, refs, ref_count, texture_refs)) {
+      e->last_used_frame = frame;
+      *out_payload = e->payload;
+      cache->hits++;
+      return true;
+    }
+  }
+  cache->misses++;
+  return false;
+}
+
+bool shader_data_cache_put(shader_data_cache* cache, const shader_data_layout* layout, u64 hash, u64 frame,
+                           u64 payload) {
+  if (cache->count + 1 > SHADER_DATA_CACHE_MAX_LOAD(cache->capacity)) {
+    u32 lru = UINT32_MAX;
+    for (u32 i = 0; i < cache->capacity; i++) {
+      const shader_data_cache_entry* e = &cache->entries[i];
+      if (!e->key || e->last_used_frame + MAX_FRAMES_IN_FLIGHT > frame) continue;
+      if (lru == UINT32_MAX || e->last_used_frame < cache->entries[lru].last_used_frame) lru = i;
+    }
+    if (lru == UINT32_MAX) return false;
+    shader_data_cache_remove_at(cache, lru);
+    cache->evictions++;
+  }
+
+  shader_data_cache_entry entry = { .key = hash, .payload = payload, .last_used_frame = frame };
+  entry.ref_count = shader_data_refs(layout, entry.refs, &entry.texture_refs);
+
+  u32 mask = cache->capacity - 1;
+  u32 i = hash & mask;
+  while (cache->entries[i].key) i = (i + 1) & mask;
+  cache->entries[i] = entry;
+  cache->count++;
+  return true;
+}
+
+void shader_data_cache_trim(shader_data_cache* cache, u64 frame, u32 max_age) {
+  for (u32 i = 0; i < cache->capacity;) {
+    const shader_data_cache_entry* e = &cache->entries[i];
+    if (e->key && e->last_used_frame + max_age < frame) {
+      shader_data_cache_remove_at(cache, i);
+      cache->evictions++;
+    } else {
+      i++;
+    }
+  }
+}
+
+static void shader_data_cache_invalidate(shader_data_cache* cache, u32 raw, bool texture) {
+  for (u32 i = 0; i < cache->capacity;) {
+    const shader_data_cache_entry* e = &cache->entries[i];
+    bool references = false;
+    for (u32 r = 0; e->key && r < e->ref_count && !references; r++) {
+      references = e->refs[r] == raw && (bool)(e->texture_refs & (1 << r)) == texture;
+    }
+    if (references) {
+      shader_data_cache_remove_at(cache, i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void shader_data_cache_invalidate_buffer(shader_data_cache* cache, buf_handle buf) {
+  shader_data_cache_invalidate(cache, buf.raw, false);
+}
+
+void shader_data_cache_invalidate_texture(shader_data_cache* cache, tex_handle tex) {
+  shader_data_cache_invalidate(cache, tex.raw, true);
+}
+
+// --- Pipeline cache
+
+static u64 hash_shader_function(const shader_function* f, u64 h) {
+  h = hash_str(f->source, h);
+  h = hash_str(f->entry_point, h);
+  u32 bits[2] = { f->is_spirv, f->stage };
+  return hash_bytes(bits, sizeof(bits), h);
+}
+
+u64 gfx_pipeline_desc_hash(const gfx_pipeline_desc* desc) {
+  u64 h = HASH_SEED;
+  h = hash_bytes(desc->vertex_desc.attributes, sizeof(vertex_attrib_type) * desc->vertex_desc.attribute_count, h);
+  u32 counts[2] = { desc->vertex_desc.attribute_count, desc->vertex_desc.padding };  // padding changes the stride
+  h = hash_bytes(counts, sizeof(counts), h);
+  h = hash_shader_function(&desc->vertex, h);
+  h = hash_shader_function(&desc->fragment, h);
+  return h;
+}
+
+// hash_str treats NULL like an empty string so comparisons have to as well
+static bool str_equal(const char* a, const char* b) { return strcmp(a ? a : "", b ? b : "") == 0; }
+
+static char* str_copy(const char* str) {
+  if (!str) return NULL;
+  size_t len = strlen(str) + 1;
+  return memcpy(malloc(len), str, len);
+}
+
+static bool shader_function_equal(const shader_function* a, const shader_function* b) {
+  return a->is_spirv == b->is_spirv && a->stage == b->stage && str_equal(a->source, b->source) &&
+         str_equal(a->entry_point, b->entry_point);
+}
+
+static shader_function shader_function_copy(const shader_function* f) {
+  return (shader_function){
+    .source = str_copy(f->source), .is_spirv = f->is_spirv, .entry_point = str_copy(f->entry_point), .stage = f->stage
+  };
+}
+
+static void shader_function_free(shader_function* f) {
+  free((char*)f->source);
+  free((char*)f->entry_point);
+}
+
+/** @brief compares exactly what `gfx_pipeline_desc_hash` hashes */
+static bool gfx_pipeline_desc_equal(const gfx_pipeline_desc* a, const gfx_pipeline_desc* b) {
+  const vertex_desc* va = &a->vertex_desc;
+  const vertex_desc* vb = &b->vertex_desc;
+  return va->attribute_count == vb->attribute_count && va->padding == vb->padding &&
+         memcmp(va->attributes, vb->attributes, sizeof(vertex_attrib_type) * va->attribute_count) == 0 &&
+         shader_function_equal(&a->vertex, &b->vertex) && shader_function_equal(&a->fragment, &b->fragment);
+}
+
+bool pipeline_dedup_acquire(pipeline_dedup* dedup, const gfx_pipeline_desc* desc, u64 hash,
+                            pipeline_handle* out_handle) {
+  for (u32 i = 0; i < dedup->count; i++) {
+    pipeline_cache_entry* e = &dedup->entries[i];
+    if (e->key == hash && gfx_pipeline_desc_equal(&e->desc, desc)) {
+      e->ref_count++;
+      dedup->hits++;
+      *out_handle = e->handle;
+      return true;
+    }
+  }
+  return false;
+}
+
+void pipeline_dedup_insert(pipeline_dedup* dedup, const gfx_pipeline_desc* desc, u64 hash, pipeline_handle handle) {
+  if (dedup->count == MAX_CACHED_PIPELINES) {
+    WARN("Pipeline dedup table is full, identical pipelines will be created again");
+    return;
+  }
+  // the caller's strings may not outlive the pipeline, so keep our own copies to compare against
+  gfx_pipeline_desc copy = { .vertex_desc = desc->vertex_desc,
+                             .vertex = shader_function_copy(&desc->vertex),
+                             .fragment = shader_function_copy(&desc->fragment) };
+  copy.vertex_desc.label = NULL;
+  dedup->entries[dedup->count++] =
+      (pipeline_cache_entry){ .key = hash, .desc = copy, .handle = handle, .ref_count = 1 };
+}
+
+bool pipeline_dedup_release(pipeline_dedup* dedup, pipeline_handle handle) {
+  for (u32 i = 0; i < dedup->count; i++) {
+    pipeline_cache_entry* e = &dedup->entries[i];
+    if (e->handle.raw != handle.raw) continue;
+    if (--e->ref_count > 0) return false;
+    shader_function_free(&e->desc.vertex);
+    shader_function_free(&e->desc.fragment);
+    *e = dedup->entries[--dedup->count];
+    return true;
+  }
+  return true;  // untracked pipelines are owned by their only user
+}
+
+void pipeline_cache_path(u64 hash, const char* extension, char* out_path, size_t out_len) {
+  snprintf(out_path, out_len, "%s/%016llx.%s", PIPELINE_CACHE_DIR, (unsigned long long)hash, extension);
+}
+
+void pipeline_cache_make_dir() {
+  make_dir("build");
+  make_dir(PIPELINE_CACHE_DIR);
+}
+
+// --- Deferred destruction
+
+#define DEFERRED_DESTROY_MASK (DEFERRED_DESTROY_CAPACITY - 1)
+_Static_assert((DEFERRED_DESTROY_CAPACITY & DEFERRED_DESTROY_MASK) == 0, "capacity must be a power of two");
+
+void deferred_destroy_init(deferred_destroy_queue* queue) {
+  for (u64 i = 0; i < DEFERRED_DESTROY_CAPACITY; i++) atomic_init(&queue->cells[i].sequence, i);
+  atomic_init(&queue->enqueue_pos, 0);
+  queue->dequeue_pos = 0;
+  atomic_init(&queue->current_frame, 0);
+}
+
+// Bounded MPMC queue after Dmitry Vyukov. A cell is free for the producer at `pos` when its sequence equals `pos`, and
+// holds a finished entry for the consumer at `pos` when its sequence is `pos + 1`
+bool deferred_destroy_push(deferred_destroy_queue* queue, gpu_resource_kind kind, u32 handle) {
+  u64 pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  deferred_destroy_cell* cell;
+  while (true) {
+    cell = &queue->cells[pos & DEFERRED_DESTROY_MASK];
+    u64 seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    i64 diff = (i64)seq - (i64)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      return false;  // full
+    } else {
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  cell->frame = atomic_load_explicit(&queue->current_frame, memory_order_acquire);
+  cell->kind = kind;
+  cell->handle = handle;
+  atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+  return true;
+}
+
+void deferred_destroy_begin_frame(deferred_destroy_queue* queue, u64 frame) {
+  atomic_store_explicit(&queue->current_frame, frame, memory_order_release);
+}
+
+u32 deferred_destroy_collect(deferred_destroy_queue* queue, u64 completed_frame, deferred_destroy_fn destroy,
+                             void* user_data) {
+  u32 destroyed = 0;
+  while (true) {
+    u64 pos = queue->dequeue_pos;
+    deferred_destroy_cell* cell = &queue->cells[pos & DEFERRED_DESTROY_MASK];
+    if (atomic_load_explicit(&cell->sequence, memory_order_acquire) != pos + 1) break;  // empty or still being written
+    // entries are roughly in frame order so the first one that is still in flight ends the sweep. anything older
+    // stuck behind it just waits another frame
+    if (cell->frame > completed_frame) break;
+
+    destroy(cell->kind, cell->handle, user_data);
+    queue->dequeue_pos = pos + 1;
+    atomic_store_explicit(&cell->sequence, pos + DEFERRED_DESTROY_CAPACITY, memory_order_release);
+    destroyed++;
+  }
+  return destroyed;
+}
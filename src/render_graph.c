@@ -0,0 +1,366 @@
+/* Render graph: passes declare resource reads/writes and compiling turns that into an execution order, a set of
+   culled passes, transient memory aliasing and barriers. Nothing in here talks to the GPU. */
+
+#include <celeritas.h>
+
+NAMESPACED_LOGGER(render_graph);
+
+// pass sets are u64 bitmasks and so are the execution positions a transient occupies
+_Static_assert(RG_MAX_PASSES <= 64, "pass masks are stored in a u64");
+
+typedef struct rg_access {
+  rg_resource res;
+  rg_state state;
+  bool write;
+} rg_access;
+
+typedef struct rg_pass {
+  const char* label;
+  rg_execute_fn execute;
+  void* user_data;
+  rg_access accesses[RG_MAX_PASS_ACCESSES];
+  u32 access_count;
+  bool side_effects;
+  bool culled;
+  u32 first_barrier;
+  u32 barrier_count;
+} rg_pass;
+
+typedef struct rg_resource_node {
+  rg_resource_desc desc;
+  bool imported;
+  rg_state initial_state;
+  rg_state final_state;
+  u32 first_use;  // positions in the execution order, UINT32_MAX if unused
+  u32 last_use;
+  u32 memory_block;
+} rg_resource_node;
+
+typedef struct rg_memory_block {
+  rg_resource_kind kind;
+  u64 size;
+  u64 occupied;  // execution positions where some resource lives in this block
+} rg_memory_block;
+
+struct render_graph {
+  rg_pass passes[RG_MAX_PASSES];
+  u32 pass_count;
+  rg_resource_node resources[RG_MAX_RESOURCES];
+  u32 resource_count;
+
+  // filled in by compile
+  u32 order[RG_MAX_PASSES];  // surviving passes in execution order
+  u32 order_count;
+  rg_barrier barriers[RG_MAX_BARRIERS];
+  u32 barrier_count;
+  u32 final_barrier_start;
+  u32 final_barrier_count;
+  rg_memory_block blocks[RG_MAX_RESOURCES];
+  u32 block_count;
+  rg_stats stats;
+};
+
+render_graph* render_graph_create(arena* a) { return arena_alloc(a, sizeof(render_graph)); }
+
+static rg_resource rg_add_resource(render_graph* graph, rg_resource_desc desc, bool imported, rg_state initial_state,
+                                   rg_state final_state) {
+  assert(graph->resource_count < RG_MAX_RESOURCES);
+  u32 idx = graph->resource_count++;
+  graph->resources[idx] = (rg_resource_node){ .desc = desc,
+                                              .imported = imported,
+                                              .initial_state = initial_state,
+                                              .final_state = final_state,
+                                              .first_use = UINT32_MAX,
+                                              .last_use = UINT32_MAX,
+                                              .memory_block = UINT32_MAX };
+  return (rg_resource){ .raw = idx };
+}
+
+rg_resource rg_create_resource(render_graph* graph, rg_resource_desc desc) {
+  return rg_add_resource(graph, desc, false, RG_STATE_UNDEFINED, RG_STATE_UNDEFINED);
+}
+
+rg_resource rg_import_resource(render_graph* graph, rg_resource_desc desc, rg_state initial_state,
+                               rg_state final_state) {
+  return rg_add_resource(graph, desc, true, initial_state, final_state);
+}
+
+u32 rg_add_pass(render_graph* graph, const char* label, rg_execute_fn execute, void* user_data) {
+  assert(graph->pass_count < RG_MAX_PASSES);
+  u32 idx = graph->pass_count++;
+  graph->passes[idx] = (rg_pass){ .label = label, .execute = execute, .user_data = user_data };
+  return idx;
+}
+
+static void rg_pass_access(render_graph* graph, u32 pass, rg_resource res, rg_state state, bool write) {
+  assert(pass < graph->pass_count && res.raw < graph->resource_count);
+  rg_pass* p = &graph->passes[pass];
+  assert(p->access_count < RG_MAX_PASS_ACCESSES);
+  p->accesses[p->access_count++] = (rg_access){ .res = res, .state = state, .write = write };
+}
+
+void rg_pass_read(render_graph* graph, u32 pass, rg_resource res, rg_state state) {
+  rg_pass_access(graph, pass, res, state, false);
+}
+
+void rg_pass_write(render_graph* graph, u32 pass, rg_resource res, rg_state state) {
+  rg_pass_access(graph, pass, res, state, true);
+}
+
+void rg_pass_set_side_effects(render_graph* graph, u32 pass) {
+  assert(pass < graph->pass_count);
+  graph->passes[pass].side_effects = true;
+}
+
+// --- Compile
+
+/** @brief predecessors of each pass: read-after-write, write-after-write and write-after-read on any resource */
+static void rg_build_dependencies(const render_graph* graph, u64* deps) {
+  u32 last_writer[RG_MAX_RESOURCES];
+  u64 readers[RG_MAX_RESOURCES] = { 0 };  // passes that read since the last write
+  for (u32 r = 0; r < graph->resource_count; r++) last_writer[r] = UINT32_MAX;
+
+  for (u32 p = 0; p < graph->pass_count; p++) {
+    const rg_pass* pass = &graph->passes[p];
+    deps[p] = 0;
+    for (u32 a = 0; a < pass->access_count; a++) {
+      u32 r = pass->accesses[a].res.raw;
+      if (last_writer[r] != UINT32_MAX && last_writer[r] != p) deps[p] |= 1ull << last_writer[r];
+      if (pass->accesses[a].write) deps[p] |= readers[r] & ~(1ull << p);
+    }
+    for (u32 a = 0; a < pass->access_count; a++) {
+      u32 r = pass->accesses[a].res.raw;
+      if (pass->accesses[a].write) {
+        last_writer[r] = p;
+        readers[r] = 0;
+      }
+    }
+    for (u32 a = 0; a < pass->access_count; a++) {
+      u32 r = pass->accesses[a].res.raw;
+      if (!pass->accesses[a].write && last_writer[r] != p) readers[r] |= 1ull << p;
+    }
+  }
+}
+
+/** @brief Kahn's algorithm, always taking the lowest numbered ready pass so the order is stable */
+static bool rg_topological_sort(const render_graph* graph, const u64* deps, u32* out_order) {
+  u64 emitted = 0;
+  for (u32 n = 0; n < graph->pass_count; n++) {
+    u32 next = UINT32_MAX;
+    for (u32 p = 0; p < graph->pass_count; p++) {
+      if (!(emitted & (1ull << p)) && (deps[p] & ~emitted) == 0) {
+        next = p;
+        break;
+      }
+    }
+    if (next == UINT32_MAX) return false;
+    emitted |= 1ull << next;
+    out_order[n] = next;
+  }
+  return true;
+}
+
+/** @brief Walks the order backwards keeping only passes whose writes are needed later, or that touch the outside
+           world. A write satisfies the need for a resource so earlier writers of it can go too. */
+static void rg_cull(render_graph* graph, const u32* order) {
+  bool needed[RG_MAX_RESOURCES] = { 0 };
+  for (u32 i = graph->pass_count; i-- > 0;) {
+    rg_pass* pass = &graph->passes[order[i]];
+    bool alive = pass->side_effects;
+    for (u32 a = 0; a < pass->access_count && !alive; a++) {
+      const rg_access* acc = &pass->accesses[a];
+      if (acc->write && (needed[acc->res.raw] || graph->resources[acc->res.raw].imported)) alive = true;
+    }
+    pass->culled = !alive;
+    if (!alive) continue;
+
+    for (u32 a = 0; a < pass->access_count; a++) {
+      if (pass->accesses[a].write) needed[pass->accesses[a].res.raw] = false;
+    }
+    for (u32 a = 0; a < pass->access_count; a++) {
+      if (!pass->accesses[a].write) needed[pass->accesses[a].res.raw] = true;
+    }
+  }
+}
+
+static void rg_compute_lifetimes(render_graph* graph) {
+  for (u32 pos = 0; pos < graph->order_count; pos++) {
+    const rg_pass* pass = &graph->passes[graph->order[pos]];
+    for (u32 a = 0; a < pass->access_count; a++) {
+      rg_resource_node* res = &graph->resources[pass->accesses[a].res.raw];
+      if (res->first_use == UINT32_MAX) res->first_use = pos;
+      res->last_use = pos;
+    }
+  }
+}
+
+/** @brief Greedy interval packing: largest transients first, each into the first block of the same kind that is free
+           for its whole lifetime. A block is as big as the first (largest) resource placed in it. */
+static void rg_alias_transients(render_graph* graph) {
+  u32 sorted[RG_MAX_RESOURCES];
+  u32 n = 0;
+  for (u32 r = 0; r < graph->resource_count; r++) {
+    const rg_resource_node* res = &graph->resources[r];
+    if (res->imported || res->first_use == UINT32_MAX) continue;
+    // insertion sort by size descending, ties by index
+    u32 i = n++;
+    while (i > 0 && graph->resources[sorted[i - 1]].desc.size < res->desc.size) {
+      sorted[i] = sorted[i - 1];
+      i--;
+    }
+    sorted[i] = r;
+  }
+
+  for (u32 i = 0; i < n; i++) {
+    rg_resource_node* res = &graph->resources[sorted[i]];
+    u32 span = res->last_use - res->first_use + 1;
+    u64 lifetime = (span == 64 ? ~0ull : ((1ull << span) - 1)) << res->first_use;
+
+    u32 block = UINT32_MAX;
+    for (u32 b = 0; b < graph->block_count; b++) {
+      if (graph->blocks[b].kind == res->desc.kind && !(graph->blocks[b].occupied & lifetime)) {
+        block = b;
+        break;
+      }
+    }
+    if (block == UINT32_MAX) {
+      block = graph->block_count++;
+      graph->blocks[block] = (rg_memory_block){ .kind = res->desc.kind, .size = res->desc.size };
+      graph->stats.aliased_bytes += res->desc.size;
+    }
+    graph->blocks[block].occupied |= lifetime;
+    res->memory_block = block;
+    graph->stats.transient_bytes += res->desc.size;
+  }
+  graph->stats.memory_block_count = graph->block_count;
+}
+
+static void rg_push_barrier(render_graph* graph, rg_barrier barrier) {
+  assert(graph->barrier_count < RG_MAX_BARRIERS);
+  graph->barriers[graph->barrier_count++] = barrier;
+}
+
+static void rg_derive_barriers(render_graph* graph) {
+  rg_state current[RG_MAX_RESOURCES];
+  u32 block_owner[RG_MAX_RESOURCES];
+  for (u32 r = 0; r < graph->resource_count; r++) current[r] = graph->resources[r].initial_state;
+  for (u32 b = 0; b < graph->block_count; b++) block_owner[b] = UINT32_MAX;
+
+  for (u32 pos = 0; pos < graph->order_count; pos++) {
+    rg_pass* pass = &graph->passes[graph->order[pos]];
+    pass->first_barrier = graph->barrier_count;
+
+    for (u32 a = 0; a < pass->access_count; a++) {
+      const rg_access* acc = &pass->accesses[a];
+      u32 r = acc->res.raw;
+      const rg_resource_node* res = &graph->resources[r];
+
+      bool aliasing = false;
+      if (res->first_use == pos && res->memory_block != UINT32_MAX) {
+        u32 owner = block_owner[res->memory_block];
+        aliasing = owner != UINT32_MAX && owner != r;
+        block_owner[res->memory_block] = r;
+        current[r] = RG_STATE_UNDEFINED;  // whatever was there before isn't ours
+      }
+
+      // back-to-back storage writes still need a barrier so the second sees the first's results
+      bool write_hazard = acc->state == RG_STATE_SHADER_WRITE && current[r] == RG_STATE_SHADER_WRITE;
+      if (current[r] != acc->state || write_hazard || aliasing) {
+        rg_push_barrier(graph, (rg_barrier){ .resource = acc->res,
+                                             .before = current[r],
+                                             .after = acc->state,
+                                             .aliasing = aliasing });
+        current[r] = acc->state;
+      }
+    }
+    pass->barrier_count = graph->barrier_count - pass->first_barrier;
+  }
+
+  graph->final_barrier_start = graph->barrier_count;
+  for (u32 r = 0; r < graph->resource_count; r++) {
+    const rg_resource_node* res = &graph->resources[r];
+    if (res->imported && res->final_state != RG_STATE_UNDEFINED && res->final_state != current[r]) {
+      rg_push_barrier(graph, (rg_barrier){ .resource = (rg_resource){ .raw = r },
+                                           .before = current[r],
+                                           .after = res->final_state,
+                                           .aliasing = false });
+    }
+  }
+  graph->final_barrier_count = graph->barrier_count - graph->final_barrier_start;
+  graph->stats.barrier_count = graph->barrier_count;
+}
+
+bool render_graph_compile(render_graph* graph) {
+  graph->order_count = 0;
+  graph->barrier_count = 0;
+  graph->block_count = 0;
+  graph->stats = (rg_stats){ .pass_count = graph->pass_count };
+  for (u32 r = 0; r < graph->resource_count; r++) {
+    graph->resources[r].first_use = UINT32_MAX;
+    graph->resources[r].last_use = UINT32_MAX;
+    graph->resources[r].memory_block = UINT32_MAX;
+  }
+
+  u64 deps[RG_MAX_PASSES];
+  u32 sorted[RG_MAX_PASSES];
+  rg_build_dependencies(graph, deps);
+  if (!rg_topological_sort(graph, deps, sorted)) {
+    ERROR("Render graph has a dependency cycle");
+    return false;
+  }
+
+  rg_cull(graph, sorted);
+  for (u32 i = 0; i < graph->pass_count; i++) {
+    if (graph->passes[sorted[i]].culled) {
+      graph->stats.culled_pass_count++;
+    } else {
+      graph->order[graph->order_count++] = sorted[i];
+    }
+  }
+
+  rg_compute_lifetimes(graph);
+  rg_alias_transients(graph);
+  rg_derive_barriers(graph);
+  return true;
+}
+
+void render_graph_execute(const render_graph* graph) {
+  for (u32 i = 0; i < graph->order_count; i++) {
+    const rg_pass* pass = &graph->passes[graph->order[i]];
+    if (pass->execute) pass->execute(graph, graph->order[i], pass->user_data);
+  }
+}
+
+// --- Compiled results
+
+u32 rg_execution_order(const render_graph* graph, const u32** out_passes) {
+  *out_passes = graph->order;
+  return graph->order_count;
+}
+
+bool rg_pass_culled(const render_graph* graph, u32 pass) { return graph->passes[pass].culled; }
+
+const rg_barrier* rg_pass_barriers(const render_graph* graph, u32 pass, u32* out_count) {
+  *out_count = graph->passes[pass].culled ? 0 : graph->passes[pass].barrier_count;
+  return &graph->barriers[graph->passes[pass].first_barrier];
+}
+
+const rg_barrier* rg_final_barriers(const render_graph* graph, u32* out_count) {
+  *out_count = graph->final_barrier_count;
+  return &graph->barriers[graph->final_barrier_start];
+}
+
+u32 rg_resource_memory_block(const render_graph* graph, rg_resource res) {
+  return graph->resources[res.raw].memory_block;
+}
+
+bool rg_resource_lifetime(const render_graph* graph, rg_resource res, u32* out_first, u32* out_last) {
+  const rg_resource_node* node = &graph->resources[res.raw];
+  *out_first = node->first_use;
+  *out_last = node->last_use;
+  return node->first_use != UINT32_MAX;
+}
+
+u64 rg_memory_block_size(const render_graph* graph, u32 block) { return graph->blocks[block].size; }
+
+rg_stats rg_get_stats(const render_graph* graph) { return graph->stats; }
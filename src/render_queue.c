@@ -0,0 +1,267 @@
+/* Render queue: packs a sort key per visible item and radix sorts them so draws reach the encoder in an order that
+   minimises state changes (opaque) and gets blending right (transparent). Everything here is CPU-side, recording the
+   resulting batches into encoders lives in `draw_encode.c` */
+
+#include <celeritas.h>
+
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
+#define RADIX_PARALLEL_THRESHOLD 65536  // below this the bookkeeping costs more than it saves
+#define RADIX_MAX_CHUNKS 64
+
+static u64 quantise_depth(f32 depth, u32 bits) {
+  depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+  u64 max = (1ull << bits) - 1;
+  return (u64)(depth * (f32)max);
+}
+
+u64 sort_key_opaque(u32 view, u32 pipeline, u32 material, u32 mesh, u32 lod, f32 depth) {
+  assert(view < SORT_KEY_MAX_VIEWS && pipeline < SORT_KEY_MAX_PIPELINES && lod < SORT_KEY_MAX_LODS);
+  return ((u64)view << 60) | (0ull << 59) | ((u64)pipeline << 48) | ((u64)(material & 0xFFFF) << 32) |
+         ((u64)(mesh & 0xFFFF) << 16) | ((u64)lod << 13) | quantise_depth(depth, 13);
+}
+
+u64 sort_key_transparent(u32 view, u32 pipeline, u32 material, u32 mesh, u32 lod, f32 depth) {
+  assert(view < SORT_KEY_MAX_VIEWS && pipeline < SORT_KEY_MAX_PIPELINES && lod < SORT_KEY_MAX_LODS);
+  u64 inverted_depth = ((1ull << 21) - 1) - quantise_depth(depth, 21);
+  return ((u64)view << 60) | (1ull << 59) | (inverted_depth << 38) | ((u64)pipeline << 27) |
+         ((u64)(material & 0xFFFF) << 11) | ((u64)(mesh & 0xFF) << 3) | (u64)lod;
+}
+
+render_queue render_queue_create(arena* frame_arena, u32 capacity) {
+  return (render_queue){ .keys = arena_alloc(frame_arena, sizeof(u64) * capacity),
+                         .items = arena_alloc(frame_arena, sizeof(u32) * capacity),
+                         .count = 0,
+                         .capacity = capacity };
+}
+
+void render_queue_push(render_queue* queue, u64 key, u32 item) {
+  assert(queue->count < queue->capacity);
+  queue->keys[queue->count] = key;
+  queue->items[queue->count] = item;
+  queue->count++;
+}
+
+void render_queue_push_ents(render_queue* queue, const render_ent* entities, const cull_result* visible, u32 view,
+                            camera cam, f32 near_z, f32 far_z) {
+  vec3 forwards = vec3_normalise(cam.forwards);
+  f32 inv_range = 1.0f / (far_z - near_z);
+
+  for (u32 i = 0; i < visible->n_visible; i++) {
+    u32 ent_idx = visible->visible_indices[i];
+    const render_ent* ent = &entities[ent_idx];
+    vec3 pos = vec3(ent->affine.data[12], ent->affine.data[13], ent->affine.data[14]);
+    f32 depth = (vec3_dot(vec3_sub(pos, cam.position), forwards) - near_z) * inv_range;
+    u32 pipeline = ent->armature ? 1 : 0;  // static vs skinned
+
+    u64 key = ent->flags & REND_ENT_TRANSPARENT
+                  ? sort_key_transparent(view, pipeline, ent->material.raw, ent->mesh.raw, ent->lod, depth)
+                  : sort_key_opaque(view, pipeline, ent->material.raw, ent->mesh.raw, ent->lod, depth);
+    render_queue_push(queue, key, ent_idx);
+  }
+}
+
+// --- Radix sort
+
+typedef struct radix_pass_ctx {
+  const u64* keys_in;
+  const u32* items_in;
+  u64* keys_out;
+  u32* items_out;
+  u32 shift;
+  u32 chunk_size;
+  u32 (*chunk_offsets)[RADIX_BUCKETS];  // [chunk][bucket]
+} radix_pass_ctx;
+
+static void radix_histogram_chunk(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  radix_pass_ctx* ctx = data;
+  u32* counts = ctx->chunk_offsets[start / ctx->chunk_size];
+  memset(counts, 0, sizeof(u32) * RADIX_BUCKETS);
+  for (u32 i = start; i < end; i++) {
+    counts[(ctx->keys_in[i] >> ctx->shift) & (RADIX_BUCKETS - 1)]++;
+  }
+}
+
+static void radix_scatter_chunk(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  radix_pass_ctx* ctx = data;
+  u32* offsets = ctx->chunk_offsets[start / ctx->chunk_size];
+  for (u32 i = start; i < end; i++) {
+    u32 dst = offsets[(ctx->keys_in[i] >> ctx->shift) & (RADIX_BUCKETS - 1)]++;
+    ctx->keys_out[dst] = ctx->keys_in[i];
+    ctx->items_out[dst] = ctx->items_in[i];
+  }
+}
+
+void render_queue_sort(render_queue* queue, arena* frame_arena) {
+  u32 count = queue->count;
+  if (count < 2) return;
+
+  arena_save save = arena_savepoint(frame_arena);
+  u64* keys_tmp = arena_alloc(frame_arena, sizeof(u64) * count);
+  u32* items_tmp = arena_alloc(frame_arena, sizeof(u32) * count);
+
+  // one read over the keys gives the histogram of every digit. these are independent of the order of the keys so they
+  // tell us up front which passes would be a no-op
+  u32 global_counts[RADIX_PASSES][RADIX_BUCKETS] = { 0 };
+  for (u32 i = 0; i < count; i++) {
+    u64 k = queue->keys[i];
+    for (u32 p = 0; p < RADIX_PASSES; p++) {
+      global_counts[p][(k >> (p * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+  }
+
+  bool parallel = count >= RADIX_PARALLEL_THRESHOLD && job_system_thread_count() > 1;
+  u32 chunk_count = parallel ? job_system_thread_count() * 4 : 1;
+  if (chunk_count > RADIX_MAX_CHUNKS) chunk_count = RADIX_MAX_CHUNKS;
+  u32 chunk_size = (count + chunk_count - 1) / chunk_count;
+  chunk_count = (count + chunk_size - 1) / chunk_size;
+
+  radix_pass_ctx ctx = { .chunk_size = chunk_size };
+  ctx.chunk_offsets = arena_alloc(frame_arena, sizeof(u32) * RADIX_BUCKETS * chunk_count);
+
+  u64* src_keys = queue->keys;
+  u32* src_items = queue->items;
+  u64* dst_keys = keys_tmp;
+  u32* dst_items = items_tmp;
+
+  for (u32 p = 0; p < RADIX_PASSES; p++) {
+    u32 shift = p * RADIX_BITS;
+    u64 first_digit = (src_keys[0] >> shift) & (RADIX_BUCKETS - 1);
+    if (global_counts[p][first_digit] == count) continue;  // every key has the same digit here
+
+    ctx.keys_in = src_keys;
+    ctx.items_in = src_items;
+    ctx.keys_out = dst_keys;
+    ctx.items_out = dst_items;
+    ctx.shift = shift;
+
+    if (chunk_count > 1) {
+      jobs_parallel_for(count, chunk_size, radix_histogram_chunk, &ctx);
+      // exclusive prefix sum ordered by (bucket, chunk) which keeps the sort stable across chunks
+      u32 running = 0;
+      for (u32 b = 0; b < RADIX_BUCKETS; b++) {
+        for (u32 c = 0; c < chunk_count; c++) {
+          u32 n = ctx.chunk_offsets[c][b];
+          ctx.chunk_offsets[c][b] = running;
+          running += n;
+        }
+      }
+      jobs_parallel_for(count, chunk_size, radix_scatter_chunk, &ctx);
+    } else {
+      u32 running = 0;
+      for (u32 b = 0; b < RADIX_BUCKETS; b++) {
+        ctx.chunk_offsets[0][b] = running;
+        running += global_counts[p][b];
+      }
+      radix_scatter_chunk(&ctx, 0, count, 0);
+    }
+
+    u64* tk = src_keys;
+    src_keys = dst_keys;
+    dst_keys = tk;
+    u32* ti = src_items;
+    src_items = dst_items;
+    dst_items = ti;
+  }
+
+  // after an odd number of passes the result lives in the temporary buffers
+  if (src_keys != queue->keys) {
+    memcpy(queue->keys, src_keys, sizeof(u64) * count);
+    memcpy(queue->items, src_items, sizeof(u32) * count);
+  }
+  arena_rewind(save);
+}
+
+// --- Instancing
+
+static u32 sort_key_pipeline(u64 key) {
+  bool transparent = (key >> 59) & 1;
+  return (u32)((transparent ? key >> 27 : key >> 48) & (SORT_KEY_MAX_PIPELINES - 1));
+}
+
+draw_batch_list render_queue_build_batches(const render_queue* queue, const render_ent* entities, const vec4* colours,
+                                           arena* frame_arena) {
+  draw_batch_list list = { 0 };
+  list.batches = arena_alloc(frame_arena, sizeof(draw_batch) * (queue->count > 0 ? queue->count : 1));
+  list.instances = arena_alloc(frame_arena, sizeof(instance_data) * (queue->count > 0 ? queue->count : 1));
+
+  draw_batch* current = NULL;
+  for (u32 i = 0; i < queue->count; i++) {
+    u32 ent_idx = queue->items[i];
+    const render_ent* ent = &entities[ent_idx];
+    u32 pipeline = sort_key_pipeline(queue->keys[i]);
+
+    bool can_merge = current && !ent->armature && current->mesh.raw == ent->mesh.raw && current->lod == ent->lod &&
+                     current->material.raw == ent->material.raw && current->pipeline == pipeline;
+    if (!can_merge) {
+      current = &list.batches[list.batch_count++];
+      *current = (draw_batch){ .mesh = ent->mesh,
+                               .material = ent->material,
+                               .lod = ent->lod,
+                               .pipeline = pipeline,
+                               .first_instance = list.instance_count,
+                               .instance_count = 0 };
+      if (ent->armature) {
+        current->first_joint = ent->armature->palette_offset;
+        current->joint_count = ent->armature->joint_count;
+      }
+    }
+
+    list.instances[list.instance_count++] = (instance_data){
+      .affine = ent->affine,
+      .colour = colours ? colours[ent_idx] : vec4(1.0, 1.0, 1.0, 1.0),
+    };
+    current->instance_count++;
+
+    // a skinned entity closes its batch so the next item can't merge into it
+    if (ent->armature) current = NULL;
+  }
+  return list;
+}
+
+// --- Indirect draws
+
+indirect_draw_stream indirect_draws_build(const draw_batch_list* list, const mesh* meshes, u32 vertex_stride,
+                                          arena* frame_arena) {
+  indirect_draw_stream stream = { .draw_data = list->instances, .draw_data_count = list->instance_count };
+  u32 n = list->batch_count > 0 ? list->batch_count : 1;
+  stream.args = arena_alloc(frame_arena, sizeof(draw_indexed_indirect_args) * n);
+  stream.segments = arena_alloc(frame_arena, sizeof(indirect_draw_segment) * n);
+  if (list->batch_count == 0) return stream;
+
+  stream.vertex_buffer = meshes[list->batches[0].mesh.raw].vertex_buffer;
+  stream.index_buffer = meshes[list->batches[0].mesh.raw].index_buffer;
+  stream.index_format = meshes[list->batches[0].mesh.raw].geo.index_format;
+
+  indirect_draw_segment* segment = NULL;
+  for (u32 i = 0; i < list->batch_count; i++) {
+    const draw_batch* batch = &list->batches[i];
+    const mesh* m = &meshes[batch->mesh.raw];
+    assert(m->geo.has_indices && m->geo.index_format == stream.index_format);
+    assert(m->vertex_buffer.raw == stream.vertex_buffer.raw && m->index_buffer.raw == stream.index_buffer.raw);
+    assert(m->vertex_offset % vertex_stride == 0);
+    assert(batch->joint_count == 0);  // the args can't rebind a palette between draws
+
+    mesh_lod lod = geo_lod(&m->geo, batch->lod);
+    stream.args[stream.draw_count] = (draw_indexed_indirect_args){
+      .index_count = lod.index_count,
+      .instance_count = batch->instance_count,
+      .first_index = (u32)(m->index_offset / index_format_size(stream.index_format)) + lod.first_index,
+      .base_vertex = (i32)(m->vertex_offset / vertex_stride),
+      .first_instance = batch->first_instance,
+    };
+
+    if (!segment || segment->pipeline != batch->pipeline || segment->material.raw != batch->material.raw) {
+      segment = &stream.segments[stream.segment_count++];
+      *segment = (indirect_draw_segment){ .pipeline = batch->pipeline,
+                                          .material = batch->material,
+                                          .first_draw = stream.draw_count };
+    }
+    segment->draw_count++;
+    stream.draw_count++;
+  }
+  return stream;
+}
@@ -0,0 +1,175 @@
+/* Retained render proxies so extraction only pays for what changed */
+
+#include <celeritas.h>
+
+static u32 simd_round_up_u32(u32 n) { return (n + SIMD_WIDTH - 1) & ~(u32)(SIMD_WIDTH - 1); }
+
+static f32* grow_lanes(f32* lanes, u32 count, u32 capacity) {
+  f32* grown = aligned_alloc(32, sizeof(f32) * capacity);
+  assert(grown);
+  // padding lanes stay zeroed, see `cull_alloc_lanes`
+  memset(grown, 0, sizeof(f32) * capacity);
+  if (lanes) memcpy(grown, lanes, sizeof(f32) * count);
+  free(lanes);
+  return grown;
+}
+
+static void render_world_reserve(render_world* world, u32 capacity) {
+  capacity = simd_round_up_u32(capacity > 0 ? capacity : SIMD_WIDTH);
+  if (capacity <= world->capacity) return;
+
+  world->ents = realloc(world->ents, sizeof(render_ent) * capacity);
+  world->dense_to_proxy = realloc(world->dense_to_proxy, sizeof(u32) * capacity);
+  world->dirty_flags = realloc(world->dirty_flags, capacity);
+  world->dirty = realloc(world->dirty, sizeof(render_proxy) * capacity);
+  world->bounds.flags = realloc(world->bounds.flags, sizeof(render_ent_flags) * capacity);
+  assert(world->ents && world->dense_to_proxy && world->dirty_flags && world->dirty && world->bounds.flags);
+  memset(world->bounds.flags + world->capacity, 0, sizeof(render_ent_flags) * (capacity - world->capacity));
+
+  cull_bounds_soa* b = &world->bounds;
+  f32** lanes[] = { &b->center_x, &b->center_y, &b->center_z, &b->radius, &b->extent_x, &b->extent_y, &b->extent_z };
+  for (u32 l = 0; l < sizeof(lanes) / sizeof(lanes[0]); l++) {
+    *lanes[l] = grow_lanes(*lanes[l], world->count, capacity);
+  }
+  world->capacity = capacity;
+}
+
+render_world render_world_create(u32 capacity) {
+  render_world world = { .free_proxy = UINT32_MAX };
+  render_world_reserve(&world, capacity);
+  return world;
+}
+
+void render_world_destroy(render_world* world) {
+  free(world->ents);
+  free(world->dense_to_proxy);
+  free(world->dirty_flags);
+  free(world->dirty);
+  free(world->proxy_to_dense);
+  cull_bounds_soa* b = &world->bounds;
+  free(b->center_x);
+  free(b->center_y);
+  free(b->center_z);
+  free(b->radius);
+  free(b->extent_x);
+  free(b->extent_y);
+  free(b->extent_z);
+  free(b->flags);
+  *world = (render_world){ 0 };
+}
+
+bool render_world_contains(const render_world* world, render_proxy proxy) {
+  if (proxy.raw >= world->proxy_count) return false;
+  // free handles hold the next free handle, which can't round-trip through `dense_to_proxy`
+  u32 dense = world->proxy_to_dense[proxy.raw];
+  return dense < world->count && world->dense_to_proxy[dense] == proxy.raw;
+}
+
+static u32 proxy_index(const render_world* world, render_proxy proxy) {
+  assert(render_world_contains(world, proxy));
+  return world->proxy_to_dense[proxy.raw];
+}
+
+static void mark_dirty(render_world* world, u32 idx) {
+  if (world->dirty_flags[idx]) return;
+  // stale entries from removed proxies can fill the list up, flushing early is always safe
+  if (world->dirty_count == world->capacity) render_world_update(world);
+  world->dirty_flags[idx] = 1;
+  world->dirty[world->dirty_count++] = (render_proxy){ world->dense_to_proxy[idx] };
+}
+
+render_proxy render_world_add(render_world* world, render_ent ent) {
+  if (world->count == world->capacity) {
+    render_world_reserve(world, world->capacity * 2);
+  }
+  u32 raw;
+  if (world->free_proxy != UINT32_MAX) {
+    raw = world->free_proxy;
+    world->free_proxy = world->proxy_to_dense[raw];
+  } else {
+    if (world->proxy_count == world->proxy_capacity) {
+      world->proxy_capacity = world->proxy_capacity > 0 ? world->proxy_capacity * 2 : SIMD_WIDTH;
+      world->proxy_to_dense = realloc(world->proxy_to_dense, sizeof(u32) * world->proxy_capacity);
+      assert(world->proxy_to_dense);
+    }
+    raw = world->proxy_count++;
+  }
+
+  u32 idx = world->count++;
+  world->bounds.count = world->count;
+  world->proxy_to_dense[raw] = idx;
+  world->dense_to_proxy[idx] = raw;
+  world->ents[idx] = ent;
+  world->dirty_flags[idx] = 0;
+  mark_dirty(world, idx);
+  return (render_proxy){ raw };
+}
+
+void render_world_remove(render_world* world, render_proxy proxy) {
+  u32 idx = proxy_index(world, proxy);
+  u32 last = world->count - 1;
+
+  // swap the last proxy into the hole, bounds included so it needn't be recomputed
+  if (idx != last) {
+    cull_bounds_soa* b = &world->bounds;
+    world->ents[idx] = world->ents[last];
+    world->dense_to_proxy[idx] = world->dense_to_proxy[last];
+    world->dirty_flags[idx] = world->dirty_flags[last];
+    world->proxy_to_dense[world->dense_to_proxy[idx]] = idx;
+    b->center_x[idx] = b->center_x[last];
+    b->center_y[idx] = b->center_y[last];
+    b->center_z[idx] = b->center_z[last];
+    b->radius[idx] = b->radius[last];
+    b->extent_x[idx] = b->extent_x[last];
+    b->extent_y[idx] = b->extent_y[last];
+    b->extent_z[idx] = b->extent_z[last];
+    b->flags[idx] = b->flags[last];
+  }
+  world->count = last;
+  world->bounds.count = last;
+
+  world->proxy_to_dense[proxy.raw] = world->free_proxy;
+  world->free_proxy = proxy.raw;
+}
+
+void render_world_set_transform(render_world* world, render_proxy proxy, mat4 affine) {
+  u32 idx = proxy_index(world, proxy);
+  world->ents[idx].affine = affine;
+  mark_dirty(world, idx);
+}
+
+void render_world_set_material(render_world* world, render_proxy proxy, material_handle material) {
+  // only the render queue reads this and it gathers from `ents` every frame anyway
+  world->ents[proxy_index(world, proxy)].material = material;
+}
+
+void render_world_set_flags(render_world* world, render_proxy proxy, render_ent_flags flags) {
+  u32 idx = proxy_index(world, proxy);
+  world->ents[idx].flags = flags;
+  mark_dirty(world, idx);
+}
+
+const render_ent* render_world_get(const render_world* world, render_proxy proxy) {
+  return &world->ents[proxy_index(world, proxy)];
+}
+
+void render_world_update(render_world* world) {
+  for (u32 d = 0; d < world->dirty_count; d++) {
+    // removed proxies may still be on the list
+    if (!render_world_contains(world, world->dirty[d])) continue;
+    u32 idx = world->proxy_to_dense[world->dirty[d].raw];
+    if (!world->dirty_flags[idx]) continue;  // a recycled handle that was already refreshed
+    cull_bounds_write_render_ent(&world->bounds, idx, &world->ents[idx]);
+    world->dirty_flags[idx] = 0;
+  }
+  world->dirty_count = 0;
+}
+
+void render_world_apply_scene_changes(render_world* world, const scene_tree* tree, const render_proxy* node_proxies,
+                                      u32 node_proxy_count) {
+  for (u32 c = 0; c < tree->changed_count; c++) {
+    scene_node node = tree->changed[c];
+    if (node.raw >= node_proxy_count || !render_world_contains(world, node_proxies[node.raw])) continue;
+    render_world_set_transform(world, node_proxies[node.raw], scene_tree_world(tree, node));
+  }
+}
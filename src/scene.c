@@ -13,14 +13,429 @@
 // Retained mode scene tree that handles performant transform propagation, and allows systems, or other languages via
 // bindings, to manipulate rendering/scene data without *owning* said data.
 
-typedef struct scene_tree_node {
-  const char* label;
-} scene_tree_node;
+#define SCENE_COMPACT_DIVISOR 4        // compact once a quarter of the slots are dead
+#define SCENE_FRONTIER_PER_THREAD 8    // split dirty subtrees until every worker has a few to pick from
+#define SCENE_CHANGED_FLUSH 64         // per-job batching of writes to the shared changed list
+#define SCENE_LINEAR_PASS_DIVISOR 8    // with this share of the tree edited a plain forward pass is cheaper
 
-DEFINE_HANDLE(scene_node_handle);
-TYPED_POOL(scene_tree_node, scene_node);
+#define SCENE_NODE_DIRTY (SCENE_NODE_LOCAL_DIRTY | SCENE_NODE_WORLD_DIRTY)
 
-typedef struct render_scene_tree {
-} render_scene_tree;
+static u32 simd_round_up_u32(u32 n) { return (n + SIMD_WIDTH - 1) & ~(u32)(SIMD_WIDTH - 1); }
 
-// What kind of operations and mutations can we perform on the tree?
+static void scene_tree_reserve(scene_tree* tree, u32 capacity) {
+  capacity = simd_round_up_u32(capacity > 0 ? capacity : SIMD_WIDTH);
+  if (capacity <= tree->capacity) return;
+
+  tree->parents = realloc(tree->parents, sizeof(u32) * capacity);
+  tree->first_child = realloc(tree->first_child, sizeof(u32) * capacity);
+  tree->next_sibling = realloc(tree->next_sibling, sizeof(u32) * capacity);
+  tree->flags = realloc(tree->flags, capacity);
+  tree->local_mats = realloc(tree->local_mats, sizeof(mat4) * capacity);
+  tree->world_mats = realloc(tree->world_mats, sizeof(mat4) * capacity);
+  tree->dense_to_node = realloc(tree->dense_to_node, sizeof(u32) * capacity);
+  tree->dirty = realloc(tree->dirty, sizeof(u32) * capacity);
+  tree->frontier[0] = realloc(tree->frontier[0], sizeof(u32) * capacity);
+  tree->frontier[1] = realloc(tree->frontier[1], sizeof(u32) * capacity);
+  tree->changed = realloc(tree->changed, sizeof(scene_node) * capacity);
+  assert(tree->parents && tree->first_child && tree->next_sibling && tree->flags && tree->local_mats &&
+         tree->world_mats && tree->dense_to_node && tree->dirty && tree->frontier[0] && tree->frontier[1] &&
+         tree->changed);
+  memset(tree->flags + tree->capacity, 0, capacity - tree->capacity);
+  transform_soa_reserve(&tree->locals, capacity);
+  tree->capacity = capacity;
+}
+
+scene_tree scene_tree_create(u32 capacity) {
+  scene_tree tree = { .free_node = UINT32_MAX };
+  scene_tree_reserve(&tree, capacity);
+  return tree;
+}
+
+void scene_tree_destroy(scene_tree* tree) {
+  free(tree->parents);
+  free(tree->first_child);
+  free(tree->next_sibling);
+  free(tree->flags);
+  free(tree->local_mats);
+  free(tree->world_mats);
+  free(tree->dense_to_node);
+  free(tree->node_to_dense);
+  free(tree->dirty);
+  free(tree->frontier[0]);
+  free(tree->frontier[1]);
+  free(tree->changed);
+  transform_soa_destroy(&tree->locals);
+  *tree = (scene_tree){ 0 };
+}
+
+static scene_node node_alloc(scene_tree* tree, u32 dense) {
+  u32 raw;
+  if (tree->free_node != UINT32_MAX) {
+    raw = tree->free_node;
+    tree->free_node = tree->node_to_dense[raw];
+  } else {
+    if (tree->node_count == tree->node_capacity) {
+      tree->node_capacity = tree->node_capacity > 0 ? tree->node_capacity * 2 : SIMD_WIDTH;
+      tree->node_to_dense = realloc(tree->node_to_dense, sizeof(u32) * tree->node_capacity);
+      assert(tree->node_to_dense);
+    }
+    raw = tree->node_count++;
+  }
+  tree->node_to_dense[raw] = dense;
+  return (scene_node){ raw };
+}
+
+static void node_free(scene_tree* tree, u32 raw) {
+  tree->node_to_dense[raw] = tree->free_node;
+  tree->free_node = raw;
+}
+
+static u32 node_index(const scene_tree* tree, scene_node node) {
+  assert(scene_tree_contains(tree, node));
+  return tree->node_to_dense[node.raw];
+}
+
+bool scene_tree_contains(const scene_tree* tree, scene_node node) {
+  if (node.raw >= tree->node_count) return false;
+  // free handles hold the next free handle, which can't round-trip through `dense_to_node`
+  u32 dense = tree->node_to_dense[node.raw];
+  return dense < tree->count && tree->dense_to_node[dense] == node.raw &&
+         !(tree->flags[dense] & SCENE_NODE_REMOVED);
+}
+
+static void mark_dirty(scene_tree* tree, u32 idx, scene_node_flags flag) {
+  if (!(tree->flags[idx] & SCENE_NODE_DIRTY)) {
+    tree->dirty[tree->dirty_count++] = idx;
+  }
+  tree->flags[idx] |= flag;
+}
+
+static void link_child(scene_tree* tree, u32 parent, u32 child) {
+  tree->parents[child] = parent;
+  if (parent == SCENE_NO_PARENT) return;
+  tree->next_sibling[child] = tree->first_child[parent];
+  tree->first_child[parent] = child;
+}
+
+static void unlink_child(scene_tree* tree, u32 child) {
+  u32 parent = tree->parents[child];
+  if (parent == SCENE_NO_PARENT) return;
+  u32* link = &tree->first_child[parent];
+  while (*link != child) link = &tree->next_sibling[*link];
+  *link = tree->next_sibling[child];
+}
+
+/** @brief Next node in a depth-first walk of `root`'s subtree or `SCENE_NO_PARENT` when done. Walks with the
+           parent/child/sibling indices so needs no stack, and doesn't descend below removed nodes */
+static u32 subtree_next(const scene_tree* tree, u32 root, u32 node) {
+  if (!(tree->flags[node] & SCENE_NODE_REMOVED) && tree->first_child[node] != SCENE_NO_PARENT) {
+    return tree->first_child[node];
+  }
+  while (node != root && tree->next_sibling[node] == SCENE_NO_PARENT) node = tree->parents[node];
+  return node == root ? SCENE_NO_PARENT : tree->next_sibling[node];
+}
+
+/** @brief appends a slot, the caller fills in everything but the local transform */
+static u32 slot_push(scene_tree* tree, transform local) {
+  if (tree->count == tree->capacity) {
+    scene_tree_reserve(tree, tree->capacity * 2);
+  }
+  u32 idx = tree->count++;
+  size_t soa_idx = transform_soa_push(&tree->locals, local);
+  assert(soa_idx == idx);
+  (void)soa_idx;
+  tree->flags[idx] = 0;
+  tree->first_child[idx] = SCENE_NO_PARENT;
+  tree->next_sibling[idx] = SCENE_NO_PARENT;
+  return idx;
+}
+
+scene_node scene_tree_add(scene_tree* tree, scene_node parent, transform local) {
+  u32 parent_idx = parent.raw == SCENE_NODE_NONE.raw ? SCENE_NO_PARENT : node_index(tree, parent);
+  u32 idx = slot_push(tree, local);
+  scene_node node = node_alloc(tree, idx);
+
+  // appending keeps the order topological as the parent already exists
+  link_child(tree, parent_idx, idx);
+  tree->world_mats[idx] = mat4_ident();
+  tree->dense_to_node[idx] = node.raw;
+  mark_dirty(tree, idx, SCENE_NODE_LOCAL_DIRTY);
+  return node;
+}
+
+void scene_tree_remove(scene_tree* tree, scene_node node) {
+  u32 root = node_index(tree, node);
+  for (u32 i = root; i != SCENE_NO_PARENT;) {
+    u32 next = subtree_next(tree, root, i);  // before flagging, or the walk won't descend
+    tree->flags[i] |= SCENE_NODE_REMOVED;
+    tree->removed_count++;
+    i = next;
+  }
+  unlink_child(tree, root);
+}
+
+void scene_tree_set_parent(scene_tree* tree, scene_node node, scene_node parent) {
+  u32 idx = node_index(tree, node);
+  u32 parent_idx = parent.raw == SCENE_NODE_NONE.raw ? SCENE_NO_PARENT : node_index(tree, parent);
+  unlink_child(tree, idx);
+
+  if (parent_idx == SCENE_NO_PARENT || parent_idx < idx) {
+    link_child(tree, parent_idx, idx);
+    mark_dirty(tree, idx, SCENE_NODE_WORLD_DIRTY);
+    return;
+  }
+
+  // The new parent comes later so the subtree has to move behind it. Slots are visited in order so parents are
+  // moved before their children
+  u32 end = tree->count;
+  for (u32 i = idx; i != SCENE_NO_PARENT; i = subtree_next(tree, idx, i)) {
+    assert(i != parent_idx && "can't parent a node to one of its descendants");
+    tree->flags[i] |= SCENE_NODE_MARKED;
+  }
+
+  for (u32 i = idx; i < end; i++) {
+    if (!(tree->flags[i] & SCENE_NODE_MARKED)) continue;
+
+    u8 flags = tree->flags[i] & ~SCENE_NODE_MARKED;
+    u32 to = slot_push(tree, transform_soa_get(&tree->locals, i));
+    // a moved parent's old slot holds its new index (see below)
+    link_child(tree, i == idx ? parent_idx : tree->parents[tree->parents[i]], to);
+    tree->local_mats[to] = tree->local_mats[i];
+    tree->world_mats[to] = tree->world_mats[i];
+    tree->dense_to_node[to] = tree->dense_to_node[i];
+    tree->node_to_dense[tree->dense_to_node[i]] = to;
+    // any dirty list entry for the old slot is dropped as a tombstone, so re-add it
+    tree->flags[to] = flags & ~SCENE_NODE_DIRTY;
+    if (flags & SCENE_NODE_DIRTY) mark_dirty(tree, to, flags & SCENE_NODE_DIRTY);
+
+    // leave a tombstone that doesn't own a handle and forwards to the new slot
+    tree->flags[i] = SCENE_NODE_REMOVED;
+    tree->dense_to_node[i] = UINT32_MAX;
+    tree->parents[i] = to;
+    tree->removed_count++;
+  }
+  mark_dirty(tree, tree->node_to_dense[node.raw], SCENE_NODE_WORLD_DIRTY);
+}
+
+scene_node scene_tree_parent(const scene_tree* tree, scene_node node) {
+  u32 p = tree->parents[node_index(tree, node)];
+  return p == SCENE_NO_PARENT ? SCENE_NODE_NONE : (scene_node){ tree->dense_to_node[p] };
+}
+
+void scene_tree_set_local(scene_tree* tree, scene_node node, transform local) {
+  u32 idx = node_index(tree, node);
+  transform_soa_set(&tree->locals, idx, local);
+  mark_dirty(tree, idx, SCENE_NODE_LOCAL_DIRTY);
+}
+
+transform scene_tree_local(const scene_tree* tree, scene_node node) {
+  return transform_soa_get(&tree->locals, node_index(tree, node));
+}
+
+mat4 scene_tree_world(const scene_tree* tree, scene_node node) { return tree->world_mats[node_index(tree, node)]; }
+
+// --- Propagation
+
+static inline void mat4_mult_into(const mat4* lhs, const mat4* rhs, mat4* out) {
+  f32x4 r0 = f32x4_load(&rhs->data[0]);
+  f32x4 r1 = f32x4_load(&rhs->data[4]);
+  f32x4 r2 = f32x4_load(&rhs->data[8]);
+  f32x4 r3 = f32x4_load(&rhs->data[12]);
+  for (u32 row = 0; row < 4; row++) {
+    const f32* a = &lhs->data[row * 4];
+    f32x4_store(&out->data[row * 4], a[0] * r0 + a[1] * r1 + a[2] * r2 + a[3] * r3);
+  }
+}
+
+static inline void update_world(scene_tree* tree, u32 i) {
+  u32 p = tree->parents[i];
+  if (p == SCENE_NO_PARENT) {
+    tree->world_mats[i] = tree->local_mats[i];
+  } else {
+    mat4_mult_into(&tree->local_mats[i], &tree->world_mats[p], &tree->world_mats[i]);
+  }
+}
+
+/** @brief rebuilds local matrices a SIMD group at a time for every group holding an edited node */
+static void update_local_mats(scene_tree* tree) {
+  for (u32 d = 0; d < tree->dirty_count; d++) {
+    u32 idx = tree->dirty[d];
+    if (!(tree->flags[idx] & SCENE_NODE_LOCAL_DIRTY)) continue;
+
+    u32 group = idx & ~(u32)(SIMD_WIDTH - 1);
+    u32 lanes = tree->count - group < SIMD_WIDTH ? tree->count - group : SIMD_WIDTH;
+    // a view of the SoA starting at this group, offsets are SIMD_WIDTH multiples so alignment is kept
+    transform_soa view = tree->locals;
+    f32** arrays[] = { &view.pos_x, &view.pos_y, &view.pos_z,   &view.rot_x,   &view.rot_y,
+                       &view.rot_z, &view.rot_w, &view.scale_x, &view.scale_y, &view.scale_z };
+    for (u32 c = 0; c < sizeof(arrays) / sizeof(arrays[0]); c++) *arrays[c] += group;
+    view.count -= group;
+    view.capacity -= group;
+    transforms_to_mats(&view, &tree->local_mats[group], lanes);
+
+    // the rest of the group is up to date now too
+    for (u32 l = 0; l < lanes; l++) tree->flags[group + l] &= ~SCENE_NODE_LOCAL_DIRTY;
+  }
+}
+
+/** @brief Reduces the dirty list to the topmost edited nodes so no subtree is visited twice */
+static u32 collect_dirty_roots(scene_tree* tree, u32* roots) {
+  u32 root_count = 0;
+  for (u32 d = 0; d < tree->dirty_count; d++) {
+    u32 idx = tree->dirty[d];
+    if (tree->flags[idx] & SCENE_NODE_REMOVED) continue;
+    bool covered = false;
+    for (u32 p = tree->parents[idx]; p != SCENE_NO_PARENT && !covered; p = tree->parents[p]) {
+      covered = tree->flags[p] & SCENE_NODE_DIRTY;
+    }
+    if (!covered) roots[root_count++] = idx;
+  }
+  return root_count;
+}
+
+typedef struct propagate_job_ctx {
+  scene_tree* tree;
+  const u32* roots;
+  atomic_uint changed_count;
+} propagate_job_ctx;
+
+static void propagate_subtrees(void* data, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  propagate_job_ctx* ctx = data;
+  scene_tree* tree = ctx->tree;
+  scene_node local[SCENE_CHANGED_FLUSH];
+  u32 local_count = 0;
+
+  for (u32 r = start; r < end; r++) {
+    u32 root = ctx->roots[r];
+    for (u32 i = root; i != SCENE_NO_PARENT; i = subtree_next(tree, root, i)) {
+      if (tree->flags[i] & SCENE_NODE_REMOVED) continue;
+      update_world(tree, i);
+
+      local[local_count++] = (scene_node){ tree->dense_to_node[i] };
+      if (local_count == SCENE_CHANGED_FLUSH) {
+        u32 at = atomic_fetch_add_explicit(&ctx->changed_count, local_count, memory_order_relaxed);
+        memcpy(&tree->changed[at], local, sizeof(scene_node) * local_count);
+        local_count = 0;
+      }
+    }
+  }
+  u32 at = atomic_fetch_add_explicit(&ctx->changed_count, local_count, memory_order_relaxed);
+  memcpy(&tree->changed[at], local, sizeof(scene_node) * local_count);
+}
+
+static void scene_tree_compact(scene_tree* tree) {
+  // dense indices shift as we go so hold parents as handles in the meantime
+  for (u32 i = 0; i < tree->count; i++) {
+    if (!(tree->flags[i] & SCENE_NODE_REMOVED) && tree->parents[i] != SCENE_NO_PARENT) {
+      tree->parents[i] = tree->dense_to_node[tree->parents[i]];
+    }
+  }
+
+  // stable so the order stays topological
+  u32 w = 0;
+  for (u32 i = 0; i < tree->count; i++) {
+    u32 raw = tree->dense_to_node[i];
+    if (tree->flags[i] & SCENE_NODE_REMOVED) {
+      if (raw != UINT32_MAX) node_free(tree, raw);
+      continue;
+    }
+    if (w != i) {
+      tree->parents[w] = tree->parents[i];
+      tree->flags[w] = tree->flags[i];
+      tree->local_mats[w] = tree->local_mats[i];
+      tree->world_mats[w] = tree->world_mats[i];
+      tree->dense_to_node[w] = raw;
+      transform_soa_set(&tree->locals, w, transform_soa_get(&tree->locals, i));
+    }
+    tree->node_to_dense[raw] = w;
+    if (tree->parents[w] != SCENE_NO_PARENT) {
+      tree->parents[w] = tree->node_to_dense[tree->parents[w]];  // already moved, parents come first
+    }
+    w++;
+  }
+
+  memset(tree->flags + w, 0, tree->count - w);
+  tree->count = w;
+  tree->locals.count = w;
+  tree->removed_count = 0;
+
+  // rebuild the child lists back to front so siblings keep their relative order
+  for (u32 i = 0; i < w; i++) tree->first_child[i] = SCENE_NO_PARENT;
+  for (u32 i = w; i-- > 0;) link_child(tree, tree->parents[i], i);
+}
+
+/** @brief Forward pass over the whole tree. Walking the arrays in order beats chasing child links once a large part
+           of the tree is dirty anyway */
+static void propagate_linear(scene_tree* tree) {
+  u32* parents = tree->parents;
+  u8* flags = tree->flags;
+  tree->changed_count = 0;
+
+  for (u32 d = 0; d < tree->dirty_count; d++) {
+    if (flags[tree->dirty[d]] & SCENE_NODE_LOCAL_DIRTY) flags[tree->dirty[d]] |= SCENE_NODE_WORLD_DIRTY;
+  }
+  update_local_mats(tree);
+
+  // parents always come first so their flags are final by the time we reach a child
+  for (u32 i = 0; i < tree->count; i++) {
+    u32 p = parents[i];
+    u8 f = flags[i];
+    if (p != SCENE_NO_PARENT) f |= flags[p] & SCENE_NODE_WORLD_DIRTY;
+    flags[i] = f;
+    if ((f & (SCENE_NODE_WORLD_DIRTY | SCENE_NODE_REMOVED)) == SCENE_NODE_WORLD_DIRTY) {
+      update_world(tree, i);
+      tree->changed[tree->changed_count++] = (scene_node){ tree->dense_to_node[i] };
+    }
+  }
+
+  const u8 keep = (u8)~SCENE_NODE_DIRTY;
+  for (u32 i = 0; i < tree->count; i++) flags[i] &= keep;
+}
+
+static void propagate_incremental(scene_tree* tree) {
+  u32* roots = tree->frontier[0];
+  u32 root_count = collect_dirty_roots(tree, roots);
+  update_local_mats(tree);
+
+  // A single dirty root (e.g. the whole level moving) would leave one worker doing everything, so walk the top
+  // levels serially until there are enough independent subtrees to share out
+  u32 target = job_system_thread_count() > 1 ? job_system_thread_count() * SCENE_FRONTIER_PER_THREAD : 0;
+  tree->changed_count = 0;
+  u32 next_frontier = 1;
+  while (root_count > 0 && root_count < target) {
+    u32* next = tree->frontier[next_frontier];
+    u32 next_count = 0;
+    for (u32 r = 0; r < root_count; r++) {
+      u32 i = roots[r];
+      update_world(tree, i);
+      tree->changed[tree->changed_count++] = (scene_node){ tree->dense_to_node[i] };
+      for (u32 c = tree->first_child[i]; c != SCENE_NO_PARENT; c = tree->next_sibling[c]) {
+        if (!(tree->flags[c] & SCENE_NODE_REMOVED)) next[next_count++] = c;
+      }
+    }
+    roots = next;
+    root_count = next_count;
+    next_frontier ^= 1;
+  }
+
+  propagate_job_ctx ctx = { .tree = tree, .roots = roots };
+  atomic_init(&ctx.changed_count, tree->changed_count);
+  jobs_parallel_for(root_count, 1, propagate_subtrees, &ctx);
+  tree->changed_count = atomic_load(&ctx.changed_count);
+
+  for (u32 d = 0; d < tree->dirty_count; d++) tree->flags[tree->dirty[d]] &= ~SCENE_NODE_DIRTY;
+}
+
+void scene_tree_propagate(scene_tree* tree) {
+  if (tree->dirty_count * SCENE_LINEAR_PASS_DIVISOR >= tree->count) {
+    propagate_linear(tree);
+  } else {
+    propagate_incremental(tree);
+  }
+  tree->dirty_count = 0;
+
+  if (tree->removed_count > 0 && tree->removed_count * SCENE_COMPACT_DIVISOR >= tree->count) {
+    scene_tree_compact(tree);
+  }
+}
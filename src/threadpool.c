@@ -0,0 +1,172 @@
+// A small job system: a fixed set of worker threads that cooperatively chew through chunks of a parallel-for.
+// The calling thread always participates so work still gets done (serially) when no workers are running.
+
+#include <celeritas.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+NAMESPACED_LOGGER(jobs);
+
+typedef struct job_batch {
+  job_range_fn fn;
+  void* ctx;
+  u32 count;
+  u32 chunk_size;
+  u32 chunk_count;
+  atomic_uint next_chunk;
+  atomic_uint chunks_done;
+} job_batch;
+
+typedef struct job_system {
+  bool running;
+  bool shutting_down;
+  u32 worker_count;
+  pthread_t threads[MAX_JOB_THREADS];
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;     // signalled when a new batch is posted
+  pthread_cond_t done;     // signalled when a batch completes or a worker leaves it
+  pthread_mutex_t submit;  // only one batch is in flight at a time
+  job_batch batch;
+  u64 generation;
+  u32 active_workers;
+} job_system;
+
+static job_system jobs = { 0 };
+static threadlocal bool tls_in_job = false;
+
+static void job_batch_run(job_batch* batch, u32 worker_idx) {
+  u32 chunk;
+  while ((chunk = atomic_fetch_add(&batch->next_chunk, 1)) < batch->chunk_count) {
+    u32 start = chunk * batch->chunk_size;
+    u32 end = start + batch->chunk_size < batch->count ? start + batch->chunk_size : batch->count;
+    batch->fn(batch->ctx, start, end, worker_idx);
+    atomic_fetch_add(&batch->chunks_done, 1);
+  }
+}
+
+static void* job_worker_main(void* arg) {
+  u32 worker_idx = (u32)(uintptr_t)arg;
+  u64 seen_generation = 0;
+  tls_in_job = true;
+
+  pthread_mutex_lock(&jobs.mutex);
+  while (true) {
+    while (jobs.generation == seen_generation && !jobs.shutting_down) {
+      pthread_cond_wait(&jobs.wake, &jobs.mutex);
+    }
+    if (jobs.shutting_down) break;
+    seen_generation = jobs.generation;
+    jobs.active_workers++;
+    pthread_mutex_unlock(&jobs.mutex);
+
+    job_batch_run(&jobs.batch, worker_idx);
+
+    pthread_mutex_lock(&jobs.mutex);
+    jobs.active_workers--;
+    pthread_cond_signal(&jobs.done);
+  }
+  pthread_mutex_unlock(&jobs.mutex);
+
+  return NULL;
+}
+
+bool job_system_init(u32 worker_count) {
+  if (jobs.running) return true;
+
+  if (worker_count == 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    worker_count = cores > 1 ? (u32)cores - 1 : 0;
+  }
+  if (worker_count > MAX_JOB_THREADS - 1) {
+    WARN("Job system has a hard limit of %d threads", MAX_JOB_THREADS);
+    worker_count = MAX_JOB_THREADS - 1;
+  }
+
+  pthread_mutex_init(&jobs.mutex, NULL);
+  pthread_mutex_init(&jobs.submit, NULL);
+  pthread_cond_init(&jobs.wake, NULL);
+  pthread_cond_init(&jobs.done, NULL);
+  jobs.shutting_down = false;
+  jobs.generation = 0;
+  jobs.worker_count = 0;
+
+  for (u32 i = 0; i < worker_count; i++) {
+    // worker index 0 is reserved for the calling thread
+    if (pthread_create(&jobs.threads[i], NULL, job_worker_main, (void*)(uintptr_t)(i + 1)) != 0) {
+      ERROR("OS error creating job thread");
+      break;
+    }
+    jobs.worker_count++;
+  }
+
+  jobs.running = true;
+  INFO("Job system started");
+  return true;
+}
+
+void job_system_shutdown() {
+  if (!jobs.running) return;
+
+  pthread_mutex_lock(&jobs.mutex);
+  jobs.shutting_down = true;
+  pthread_cond_broadcast(&jobs.wake);
+  pthread_mutex_unlock(&jobs.mutex);
+
+  for (u32 i = 0; i < jobs.worker_count; i++) {
+    pthread_join(jobs.threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&jobs.wake);
+  pthread_cond_destroy(&jobs.done);
+  pthread_mutex_destroy(&jobs.mutex);
+  pthread_mutex_destroy(&jobs.submit);
+  jobs = (job_system){ 0 };
+}
+
+u32 job_system_thread_count() { return jobs.running ? jobs.worker_count + 1 : 1; }
+
+void jobs_parallel_for(u32 count, u32 chunk_size, job_range_fn fn, void* ctx) {
+  if (count == 0) return;
+  if (chunk_size == 0) chunk_size = count;
+
+  // Serial fallback: no workers, only one chunk, or we're already inside a job
+  if (!jobs.running || jobs.worker_count == 0 || count <= chunk_size || tls_in_job) {
+    for (u32 start = 0; start < count; start += chunk_size) {
+      u32 end = start + chunk_size < count ? start + chunk_size : count;
+      fn(ctx, start, end, 0);
+    }
+    return;
+  }
+
+  pthread_mutex_lock(&jobs.submit);
+
+  pthread_mutex_lock(&jobs.mutex);
+  // a worker that woke late may still be looking at the previous batch
+  while (jobs.active_workers > 0) {
+    pthread_cond_wait(&jobs.done, &jobs.mutex);
+  }
+  jobs.batch.fn = fn;
+  jobs.batch.ctx = ctx;
+  jobs.batch.count = count;
+  jobs.batch.chunk_size = chunk_size;
+  jobs.batch.chunk_count = (count + chunk_size - 1) / chunk_size;
+  atomic_store(&jobs.batch.next_chunk, 0);
+  atomic_store(&jobs.batch.chunks_done, 0);
+  jobs.generation++;
+  pthread_cond_broadcast(&jobs.wake);
+  pthread_mutex_unlock(&jobs.mutex);
+
+  tls_in_job = true;
+  job_batch_run(&jobs.batch, 0);
+  tls_in_job = false;
+
+  // wait for stragglers. workers that have joined must also leave before the batch can be reused
+  pthread_mutex_lock(&jobs.mutex);
+  while (atomic_load(&jobs.batch.chunks_done) < jobs.batch.chunk_count || jobs.active_workers > 0) {
+    pthread_cond_wait(&jobs.done, &jobs.mutex);
+  }
+  pthread_mutex_unlock(&jobs.mutex);
+
+  pthread_mutex_unlock(&jobs.submit);
+}
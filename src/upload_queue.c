@@ -0,0 +1,121 @@
+/* Batched staging uploads: data is copied into a ring buffer as it's queued and the GPU copies go out together */
+
+#include <celeritas.h>
+
+NAMESPACED_LOGGER(upload);
+
+#define UPLOAD_ALIGNMENT 16
+
+upload_queue upload_queue_create(u64 staging_size, u64 frame_budget) {
+  buf_handle staging = ral_buffer_create(staging_size, NULL);
+  return (upload_queue){ .staging = staging,
+                         .mapped = ral_buffer_mapped(staging),
+                         .capacity = staging_size,
+                         .frame_budget = frame_budget,
+                         .pending = malloc(sizeof(gpu_copy_region) * UPLOAD_QUEUE_MAX_PENDING),
+                         .pending_ring_ends = malloc(sizeof(u64) * UPLOAD_QUEUE_MAX_PENDING),
+                         .pending_first_ticket = 1 };
+}
+
+void upload_queue_destroy(upload_queue* queue) {
+  ral_buffer_destroy(queue->staging);
+  free(queue->pending);
+  free(queue->pending_ring_ends);
+  *queue = (upload_queue){ 0 };
+}
+
+/** @brief reserves contiguous staging space, skipping the gap at the end of the ring if it doesn't fit there */
+static bool upload_reserve(upload_queue* queue, u64 size, u64* out_offset) {
+  if (size > queue->capacity) {
+    ERROR("Upload is bigger than the whole staging buffer");
+    return false;
+  }
+  u64 start = (queue->head + UPLOAD_ALIGNMENT - 1) & ~(u64)(UPLOAD_ALIGNMENT - 1);
+  u64 pos = start % queue->capacity;
+  if (pos + size > queue->capacity) start += queue->capacity - pos;
+
+  if (start + size - queue->tail > queue->capacity) {
+    upload_queue_poll(queue);
+    if (start + size - queue->tail > queue->capacity) return false;
+  }
+  queue->head = start + size;
+  *out_offset = start % queue->capacity;
+  return true;
+}
+
+static upload_ticket upload_enqueue(upload_queue* queue, gpu_copy_region region, const void* data) {
+  if (queue->pending_count == UPLOAD_QUEUE_MAX_PENDING) return 0;
+  if (!upload_reserve(queue, region.size, &region.src_offset)) return 0;
+  memcpy(queue->mapped + region.src_offset, data, region.size);
+
+  u32 i = queue->pending_count++;
+  queue->pending[i] = region;
+  queue->pending_ring_ends[i] = queue->head;
+  return queue->pending_first_ticket + i;
+}
+
+upload_ticket upload_queue_buffer(upload_queue* queue, buf_handle dst, u64 dst_offset, const void* data, u64 size) {
+  gpu_copy_region region = { .kind = COPY_BUFFER_TO_BUFFER, .size = size, .dst_buf = dst, .dst_offset = dst_offset };
+  return upload_enqueue(queue, region, data);
+}
+
+upload_ticket upload_queue_texture(upload_queue* queue, tex_handle dst, u32 width, u32 height, u32 bytes_per_pixel,
+                                   const void* data) {
+  gpu_copy_region region = { .kind = COPY_BUFFER_TO_TEXTURE,
+                             .size = (u64)width * height * bytes_per_pixel,
+                             .dst_tex = dst,
+                             .width = width,
+                             .height = height,
+                             .bytes_per_row = width * bytes_per_pixel };
+  return upload_enqueue(queue, region, data);
+}
+
+static void upload_batch_done(void* user_data, u64 batch_id) {
+  upload_queue* queue = user_data;
+  atomic_store_explicit(&queue->batches[batch_id].done, 1, memory_order_release);
+}
+
+u32 upload_queue_flush(upload_queue* queue) {
+  upload_queue_poll(queue);
+  if (queue->pending_count == 0 || queue->batch_count == UPLOAD_QUEUE_MAX_BATCHES) return 0;
+
+  // always take at least one copy so an upload bigger than the budget can't get stuck
+  u32 n = 0;
+  u64 bytes = 0;
+  while (n < queue->pending_count) {
+    u64 size = queue->pending[n].size;
+    if (n > 0 && queue->frame_budget && bytes + size > queue->frame_budget) break;
+    bytes += size;
+    n++;
+  }
+
+  u32 slot = (queue->batch_first + queue->batch_count) % UPLOAD_QUEUE_MAX_BATCHES;
+  queue->batches[slot] = (upload_batch){ .last_ticket = queue->pending_first_ticket + n - 1,
+                                         .ring_end = queue->pending_ring_ends[n - 1],
+                                         .done = 0 };
+  queue->batch_count++;
+  ral_submit_copies(queue->staging, queue->pending, n, upload_batch_done, queue, slot);
+
+  queue->pending_count -= n;
+  queue->pending_first_ticket += n;
+  memmove(queue->pending, queue->pending + n, sizeof(gpu_copy_region) * queue->pending_count);
+  memmove(queue->pending_ring_ends, queue->pending_ring_ends + n, sizeof(u64) * queue->pending_count);
+  TRACE("Submitted a batch of staging copies");
+  return n;
+}
+
+void upload_queue_poll(upload_queue* queue) {
+  // batches finish in submission order on a single queue so only the oldest needs checking
+  while (queue->batch_count > 0 &&
+         atomic_load_explicit(&queue->batches[queue->batch_first].done, memory_order_acquire)) {
+    upload_batch* batch = &queue->batches[queue->batch_first];
+    queue->tail = batch->ring_end;
+    queue->completed_ticket = batch->last_ticket;
+    queue->batch_first = (queue->batch_first + 1) % UPLOAD_QUEUE_MAX_BATCHES;
+    queue->batch_count--;
+  }
+}
+
+bool upload_queue_is_complete(const upload_queue* queue, upload_ticket ticket) {
+  return ticket != 0 && ticket <= queue->completed_ticket;
+}
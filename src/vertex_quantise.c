@@ -0,0 +1,295 @@
+/* Import-time vertex quantisation: repack float attributes into the compact formats the shaders unpack. Vertices
+   are gathered 8 at a time into component lanes so the arithmetic runs on whole SIMD registers */
+
+#include <celeritas.h>
+
+// macros rather than functions for the same reason as `f32x8_load`
+#define i32x8_splat(s) ((i32x8){ 0 } + (i32)(s))
+#define i32x8_select(mask, a, b) (((a) & (mask)) | ((b) & ~(mask)))
+#define f32x8_select(mask, a, b) ((f32x8)i32x8_select((mask), (i32x8)(a), (i32x8)(b)))
+#define f32x8_abs(v) ((f32x8)((i32x8)(v) & 0x7FFFFFFF))
+#define f32x8_sign_not_zero(v) ((f32x8)(((i32x8)(v) & (i32)0x80000000) | (i32x8)f32x8_splat(1.0f)))
+#define f32x8_round(v) __builtin_convertvector((v) + f32x8_sign_not_zero(v) * 0.5f, i32x8)
+
+typedef f32 component_lanes[4][SIMD_WIDTH];
+
+static u32 attrib_components(vertex_attrib_type type) { return vertex_attrib_size(type) / 4; }
+
+static vertex_attrib_type packed_attrib_type(vertex_attrib_type type, vertex_semantic semantic, bool low_precision) {
+  switch (semantic) {
+    case VERTEX_SEMANTIC_OTHER:
+      return type;
+    case VERTEX_SEMANTIC_POSITION:
+      assert(type == ATTR_F32x3 || type == ATTR_F32x4);
+      return ATTR_U16x4_NORM;
+    case VERTEX_SEMANTIC_NORMAL:
+    case VERTEX_SEMANTIC_TANGENT:
+      assert(type == ATTR_F32x3 || type == ATTR_F32x4);
+      return low_precision ? ATTR_I8x2_NORM : ATTR_I16x2_NORM;
+    case VERTEX_SEMANTIC_TEX_COORD:
+      assert(type == ATTR_F32x2);
+      return ATTR_F16x2;
+    case VERTEX_SEMANTIC_JOINTS:
+      assert(type == ATTR_U32x4 || type == ATTR_I32x4 || type == ATTR_F32x4);
+      return ATTR_U8x4;
+    case VERTEX_SEMANTIC_WEIGHTS:
+      assert(type == ATTR_F32x4);
+      return ATTR_U8x4_NORM;
+  }
+  return type;
+}
+
+/** @brief deinterleaves `n` vertices' float components into lanes, zeroing the lanes past the last vertex */
+static void gather_lanes(component_lanes lanes, const u8* src, u32 stride, u32 components, u32 n) {
+  memset(lanes, 0, sizeof(component_lanes));
+  for (u32 v = 0; v < n; v++) {
+    f32 values[4];
+    memcpy(values, src + (u64)v * stride, sizeof(f32) * components);
+    for (u32 c = 0; c < components; c++) lanes[c][v] = values[c];
+  }
+}
+
+static void encode_positions(u8* out, u32 stride, component_lanes lanes, u32 n, vec3 offset, vec3 inv_scale) {
+  f32 offsets[3] = { offset.x, offset.y, offset.z }, inv_scales[3] = { inv_scale.x, inv_scale.y, inv_scale.z };
+  i32 q[3][SIMD_WIDTH];
+  for (u32 c = 0; c < 3; c++) {
+    f32x8 p = (f32x8_load(lanes[c]) - offsets[c]) * inv_scales[c];
+    p = f32x8_select(p < 0.0f, f32x8_splat(0.0f), p);
+    p = f32x8_select(p > 1.0f, f32x8_splat(1.0f), p);
+    i32x8 qc = f32x8_round(p * 65535.0f);
+    memcpy(q[c], &qc, sizeof(qc));
+  }
+  for (u32 v = 0; v < n; v++) {
+    u16 packed[4] = { (u16)q[0][v], (u16)q[1][v], (u16)q[2][v], 0xFFFF };
+    memcpy(out + (u64)v * stride, packed, sizeof(packed));
+  }
+}
+
+/** @brief Octahedral encoding (Cigolle et al., "A Survey of Efficient Representations for Independent Unit
+           Vectors"): project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper one */
+static void encode_directions(u8* out, u32 stride, component_lanes lanes, u32 n, bool low_precision,
+                              bool bitangent_sign) {
+  f32x8 x = f32x8_load(lanes[0]), y = f32x8_load(lanes[1]), z = f32x8_load(lanes[2]);
+  f32x8 l1 = f32x8_abs(x) + f32x8_abs(y) + f32x8_abs(z);
+  l1 = f32x8_select(l1 > 1e-20f, l1, f32x8_splat(1.0f));  // zero vectors stay zero rather than turning into NaNs
+  x /= l1;
+  y /= l1;
+  z /= l1;
+
+  i32x8 lower = z < 0.0f;
+  f32x8 folded_x = (1.0f - f32x8_abs(y)) * f32x8_sign_not_zero(x);
+  f32x8 folded_y = (1.0f - f32x8_abs(x)) * f32x8_sign_not_zero(y);
+  x = f32x8_select(lower, folded_x, x);
+  y = f32x8_select(lower, folded_y, y);
+
+  f32 max_q = low_precision ? 127.0f : 32767.0f;
+  if (bitangent_sign) {
+    // keep the magnitude at least one step above zero so a negative sign survives quantisation
+    f32x8 w = f32x8_load(lanes[3]);
+    y = y * 0.5f + 0.5f;
+    y = f32x8_select(y < 1.0f / max_q, f32x8_splat(1.0f / max_q), y);
+    y = f32x8_select(w < 0.0f, -y, y);
+  }
+
+  i32 qx[SIMD_WIDTH], qy[SIMD_WIDTH];
+  i32x8 qx_lanes = f32x8_round(x * max_q), qy_lanes = f32x8_round(y * max_q);
+  memcpy(qx, &qx_lanes, sizeof(qx));
+  memcpy(qy, &qy_lanes, sizeof(qy));
+  for (u32 v = 0; v < n; v++) {
+    if (low_precision) {
+      i8 packed[2] = { (i8)qx[v], (i8)qy[v] };
+      memcpy(out + (u64)v * stride, packed, sizeof(packed));
+    } else {
+      i16 packed[2] = { (i16)qx[v], (i16)qy[v] };
+      memcpy(out + (u64)v * stride, packed, sizeof(packed));
+    }
+  }
+}
+
+/** @brief round to nearest even float to half conversion, after Fabian Giesen's `float_to_half_fast3` */
+static void encode_halves(u8* out, u32 stride, component_lanes lanes, u32 n) {
+  const i32 f16_max = (127 + 16) << 23;  // the first float that overflows to infinity
+  const i32 f32_infinity = 255 << 23;
+  const i32 min_normal = 113 << 23;  // smallest float that is a normal half
+  const i32 denorm_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+  u16 halves[2][SIMD_WIDTH];
+  for (u32 c = 0; c < 2; c++) {
+    i32x8 f = (i32x8)f32x8_load(lanes[c]);
+    i32x8 sign = f & (i32)0x80000000;
+    f ^= sign;
+
+    i32x8 special = i32x8_select(f > f32_infinity, i32x8_splat(0x7E00), i32x8_splat(0x7C00));  // NaN or infinity
+    // adding the magic float lines the half's subnormal bits up at the bottom of the mantissa, rounding included
+    i32x8 subnormal = (i32x8)((f32x8)f + (f32x8)i32x8_splat(denorm_magic)) - denorm_magic;
+    i32x8 mantissa_odd = (f >> 13) & 1;
+    i32x8 normal = (f - ((127 - 15) << 23) + 0xFFF + mantissa_odd) >> 13;  // rebias the exponent and round
+
+    i32x8 h = i32x8_select(f < min_normal, subnormal, normal);
+    h = i32x8_select(f >= f16_max, special, h);
+    h |= (sign >> 16) & 0x8000;
+    for (u32 v = 0; v < SIMD_WIDTH; v++) halves[c][v] = (u16)h[v];
+  }
+  for (u32 v = 0; v < n; v++) {
+    u16 packed[2] = { halves[0][v], halves[1][v] };
+    memcpy(out + (u64)v * stride, packed, sizeof(packed));
+  }
+}
+
+static void encode_weights(u8* out, u32 stride, component_lanes lanes, u32 n) {
+  f32x8 w[4];
+  for (u32 c = 0; c < 4; c++) w[c] = f32x8_load(lanes[c]);
+  f32x8 sum = w[0] + w[1] + w[2] + w[3];
+  f32x8 to_unorm = 255.0f / f32x8_select(sum > 1e-20f, sum, f32x8_splat(1.0f));
+
+  i32 q[4][SIMD_WIDTH];
+  for (u32 c = 0; c < 4; c++) {
+    i32x8 qc = __builtin_convertvector(w[c] * to_unorm + 0.5f, i32x8);
+    memcpy(q[c], &qc, sizeof(qc));
+  }
+  for (u32 v = 0; v < n; v++) {
+    i32 total = q[0][v] + q[1][v] + q[2][v] + q[3][v];
+    // rounding can leave the sum a step or two off 255, the heaviest weight absorbs that with the least distortion
+    if (total > 0 && total != 255) {
+      u32 heaviest = 0;
+      for (u32 c = 1; c < 4; c++) heaviest = q[c][v] > q[heaviest][v] ? c : heaviest;
+      q[heaviest][v] += 255 - total;
+    }
+    u8 packed[4];
+    for (u32 c = 0; c < 4; c++) packed[c] = (u8)(q[c][v] < 0 ? 0 : q[c][v] > 255 ? 255 : q[c][v]);
+    memcpy(out + (u64)v * stride, packed, sizeof(packed));
+  }
+}
+
+static void encode_joints(u8* out, u32 stride, const u8* src, u32 src_stride, vertex_attrib_type type, u32 n) {
+  for (u32 v = 0; v < n; v++) {
+    u32 joints[4];
+    memcpy(joints, src + (u64)v * src_stride, sizeof(joints));
+    u8 packed[4];
+    for (u32 c = 0; c < 4; c++) {
+      f32 as_float;
+      memcpy(&as_float, &joints[c], sizeof(f32));
+      u32 joint = type == ATTR_F32x4 ? (u32)as_float : joints[c];
+      assert(joint <= 0xFF);
+      packed[c] = (u8)joint;
+    }
+    memcpy(out + (u64)v * stride, packed, sizeof(packed));
+  }
+}
+
+void geo_quantise(geometry* geo, const vertex_quantise_desc* desc) {
+  const vertex_desc* src_format = &geo->vertex_format;
+  u32 src_stride = vertex_desc_stride(src_format);
+  vertex_desc dst_format = { .label = src_format->label, .attribute_count = src_format->attribute_count };
+
+  u32 src_offsets[MAX_VERTEX_ATTRIBUTES], dst_offsets[MAX_VERTEX_ATTRIBUTES];
+  u32 src_offset = 0, dst_offset = 0;
+  i32 position = -1;
+  for (u32 a = 0; a < src_format->attribute_count; a++) {
+    vertex_attrib_type type = src_format->attributes[a];
+    dst_format.attributes[a] = packed_attrib_type(type, desc->semantics[a], desc->low_precision_directions);
+    src_offsets[a] = src_offset;
+    dst_offsets[a] = dst_offset;
+    src_offset += vertex_attrib_size(type);
+    dst_offset += vertex_attrib_size(dst_format.attributes[a]);
+    if (desc->semantics[a] == VERTEX_SEMANTIC_POSITION) {
+      assert(position < 0);
+      position = (i32)a;
+    }
+  }
+  dst_format.padding = (4 - dst_offset % 4) % 4;  // keeps every vertex 4 byte aligned after 8 bit directions
+  u32 dst_stride = dst_offset + dst_format.padding;
+
+  const u8* src = geo->vertex_data;
+  vec3 lo = VEC3_ZERO, extent = VEC3_ZERO, inv_extent = VEC3_ZERO;
+  if (position >= 0 && geo->vertex_count > 0) {
+    vec3 hi;
+    memcpy(&lo, src + src_offsets[position], sizeof(vec3));
+    hi = lo;
+    for (u32 v = 1; v < geo->vertex_count; v++) {
+      vec3 p;
+      memcpy(&p, src + (u64)v * src_stride + src_offsets[position], sizeof(vec3));
+      lo = vec3(fminf(lo.x, p.x), fminf(lo.y, p.y), fminf(lo.z, p.z));
+      hi = vec3(fmaxf(hi.x, p.x), fmaxf(hi.y, p.y), fmaxf(hi.z, p.z));
+    }
+    extent = vec3_sub(hi, lo);
+    // a flat axis quantises to zero rather than dividing by it
+    inv_extent = vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                      extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+  }
+
+  // zeroed so the padding bytes are deterministic, `geo_optimise` hashes whole vertices
+  u8* dst = calloc(geo->vertex_count > 0 ? geo->vertex_count : 1, dst_stride);
+  assert(dst);
+  component_lanes lanes;
+  for (u32 first = 0; first < geo->vertex_count; first += SIMD_WIDTH) {
+    u32 n = geo->vertex_count - first < SIMD_WIDTH ? geo->vertex_count - first : SIMD_WIDTH;
+    for (u32 a = 0; a < src_format->attribute_count; a++) {
+      vertex_attrib_type type = src_format->attributes[a];
+      const u8* in = src + (u64)first * src_stride + src_offsets[a];
+      u8* out = dst + (u64)first * dst_stride + dst_offsets[a];
+      switch (desc->semantics[a]) {
+        case VERTEX_SEMANTIC_OTHER:
+          for (u32 v = 0; v < n; v++) {
+            memcpy(out + (u64)v * dst_stride, in + (u64)v * src_stride, vertex_attrib_size(type));
+          }
+          break;
+        case VERTEX_SEMANTIC_POSITION:
+          gather_lanes(lanes, in, src_stride, 3, n);
+          encode_positions(out, dst_stride, lanes, n, lo, inv_extent);
+          break;
+        case VERTEX_SEMANTIC_NORMAL:
+        case VERTEX_SEMANTIC_TANGENT: {
+          bool bitangent_sign = desc->semantics[a] == VERTEX_SEMANTIC_TANGENT && type == ATTR_F32x4;
+          gather_lanes(lanes, in, src_stride, attrib_components(type), n);
+          encode_directions(out, dst_stride, lanes, n, desc->low_precision_directions, bitangent_sign);
+          break;
+        }
+        case VERTEX_SEMANTIC_TEX_COORD:
+          gather_lanes(lanes, in, src_stride, 2, n);
+          encode_halves(out, dst_stride, lanes, n);
+          break;
+        case VERTEX_SEMANTIC_JOINTS:
+          encode_joints(out, dst_stride, in, src_stride, type, n);
+          break;
+        case VERTEX_SEMANTIC_WEIGHTS:
+          gather_lanes(lanes, in, src_stride, 4, n);
+          encode_weights(out, dst_stride, lanes, n);
+          break;
+      }
+    }
+  }
+
+  free(geo->vertex_data);
+  geo->vertex_data = dst;
+  geo->vertex_format = dst_format;
+  if (position >= 0) {
+    geo->position_offset = lo;
+    geo->position_scale = extent;
+  }
+}
+
+vec3 oct_decode(f32 x, f32 y) {
+  f32 z = 1.0f - fabsf(x) - fabsf(y);
+  if (z < 0.0f) {
+    f32 folded_x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    f32 folded_y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = folded_x;
+    y = folded_y;
+  }
+  return vec3_normalise(vec3(x, y, z));
+}
+
+f32 f16_to_f32(u16 half) {
+  u32 sign = (u32)(half & 0x8000) << 16;
+  u32 exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+  if (exponent == 0) {
+    f32 value = ldexpf((f32)mantissa, -24);
+    return sign ? -value : value;
+  }
+  // rebias the exponent, infinities and NaNs keep the float's maximum one
+  u32 bits = sign | (exponent == 0x1F ? 0x7F800000 : (exponent + 112) << 23) | (mantissa << 13);
+  f32 value;
+  memcpy(&value, &bits, sizeof(f32));
+  return value;
+}
@@ -0,0 +1,16 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(AabbTree) {
+  RUN_TEST_CASE(AabbTree, StaysShallow);
+  RUN_TEST_CASE(AabbTree, BoxQueryFindsOverlaps);
+  RUN_TEST_CASE(AabbTree, RayCastFindsClosest);
+  RUN_TEST_CASE(AabbTree, SmallMovesStayInsideTheFatBox);
+  RUN_TEST_CASE(AabbTree, RemovedProxiesAreNotReported);
+  RUN_TEST_CASE(AabbTree, RefitTightensNodesThatRotationsMovedUnderCleanParents);
+  RUN_TEST_CASE(AabbTree, RefitTightensNodesAnInsertPushedUnderANewParent);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(AabbTree); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,144 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define BOX_COUNT 512
+
+static aabb_tree tree;
+static bbox_3d boxes[BOX_COUNT];
+static u32 proxies[BOX_COUNT];
+
+TEST_GROUP(AabbTree);
+
+static bbox_3d unit_box_at(f32 x, f32 y, f32 z) { return (bbox_3d){ vec3(x, y, z), vec3(x + 1, y + 1, z + 1) }; }
+
+TEST_SETUP(AabbTree) {
+  tree = aabb_tree_create(BOX_COUNT, 0.1f);
+  // an 8x8x8 grid with gaps of one unit between boxes
+  for (u32 i = 0; i < BOX_COUNT; i++) {
+    boxes[i] = unit_box_at((f32)(i % 8) * 2, (f32)((i / 8) % 8) * 2, (f32)(i / 64) * 2);
+    proxies[i] = aabb_tree_insert(&tree, boxes[i], i);
+  }
+}
+
+TEST_TEAR_DOWN(AabbTree) { aabb_tree_destroy(&tree); }
+
+static u32 hit_count;
+static bool count_hit(void* user, u32 proxy, u64 user_data) {
+  (void)user, (void)proxy, (void)user_data;
+  hit_count++;
+  return true;
+}
+
+static u32 closest;
+static f32 record_closest(void* user, u32 proxy, u64 user_data, f32 max_t) {
+  (void)user, (void)proxy;
+  // fat boxes only ever start the ray early so the tight box decides
+  f32 t = boxes[user_data].min.x + 5.0f;  // the ray starts at x = -5 with a unit direction
+  if (t < max_t) {
+    closest = (u32)user_data;
+    return t;
+  }
+  return max_t;
+}
+
+TEST(AabbTree, StaysShallow) {
+  // a balanced tree over 512 leaves is 9 deep, rotations should keep us close to that
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(18, aabb_tree_height(&tree));
+  TEST_ASSERT_EQUAL_UINT32(BOX_COUNT, tree.proxy_count);
+}
+
+TEST(AabbTree, BoxQueryFindsOverlaps) {
+  hit_count = 0;
+  // covers the 2x2x2 block of boxes in the corner
+  aabb_tree_query_aabb(&tree, (bbox_3d){ vec3(0.5f, 0.5f, 0.5f), vec3(2.5f, 2.5f, 2.5f) }, count_hit, NULL);
+  TEST_ASSERT_EQUAL_UINT32(8, hit_count);
+
+  hit_count = 0;
+  aabb_tree_query_sphere(&tree, vec3(8.5f, 8.5f, 8.5f), 0.4f, count_hit, NULL);
+  TEST_ASSERT_EQUAL_UINT32(1, hit_count);
+}
+
+TEST(AabbTree, RayCastFindsClosest) {
+  closest = UINT32_MAX;
+  // along the x axis through the middle of the first row of boxes
+  aabb_tree_ray_cast(&tree, vec3(-5, 0.5f, 0.5f), vec3(1, 0, 0), 100, record_closest, NULL);
+  TEST_ASSERT_EQUAL_UINT32(0, closest);
+}
+
+TEST(AabbTree, SmallMovesStayInsideTheFatBox) {
+  bbox_3d nudged = boxes[0];
+  nudged.min.x += 0.05f;
+  nudged.max.x += 0.05f;
+  TEST_ASSERT_FALSE(aabb_tree_move(&tree, proxies[0], nudged));
+
+  bbox_3d far = unit_box_at(100, 100, 100);
+  TEST_ASSERT_TRUE(aabb_tree_move(&tree, proxies[0], far));
+  aabb_tree_refit(&tree);
+
+  hit_count = 0;
+  aabb_tree_query_aabb(&tree, far, count_hit, NULL);
+  TEST_ASSERT_EQUAL_UINT32(1, hit_count);
+  TEST_ASSERT_EQUAL_UINT64(0, aabb_tree_user_data(&tree, proxies[0]));
+}
+
+TEST(AabbTree, RemovedProxiesAreNotReported) {
+  for (u32 i = 0; i < BOX_COUNT; i += 2) aabb_tree_remove(&tree, proxies[i]);
+  hit_count = 0;
+  aabb_tree_query_aabb(&tree, (bbox_3d){ vec3(-1, -1, -1), vec3(100, 100, 100) }, count_hit, NULL);
+  TEST_ASSERT_EQUAL_UINT32(BOX_COUNT / 2, hit_count);
+}
+
+static bool box_equal(bbox_3d a, bbox_3d b) {
+  return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z && a.max.x == b.max.x &&
+         a.max.y == b.max.y && a.max.z == b.max.z;
+}
+
+/** @brief checks every internal node below `idx` is refitted exactly around its children. Returns the leaf count */
+static u32 assert_tight(u32 idx) {
+  const aabb_tree_node* n = &tree.nodes[idx];
+  if (n->child1 == AABB_TREE_NULL) return 1;
+  TEST_ASSERT_EQUAL_UINT16(0, n->flags);
+  const aabb_tree_node* c1 = &tree.nodes[n->child1];
+  const aabb_tree_node* c2 = &tree.nodes[n->child2];
+  TEST_ASSERT_EQUAL_UINT32(idx, c1->parent);
+  TEST_ASSERT_EQUAL_UINT32(idx, c2->parent);
+  bbox_3d fit = { vec3(fminf(c1->box.min.x, c2->box.min.x), fminf(c1->box.min.y, c2->box.min.y),
+                       fminf(c1->box.min.z, c2->box.min.z)),
+                  vec3(fmaxf(c1->box.max.x, c2->box.max.x), fmaxf(c1->box.max.y, c2->box.max.y),
+                       fmaxf(c1->box.max.z, c2->box.max.z)) };
+  TEST_ASSERT_TRUE(box_equal(fit, n->box));
+  return assert_tight(n->child1) + assert_tight(n->child2);
+}
+
+TEST(AabbTree, RefitTightensNodesThatRotationsMovedUnderCleanParents) {
+  // moves leave their ancestors grown and flagged, then inserts and removes rotate the tree around them
+  for (u32 i = 0; i < BOX_COUNT; i += 8) {
+    boxes[i] = unit_box_at(boxes[i].min.x + 7, boxes[i].min.y, boxes[i].min.z - 5);
+    TEST_ASSERT_TRUE(aabb_tree_move(&tree, proxies[i], boxes[i]));
+  }
+  for (u32 i = 1; i < BOX_COUNT; i += 4) {
+    aabb_tree_remove(&tree, proxies[i]);
+    boxes[i] = unit_box_at(boxes[i].min.z, boxes[i].min.x + 0.5f, boxes[i].min.y);
+    proxies[i] = aabb_tree_insert(&tree, boxes[i], i);
+  }
+  aabb_tree_refit(&tree);
+
+  TEST_ASSERT_EQUAL_UINT32(BOX_COUNT, assert_tight(tree.root));
+}
+
+TEST(AabbTree, RefitTightensNodesAnInsertPushedUnderANewParent) {
+  aabb_tree_destroy(&tree);
+  tree = aabb_tree_create(16, 0.1f);
+  u32 moved = 0;
+  for (u32 i = 0; i < 4; i++) moved = aabb_tree_insert(&tree, unit_box_at((f32)i, 0, 0), i);
+
+  // there and back again leaves the old root grown out to x=50 and flagged
+  aabb_tree_move(&tree, moved, unit_box_at(50, 0, 0));
+  aabb_tree_move(&tree, moved, unit_box_at(3, 0, 0));
+  // far enough away that the old root becomes its sibling under a new root
+  aabb_tree_insert(&tree, unit_box_at(-200, 0, 0), 4);
+  aabb_tree_refit(&tree);
+
+  TEST_ASSERT_EQUAL_UINT32(5, assert_tight(tree.root));
+}
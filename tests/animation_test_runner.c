@@ -0,0 +1,15 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Animation) {
+  RUN_TEST_CASE(Animation, SeekFindsTheKeyAtOrBeforeTheTime);
+  RUN_TEST_CASE(Animation, LinearAndStepTracks);
+  RUN_TEST_CASE(Animation, CubicSplinesFollowTheirTangents);
+  RUN_TEST_CASE(Animation, RotationsTrackSlerp);
+  RUN_TEST_CASE(Animation, RotationsTakeTheShorterArc);
+  RUN_TEST_CASE(Animation, PlayerLoopsAndPosesTheArmature);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Animation); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
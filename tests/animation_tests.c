@@ -0,0 +1,151 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define TRACKS 11  // more than one SIMD batch with a ragged tail
+
+static u8 arena_buf[1 << 16];
+static arena frame_arena;
+static animation_track tracks[TRACKS];
+static animation_clip clip;
+
+TEST_GROUP(Animation);
+
+TEST_SETUP(Animation) {
+  frame_arena = arena_create(arena_buf, sizeof(arena_buf));
+  clip = (animation_clip){ .name = "Test", .tracks = tracks, .track_count = 0, .duration = 1.0f };
+}
+
+TEST_TEAR_DOWN(Animation) {
+  for (u32 i = 0; i < clip.track_count; i++) animation_track_destroy(&tracks[i]);
+}
+
+static const f32 two_keys[2] = { 0.0f, 1.0f };
+
+static void add_track(keyframe_kind kind, interpolation interp, joint_idx target, u32 components, const f32* values) {
+  tracks[clip.track_count++] = animation_track_create(kind, interp, target, components, two_keys, values, 2);
+}
+
+static quat rotation_track_values[2];
+
+static void add_rotation_track(joint_idx target, f32 angle) {
+  rotation_track_values[0] = quat_ident();
+  rotation_track_values[1] = quat_from_axis_angle(VEC3_Y, angle, true);
+  add_track(Keyframe_Rotation, Interpolation_Linear, target, 4, (const f32*)rotation_track_values);
+}
+
+static void sample_at(animation_player* player, f32 t) {
+  player->time = t;
+  arena_free_all(&frame_arena);
+  animation_player_sample(player, &frame_arena);
+}
+
+TEST(Animation, SeekFindsTheKeyAtOrBeforeTheTime) {
+  f32 times[100];
+  f32 values[100];
+  for (u32 k = 0; k < 100; k++) times[k] = values[k] = (f32)k * 0.1f;
+  animation_track track = animation_track_create(Keyframe_Weights, Interpolation_Linear, 0, 1, times, values, 100);
+
+  TEST_ASSERT_EQUAL_UINT32(50, animation_track_seek(&track, 0, 5.05f));   // a jump binary searches
+  TEST_ASSERT_EQUAL_UINT32(51, animation_track_seek(&track, 50, 5.15f));  // playing forwards steps
+  TEST_ASSERT_EQUAL_UINT32(12, animation_track_seek(&track, 51, 1.25f));  // and going backwards starts over
+  TEST_ASSERT_EQUAL_UINT32(0, animation_track_seek(&track, 12, -1.0f));
+  TEST_ASSERT_EQUAL_UINT32(99, animation_track_seek(&track, 12, 100.0f));
+  animation_track_destroy(&track);
+}
+
+TEST(Animation, LinearAndStepTracks) {
+  f32 translation[6] = { 0, 0, 0, 2, 4, 6 };
+  add_track(Keyframe_Translation, Interpolation_Linear, 0, 3, translation);
+  add_track(Keyframe_Scale, Interpolation_Step, 0, 3, translation);
+  animation_player player = animation_player_create(&clip, false);
+
+  sample_at(&player, 0.25f);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.5f, player.outputs[0][0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.0f, player.outputs[1][0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6f, 1.5f, player.outputs[2][0]);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, player.outputs[2][1]);
+
+  sample_at(&player, 1.0f);
+  TEST_ASSERT_EQUAL_FLOAT(6.0f, player.outputs[2][0]);
+  TEST_ASSERT_EQUAL_FLOAT(6.0f, player.outputs[2][1]);
+  animation_player_destroy(&player);
+}
+
+TEST(Animation, CubicSplinesFollowTheirTangents) {
+  // in tangent, value, out tangent per key
+  f32 spline[6] = { 0.0f, 1.0f, 2.0f, -3.0f, 5.0f, 0.0f };
+  add_track(Keyframe_Weights, Interpolation_Cubic, 0, 1, spline);
+  animation_player player = animation_player_create(&clip, false);
+
+  for (f32 t = 0.0f; t <= 1.0f; t += 0.125f) {
+    sample_at(&player, t);
+    f32 t2 = t * t, t3 = t2 * t;
+    f32 expected = (2 * t3 - 3 * t2 + 1) * 1.0f + (t3 - 2 * t2 + t) * 2.0f + (-2 * t3 + 3 * t2) * 5.0f +
+                   (t3 - t2) * -3.0f;
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, expected, player.outputs[0][0]);
+  }
+  animation_player_destroy(&player);
+}
+
+TEST(Animation, RotationsTrackSlerp) {
+  f32 angles[TRACKS];
+  for (u32 i = 0; i < TRACKS; i++) {
+    angles[i] = 0.2f + 0.25f * (f32)i;  // up to about 150 degrees between keys
+    add_rotation_track(0, angles[i]);
+  }
+  animation_player player = animation_player_create(&clip, false);
+
+  for (f32 t = 0.0f; t <= 1.0f; t += 0.1f) {
+    sample_at(&player, t);
+    for (u32 i = 0; i < TRACKS; i++) {
+      quat expected = quat_slerp(quat_ident(), quat_from_axis_angle(VEC3_Y, angles[i], true), t);
+      quat q = { player.outputs[0][i], player.outputs[1][i], player.outputs[2][i], player.outputs[3][i] };
+      f32 dot = fabsf(q.x * expected.x + q.y * expected.y + q.z * expected.z + q.w * expected.w);
+      TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+      TEST_ASSERT_TRUE(dot > 0.99999f);
+    }
+  }
+  animation_player_destroy(&player);
+}
+
+TEST(Animation, RotationsTakeTheShorterArc) {
+  add_rotation_track(0, 0.5f);
+  // the same rotation with every component negated, which should not send it the long way round
+  rotation_track_values[1] = (quat){ -rotation_track_values[1].x, -rotation_track_values[1].y,
+                                     -rotation_track_values[1].z, -rotation_track_values[1].w };
+  add_track(Keyframe_Rotation, Interpolation_Linear, 0, 4, (const f32*)rotation_track_values);
+  animation_player player = animation_player_create(&clip, false);
+  player.nlerp_rotations = true;
+
+  sample_at(&player, 0.5f);
+  for (u32 c = 0; c < 4; c++) TEST_ASSERT_FLOAT_WITHIN(1e-6f, player.outputs[c][0], player.outputs[c][1]);
+  animation_player_destroy(&player);
+}
+
+TEST(Animation, PlayerLoopsAndPosesTheArmature) {
+  joint_idx parents[2] = { JOINT_NO_PARENT, 0 };
+  transform bind_pose[2] = { transform_create(VEC3_ZERO, quat_ident(), VEC3_ONES),
+                             transform_create(VEC3_ZERO, quat_ident(), VEC3_ONES) };
+  mat4 inverse_bind[2] = { mat4_ident(), mat4_ident() };
+  armature arm = armature_create(parents, bind_pose, inverse_bind, 2, NULL);
+
+  f32 translation[6] = { 0, 0, 0, 0, 8, 0 };
+  add_track(Keyframe_Translation, Interpolation_Linear, 1, 3, translation);
+  add_rotation_track(1, PI / 2.0f);
+  animation_player player = animation_player_create(&clip, true);
+
+  animation_player_advance(&player, 0.75f);
+  animation_player_advance(&player, 0.5f);  // wraps around to 0.25
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.25f, player.time);
+  animation_player_sample(&player, &frame_arena);
+  animation_player_apply(&player, &arm);
+
+  transform pose = transform_soa_get(&arm.local_pose, 1);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 2.0f, pose.position.y);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, sinf(PI / 16.0f), pose.rotation.y);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, transform_soa_get(&arm.local_pose, 0).position.y);
+
+  animation_player_destroy(&player);
+  armature_destroy(&arm);
+}
@@ -0,0 +1,14 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Armature) {
+  RUN_TEST_CASE(Armature, JointsAreSortedParentsFirst);
+  RUN_TEST_CASE(Armature, BindPoseGivesIdentityPalette);
+  RUN_TEST_CASE(Armature, ChildrenFollowTheirParent);
+  RUN_TEST_CASE(Armature, SharedArmaturesAreEvaluatedOnce);
+  RUN_TEST_CASE(Armature, SkinnedBatchesPointAtTheirPalette);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Armature); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
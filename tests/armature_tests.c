@@ -0,0 +1,107 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+static u8 arena_buf[1 << 16];
+static arena frame_arena;
+
+TEST_GROUP(Armature);
+
+TEST_SETUP(Armature) { frame_arena = arena_create(arena_buf, sizeof(arena_buf)); }
+
+TEST_TEAR_DOWN(Armature) {}
+
+static transform translation(f32 x, f32 y, f32 z) { return transform_create(vec3(x, y, z), quat_ident(), VEC3_ONES); }
+
+static void assert_translation(mat4 m, f32 x, f32 y, f32 z) {
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, x, m.data[12]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, y, m.data[13]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, z, m.data[14]);
+}
+
+/** @brief a chain of 4 joints one unit apart along x, listed leaf first like an exporter might */
+static armature chain(joint_idx* remap) {
+  joint_idx parents[4] = { 1, 2, 3, JOINT_NO_PARENT };
+  transform bind_pose[4] = { translation(1, 0, 0), translation(1, 0, 0), translation(1, 0, 0), translation(0, 0, 0) };
+  // joint j sits at x = 3 - j in the bind pose so its inverse bind matrix moves it back to the origin
+  mat4 inverse_bind[4];
+  for (u32 j = 0; j < 4; j++) inverse_bind[j] = mat4_translation(vec3(-(f32)(3 - j), 0, 0));
+  return armature_create(parents, bind_pose, inverse_bind, 4, remap);
+}
+
+TEST(Armature, JointsAreSortedParentsFirst) {
+  joint_idx remap[4];
+  armature arm = chain(remap);
+
+  TEST_ASSERT_EQUAL_UINT32(JOINT_NO_PARENT, arm.parents[0]);
+  for (u32 j = 1; j < arm.joint_count; j++) TEST_ASSERT_TRUE(arm.parents[j] < j);
+  // the root was listed last and the leaf first
+  TEST_ASSERT_EQUAL_UINT32(0, remap[3]);
+  TEST_ASSERT_EQUAL_UINT32(3, remap[0]);
+  armature_destroy(&arm);
+}
+
+TEST(Armature, BindPoseGivesIdentityPalette) {
+  armature arm = chain(NULL);
+  render_ent ent = { .armature = &arm };
+
+  skinning_palettes palettes = armatures_evaluate_poses(&ent, 1, 0, &frame_arena);
+  TEST_ASSERT_EQUAL_UINT32(4, palettes.count);
+  mat4 ident = mat4_ident();
+  for (u32 j = 0; j < palettes.count; j++) {
+    TEST_ASSERT_FLOAT_ARRAY_WITHIN(1e-5f, ident.data, palettes.matrices[j].data, 16);
+  }
+  assert_translation(arm.model_pose[3], 3, 0, 0);
+  armature_destroy(&arm);
+}
+
+TEST(Armature, ChildrenFollowTheirParent) {
+  armature arm = chain(NULL);
+  render_ent ent = { .armature = &arm };
+  transform bent = transform_soa_get(&arm.local_pose, 1);
+  bent.rotation = (quat){ 0, 0, sinf(PI / 4.0f), cosf(PI / 4.0f) };  // a quarter turn about z
+  transform_soa_set(&arm.local_pose, 1, bent);
+
+  armatures_evaluate_poses(&ent, 1, 0, &frame_arena);
+  assert_translation(arm.model_pose[1], 1, 0, 0);
+  // the rest of the chain carries on along joint 1's rotated x axis
+  const f32* x_axis = arm.model_pose[1].data;
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 0.0f, x_axis[0]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 1.0f, fabsf(x_axis[1]));
+  assert_translation(arm.model_pose[2], 1, x_axis[1], 0);
+  assert_translation(arm.model_pose[3], 1, 2 * x_axis[1], 0);
+  armature_destroy(&arm);
+}
+
+TEST(Armature, SharedArmaturesAreEvaluatedOnce) {
+  armature a = chain(NULL), b = chain(NULL);
+  render_ent ents[4] = { { .armature = &a }, { .armature = NULL }, { .armature = &b }, { .armature = &a } };
+
+  skinning_palettes palettes = armatures_evaluate_poses(ents, 4, 7, &frame_arena);
+  TEST_ASSERT_EQUAL_UINT32(8, palettes.count);
+  TEST_ASSERT_EQUAL_UINT32(0, a.palette_offset);
+  TEST_ASSERT_EQUAL_UINT32(4, b.palette_offset);
+
+  // the next frame evaluates them again
+  palettes = armatures_evaluate_poses(ents, 4, 8, &frame_arena);
+  TEST_ASSERT_EQUAL_UINT32(8, palettes.count);
+  armature_destroy(&a);
+  armature_destroy(&b);
+}
+
+TEST(Armature, SkinnedBatchesPointAtTheirPalette) {
+  armature a = chain(NULL), b = chain(NULL);
+  render_ent ents[2] = { { .armature = &a }, { .armature = &b } };
+  armatures_evaluate_poses(ents, 2, 0, &frame_arena);
+
+  u64 keys[2] = { 0, 0 };
+  u32 items[2] = { 0, 1 };
+  render_queue queue = { .keys = keys, .items = items, .count = 2 };
+  draw_batch_list list = render_queue_build_batches(&queue, ents, NULL, &frame_arena);
+  TEST_ASSERT_EQUAL_UINT32(2, list.batch_count);
+  TEST_ASSERT_EQUAL_UINT32(0, list.batches[0].first_joint);
+  TEST_ASSERT_EQUAL_UINT32(4, list.batches[1].first_joint);
+  TEST_ASSERT_EQUAL_UINT32(4, list.batches[1].joint_count);
+  armature_destroy(&a);
+  armature_destroy(&b);
+}
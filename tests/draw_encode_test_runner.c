@@ -0,0 +1,13 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(DrawEncode) {
+  RUN_TEST_CASE(DrawEncode, BatchesBindTheirMaterial);
+  RUN_TEST_CASE(DrawEncode, EachFrameInFlightUploadsInstancesToItsOwnRegion);
+  RUN_TEST_CASE(DrawEncode, EachFrameInFlightBindsPalettesFromItsOwnRegion);
+  RUN_TEST_CASE(DrawEncode, IndirectSegmentsSplitOnMaterial);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(DrawEncode); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,235 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// The encoders only talk to the backend through these, so record the calls instead of drawing anything
+
+typedef enum ral_call_kind {
+  CALL_UPLOAD,
+  CALL_INSTANCE_BUF,
+  CALL_PIPELINE,
+  CALL_UNIFORMS,
+  CALL_TEXTURE,
+  CALL_VERTEX_BUF,
+  CALL_INDEX_BUF,
+  CALL_DRAW,
+  CALL_MULTI_DRAW,
+} ral_call_kind;
+
+typedef struct ral_call {
+  ral_call_kind kind;
+  u32 handle;
+  u64 offset;
+  u32 slot;   // uniform or texture slot, first instance of a draw
+  u32 count;  // bytes uploaded or draws issued
+} ral_call;
+
+#define MAX_CALLS 256
+static ral_call calls[MAX_CALLS];
+static u32 call_count;
+
+static void record(ral_call call) {
+  TEST_ASSERT_TRUE(call_count < MAX_CALLS);
+  calls[call_count++] = call;
+}
+
+void ral_buffer_upload(buf_handle handle, u64 offset, u64 size, const void* data) {
+  (void)data;
+  record((ral_call){ CALL_UPLOAD, handle.raw, offset, 0, (u32)size });
+}
+void ral_encode_set_instance_buf(gpu_encoder* enc, buf_handle buf, u64 offset) {
+  (void)enc;
+  record((ral_call){ CALL_INSTANCE_BUF, buf.raw, offset, 0, 0 });
+}
+void ral_encode_bind_pipeline(gpu_encoder* enc, pipeline_handle pipeline) {
+  (void)enc;
+  record((ral_call){ CALL_PIPELINE, pipeline.raw, 0, 0, 0 });
+}
+void ral_encode_set_uniforms(gpu_encoder* enc, buf_handle buf, u64 offset, u32 slot, shader_stage stages) {
+  (void)enc;
+  (void)stages;
+  record((ral_call){ CALL_UNIFORMS, buf.raw, offset, slot, 0 });
+}
+void ral_encode_set_texture(gpu_encoder* enc, tex_handle texture, u32 slot) {
+  (void)enc;
+  record((ral_call){ CALL_TEXTURE, texture.raw, 0, slot, 0 });
+}
+void ral_encode_set_vertex_buf(gpu_encoder* enc, buf_handle vbuf) {
+  (void)enc;
+  record((ral_call){ CALL_VERTEX_BUF, vbuf.raw, 0, 0, 0 });
+}
+void ral_encode_set_vertex_buf_offset(gpu_encoder* enc, buf_handle vbuf, u64 offset) {
+  (void)enc;
+  record((ral_call){ CALL_VERTEX_BUF, vbuf.raw, offset, 0, 0 });
+}
+void ral_encode_set_index_buf(gpu_encoder* enc, buf_handle ibuf, index_format format) {
+  (void)enc;
+  (void)format;
+  record((ral_call){ CALL_INDEX_BUF, ibuf.raw, 0, 0, 0 });
+}
+void ral_encode_draw_tris_instanced(gpu_encoder* enc, size_t start, size_t count, u32 instance_count,
+                                    u32 first_instance) {
+  (void)enc;
+  (void)start;
+  (void)count;
+  record((ral_call){ CALL_DRAW, 0, 0, first_instance, instance_count });
+}
+void ral_encode_draw_indexed_tris_instanced(gpu_encoder* enc, u32 first_index, u32 index_count, u32 instance_count,
+                                            u32 first_instance) {
+  (void)enc;
+  (void)first_index;
+  (void)index_count;
+  record((ral_call){ CALL_DRAW, 0, 0, first_instance, instance_count });
+}
+void ral_encode_multi_draw_indexed_indirect(gpu_encoder* enc, buf_handle args_buf, u64 offset, u32 draw_count,
+                                            u32 stride) {
+  (void)enc;
+  (void)stride;
+  record((ral_call){ CALL_MULTI_DRAW, args_buf.raw, offset, 0, draw_count });
+}
+gpu_encoder** ral_parallel_encoder_streams(gpu_parallel_encoder* penc, u32 count) {
+  (void)penc;
+  (void)count;
+  static gpu_encoder* streams[MAX_JOB_THREADS * 4];
+  return streams;
+}
+
+static u32 count_calls(ral_call_kind kind, u32* out_first) {
+  u32 n = 0;
+  for (u32 i = 0; i < call_count; i++) {
+    if (calls[i].kind != kind) continue;
+    if (n == 0 && out_first) *out_first = i;
+    n++;
+  }
+  return n;
+}
+
+static mesh meshes[1];
+static material_binding materials[2];
+static pipeline_handle pipelines[2] = { { 100 }, { 101 } };
+static instance_data instances[4];
+static draw_batch batches[3];
+static draw_batch_list list;
+
+static u8 arena_buf[1 << 14];
+static arena frame_arena;
+
+#define INSTANCE_FRAME_SIZE 4096
+#define PALETTE_FRAME_SIZE 1024
+
+static per_frame_buffer palette_buf = { .buffer = { 6 }, .frame_size = PALETTE_FRAME_SIZE };
+
+TEST_GROUP(DrawEncode);
+
+TEST_SETUP(DrawEncode) {
+  call_count = 0;
+  frame_arena = arena_create(arena_buf, sizeof(arena_buf));
+  meshes[0] = (mesh){ .vertex_buffer = { 1 },
+                      .index_buffer = { 2 },
+                      .geo = { .has_indices = true, .index_format = INDEX_FORMAT_U32, .index_count = 6 } };
+  materials[0] = (material_binding){
+    .has_uniforms = true, .uniforms = { 7 }, .uniform_offset = 256, .textures = { { 11 }, { 12 } }, .texture_count = 2
+  };
+  materials[1] = (material_binding){ .textures = { { 13 } }, .texture_count = 1 };
+  // two pipelines with the first material then one with the second
+  batches[0] = (draw_batch){ .material = { 0 }, .pipeline = 0, .first_instance = 0, .instance_count = 2 };
+  batches[1] = (draw_batch){ .material = { 0 }, .pipeline = 1, .first_instance = 2, .instance_count = 1 };
+  batches[2] = (draw_batch){ .material = { 1 }, .pipeline = 1, .first_instance = 3, .instance_count = 1 };
+  list = (draw_batch_list){ .batches = batches, .batch_count = 3, .instances = instances, .instance_count = 4 };
+}
+
+TEST_TEAR_DOWN(DrawEncode) {}
+
+TEST(DrawEncode, BatchesBindTheirMaterial) {
+  per_frame_buffer instance_buf = { .buffer = { 5 }, .frame_size = INSTANCE_FRAME_SIZE };
+  draw_batches_encode(NULL, &list, meshes, materials, pipelines, instance_buf, 0, palette_buf);
+
+  u32 first;
+  TEST_ASSERT_EQUAL_UINT32(1, count_calls(CALL_UNIFORMS, &first));
+  TEST_ASSERT_EQUAL_UINT32(7, calls[first].handle);
+  TEST_ASSERT_EQUAL_UINT64(256, calls[first].offset);
+  TEST_ASSERT_EQUAL_UINT32(MATERIAL_UNIFORM_SLOT, calls[first].slot);
+
+  // the second batch shares the first one's material so it isn't bound again
+  TEST_ASSERT_EQUAL_UINT32(3, count_calls(CALL_TEXTURE, &first));
+  TEST_ASSERT_EQUAL_UINT32(11, calls[first].handle);
+  TEST_ASSERT_EQUAL_UINT32(12, calls[first + 1].handle);
+  TEST_ASSERT_EQUAL_UINT32(1, calls[first + 1].slot);
+  u32 last_texture = call_count;
+  while (calls[--last_texture].kind != CALL_TEXTURE) {
+  }
+  TEST_ASSERT_EQUAL_UINT32(13, calls[last_texture].handle);
+  TEST_ASSERT_EQUAL_UINT32(0, calls[last_texture].slot);
+  // and the second material is bound before the last draw
+  TEST_ASSERT_EQUAL_INT(CALL_DRAW, calls[call_count - 1].kind);
+  TEST_ASSERT_TRUE(last_texture < call_count - 1);
+  TEST_ASSERT_EQUAL_UINT32(3, count_calls(CALL_DRAW, NULL));
+}
+
+TEST(DrawEncode, EachFrameInFlightUploadsInstancesToItsOwnRegion) {
+  per_frame_buffer instance_buf = { .buffer = { 5 }, .frame_size = INSTANCE_FRAME_SIZE };
+  for (u32 frame = 0; frame < MAX_FRAMES_IN_FLIGHT + 1; frame++) {
+    call_count = 0;
+    draw_batches_encode(NULL, &list, meshes, materials, pipelines, instance_buf, frame, palette_buf);
+
+    u64 expected = (u64)(frame % MAX_FRAMES_IN_FLIGHT) * INSTANCE_FRAME_SIZE;
+    u32 upload, bind;
+    TEST_ASSERT_EQUAL_UINT32(1, count_calls(CALL_UPLOAD, &upload));
+    TEST_ASSERT_EQUAL_UINT64(expected, calls[upload].offset);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(instances), calls[upload].count);
+    TEST_ASSERT_EQUAL_UINT32(1, count_calls(CALL_INSTANCE_BUF, &bind));
+    TEST_ASSERT_EQUAL_UINT64(expected, calls[bind].offset);
+  }
+}
+
+TEST(DrawEncode, EachFrameInFlightBindsPalettesFromItsOwnRegion) {
+  per_frame_buffer instance_buf = { .buffer = { 5 }, .frame_size = INSTANCE_FRAME_SIZE };
+  batches[1].first_joint = 4;
+  batches[1].joint_count = 2;
+  for (u32 frame = 0; frame < MAX_FRAMES_IN_FLIGHT + 1; frame++) {
+    call_count = 0;
+    draw_batches_encode(NULL, &list, meshes, materials, pipelines, instance_buf, frame, palette_buf);
+
+    u32 first = 0, n = 0;
+    for (u32 i = 0; i < call_count; i++) {
+      if (calls[i].kind != CALL_UNIFORMS || calls[i].slot != SKINNING_PALETTE_SLOT) continue;
+      first = i;
+      n++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, n);
+    TEST_ASSERT_EQUAL_UINT32(6, calls[first].handle);
+    u64 region = (u64)(frame % MAX_FRAMES_IN_FLIGHT) * PALETTE_FRAME_SIZE;
+    TEST_ASSERT_EQUAL_UINT64(region + 4 * sizeof(mat4), calls[first].offset);
+  }
+}
+
+TEST(DrawEncode, IndirectSegmentsSplitOnMaterial) {
+  batches[0].pipeline = 1;  // now all three share a pipeline and only the material changes
+  indirect_draw_stream stream = indirect_draws_build(&list, meshes, 32, &frame_arena);
+  TEST_ASSERT_EQUAL_UINT32(3, stream.draw_count);
+  TEST_ASSERT_EQUAL_UINT32(2, stream.segment_count);
+  TEST_ASSERT_EQUAL_UINT32(2, stream.segments[0].draw_count);
+  TEST_ASSERT_EQUAL_UINT32(1, stream.segments[1].material.raw);
+
+  per_frame_buffer args = { .buffer = { 8 }, .frame_size = 1024 };
+  per_frame_buffer draw_data = { .buffer = { 9 }, .frame_size = INSTANCE_FRAME_SIZE };
+  indirect_draws_encode(NULL, &stream, materials, pipelines, args, draw_data, 1);
+
+  u32 upload, bind, draw;
+  TEST_ASSERT_EQUAL_UINT32(2, count_calls(CALL_UPLOAD, &upload));
+  TEST_ASSERT_EQUAL_UINT64(1024, calls[upload].offset);
+  TEST_ASSERT_EQUAL_UINT64(INSTANCE_FRAME_SIZE, calls[upload + 1].offset);
+  TEST_ASSERT_EQUAL_UINT32(1, count_calls(CALL_INSTANCE_BUF, &bind));
+  TEST_ASSERT_EQUAL_UINT64(INSTANCE_FRAME_SIZE, calls[bind].offset);
+
+  TEST_ASSERT_EQUAL_UINT32(2, count_calls(CALL_MULTI_DRAW, &draw));
+  TEST_ASSERT_EQUAL_UINT64(1024, calls[draw].offset);
+  TEST_ASSERT_EQUAL_UINT32(2, calls[draw].count);
+  u32 second_draw = draw + 1;
+  while (calls[second_draw].kind != CALL_MULTI_DRAW) second_draw++;
+  TEST_ASSERT_EQUAL_UINT64(1024 + 2 * sizeof(draw_indexed_indirect_args), calls[second_draw].offset);
+  // the second material's texture is bound between the two multi-draws
+  TEST_ASSERT_EQUAL_UINT32(3, count_calls(CALL_TEXTURE, NULL));
+  TEST_ASSERT_EQUAL_INT(CALL_TEXTURE, calls[second_draw - 1].kind);
+  TEST_ASSERT_EQUAL_UINT32(13, calls[second_draw - 1].handle);
+}
@@ -0,0 +1,12 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Frustum) {
+  RUN_TEST_CASE(Frustum, PlanesFromAKnownProjection);
+  RUN_TEST_CASE(Frustum, InsideOutsideAndStraddlingBoxes);
+  RUN_TEST_CASE(Frustum, ManyViewsAcrossChunksMatchAScalarTest);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Frustum); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,107 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define ENTITY_COUNT 2053  // a few cull chunks with a partial SIMD iteration at the end
+
+static u8 arena_buf[1 << 20];
+static arena frame_arena;
+static frustum view_frustum;
+static render_ent entities[ENTITY_COUNT];
+
+TEST_GROUP(Frustum);
+
+TEST_SETUP(Frustum) {
+  frame_arena = arena_create(arena_buf, sizeof(arena_buf));
+  // 90 degree square frustum looking down -z from the origin, near 1 far 100
+  view_frustum = frustum_from_view_proj(mat4_perspective(PI / 2.0f, 1.0f, 1.0f, 100.0f));
+}
+
+TEST_TEAR_DOWN(Frustum) {}
+
+static render_ent unit_box_at(f32 x, f32 y, f32 z) {
+  return (render_ent){ .affine = mat4_translation(vec3(x, y, z)),
+                       .bounding_box = { .min = vec3(-1, -1, -1), .max = vec3(1, 1, 1) } };
+}
+
+static void assert_plane(plane expected, plane actual) {
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, expected.normal.x, actual.normal.x);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, expected.normal.y, actual.normal.y);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, expected.normal.z, actual.normal.z);
+  TEST_ASSERT_FLOAT_WITHIN(1e-3f, expected.distance, actual.distance);
+}
+
+TEST(Frustum, PlanesFromAKnownProjection) {
+  f32 h = sqrtf(0.5f);
+  assert_plane((plane){ vec3(h, 0, -h), 0 }, view_frustum.planes[0]);   // left
+  assert_plane((plane){ vec3(-h, 0, -h), 0 }, view_frustum.planes[1]);  // right
+  assert_plane((plane){ vec3(0, h, -h), 0 }, view_frustum.planes[2]);   // bottom
+  assert_plane((plane){ vec3(0, -h, -h), 0 }, view_frustum.planes[3]);  // top
+  assert_plane((plane){ vec3(0, 0, -1), -1 }, view_frustum.planes[4]);  // near
+  assert_plane((plane){ vec3(0, 0, 1), 100 }, view_frustum.planes[5]);  // far
+}
+
+TEST(Frustum, InsideOutsideAndStraddlingBoxes) {
+  render_ent ents[] = {
+    unit_box_at(0, 0, -10),      // inside
+    unit_box_at(0, 0, 5),        // behind the camera
+    unit_box_at(0, 0, -200),     // past the far plane
+    unit_box_at(-10, 0, -10),    // centred on the left plane
+    unit_box_at(0, 10.5f, -10),  // just poking over the top plane
+    unit_box_at(-13, 0, -10),    // clear of the left plane
+    unit_box_at(0, 0, -100.5f),  // straddling the far plane
+  };
+  u32 n = sizeof(ents) / sizeof(ents[0]);
+  cull_bounds_soa bounds = cull_bounds_from_render_ents(ents, n, &frame_arena);
+  cull_view view = { .frustum = view_frustum };
+  cull_result result;
+  frustum_cull(&bounds, &view, 1, &frame_arena, &result);
+
+  u32 expected[] = { 0, 3, 4, 6 };
+  TEST_ASSERT_EQUAL_UINT32(4, result.n_visible);
+  TEST_ASSERT_EQUAL_UINT32(n - 4, result.n_culled);
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, result.visible_indices, 4);
+}
+
+static bool box_visible(const render_ent* ent, const frustum* f) {
+  vec3 c = vec3(ent->affine.data[12], ent->affine.data[13], ent->affine.data[14]);
+  for (u32 p = 0; p < 6; p++) {
+    const plane* pl = &f->planes[p];
+    f32 dist = c.x * pl->normal.x + c.y * pl->normal.y + c.z * pl->normal.z + pl->distance;
+    f32 reach = fabsf(pl->normal.x) + fabsf(pl->normal.y) + fabsf(pl->normal.z);
+    if (dist < -reach) return false;
+  }
+  return true;
+}
+
+TEST(Frustum, ManyViewsAcrossChunksMatchAScalarTest) {
+  job_system_init(3);
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    // walk a spiral through and around the frustum
+    f32 t = (f32)i * 0.37f;
+    entities[i] = unit_box_at(cosf(t) * t * 0.1f, sinf(t) * t * 0.1f, -(f32)(i % 150));
+    entities[i].flags = i % 3 == 0 ? REND_ENT_CASTS_SHADOWS : 0;
+  }
+  // the last lanes of the partial SIMD iteration: one out of view, one in
+  entities[ENTITY_COUNT - 2] = unit_box_at(0, 0, 5);
+  entities[ENTITY_COUNT - 1] = unit_box_at(0, 0, -10);
+  cull_bounds_soa bounds = cull_bounds_from_render_ents(entities, ENTITY_COUNT, &frame_arena);
+  cull_view views[2] = { { .frustum = view_frustum },
+                         { .frustum = view_frustum, .required_flags = REND_ENT_CASTS_SHADOWS } };
+  cull_result results[2];
+  frustum_cull(&bounds, views, 2, &frame_arena, results);
+  job_system_shutdown();
+
+  u32 camera_seen = 0, shadow_seen = 0;
+  for (u32 i = 0; i < ENTITY_COUNT; i++) {
+    if (!box_visible(&entities[i], &view_frustum)) continue;
+    TEST_ASSERT_EQUAL_UINT32(i, results[0].visible_indices[camera_seen++]);
+    if (entities[i].flags & REND_ENT_CASTS_SHADOWS) {
+      TEST_ASSERT_EQUAL_UINT32(i, results[1].visible_indices[shadow_seen++]);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(camera_seen, results[0].n_visible);
+  TEST_ASSERT_EQUAL_UINT32(shadow_seen, results[1].n_visible);
+  TEST_ASSERT_TRUE(camera_seen > 0 && camera_seen < ENTITY_COUNT);
+  TEST_ASSERT_EQUAL_UINT32(ENTITY_COUNT - 1, results[0].visible_indices[camera_seen - 1]);
+}
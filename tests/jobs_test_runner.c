@@ -0,0 +1,13 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Jobs) {
+  RUN_TEST_CASE(Jobs, RunsSeriallyWithoutWorkers);
+  RUN_TEST_CASE(Jobs, CoversEveryIndexWithWorkers);
+  RUN_TEST_CASE(Jobs, NestedCallsRunInline);
+  RUN_TEST_CASE(Jobs, EmptyRangeDoesNothing);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Jobs); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
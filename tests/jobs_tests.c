@@ -0,0 +1,82 @@
+#include <celeritas.h>
+#include <stdatomic.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define ITEM_COUNT 10007  // not a multiple of the chunk size
+
+static atomic_uint hits[ITEM_COUNT];
+static atomic_uint max_worker;
+static atomic_uint empty_ranges;  // asserting from a worker thread would longjmp across threads
+
+TEST_GROUP(Jobs);
+
+TEST_SETUP(Jobs) {
+  for (u32 i = 0; i < ITEM_COUNT; i++) atomic_store(&hits[i], 0);
+  atomic_store(&max_worker, 0);
+  atomic_store(&empty_ranges, 0);
+}
+
+TEST_TEAR_DOWN(Jobs) { job_system_shutdown(); }
+
+static void count_hits(void* ctx, u32 start, u32 end, u32 worker_idx) {
+  (void)ctx;
+  if (start >= end) atomic_fetch_add(&empty_ranges, 1);
+  for (u32 i = start; i < end; i++) atomic_fetch_add(&hits[i], 1);
+  u32 seen = atomic_load(&max_worker);
+  while (worker_idx > seen && !atomic_compare_exchange_weak(&max_worker, &seen, worker_idx)) {
+  }
+}
+
+static void assert_every_index_hit_once(u32 count) {
+  for (u32 i = 0; i < count; i++) TEST_ASSERT_EQUAL_UINT32(1, atomic_load(&hits[i]));
+  for (u32 i = count; i < ITEM_COUNT; i++) TEST_ASSERT_EQUAL_UINT32(0, atomic_load(&hits[i]));
+  TEST_ASSERT_EQUAL_UINT32(0, atomic_load(&empty_ranges));
+}
+
+TEST(Jobs, RunsSeriallyWithoutWorkers) {
+  TEST_ASSERT_EQUAL_UINT32(1, job_system_thread_count());
+  jobs_parallel_for(ITEM_COUNT, 64, count_hits, NULL);
+  assert_every_index_hit_once(ITEM_COUNT);
+  TEST_ASSERT_EQUAL_UINT32(0, atomic_load(&max_worker));
+}
+
+TEST(Jobs, CoversEveryIndexWithWorkers) {
+  job_system_init(4);
+  TEST_ASSERT_EQUAL_UINT32(5, job_system_thread_count());
+  // several batches back to back reuse the same workers
+  for (u32 round = 0; round < 8; round++) {
+    for (u32 i = 0; i < ITEM_COUNT; i++) atomic_store(&hits[i], 0);
+    u32 count = ITEM_COUNT - round * 13;
+    jobs_parallel_for(count, 17, count_hits, NULL);
+    assert_every_index_hit_once(count);
+  }
+  TEST_ASSERT_TRUE(atomic_load(&max_worker) < job_system_thread_count());
+}
+
+static void count_block_hits(void* ctx, u32 start, u32 end, u32 worker_idx) {
+  u32 first = *(const u32*)ctx;
+  count_hits(NULL, first + start, first + end, worker_idx);
+}
+
+static void nested_for(void* ctx, u32 start, u32 end, u32 worker_idx) {
+  (void)ctx;
+  (void)worker_idx;
+  // each outer item owns a block of 10 inner items
+  for (u32 i = start; i < end; i++) {
+    u32 first = i * 10;
+    jobs_parallel_for(10, 3, count_block_hits, &first);
+  }
+}
+
+TEST(Jobs, NestedCallsRunInline) {
+  job_system_init(4);
+  jobs_parallel_for(ITEM_COUNT / 10, 8, nested_for, NULL);
+  assert_every_index_hit_once(ITEM_COUNT / 10 * 10);
+}
+
+TEST(Jobs, EmptyRangeDoesNothing) {
+  job_system_init(2);
+  jobs_parallel_for(0, 64, count_hits, NULL);
+  assert_every_index_hit_once(0);
+}
@@ -0,0 +1,15 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Lod) {
+  RUN_TEST_CASE(Lod, EachLevelHalvesTheTriangles);
+  RUN_TEST_CASE(Lod, LevelsReuseTheFullDetailVertices);
+  RUN_TEST_CASE(Lod, ErrorLimitStopsTheChain);
+  RUN_TEST_CASE(Lod, SimplifiedLevelsStayFacingOutwards);
+  RUN_TEST_CASE(Lod, DistantEntitiesGetCoarserLevels);
+  RUN_TEST_CASE(Lod, HysteresisHoldsALevelNearItsBoundary);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Lod); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
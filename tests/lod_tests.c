@@ -0,0 +1,153 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// the geometry's buffers get replaced by the library so they have to come from the system allocator rather than
+// Unity's leak-checking one
+#undef malloc
+#undef free
+
+#define SUBDIVISIONS 5
+#define SPHERE_TRIS (8 << (2 * SUBDIVISIONS))
+
+static geometry sphere;
+static mesh meshes[1];
+
+TEST_GROUP(Lod);
+
+static vec3 on_sphere(vec3 p) { return vec3_mult(p, 1.0f / vec3_len(p)); }
+
+static void subdivide(vec3* out, u32* n, vec3 a, vec3 b, vec3 c, u32 depth) {
+  if (depth == 0) {
+    out[(*n)++] = a;
+    out[(*n)++] = b;
+    out[(*n)++] = c;
+    return;
+  }
+  vec3 ab = on_sphere(vec3_mult(vec3_add(a, b), 0.5f));
+  vec3 bc = on_sphere(vec3_mult(vec3_add(b, c), 0.5f));
+  vec3 ca = on_sphere(vec3_mult(vec3_add(c, a), 0.5f));
+  subdivide(out, n, a, ab, ca, depth - 1);
+  subdivide(out, n, ab, b, bc, depth - 1);
+  subdivide(out, n, ca, bc, c, depth - 1);
+  subdivide(out, n, ab, bc, ca, depth - 1);
+}
+
+/** @brief a closed unit sphere from a subdivided octahedron, optimised like an imported mesh would be */
+TEST_SETUP(Lod) {
+  vec3 axes[6] = { VEC3_X, VEC3_Y, VEC3_Z, VEC3_NEG_X, VEC3_NEG_Y, VEC3_NEG_Z };
+  vec3* verts = malloc(sizeof(vec3) * SPHERE_TRIS * 3);
+  u32 n = 0;
+  for (u32 f = 0; f < 8; f++) {
+    vec3 x = axes[f & 1 ? 3 : 0], y = axes[f & 2 ? 4 : 1], z = axes[f & 4 ? 5 : 2];
+    // keep every face wound outwards whichever octant it is in
+    bool flip = ((f & 1) != 0) ^ ((f & 2) != 0) ^ ((f & 4) != 0);
+    subdivide(verts, &n, x, flip ? z : y, flip ? y : z, SUBDIVISIONS);
+  }
+  sphere = (geometry){
+    .vertex_format = { .label = "Sphere", .attributes = { ATTR_F32x3 }, .attribute_count = 1 },
+    .vertex_data = verts,
+    .vertex_count = n,
+  };
+  geo_optimise(&sphere);
+  meshes[0] = (mesh){ .geo = sphere };
+}
+
+TEST_TEAR_DOWN(Lod) {
+  free(sphere.vertex_data);
+  free(sphere.indices);
+}
+
+static const lod_chain_desc chain = { .level_count = 4, .triangle_ratio = 0.5f };
+
+TEST(Lod, EachLevelHalvesTheTriangles) {
+  geo_generate_lods(&sphere, &chain);
+
+  TEST_ASSERT_EQUAL_UINT32(4, sphere.lod_count);
+  TEST_ASSERT_EQUAL_UINT32(SPHERE_TRIS * 3, sphere.lods[0].index_count);
+  for (u32 l = 1; l < sphere.lod_count; l++) {
+    u32 prev = sphere.lods[l - 1].index_count / 3, tris = sphere.lods[l].index_count / 3;
+    TEST_ASSERT_TRUE(tris <= prev / 2 + prev / 20);
+    TEST_ASSERT_TRUE(sphere.lods[l].error >= sphere.lods[l - 1].error);
+  }
+  TEST_ASSERT_EQUAL_UINT32(sphere.lods[3].first_index + sphere.lods[3].index_count, sphere.index_count);
+}
+
+TEST(Lod, LevelsReuseTheFullDetailVertices) {
+  u32 vertex_count = sphere.vertex_count;
+  geo_generate_lods(&sphere, &chain);
+
+  TEST_ASSERT_EQUAL_UINT32(vertex_count, sphere.vertex_count);
+  for (u32 i = 0; i < sphere.index_count; i++) {
+    u32 v = sphere.index_format == INDEX_FORMAT_U16 ? ((u16*)sphere.indices)[i] : ((u32*)sphere.indices)[i];
+    TEST_ASSERT_TRUE(v < vertex_count);
+  }
+}
+
+TEST(Lod, ErrorLimitStopsTheChain) {
+  lod_chain_desc strict = chain;
+  strict.max_error[1] = 1e-6f;  // nothing on a sphere collapses that cheaply
+  geo_generate_lods(&sphere, &strict);
+
+  TEST_ASSERT_EQUAL_UINT32(1, sphere.lod_count);
+  TEST_ASSERT_EQUAL_UINT32(SPHERE_TRIS * 3, sphere.index_count);
+}
+
+TEST(Lod, SimplifiedLevelsStayFacingOutwards) {
+  geo_generate_lods(&sphere, &chain);
+
+  const vec3* verts = sphere.vertex_data;
+  mesh_lod lod = geo_lod(&sphere, 3);
+  for (u32 t = 0; t < lod.index_count / 3; t++) {
+    vec3 p[3];
+    for (u32 c = 0; c < 3; c++) {
+      u32 i = lod.first_index + t * 3 + c;
+      p[c] = verts[sphere.index_format == INDEX_FORMAT_U16 ? ((u16*)sphere.indices)[i] : ((u32*)sphere.indices)[i]];
+    }
+    vec3 n = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+    TEST_ASSERT_TRUE(vec3_dot(n, vec3_add(vec3_add(p[0], p[1]), p[2])) > 0.0f);
+  }
+}
+
+TEST(Lod, DistantEntitiesGetCoarserLevels) {
+  geo_generate_lods(&sphere, &chain);
+  meshes[0].geo = sphere;
+
+  f32 center_z[2] = { -1.5f, -300.0f }, zeros[2] = { 0 }, radius[2] = { 1.0f, 1.0f };
+  cull_bounds_soa bounds = { .center_x = zeros, .center_y = zeros, .center_z = center_z, .radius = radius, .count = 2 };
+  u32 visible_indices[2] = { 0, 1 };
+  cull_result visible = { .visible_indices = visible_indices, .n_visible = 2 };
+  render_ent ents[2] = { 0 };
+  camera cam = { .position = VEC3_ZERO, .forwards = VEC3_NEG_Z, .up = VEC3_Y, .fov = PI / 3.0f };
+
+  render_ents_select_lods(ents, &bounds, &visible, meshes, cam, 1080.0f, 1.0f, 0.1f);
+  TEST_ASSERT_EQUAL_UINT8(0, ents[0].lod);
+  TEST_ASSERT_EQUAL_UINT8(3, ents[1].lod);
+}
+
+TEST(Lod, HysteresisHoldsALevelNearItsBoundary) {
+  geo_generate_lods(&sphere, &chain);
+  meshes[0].geo = sphere;
+
+  // put the entity exactly where level 1's projected error meets the limit
+  f32 pixels_per_unit = 1080.0f * 0.5f / tanf(PI / 6.0f);
+  f32 boundary = sphere.lods[1].error * pixels_per_unit;  // the distance at which the error is one pixel
+  f32 center_z[1], zeros[1] = { 0 }, radius[1] = { 1.0f };
+  cull_bounds_soa bounds = { .center_x = zeros, .center_y = zeros, .center_z = center_z, .radius = radius, .count = 1 };
+  u32 visible_indices[1] = { 0 };
+  cull_result visible = { .visible_indices = visible_indices, .n_visible = 1 };
+  render_ent ent = { 0 };
+  camera cam = { .position = VEC3_ZERO, .forwards = VEC3_NEG_Z, .up = VEC3_Y, .fov = PI / 3.0f };
+
+  center_z[0] = -boundary * 1.02f;  // just past the boundary isn't far enough to coarsen
+  render_ents_select_lods(&ent, &bounds, &visible, meshes, cam, 1080.0f, 1.0f, 0.1f);
+  TEST_ASSERT_EQUAL_UINT8(0, ent.lod);
+
+  center_z[0] = -boundary * 1.2f;
+  render_ents_select_lods(&ent, &bounds, &visible, meshes, cam, 1080.0f, 1.0f, 0.1f);
+  TEST_ASSERT_EQUAL_UINT8(1, ent.lod);
+
+  center_z[0] = -boundary * 0.98f;  // and coming back just inside doesn't refine it again
+  render_ents_select_lods(&ent, &bounds, &visible, meshes, cam, 1080.0f, 1.0f, 0.1f);
+  TEST_ASSERT_EQUAL_UINT8(1, ent.lod);
+}
@@ -0,0 +1,13 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Maths) {
+  RUN_TEST_CASE(Maths, SoARoundTripsTransforms);
+  RUN_TEST_CASE(Maths, TransformsToMatsMatchesScalar);
+  RUN_TEST_CASE(Maths, MultBatchMatchesScalar);
+  RUN_TEST_CASE(Maths, TransformPointsAndVectorsMatchScalar);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Maths); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,88 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define BATCH 37  // four full SIMD iterations and a partial one
+
+static transform transforms[BATCH];
+static transform_soa soa;
+
+TEST_GROUP(Maths);
+
+static u32 rng_state;
+static f32 rand_f32(f32 lo, f32 hi) {
+  rng_state = rng_state * 1664525u + 1013904223u;
+  return lo + (hi - lo) * (f32)(rng_state >> 8) / (f32)(1u << 24);
+}
+
+TEST_SETUP(Maths) {
+  rng_state = 1;
+  soa = transform_soa_create(3);  // small so pushing has to grow it
+  for (u32 i = 0; i < BATCH; i++) {
+    vec3 pos = vec3(rand_f32(-10, 10), rand_f32(-10, 10), rand_f32(-10, 10));
+    quat rot = quat_from_axis_angle(vec3(rand_f32(-1, 1), rand_f32(-1, 1), 1.0f), rand_f32(-PI, PI), true);
+    vec3 scale = vec3(rand_f32(0.5f, 2), rand_f32(0.5f, 2), rand_f32(0.5f, 2));
+    transforms[i] = transform_create(pos, rot, scale);
+    transform_soa_push(&soa, transforms[i]);
+  }
+}
+
+TEST_TEAR_DOWN(Maths) { transform_soa_destroy(&soa); }
+
+static void assert_mat4_within(f32 delta, mat4 expected, mat4 actual) {
+  for (u32 k = 0; k < 16; k++) TEST_ASSERT_FLOAT_WITHIN(delta, expected.data[k], actual.data[k]);
+}
+
+TEST(Maths, SoARoundTripsTransforms) {
+  TEST_ASSERT_EQUAL_size_t(BATCH, soa.count);
+  TEST_ASSERT_EQUAL_size_t(0, soa.capacity % SIMD_WIDTH);
+  for (u32 i = 0; i < BATCH; i++) {
+    transform tf = transform_soa_get(&soa, i);
+    TEST_ASSERT_EQUAL_MEMORY(&transforms[i].position, &tf.position, sizeof(vec3));
+    TEST_ASSERT_EQUAL_MEMORY(&transforms[i].rotation, &tf.rotation, sizeof(quat));
+    TEST_ASSERT_EQUAL_MEMORY(&transforms[i].scale, &tf.scale, sizeof(vec3));
+  }
+}
+
+TEST(Maths, TransformsToMatsMatchesScalar) {
+  mat4 batched[BATCH];
+  transforms_to_mats(&soa, batched, BATCH);
+  for (u32 i = 0; i < BATCH; i++) assert_mat4_within(1e-5f, transform_to_mat(&transforms[i]), batched[i]);
+}
+
+TEST(Maths, MultBatchMatchesScalar) {
+  mat4 locals[BATCH], parents[BATCH], batched[BATCH];
+  transforms_to_mats(&soa, locals, BATCH);
+  for (u32 i = 0; i < BATCH; i++) parents[i] = locals[(i * 7 + 3) % BATCH];
+  mat4_mult_batch(locals, parents, batched, BATCH);
+  for (u32 i = 0; i < BATCH; i++) assert_mat4_within(1e-3f, mat4_mult(locals[i], parents[i]), batched[i]);
+
+  // writing the result over an input
+  mat4_mult_batch(locals, parents, locals, BATCH);
+  for (u32 i = 0; i < BATCH; i++) assert_mat4_within(0.0f, batched[i], locals[i]);
+}
+
+static vec3 row_vec_mult(vec3 v, f32 w, mat4 m) {
+  const f32* d = m.data;
+  return vec3(v.x * d[0] + v.y * d[4] + v.z * d[8] + w * d[12], v.x * d[1] + v.y * d[5] + v.z * d[9] + w * d[13],
+              v.x * d[2] + v.y * d[6] + v.z * d[10] + w * d[14]);
+}
+
+TEST(Maths, TransformPointsAndVectorsMatchScalar) {
+  mat4 m = transform_to_mat(&transforms[0]);
+  vec3 in[BATCH], points[BATCH], vectors[BATCH];
+  for (u32 i = 0; i < BATCH; i++) in[i] = vec3(rand_f32(-5, 5), rand_f32(-5, 5), rand_f32(-5, 5));
+  mat4_transform_points(m, in, points, BATCH);
+  mat4_transform_vectors(m, in, vectors, BATCH);
+
+  for (u32 i = 0; i < BATCH; i++) {
+    vec3 p = row_vec_mult(in[i], 1.0f, m);
+    vec3 v = row_vec_mult(in[i], 0.0f, m);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, p.x, points[i].x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, p.y, points[i].y);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, p.z, points[i].z);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, v.x, vectors[i].x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, v.y, vectors[i].y);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, v.z, vectors[i].z);
+  }
+}
@@ -0,0 +1,14 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(MeshOpt) {
+  RUN_TEST_CASE(MeshOpt, MergesDuplicateVertices);
+  RUN_TEST_CASE(MeshOpt, UsesSixteenBitIndicesForSmallMeshes);
+  RUN_TEST_CASE(MeshOpt, KeepsEveryTriangleAndItsWinding);
+  RUN_TEST_CASE(MeshOpt, LowersTheCacheMissRatio);
+  RUN_TEST_CASE(MeshOpt, NumbersVerticesInFirstUseOrder);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(MeshOpt); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
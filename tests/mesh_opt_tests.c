@@ -0,0 +1,120 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// `geo_optimise` frees and replaces the geometry's buffers so they have to come from the system allocator rather
+// than Unity's leak-checking one
+#undef malloc
+#undef free
+
+#define GRID_SIZE 32  // quads per side
+#define GRID_TRIS (GRID_SIZE * GRID_SIZE * 2)
+
+typedef struct grid_vert {
+  vec3 pos;
+  vec2 uv;
+} grid_vert;
+
+static geometry grid;
+
+TEST_GROUP(MeshOpt);
+
+/** @brief a flat grid as an unindexed triangle soup, in a scrambled order like a careless exporter would write */
+TEST_SETUP(MeshOpt) {
+  grid_vert* verts = malloc(sizeof(grid_vert) * GRID_TRIS * 3);
+  u32 order[GRID_TRIS];
+  for (u32 t = 0; t < GRID_TRIS; t++) order[t] = t;
+  u32 seed = 12345;
+  for (u32 t = GRID_TRIS - 1; t > 0; t--) {
+    seed = seed * 1664525u + 1013904223u;
+    u32 j = (seed >> 8) % (t + 1);
+    u32 tmp = order[t];
+    order[t] = order[j];
+    order[j] = tmp;
+  }
+
+  for (u32 t = 0; t < GRID_TRIS; t++) {
+    u32 quad = order[t] / 2;
+    f32 x = (f32)(quad % GRID_SIZE), y = (f32)(quad / GRID_SIZE);
+    vec3 corners[2][3] = {
+      { vec3(x, y, 0), vec3(x + 1, y, 0), vec3(x + 1, y + 1, 0) },
+      { vec3(x, y, 0), vec3(x + 1, y + 1, 0), vec3(x, y + 1, 0) },
+    };
+    for (u32 c = 0; c < 3; c++) {
+      vec3 p = corners[order[t] % 2][c];
+      verts[t * 3 + c] = (grid_vert){ .pos = p, .uv = { p.x / GRID_SIZE, p.y / GRID_SIZE } };
+    }
+  }
+
+  grid = (geometry){
+    .vertex_format = { .label = "Grid", .attributes = { ATTR_F32x3, ATTR_F32x2 }, .attribute_count = 2 },
+    .vertex_data = verts,
+    .vertex_count = GRID_TRIS * 3,
+    .has_indices = false,
+  };
+}
+
+TEST_TEAR_DOWN(MeshOpt) {
+  free(grid.vertex_data);
+  free(grid.indices);
+}
+
+static u32 index_at(const geometry* geo, u32 i) {
+  return geo->index_format == INDEX_FORMAT_U16 ? ((u16*)geo->indices)[i] : ((u32*)geo->indices)[i];
+}
+
+TEST(MeshOpt, MergesDuplicateVertices) {
+  mesh_opt_stats stats = geo_optimise(&grid);
+
+  TEST_ASSERT_TRUE(grid.has_indices);
+  TEST_ASSERT_EQUAL_UINT32((GRID_SIZE + 1) * (GRID_SIZE + 1), grid.vertex_count);
+  TEST_ASSERT_EQUAL_UINT32(GRID_TRIS * 3, grid.index_count);
+  TEST_ASSERT_EQUAL_UINT32(GRID_TRIS * 3, stats.vertices_before);
+  TEST_ASSERT_EQUAL_UINT32(grid.vertex_count, stats.vertices_after);
+  TEST_ASSERT_TRUE(stats.bytes_after < stats.bytes_before);
+}
+
+TEST(MeshOpt, UsesSixteenBitIndicesForSmallMeshes) {
+  geo_optimise(&grid);
+  TEST_ASSERT_EQUAL(INDEX_FORMAT_U16, grid.index_format);
+}
+
+TEST(MeshOpt, KeepsEveryTriangleAndItsWinding) {
+  geo_optimise(&grid);
+
+  const grid_vert* verts = grid.vertex_data;
+  f32 area = 0;
+  for (u32 t = 0; t < GRID_TRIS; t++) {
+    vec3 p[3];
+    for (u32 c = 0; c < 3; c++) {
+      u32 v = index_at(&grid, t * 3 + c);
+      TEST_ASSERT_TRUE(v < grid.vertex_count);
+      p[c] = verts[v].pos;
+    }
+    // every source triangle is half a unit quad wound counter-clockwise
+    f32 signed_area = 0.5f * ((p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y));
+    TEST_ASSERT_EQUAL_FLOAT(0.5f, signed_area);
+    area += signed_area;
+  }
+  TEST_ASSERT_EQUAL_FLOAT(GRID_SIZE * GRID_SIZE, area);
+}
+
+TEST(MeshOpt, LowersTheCacheMissRatio) {
+  mesh_opt_stats stats = geo_optimise(&grid);
+
+  // triangle soup misses on every vertex, a well ordered grid gets close to one miss per two triangles
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, stats.acmr_before);
+  TEST_ASSERT_TRUE(stats.acmr_after < 0.8f);
+}
+
+TEST(MeshOpt, NumbersVerticesInFirstUseOrder) {
+  geo_optimise(&grid);
+
+  u32 next = 0;
+  for (u32 i = 0; i < grid.index_count; i++) {
+    u32 v = index_at(&grid, i);
+    TEST_ASSERT_TRUE(v <= next);
+    if (v == next) next++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(grid.vertex_count, next);
+}
@@ -0,0 +1,15 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Meshlet) {
+  RUN_TEST_CASE(Meshlet, MeshletsStayWithinLimitsAndCoverEveryTriangle);
+  RUN_TEST_CASE(Meshlet, BoundsContainTheirTriangles);
+  RUN_TEST_CASE(Meshlet, FarSideIsBackfaceCulled);
+  RUN_TEST_CASE(Meshlet, OffscreenInstanceIsFrustumCulled);
+  RUN_TEST_CASE(Meshlet, NonUniformScaleSkipsTheConeTest);
+  RUN_TEST_CASE(Meshlet, NeighbouringSurvivorsShareARange);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Meshlet); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,177 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// the geometry's buffers get replaced by the library so they have to come from the system allocator rather than
+// Unity's leak-checking one
+#undef malloc
+#undef free
+
+#define SUBDIVISIONS 5
+#define SPHERE_TRIS (8 << (2 * SUBDIVISIONS))
+
+static geometry sphere;
+static u8 arena_buf[1 << 20];
+static arena scratch;
+
+TEST_GROUP(Meshlet);
+
+static vec3 on_sphere(vec3 p) { return vec3_mult(p, 1.0f / vec3_len(p)); }
+
+static void subdivide(vec3* out, u32* n, vec3 a, vec3 b, vec3 c, u32 depth) {
+  if (depth == 0) {
+    out[(*n)++] = a;
+    out[(*n)++] = b;
+    out[(*n)++] = c;
+    return;
+  }
+  vec3 ab = on_sphere(vec3_mult(vec3_add(a, b), 0.5f));
+  vec3 bc = on_sphere(vec3_mult(vec3_add(b, c), 0.5f));
+  vec3 ca = on_sphere(vec3_mult(vec3_add(c, a), 0.5f));
+  subdivide(out, n, a, ab, ca, depth - 1);
+  subdivide(out, n, ab, b, bc, depth - 1);
+  subdivide(out, n, ca, bc, c, depth - 1);
+  subdivide(out, n, ab, bc, ca, depth - 1);
+}
+
+static u32 index_at(const geometry* geo, u32 i) {
+  return geo->index_format == INDEX_FORMAT_U16 ? ((const u16*)geo->indices)[i] : ((const u32*)geo->indices)[i];
+}
+
+/** @brief a closed unit sphere from a subdivided octahedron, optimised like an imported mesh would be */
+TEST_SETUP(Meshlet) {
+  vec3 axes[6] = { VEC3_X, VEC3_Y, VEC3_Z, VEC3_NEG_X, VEC3_NEG_Y, VEC3_NEG_Z };
+  vec3* verts = malloc(sizeof(vec3) * SPHERE_TRIS * 3);
+  u32 n = 0;
+  for (u32 f = 0; f < 8; f++) {
+    vec3 x = axes[f & 1 ? 3 : 0], y = axes[f & 2 ? 4 : 1], z = axes[f & 4 ? 5 : 2];
+    // keep every face wound outwards whichever octant it is in
+    bool flip = ((f & 1) != 0) ^ ((f & 2) != 0) ^ ((f & 4) != 0);
+    subdivide(verts, &n, x, flip ? z : y, flip ? y : z, SUBDIVISIONS);
+  }
+  sphere = (geometry){
+    .vertex_format = { .label = "Sphere", .attributes = { ATTR_F32x3 }, .attribute_count = 1 },
+    .vertex_data = verts,
+    .vertex_count = n,
+  };
+  geo_optimise(&sphere);
+  scratch = arena_create(arena_buf, sizeof(arena_buf));
+}
+
+TEST_TEAR_DOWN(Meshlet) {
+  meshlet_set_destroy(&sphere.meshlets);
+  free(sphere.vertex_data);
+  free(sphere.indices);
+}
+
+static frustum looking_at_origin(vec3 eye) {
+  camera cam = { .position = eye, .forwards = vec3_normalise(vec3_negate(eye)), .up = VEC3_Y, .fov = PI / 3.0f };
+  mat4 view, proj;
+  return frustum_from_view_proj(camera_view_proj(cam, 720, 1280, &view, &proj));
+}
+
+TEST(Meshlet, MeshletsStayWithinLimitsAndCoverEveryTriangle) {
+  geo_build_meshlets(&sphere);
+
+  const meshlet_set* set = &sphere.meshlets;
+  TEST_ASSERT_TRUE(set->count > 0);
+  u32 next_index = 0;
+  for (u32 m = 0; m < set->count; m++) {
+    meshlet ml = set->meshlets[m];
+    TEST_ASSERT_EQUAL_UINT32(next_index, ml.first_index);
+    TEST_ASSERT_TRUE(ml.vertex_count <= MESHLET_MAX_VERTICES);
+    TEST_ASSERT_TRUE(ml.triangle_count > 0 && ml.triangle_count <= MESHLET_MAX_TRIANGLES);
+    next_index += ml.triangle_count * 3;
+  }
+  TEST_ASSERT_EQUAL_UINT32(SPHERE_TRIS * 3, next_index);
+  // greedy growth should fill most meshlets rather than leave scraps behind
+  TEST_ASSERT_TRUE(set->count < SPHERE_TRIS / 48);
+}
+
+TEST(Meshlet, BoundsContainTheirTriangles) {
+  geo_build_meshlets(&sphere);
+
+  const meshlet_set* set = &sphere.meshlets;
+  const vec3* verts = sphere.vertex_data;
+  for (u32 m = 0; m < set->count; m++) {
+    meshlet ml = set->meshlets[m];
+    vec3 center = vec3(set->center_x[m], set->center_y[m], set->center_z[m]);
+    vec3 axis = vec3(set->cone_axis_x[m], set->cone_axis_y[m], set->cone_axis_z[m]);
+    for (u32 t = 0; t < ml.triangle_count; t++) {
+      vec3 p[3];
+      for (u32 c = 0; c < 3; c++) p[c] = verts[index_at(&sphere, ml.first_index + t * 3 + c)];
+      for (u32 c = 0; c < 3; c++) TEST_ASSERT_TRUE(vec3_len(vec3_sub(p[c], center)) <= set->radius[m] * 1.0001f);
+      // a small patch of a sphere has a tight cone around its outward normal
+      vec3 n = vec3_normalise(vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0])));
+      TEST_ASSERT_TRUE(vec3_dot(n, axis) > 0.5f);
+    }
+    TEST_ASSERT_TRUE(set->cone_cutoff[m] < 1.0f);
+  }
+}
+
+TEST(Meshlet, FarSideIsBackfaceCulled) {
+  geo_build_meshlets(&sphere);
+  vec3 eye = vec3(0, 0, 10);
+  frustum f = looking_at_origin(eye);
+
+  meshlet_cull_result r = meshlet_cull(&sphere.meshlets, mat4_ident(), &f, eye, NULL, &scratch);
+  TEST_ASSERT_EQUAL_UINT32(0, r.n_frustum_culled);
+  TEST_ASSERT_TRUE(r.n_backface_culled > sphere.meshlets.count / 3);
+  TEST_ASSERT_EQUAL_UINT32(sphere.meshlets.count, r.n_visible + r.n_backface_culled);
+
+  // nothing facing the camera may be dropped
+  const vec3* verts = sphere.vertex_data;
+  u32 covered = 0;
+  for (u32 m = 0; m < sphere.meshlets.count; m++) {
+    meshlet ml = sphere.meshlets.meshlets[m];
+    bool kept = false;
+    for (u32 i = 0; i < r.range_count; i++) {
+      kept |= ml.first_index >= r.ranges[i].first_index &&
+              ml.first_index < r.ranges[i].first_index + r.ranges[i].index_count;
+    }
+    covered += kept;
+    if (kept) continue;
+    for (u32 t = 0; t < ml.triangle_count; t++) {
+      vec3 p[3];
+      for (u32 c = 0; c < 3; c++) p[c] = verts[index_at(&sphere, ml.first_index + t * 3 + c)];
+      vec3 n = vec3_cross(vec3_sub(p[1], p[0]), vec3_sub(p[2], p[0]));
+      TEST_ASSERT_TRUE(vec3_dot(n, vec3_sub(eye, p[0])) <= 0.0f);
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(r.n_visible, covered);
+}
+
+TEST(Meshlet, OffscreenInstanceIsFrustumCulled) {
+  geo_build_meshlets(&sphere);
+  vec3 eye = vec3(0, 0, 10);
+  frustum f = looking_at_origin(eye);
+
+  mat4 behind = mat4_translation(vec3(0, 0, 20));
+  meshlet_cull_result r = meshlet_cull(&sphere.meshlets, behind, &f, eye, NULL, &scratch);
+  TEST_ASSERT_EQUAL_UINT32(0, r.n_visible);
+  TEST_ASSERT_EQUAL_UINT32(0, r.range_count);
+  TEST_ASSERT_EQUAL_UINT32(sphere.meshlets.count, r.n_frustum_culled);
+}
+
+TEST(Meshlet, NonUniformScaleSkipsTheConeTest) {
+  geo_build_meshlets(&sphere);
+  vec3 eye = vec3(0, 0, 10);
+  frustum f = looking_at_origin(eye);
+
+  mat4 squash = mat4_scale(vec3(1.0f, 0.25f, 1.0f));
+  meshlet_cull_result r = meshlet_cull(&sphere.meshlets, squash, &f, eye, NULL, &scratch);
+  TEST_ASSERT_EQUAL_UINT32(0, r.n_backface_culled);
+  TEST_ASSERT_EQUAL_UINT32(sphere.meshlets.count, r.n_visible);
+}
+
+TEST(Meshlet, NeighbouringSurvivorsShareARange) {
+  geo_build_meshlets(&sphere);
+  vec3 eye = vec3(0, 0, 10);
+  frustum f = looking_at_origin(eye);
+
+  mat4 squash = mat4_scale(vec3(1.0f, 0.25f, 1.0f));
+  meshlet_cull_result r = meshlet_cull(&sphere.meshlets, squash, &f, eye, NULL, &scratch);
+  TEST_ASSERT_EQUAL_UINT32(1, r.range_count);
+  TEST_ASSERT_EQUAL_UINT32(0, r.ranges[0].first_index);
+  TEST_ASSERT_EQUAL_UINT32(SPHERE_TRIS * 3, r.ranges[0].index_count);
+}
@@ -0,0 +1,12 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(Occlusion) {
+  RUN_TEST_CASE(Occlusion, PyramidHoldsTheFarthestDepthOfEachTile);
+  RUN_TEST_CASE(Occlusion, BoxesBehindTheOccluderAreCulled);
+  RUN_TEST_CASE(Occlusion, CullKeepsTheVisibleOrder);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(Occlusion); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,85 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// with an identity view-projection x and y in [-1, 1] span the screen and depth is z * 0.5 + 0.5
+#define WIDTH 32
+#define HEIGHT 16
+
+static u8 arena_buf[1 << 16];
+static arena frame_arena;
+static occlusion_buffer ob;
+
+TEST_GROUP(Occlusion);
+
+TEST_SETUP(Occlusion) {
+  frame_arena = arena_create(arena_buf, sizeof(arena_buf));
+  ob = occlusion_buffer_create(WIDTH, HEIGHT);
+}
+
+TEST_TEAR_DOWN(Occlusion) { occlusion_buffer_destroy(&ob); }
+
+static bbox_3d box(f32 x0, f32 y0, f32 z0, f32 x1, f32 y1, f32 z1) {
+  return (bbox_3d){ .min = vec3(x0, y0, z0), .max = vec3(x1, y1, z1) };
+}
+
+// the left half of the screen at depth 0.25, the right half empty
+static void fill_left_half(void) {
+  for (u32 y = 0; y < HEIGHT; y++) {
+    for (u32 x = 0; x < WIDTH; x++) ob.depth[y * WIDTH + x] = x < WIDTH / 2 ? 0.25f : 1.0f;
+  }
+  for (u32 ty = 0; ty < ob.tiles_y; ty++) {
+    for (u32 tx = 0; tx < ob.tiles_x; tx++) {
+      ob.tile_max_depth[ty * ob.tiles_x + tx] = tx < ob.tiles_x / 2 ? 0.25f : 1.0f;
+    }
+  }
+}
+
+TEST(Occlusion, PyramidHoldsTheFarthestDepthOfEachTile) {
+  // a quad over the left half at depth 0.5 and a smaller one nearer the camera in the top left tile
+  vec3 half[6] = { vec3(-1, -1, 0), vec3(0, -1, 0), vec3(0, 1, 0), vec3(-1, -1, 0), vec3(0, 1, 0), vec3(-1, 1, 0) };
+  vec3 corner[3] = { vec3(-1, 0.5f, -0.5f), vec3(-0.5f, 1, -0.5f), vec3(-1, 1, -0.5f) };
+  occluder_mesh occluders[2] = {
+    { .positions = half, .vertex_count = 6, .affine = mat4_ident() },
+    { .positions = corner, .vertex_count = 3, .affine = mat4_ident() },
+  };
+  occlusion_rasterize(&ob, mat4_ident(), occluders, 2);
+
+  TEST_ASSERT_EQUAL_FLOAT(0.25f, ob.depth[0]);
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, ob.depth[(HEIGHT - 1) * WIDTH]);
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, ob.depth[WIDTH - 1]);
+  for (u32 ty = 0; ty < ob.tiles_y; ty++) {
+    for (u32 tx = 0; tx < ob.tiles_x; tx++) {
+      // the tile only partly covered by the nearer quad keeps the farther depth around it
+      f32 expected = tx < ob.tiles_x / 2 ? 0.5f : 1.0f;
+      TEST_ASSERT_EQUAL_FLOAT(expected, ob.tile_max_depth[ty * ob.tiles_x + tx]);
+    }
+  }
+}
+
+TEST(Occlusion, BoxesBehindTheOccluderAreCulled) {
+  fill_left_half();
+  TEST_ASSERT_FALSE(occlusion_test_aabb(&ob, box(-0.9f, -0.5f, 0.2f, -0.1f, 0.5f, 0.4f)));  // behind
+  TEST_ASSERT_TRUE(occlusion_test_aabb(&ob, box(0.1f, -0.5f, 0.2f, 0.9f, 0.5f, 0.4f)));     // beside
+  TEST_ASSERT_TRUE(occlusion_test_aabb(&ob, box(-0.9f, -0.5f, -0.9f, -0.1f, 0.5f, -0.8f)));  // in front
+  TEST_ASSERT_TRUE(occlusion_test_aabb(&ob, box(-0.5f, -0.5f, 0.2f, 0.5f, 0.5f, 0.4f)));     // partly beside
+}
+
+TEST(Occlusion, CullKeepsTheVisibleOrder) {
+  fill_left_half();
+  render_ent ents[3] = {
+    { .affine = mat4_translation(vec3(0.5f, 0, 0.3f)) },    // visible on the right
+    { .affine = mat4_translation(vec3(-0.5f, 0, 0.3f)) },   // occluded on the left
+    { .affine = mat4_translation(vec3(-0.5f, 0, -0.9f)) },  // in front of the occluder
+  };
+  for (u32 i = 0; i < 3; i++) ents[i].bounding_box = box(-0.1f, -0.1f, -0.05f, 0.1f, 0.1f, 0.05f);
+  cull_bounds_soa bounds = cull_bounds_from_render_ents(ents, 3, &frame_arena);
+  u32 indices[3] = { 0, 1, 2 };
+  cull_result result = { .visible_indices = indices, .n_visible = 3 };
+  occlusion_cull(&ob, &bounds, &frame_arena, &result);
+
+  u32 expected[2] = { 0, 2 };
+  TEST_ASSERT_EQUAL_UINT32(2, result.n_visible);
+  TEST_ASSERT_EQUAL_UINT32(1, result.n_culled);
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, result.visible_indices, 2);
+}
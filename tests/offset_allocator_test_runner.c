@@ -0,0 +1,14 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(OffsetAllocator) {
+  RUN_TEST_CASE(OffsetAllocator, AllocatesContiguously);
+  RUN_TEST_CASE(OffsetAllocator, FreeMergesNeighbours);
+  RUN_TEST_CASE(OffsetAllocator, ReusesFreedRange);
+  RUN_TEST_CASE(OffsetAllocator, ReportsFragmentation);
+  RUN_TEST_CASE(OffsetAllocator, FailsWhenFull);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(OffsetAllocator); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,73 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+static offset_allocator allocator;
+
+TEST_GROUP(OffsetAllocator);
+
+TEST_SETUP(OffsetAllocator) { allocator = offset_allocator_create(1024 * 1024, 1024); }
+
+TEST_TEAR_DOWN(OffsetAllocator) { offset_allocator_destroy(&allocator); }
+
+TEST(OffsetAllocator, AllocatesContiguously) {
+  offset_alloc a = offset_allocator_alloc(&allocator, 100);
+  offset_alloc b = offset_allocator_alloc(&allocator, 200);
+  offset_alloc c = offset_allocator_alloc(&allocator, 300);
+  TEST_ASSERT_EQUAL_UINT32(0, a.offset);
+  TEST_ASSERT_EQUAL_UINT32(100, b.offset);
+  TEST_ASSERT_EQUAL_UINT32(300, c.offset);
+  TEST_ASSERT_EQUAL_UINT32(1024 * 1024 - 600, allocator.free_storage);
+}
+
+TEST(OffsetAllocator, FreeMergesNeighbours) {
+  offset_alloc a = offset_allocator_alloc(&allocator, 1000);
+  offset_alloc b = offset_allocator_alloc(&allocator, 1000);
+  offset_alloc c = offset_allocator_alloc(&allocator, 1000);
+
+  offset_allocator_free(&allocator, a);
+  offset_allocator_free(&allocator, c);
+  // a's hole and the tail are separate ranges until b goes
+  TEST_ASSERT_EQUAL_UINT32(2, offset_allocator_get_stats(&allocator).free_region_count);
+  offset_allocator_free(&allocator, b);
+
+  offset_allocator_stats stats = offset_allocator_get_stats(&allocator);
+  TEST_ASSERT_EQUAL_UINT32(1, stats.free_region_count);
+  TEST_ASSERT_EQUAL_UINT32(1024 * 1024, stats.largest_free);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.fragmentation);
+}
+
+TEST(OffsetAllocator, ReusesFreedRange) {
+  offset_alloc a = offset_allocator_alloc(&allocator, 4096);
+  offset_alloc b = offset_allocator_alloc(&allocator, 4096);
+  (void)b;
+  offset_allocator_free(&allocator, a);
+  offset_alloc c = offset_allocator_alloc(&allocator, 4096);
+  TEST_ASSERT_EQUAL_UINT32(0, c.offset);
+}
+
+TEST(OffsetAllocator, ReportsFragmentation) {
+  // sizes that are exactly a bin boundary so no space is lost to rounding
+  offset_alloc allocs[8];
+  offset_allocator_destroy(&allocator);
+  allocator = offset_allocator_create(8 * 128, 64);
+  for (u32 i = 0; i < 8; i++) allocs[i] = offset_allocator_alloc(&allocator, 128);
+  for (u32 i = 0; i < 8; i += 2) offset_allocator_free(&allocator, allocs[i]);
+
+  offset_allocator_stats stats = offset_allocator_get_stats(&allocator);
+  TEST_ASSERT_EQUAL_UINT32(512, stats.total_free);
+  TEST_ASSERT_EQUAL_UINT32(128, stats.largest_free);
+  TEST_ASSERT_EQUAL_UINT32(4, stats.free_region_count);
+  TEST_ASSERT_EQUAL_FLOAT(0.75f, stats.fragmentation);
+
+  // half the space is free but no single range can fit 256
+  TEST_ASSERT_EQUAL_UINT32(OFFSET_ALLOC_NO_SPACE, offset_allocator_alloc(&allocator, 256).offset);
+}
+
+TEST(OffsetAllocator, FailsWhenFull) {
+  offset_alloc a = offset_allocator_alloc(&allocator, 1024 * 1024);
+  TEST_ASSERT_EQUAL_UINT32(0, a.offset);
+  TEST_ASSERT_EQUAL_UINT32(OFFSET_ALLOC_NO_SPACE, offset_allocator_alloc(&allocator, 1).offset);
+  offset_allocator_free(&allocator, a);
+  TEST_ASSERT_EQUAL_UINT32(0, offset_allocator_alloc(&allocator, 1).offset);
+}
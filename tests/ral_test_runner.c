@@ -0,0 +1,40 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(BindState) {
+  RUN_TEST_CASE(BindState, RepeatedBindsAreDropped);
+  RUN_TEST_CASE(BindState, InvalidatingLetsTheNextBindsThrough);
+  RUN_TEST_CASE(BindState, UniformsAreOnlyMovedByOffsetForStagesThatHaveThemBound);
+}
+
+TEST_GROUP_RUNNER(UniformRing) {
+  RUN_TEST_CASE(UniformRing, AllocationsAreAlignedWithinTheirFramesRegion);
+  RUN_TEST_CASE(UniformRing, RunningOutFailsUntilTheNextFrame);
+  RUN_TEST_CASE(UniformRing, ArrayElementsArePaddedToTheAlignment);
+}
+
+TEST_GROUP_RUNNER(ShaderDataCache) {
+  RUN_TEST_CASE(ShaderDataCache, LooksUpWhatWasPut);
+  RUN_TEST_CASE(ShaderDataCache, RemovalShiftsTheProbeRunBack);
+  RUN_TEST_CASE(ShaderDataCache, EvictsTheLeastRecentlyUsedEntryTheGpuIsDoneWith);
+  RUN_TEST_CASE(ShaderDataCache, NothingIsEvictedWhileFramesInFlightMayUseIt);
+  RUN_TEST_CASE(ShaderDataCache, DestroyingAResourceDropsEntriesThatReferenceIt);
+}
+
+TEST_GROUP_RUNNER(PipelineCache) {
+  RUN_TEST_CASE(PipelineCache, HashCoversTheVertexStrideButNotLabels);
+  RUN_TEST_CASE(PipelineCache, EqualDescriptionsShareOnePipeline);
+  RUN_TEST_CASE(PipelineCache, HashCollisionsAreNotShared);
+}
+
+TEST_GROUP_RUNNER(DeferredDestroy) { RUN_TEST_CASE(DeferredDestroy, EveryEntryIsDestroyedOnceAfterItsFrameRetires); }
+
+static void RunAllTests(void) {
+  RUN_TEST_GROUP(BindState);
+  RUN_TEST_GROUP(UniformRing);
+  RUN_TEST_GROUP(ShaderDataCache);
+  RUN_TEST_GROUP(PipelineCache);
+  RUN_TEST_GROUP(DeferredDestroy);
+}
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
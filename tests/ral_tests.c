@@ -0,0 +1,441 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// The uniform ring only needs somewhere to put its bytes, so back buffers with host memory instead of a GPU
+
+#define MAX_FAKE_BUFFERS 8
+static void* fake_buffers[MAX_FAKE_BUFFERS];
+
+buf_handle ral_buffer_create(u64 size, const void* data) {
+  for (u32 i = 0; i < MAX_FAKE_BUFFERS; i++) {
+    if (fake_buffers[i]) continue;
+    fake_buffers[i] = calloc(1, size);
+    if (data) memcpy(fake_buffers[i], data, size);
+    return (buf_handle){ .raw = i + 1 };
+  }
+  TEST_FAIL_MESSAGE("out of fake buffers");
+  return (buf_handle){ 0 };
+}
+void* ral_buffer_mapped(buf_handle handle) { return fake_buffers[handle.raw - 1]; }
+void ral_buffer_destroy(buf_handle handle) {
+  free(fake_buffers[handle.raw - 1]);
+  fake_buffers[handle.raw - 1] = NULL;
+}
+
+// --- Redundant state filtering
+
+static gpu_bind_state bound;
+
+TEST_GROUP(BindState);
+
+TEST_SETUP(BindState) { bound = (gpu_bind_state){ 0 }; }
+
+TEST_TEAR_DOWN(BindState) {}
+
+TEST(BindState, RepeatedBindsAreDropped) {
+  pipeline_handle pipeline = { .raw = 3 };
+  buf_handle vbuf = { .raw = 1 }, ibuf = { .raw = 2 };
+  tex_handle tex = { .raw = 5 };
+
+  TEST_ASSERT_TRUE(gpu_bind_state_pipeline(&bound, pipeline));
+  TEST_ASSERT_FALSE(gpu_bind_state_pipeline(&bound, pipeline));
+  TEST_ASSERT_TRUE(gpu_bind_state_pipeline(&bound, (pipeline_handle){ .raw = 4 }));
+
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_vertex_buf(&bound, vbuf, 0));
+  TEST_ASSERT_EQUAL(BIND_ELIDE, gpu_bind_state_vertex_buf(&bound, vbuf, 0));
+  TEST_ASSERT_EQUAL(BIND_OFFSET_ONLY, gpu_bind_state_vertex_buf(&bound, vbuf, 64));
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_vertex_buf(&bound, ibuf, 64));
+
+  TEST_ASSERT_TRUE(gpu_bind_state_index_buf(&bound, ibuf));
+  TEST_ASSERT_FALSE(gpu_bind_state_index_buf(&bound, ibuf));
+
+  TEST_ASSERT_TRUE(gpu_bind_state_instance_buf(&bound, vbuf, 0));
+  TEST_ASSERT_FALSE(gpu_bind_state_instance_buf(&bound, vbuf, 0));
+  TEST_ASSERT_TRUE(gpu_bind_state_instance_buf(&bound, vbuf, 128));
+
+  TEST_ASSERT_TRUE(gpu_bind_state_texture(&bound, tex, 0));
+  TEST_ASSERT_FALSE(gpu_bind_state_texture(&bound, tex, 0));
+  // the same texture in another slot is a different bind
+  TEST_ASSERT_TRUE(gpu_bind_state_texture(&bound, tex, 1));
+
+  TEST_ASSERT_EQUAL_UINT32(10, bound.stats.binds_issued);
+  TEST_ASSERT_EQUAL_UINT32(5, bound.stats.binds_elided);
+}
+
+TEST(BindState, InvalidatingLetsTheNextBindsThrough) {
+  pipeline_handle pipeline = { .raw = 3 };
+  buf_handle buf = { .raw = 1 };
+  tex_handle tex = { .raw = 5 };
+  gpu_bind_state_pipeline(&bound, pipeline);
+  gpu_bind_state_vertex_buf(&bound, buf, 0);
+  gpu_bind_state_index_buf(&bound, buf);
+  gpu_bind_state_instance_buf(&bound, buf, 0);
+  gpu_bind_state_texture(&bound, tex, 2);
+  gpu_bind_state_uniforms(&bound, buf, 0, 1, STAGE_VERTEX);
+
+  gpu_bind_state_invalidate(&bound);
+  TEST_ASSERT_TRUE(gpu_bind_state_pipeline(&bound, pipeline));
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_vertex_buf(&bound, buf, 0));
+  TEST_ASSERT_TRUE(gpu_bind_state_index_buf(&bound, buf));
+  TEST_ASSERT_TRUE(gpu_bind_state_instance_buf(&bound, buf, 0));
+  TEST_ASSERT_TRUE(gpu_bind_state_texture(&bound, tex, 2));
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_uniforms(&bound, buf, 0, 1, STAGE_VERTEX));
+
+  // stats survive the reset
+  TEST_ASSERT_EQUAL_UINT32(12, bound.stats.binds_issued);
+  TEST_ASSERT_EQUAL_UINT32(0, bound.stats.binds_elided);
+}
+
+TEST(BindState, UniformsAreOnlyMovedByOffsetForStagesThatHaveThemBound) {
+  buf_handle buf = { .raw = 1 };
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_uniforms(&bound, buf, 0, 0, STAGE_VERTEX));
+  TEST_ASSERT_EQUAL(BIND_ELIDE, gpu_bind_state_uniforms(&bound, buf, 0, 0, STAGE_VERTEX));
+  TEST_ASSERT_EQUAL(BIND_OFFSET_ONLY, gpu_bind_state_uniforms(&bound, buf, 256, 0, STAGE_VERTEX));
+  // the fragment stage never saw the buffer
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_uniforms(&bound, buf, 256, 0, STAGE_VERTEX | STAGE_FRAGMENT));
+  TEST_ASSERT_EQUAL(BIND_ELIDE, gpu_bind_state_uniforms(&bound, buf, 256, 0, STAGE_FRAGMENT));
+  TEST_ASSERT_EQUAL(BIND_OFFSET_ONLY, gpu_bind_state_uniforms(&bound, buf, 512, 0, STAGE_FRAGMENT));
+  // the vertex stage was left at the old offset
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_uniforms(&bound, buf, 512, 0, STAGE_VERTEX));
+  TEST_ASSERT_EQUAL(BIND_ELIDE, gpu_bind_state_uniforms(&bound, buf, 512, 0, STAGE_VERTEX | STAGE_FRAGMENT));
+
+  // other slots are tracked separately
+  TEST_ASSERT_EQUAL(BIND_FULL, gpu_bind_state_uniforms(&bound, buf, 512, 1, STAGE_VERTEX));
+}
+
+// --- Per-frame uniform ring
+
+static uniform_ring ring;
+
+TEST_GROUP(UniformRing);
+
+TEST_SETUP(UniformRing) { ring = uniform_ring_create(1000, 256); }
+
+TEST_TEAR_DOWN(UniformRing) { uniform_ring_destroy(&ring); }
+
+TEST(UniformRing, AllocationsAreAlignedWithinTheirFramesRegion) {
+  TEST_ASSERT_EQUAL_UINT64(1024, ring.frame_size);
+
+  uniform_ring_begin_frame(&ring, 0);
+  uniform_alloc a = uniform_ring_alloc(&ring, 10);
+  uniform_alloc b = uniform_ring_alloc(&ring, 300);
+  uniform_alloc c = uniform_ring_alloc(&ring, 1);
+  TEST_ASSERT_EQUAL_UINT64(0, a.offset);
+  TEST_ASSERT_EQUAL_UINT64(256, b.offset);
+  TEST_ASSERT_EQUAL_UINT64(768, c.offset);
+  TEST_ASSERT_EQUAL_PTR(ring.mapped + 768, c.ptr);
+
+  uniform_ring_begin_frame(&ring, 1);
+  TEST_ASSERT_EQUAL_UINT64(1024, uniform_ring_alloc(&ring, 4).offset);
+
+  // frame indices wrap back onto the first region
+  uniform_ring_begin_frame(&ring, MAX_FRAMES_IN_FLIGHT);
+  TEST_ASSERT_EQUAL_UINT64(0, uniform_ring_alloc(&ring, 4).offset);
+}
+
+TEST(UniformRing, RunningOutFailsUntilTheNextFrame) {
+  uniform_ring_begin_frame(&ring, 1);
+  u32 data = 7;
+  TEST_ASSERT_NOT_NULL(uniform_ring_alloc(&ring, 1024 - 256).ptr);
+  TEST_ASSERT_EQUAL_UINT64(1024 + 768, uniform_ring_push(&ring, &data, sizeof(data)));
+  TEST_ASSERT_NULL(uniform_ring_alloc(&ring, 1).ptr);
+  TEST_ASSERT_EQUAL_UINT64(UINT64_MAX, uniform_ring_push(&ring, &data, sizeof(data)));
+
+  uniform_ring_begin_frame(&ring, 2);
+  TEST_ASSERT_EQUAL_UINT64(0, uniform_ring_push(&ring, &data, sizeof(data)));
+}
+
+TEST(UniformRing, ArrayElementsArePaddedToTheAlignment) {
+  uniform_ring_begin_frame(&ring, 1);
+  uniform_ring_alloc(&ring, 1);
+
+  u8 elems[3][20];
+  for (u32 i = 0; i < 3; i++) memset(elems[i], i + 1, sizeof(elems[i]));
+  u64 stride;
+  uniform_alloc a = uniform_ring_push_array(&ring, elems, sizeof(elems[0]), 3, &stride);
+  TEST_ASSERT_EQUAL_UINT64(256, stride);
+  TEST_ASSERT_EQUAL_UINT64(1024 + 256, a.offset);
+  for (u32 i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_MEMORY(elems[i], (u8*)a.ptr + i * stride, sizeof(elems[i]));
+  }
+
+  // a fourth element wouldn't fit
+  TEST_ASSERT_NULL(uniform_ring_push_array(&ring, elems, sizeof(elems[0]), 1, &stride).ptr);
+}
+
+// --- Shader data cache
+
+static shader_data_cache cache;
+static u64 released[32];
+static u32 released_count;
+
+static void record_release(u64 payload, void* user_data) {
+  (void)user_data;
+  TEST_ASSERT_TRUE(released_count < 32);
+  released[released_count++] = payload;
+}
+
+static shader_data_layout binding_buffer(u32 raw) {
+  shader_data_layout layout = { .binding_count = 1 };
+  layout.bindings[0] = (shader_binding){ .binding_type = BINDING_BUFFER, .visibility = STAGE_VERTEX };
+  layout.bindings[0].data.buffer.handle = (buf_handle){ .raw = raw };
+  return layout;
+}
+
+static shader_data_layout binding_texture(u32 raw) {
+  shader_data_layout layout = { .binding_count = 1 };
+  layout.bindings[0] = (shader_binding){ .binding_type = BINDING_TEXTURE, .visibility = STAGE_FRAGMENT };
+  layout.bindings[0].data.texture.handle = (tex_handle){ .raw = raw };
+  return layout;
+}
+
+/** @brief hashes are passed in so tests can pick which slots entries land in */
+static bool cached(shader_data_layout layout, u64 hash, u64 frame, u64 expected_payload) {
+  u64 payload = 0;
+  return shader_data_cache_get(&cache, &layout, hash, frame, &payload) && payload == expected_payload;
+}
+
+TEST_GROUP(ShaderDataCache);
+
+TEST_SETUP(ShaderDataCache) {
+  cache = shader_data_cache_create(16, record_release, NULL);
+  released_count = 0;
+}
+
+TEST_TEAR_DOWN(ShaderDataCache) { shader_data_cache_destroy(&cache); }
+
+TEST(ShaderDataCache, LooksUpWhatWasPut) {
+  shader_data_layout a = binding_buffer(1), b = binding_buffer(2);
+  u64 hash_a = shader_data_layout_hash(&a), hash_b = shader_data_layout_hash(&b);
+  TEST_ASSERT_TRUE(hash_a != hash_b);
+
+  TEST_ASSERT_FALSE(cached(a, hash_a, 0, 100));
+  TEST_ASSERT_TRUE(shader_data_cache_put(&cache, &a, hash_a, 0, 100));
+  TEST_ASSERT_TRUE(shader_data_cache_put(&cache, &b, hash_b, 0, 200));
+  TEST_ASSERT_TRUE(cached(a, hash_a, 1, 100));
+  TEST_ASSERT_TRUE(cached(b, hash_b, 1, 200));
+
+  // a colliding hash still has to bind the same resources
+  shader_data_layout c = binding_buffer(3);
+  TEST_ASSERT_FALSE(cached(c, hash_a, 1, 100));
+  TEST_ASSERT_EQUAL_UINT64(2, cache.hits);
+  TEST_ASSERT_EQUAL_UINT64(2, cache.misses);
+}
+
+TEST(ShaderDataCache, RemovalShiftsTheProbeRunBack) {
+  // 1, 17 and 33 share home slot 1 and push 2 out of its home slot 2
+  shader_data_cache_put(&cache, &(shader_data_layout){ 0 }, 1, 0, 10);
+  shader_data_layout doomed = binding_buffer(7);
+  shader_data_cache_put(&cache, &doomed, 17, 0, 170);
+  shader_data_cache_put(&cache, &(shader_data_layout){ 0 }, 33, 0, 330);
+  shader_data_cache_put(&cache, &(shader_data_layout){ 0 }, 2, 0, 20);
+  TEST_ASSERT_EQUAL_UINT64(2, cache.entries[4].key);
+
+  shader_data_cache_invalidate_buffer(&cache, (buf_handle){ .raw = 7 });
+  TEST_ASSERT_EQUAL_UINT32(1, released_count);
+  TEST_ASSERT_EQUAL_UINT64(170, released[0]);
+  TEST_ASSERT_EQUAL_UINT32(3, cache.count);
+
+  // no tombstones: the run is moved up and its old tail emptied
+  TEST_ASSERT_EQUAL_UINT64(33, cache.entries[2].key);
+  TEST_ASSERT_EQUAL_UINT64(2, cache.entries[3].key);
+  TEST_ASSERT_EQUAL_UINT64(0, cache.entries[4].key);
+  TEST_ASSERT_TRUE(cached((shader_data_layout){ 0 }, 1, 0, 10));
+  TEST_ASSERT_TRUE(cached((shader_data_layout){ 0 }, 33, 0, 330));
+  TEST_ASSERT_TRUE(cached((shader_data_layout){ 0 }, 2, 0, 20));
+}
+
+TEST(ShaderDataCache, EvictsTheLeastRecentlyUsedEntryTheGpuIsDoneWith) {
+  // 16 slots take 12 entries before evicting
+  for (u32 i = 0; i < 12; i++) {
+    shader_data_layout layout = binding_buffer(i + 1);
+    TEST_ASSERT_TRUE(shader_data_cache_put(&cache, &layout, shader_data_layout_hash(&layout), i, i + 100));
+  }
+  shader_data_layout first = binding_buffer(1), second = binding_buffer(2);
+  TEST_ASSERT_TRUE(cached(first, shader_data_layout_hash(&first), 20, 100));
+
+  shader_data_layout extra = binding_buffer(50);
+  TEST_ASSERT_TRUE(shader_data_cache_put(&cache, &extra, shader_data_layout_hash(&extra), 21, 150));
+  TEST_ASSERT_EQUAL_UINT64(1, cache.evictions);
+  TEST_ASSERT_EQUAL_UINT32(1, released_count);
+  TEST_ASSERT_EQUAL_UINT64(101, released[0]);
+  TEST_ASSERT_FALSE(cached(second, shader_data_layout_hash(&second), 21, 101));
+  TEST_ASSERT_TRUE(cached(first, shader_data_layout_hash(&first), 21, 100));
+}
+
+TEST(ShaderDataCache, NothingIsEvictedWhileFramesInFlightMayUseIt) {
+  for (u32 i = 0; i < 12; i++) {
+    shader_data_layout layout = binding_buffer(i + 1);
+    shader_data_cache_put(&cache, &layout, shader_data_layout_hash(&layout), 5, i + 100);
+  }
+  shader_data_layout extra = binding_buffer(50);
+  u64 hash = shader_data_layout_hash(&extra);
+  TEST_ASSERT_FALSE(shader_data_cache_put(&cache, &extra, hash, 5 + MAX_FRAMES_IN_FLIGHT - 1, 150));
+  TEST_ASSERT_EQUAL_UINT32(0, released_count);
+  TEST_ASSERT_TRUE(shader_data_cache_put(&cache, &extra, hash, 5 + MAX_FRAMES_IN_FLIGHT, 150));
+}
+
+TEST(ShaderDataCache, DestroyingAResourceDropsEntriesThatReferenceIt) {
+  shader_data_layout buf = binding_buffer(3), tex = binding_texture(3), other = binding_buffer(4);
+  shader_data_cache_put(&cache, &buf, shader_data_layout_hash(&buf), 0, 1);
+  shader_data_cache_put(&cache, &tex, shader_data_layout_hash(&tex), 0, 2);
+  shader_data_cache_put(&cache, &other, shader_data_layout_hash(&other), 0, 3);
+
+  // a texture that happens to share the buffer's raw handle is a different resource
+  shader_data_cache_invalidate_buffer(&cache, (buf_handle){ .raw = 3 });
+  TEST_ASSERT_EQUAL_UINT32(1, released_count);
+  TEST_ASSERT_EQUAL_UINT64(1, released[0]);
+  TEST_ASSERT_TRUE(cached(tex, shader_data_layout_hash(&tex), 0, 2));
+
+  shader_data_cache_invalidate_texture(&cache, (tex_handle){ .raw = 3 });
+  TEST_ASSERT_EQUAL_UINT32(2, released_count);
+  TEST_ASSERT_EQUAL_UINT64(2, released[1]);
+  TEST_ASSERT_TRUE(cached(other, shader_data_layout_hash(&other), 0, 3));
+  TEST_ASSERT_EQUAL_UINT32(1, cache.count);
+}
+
+// --- Pipeline cache
+
+static pipeline_dedup dedup;
+
+static gfx_pipeline_desc pipeline_desc(const char* vertex_entry, const char* fragment_entry) {
+  return (gfx_pipeline_desc){
+    .label = "pipeline",
+    .vertex_desc = { .attributes = { ATTR_F32x3, ATTR_F32x2 }, .attribute_count = 2 },
+    .vertex = { .source = "shader source", .entry_point = vertex_entry, .stage = STAGE_VERTEX },
+    .fragment = { .source = "shader source", .entry_point = fragment_entry, .stage = STAGE_FRAGMENT },
+  };
+}
+
+TEST_GROUP(PipelineCache);
+
+TEST_SETUP(PipelineCache) { dedup = (pipeline_dedup){ 0 }; }
+
+TEST_TEAR_DOWN(PipelineCache) {
+  while (dedup.count) pipeline_dedup_release(&dedup, dedup.entries[0].handle);
+}
+
+TEST(PipelineCache, HashCoversTheVertexStrideButNotLabels) {
+  gfx_pipeline_desc desc = pipeline_desc("vs", "fs");
+  u64 hash = gfx_pipeline_desc_hash(&desc);
+
+  gfx_pipeline_desc relabelled = desc;
+  relabelled.label = "another pipeline";
+  relabelled.vertex_desc.label = "another layout";
+  TEST_ASSERT_EQUAL_UINT64(hash, gfx_pipeline_desc_hash(&relabelled));
+
+  gfx_pipeline_desc padded = desc;
+  padded.vertex_desc.padding = 4;
+  TEST_ASSERT_TRUE(hash != gfx_pipeline_desc_hash(&padded));
+}
+
+TEST(PipelineCache, EqualDescriptionsShareOnePipeline) {
+  char vertex_entry[] = "vs";
+  gfx_pipeline_desc desc = pipeline_desc(vertex_entry, "fs");
+  u64 hash = gfx_pipeline_desc_hash(&desc);
+  pipeline_handle handle = { .raw = 9 }, shared = { 0 };
+  TEST_ASSERT_FALSE(pipeline_dedup_acquire(&dedup, &desc, hash, &shared));
+  pipeline_dedup_insert(&dedup, &desc, hash, handle);
+
+  // the table keeps its own copy of the strings
+  vertex_entry[0] = 'x';
+  gfx_pipeline_desc again = pipeline_desc("vs", "fs");
+  TEST_ASSERT_TRUE(pipeline_dedup_acquire(&dedup, &again, gfx_pipeline_desc_hash(&again), &shared));
+  TEST_ASSERT_EQUAL_UINT32(handle.raw, shared.raw);
+  TEST_ASSERT_EQUAL_UINT32(1, dedup.hits);
+
+  TEST_ASSERT_FALSE(pipeline_dedup_release(&dedup, handle));
+  TEST_ASSERT_TRUE(pipeline_dedup_release(&dedup, handle));
+  TEST_ASSERT_EQUAL_UINT32(0, dedup.count);
+}
+
+TEST(PipelineCache, HashCollisionsAreNotShared) {
+  gfx_pipeline_desc desc = pipeline_desc("vs", "fs");
+  u64 hash = gfx_pipeline_desc_hash(&desc);
+  pipeline_dedup_insert(&dedup, &desc, hash, (pipeline_handle){ .raw = 9 });
+
+  pipeline_handle shared = { 0 };
+  gfx_pipeline_desc other_entry = pipeline_desc("vs", "fs_lit");
+  TEST_ASSERT_FALSE(pipeline_dedup_acquire(&dedup, &other_entry, hash, &shared));
+  gfx_pipeline_desc padded = desc;
+  padded.vertex_desc.padding = 4;
+  TEST_ASSERT_FALSE(pipeline_dedup_acquire(&dedup, &padded, hash, &shared));
+  TEST_ASSERT_EQUAL_UINT32(0, dedup.hits);
+}
+
+// --- Deferred destruction
+
+#define DESTROY_PRODUCERS 4
+#define DESTROYS_PER_PRODUCER 250  // per frame. three frames of these have to fit in the queue
+#define DESTROY_FRAMES 400
+#define DESTROY_ENTRIES (DESTROY_PRODUCERS * DESTROYS_PER_PRODUCER * DESTROY_FRAMES)
+
+static deferred_destroy_queue destroy_queue;
+static u32 pushed_in_frame[DESTROY_ENTRIES];
+static u8 times_destroyed[DESTROY_ENTRIES];
+static atomic_uint failed_pushes;
+static u32 destroyed_early;
+
+typedef struct destroy_frame {
+  u64 frame;
+  u64 completed;
+  u32 collected;
+} destroy_frame;
+
+static void count_destroy(gpu_resource_kind kind, u32 handle, void* user_data) {
+  u64 completed = *(const u64*)user_data;
+  if (kind != GPU_RESOURCE_BUFFER || pushed_in_frame[handle] > completed) destroyed_early++;
+  times_destroyed[handle]++;
+}
+
+/** @brief chunks below DESTROY_PRODUCERS push a frame's worth of entries each, the last one collects alongside them */
+static void destroy_frame_job(void* ctx, u32 start, u32 end, u32 worker_idx) {
+  (void)worker_idx;
+  destroy_frame* f = ctx;
+  for (u32 p = start; p < end; p++) {
+    if (p == DESTROY_PRODUCERS) {
+      f->collected = deferred_destroy_collect(&destroy_queue, f->completed, count_destroy, &f->completed);
+      continue;
+    }
+    u32 first = ((u32)(f->frame - 1) * DESTROY_PRODUCERS + p) * DESTROYS_PER_PRODUCER;
+    for (u32 handle = first; handle < first + DESTROYS_PER_PRODUCER; handle++) {
+      pushed_in_frame[handle] = (u32)f->frame;
+      if (!deferred_destroy_push(&destroy_queue, GPU_RESOURCE_BUFFER, handle)) atomic_fetch_add(&failed_pushes, 1);
+    }
+  }
+}
+
+TEST_GROUP(DeferredDestroy);
+
+TEST_SETUP(DeferredDestroy) {
+  deferred_destroy_init(&destroy_queue);
+  memset(times_destroyed, 0, sizeof(times_destroyed));
+  atomic_store(&failed_pushes, 0);
+  destroyed_early = 0;
+}
+
+TEST_TEAR_DOWN(DeferredDestroy) { job_system_shutdown(); }
+
+TEST(DeferredDestroy, EveryEntryIsDestroyedOnceAfterItsFrameRetires) {
+  TEST_ASSERT_TRUE(job_system_init(DESTROY_PRODUCERS));
+
+  u32 collected = 0;
+  for (u64 frame = 1; frame <= DESTROY_FRAMES; frame++) {
+    deferred_destroy_begin_frame(&destroy_queue, frame);
+    // the GPU runs MAX_FRAMES_IN_FLIGHT frames behind the producers
+    destroy_frame f = { .frame = frame, .completed = frame > MAX_FRAMES_IN_FLIGHT ? frame - MAX_FRAMES_IN_FLIGHT : 0 };
+    jobs_parallel_for(DESTROY_PRODUCERS + 1, 1, destroy_frame_job, &f);
+    collected += f.collected;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, atomic_load(&failed_pushes));
+  TEST_ASSERT_TRUE(collected > 0);
+
+  u64 all_done = DESTROY_FRAMES;
+  collected += deferred_destroy_collect(&destroy_queue, all_done, count_destroy, &all_done);
+  TEST_ASSERT_EQUAL_UINT32(DESTROY_ENTRIES, collected);
+  TEST_ASSERT_EQUAL_UINT32(0, destroyed_early);
+  for (u32 i = 0; i < DESTROY_ENTRIES; i++) {
+    if (times_destroyed[i] != 1) TEST_FAIL_MESSAGE("an entry was not destroyed exactly once");
+  }
+}
@@ -0,0 +1,14 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(RenderGraph) {
+  RUN_TEST_CASE(RenderGraph, CullsPassesNobodyReads);
+  RUN_TEST_CASE(RenderGraph, OverwrittenResultIsCulled);
+  RUN_TEST_CASE(RenderGraph, AliasesDisjointLifetimes);
+  RUN_TEST_CASE(RenderGraph, DerivesBarriers);
+  RUN_TEST_CASE(RenderGraph, ExecutesSurvivorsInOrder);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(RenderGraph); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
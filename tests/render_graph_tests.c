@@ -0,0 +1,171 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define ARENA_SIZE (1024 * 1024)
+
+static char storage[ARENA_SIZE];
+static arena a;
+static render_graph* graph;
+
+TEST_GROUP(RenderGraph);
+
+TEST_SETUP(RenderGraph) {
+  a = arena_create(storage, ARENA_SIZE);
+  graph = render_graph_create(&a);
+}
+
+TEST_TEAR_DOWN(RenderGraph) { arena_free_all(&a); }
+
+static rg_resource_desc texture(const char* label, u64 size) {
+  return (rg_resource_desc){ .label = label, .kind = RG_RESOURCE_TEXTURE, .size = size };
+}
+
+TEST(RenderGraph, CullsPassesNobodyReads) {
+  rg_resource backbuffer = rg_import_resource(graph, texture("backbuffer", 100), RG_STATE_UNDEFINED, RG_STATE_PRESENT);
+  rg_resource shadow_map = rg_create_resource(graph, texture("shadow map", 50));
+  rg_resource gbuffer = rg_create_resource(graph, texture("gbuffer", 200));
+
+  u32 shadows = rg_add_pass(graph, "shadows", NULL, NULL);
+  rg_pass_write(graph, shadows, shadow_map, RG_STATE_DEPTH_TARGET);
+  u32 geometry = rg_add_pass(graph, "geometry", NULL, NULL);
+  rg_pass_write(graph, geometry, gbuffer, RG_STATE_COLOUR_TARGET);
+  u32 lighting = rg_add_pass(graph, "lighting", NULL, NULL);
+  rg_pass_read(graph, lighting, gbuffer, RG_STATE_SHADER_READ);
+  rg_pass_write(graph, lighting, backbuffer, RG_STATE_COLOUR_TARGET);
+
+  TEST_ASSERT_TRUE(render_graph_compile(graph));
+  TEST_ASSERT_TRUE(rg_pass_culled(graph, shadows));
+  TEST_ASSERT_FALSE(rg_pass_culled(graph, geometry));
+  TEST_ASSERT_FALSE(rg_pass_culled(graph, lighting));
+
+  const u32* order;
+  TEST_ASSERT_EQUAL_UINT32(2, rg_execution_order(graph, &order));
+  TEST_ASSERT_EQUAL_UINT32(geometry, order[0]);
+  TEST_ASSERT_EQUAL_UINT32(lighting, order[1]);
+  TEST_ASSERT_EQUAL_UINT32(1, rg_get_stats(graph).culled_pass_count);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, rg_resource_memory_block(graph, shadow_map));
+}
+
+TEST(RenderGraph, OverwrittenResultIsCulled) {
+  rg_resource backbuffer = rg_import_resource(graph, texture("backbuffer", 100), RG_STATE_UNDEFINED, RG_STATE_PRESENT);
+  rg_resource colour = rg_create_resource(graph, texture("colour", 100));
+
+  u32 first = rg_add_pass(graph, "first", NULL, NULL);
+  rg_pass_write(graph, first, colour, RG_STATE_COLOUR_TARGET);
+  u32 second = rg_add_pass(graph, "second", NULL, NULL);
+  rg_pass_write(graph, second, colour, RG_STATE_COLOUR_TARGET);
+  u32 blit = rg_add_pass(graph, "blit", NULL, NULL);
+  rg_pass_read(graph, blit, colour, RG_STATE_COPY_SRC);
+  rg_pass_write(graph, blit, backbuffer, RG_STATE_COPY_DST);
+
+  TEST_ASSERT_TRUE(render_graph_compile(graph));
+  TEST_ASSERT_TRUE(rg_pass_culled(graph, first));
+  TEST_ASSERT_FALSE(rg_pass_culled(graph, second));
+}
+
+TEST(RenderGraph, AliasesDisjointLifetimes) {
+  rg_resource backbuffer = rg_import_resource(graph, texture("backbuffer", 100), RG_STATE_UNDEFINED, RG_STATE_PRESENT);
+  rg_resource t0 = rg_create_resource(graph, texture("t0", 400));
+  rg_resource t1 = rg_create_resource(graph, texture("t1", 400));
+  rg_resource t2 = rg_create_resource(graph, texture("t2", 300));
+
+  u32 p0 = rg_add_pass(graph, "p0", NULL, NULL);
+  rg_pass_write(graph, p0, t0, RG_STATE_COLOUR_TARGET);
+  u32 p1 = rg_add_pass(graph, "p1", NULL, NULL);
+  rg_pass_read(graph, p1, t0, RG_STATE_SHADER_READ);
+  rg_pass_write(graph, p1, t1, RG_STATE_COLOUR_TARGET);
+  u32 p2 = rg_add_pass(graph, "p2", NULL, NULL);
+  rg_pass_read(graph, p2, t1, RG_STATE_SHADER_READ);
+  rg_pass_write(graph, p2, t2, RG_STATE_COLOUR_TARGET);
+  u32 p3 = rg_add_pass(graph, "p3", NULL, NULL);
+  rg_pass_read(graph, p3, t2, RG_STATE_SHADER_READ);
+  rg_pass_write(graph, p3, backbuffer, RG_STATE_COLOUR_TARGET);
+
+  TEST_ASSERT_TRUE(render_graph_compile(graph));
+
+  u32 first, last;
+  TEST_ASSERT_TRUE(rg_resource_lifetime(graph, t1, &first, &last));
+  TEST_ASSERT_EQUAL_UINT32(1, first);
+  TEST_ASSERT_EQUAL_UINT32(2, last);
+
+  // t0 [0,1] and t2 [2,3] don't overlap so they share a block, t1 overlaps both
+  TEST_ASSERT_EQUAL_UINT32(rg_resource_memory_block(graph, t0), rg_resource_memory_block(graph, t2));
+  TEST_ASSERT_NOT_EQUAL(rg_resource_memory_block(graph, t0), rg_resource_memory_block(graph, t1));
+
+  rg_stats stats = rg_get_stats(graph);
+  TEST_ASSERT_EQUAL_UINT32(2, stats.memory_block_count);
+  TEST_ASSERT_EQUAL_UINT64(1100, stats.transient_bytes);
+  TEST_ASSERT_EQUAL_UINT64(800, stats.aliased_bytes);
+
+  // t2 takes over t0's memory so its first barrier must say so
+  u32 n;
+  const rg_barrier* barriers = rg_pass_barriers(graph, p2, &n);
+  bool saw_alias = false;
+  for (u32 i = 0; i < n; i++) {
+    if (barriers[i].resource.raw == t2.raw) saw_alias = barriers[i].aliasing;
+  }
+  TEST_ASSERT_TRUE(saw_alias);
+}
+
+TEST(RenderGraph, DerivesBarriers) {
+  rg_resource backbuffer = rg_import_resource(graph, texture("backbuffer", 100), RG_STATE_UNDEFINED, RG_STATE_PRESENT);
+  rg_resource depth = rg_create_resource(graph, texture("depth", 100));
+
+  u32 prepass = rg_add_pass(graph, "depth prepass", NULL, NULL);
+  rg_pass_write(graph, prepass, depth, RG_STATE_DEPTH_TARGET);
+  u32 main = rg_add_pass(graph, "main", NULL, NULL);
+  rg_pass_read(graph, main, depth, RG_STATE_DEPTH_READ);
+  rg_pass_write(graph, main, backbuffer, RG_STATE_COLOUR_TARGET);
+
+  TEST_ASSERT_TRUE(render_graph_compile(graph));
+
+  u32 n;
+  const rg_barrier* b = rg_pass_barriers(graph, prepass, &n);
+  TEST_ASSERT_EQUAL_UINT32(1, n);
+  TEST_ASSERT_EQUAL(RG_STATE_UNDEFINED, b[0].before);
+  TEST_ASSERT_EQUAL(RG_STATE_DEPTH_TARGET, b[0].after);
+
+  b = rg_pass_barriers(graph, main, &n);
+  TEST_ASSERT_EQUAL_UINT32(2, n);
+  TEST_ASSERT_EQUAL(RG_STATE_DEPTH_TARGET, b[0].before);
+  TEST_ASSERT_EQUAL(RG_STATE_DEPTH_READ, b[0].after);
+  TEST_ASSERT_EQUAL(RG_STATE_UNDEFINED, b[1].before);
+  TEST_ASSERT_EQUAL(RG_STATE_COLOUR_TARGET, b[1].after);
+
+  b = rg_final_barriers(graph, &n);
+  TEST_ASSERT_EQUAL_UINT32(1, n);
+  TEST_ASSERT_EQUAL_UINT32(backbuffer.raw, b[0].resource.raw);
+  TEST_ASSERT_EQUAL(RG_STATE_PRESENT, b[0].after);
+}
+
+static u32 executed[RG_MAX_PASSES];
+static u32 executed_count;
+
+static void record_pass(const render_graph* g, u32 pass, void* user_data) {
+  (void)g;
+  (void)user_data;
+  executed[executed_count++] = pass;
+}
+
+TEST(RenderGraph, ExecutesSurvivorsInOrder) {
+  rg_resource backbuffer = rg_import_resource(graph, texture("backbuffer", 100), RG_STATE_UNDEFINED, RG_STATE_PRESENT);
+  rg_resource unused = rg_create_resource(graph, texture("unused", 100));
+  rg_resource readback = rg_create_resource(graph, (rg_resource_desc){ .kind = RG_RESOURCE_BUFFER, .size = 64 });
+  executed_count = 0;
+
+  u32 debug = rg_add_pass(graph, "debug", record_pass, NULL);
+  rg_pass_write(graph, debug, unused, RG_STATE_COLOUR_TARGET);
+  u32 capture = rg_add_pass(graph, "capture", record_pass, NULL);
+  rg_pass_write(graph, capture, readback, RG_STATE_COPY_DST);
+  rg_pass_set_side_effects(graph, capture);
+  u32 draw = rg_add_pass(graph, "draw", record_pass, NULL);
+  rg_pass_write(graph, draw, backbuffer, RG_STATE_COLOUR_TARGET);
+
+  TEST_ASSERT_TRUE(render_graph_compile(graph));
+  render_graph_execute(graph);
+
+  TEST_ASSERT_EQUAL_UINT32(2, executed_count);
+  TEST_ASSERT_EQUAL_UINT32(capture, executed[0]);
+  TEST_ASSERT_EQUAL_UINT32(draw, executed[1]);
+}
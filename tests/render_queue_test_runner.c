@@ -0,0 +1,14 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(RenderQueue) {
+  RUN_TEST_CASE(RenderQueue, EqualKeysKeepTheirOrder);
+  RUN_TEST_CASE(RenderQueue, ConstantBytesAreSkipped);
+  RUN_TEST_CASE(RenderQueue, ParallelSortMatchesSerial);
+  RUN_TEST_CASE(RenderQueue, OpaqueBeforeTransparentAndDepthOrder);
+  RUN_TEST_CASE(RenderQueue, LevelsOfDetailOfAMeshStayTogether);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(RenderQueue); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
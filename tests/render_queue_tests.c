@@ -0,0 +1,116 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+#define LARGE_QUEUE 300007  // over the parallel threshold and not a multiple of the chunk count
+
+static u8* arena_buf;
+static arena frame_arena;
+
+TEST_GROUP(RenderQueue);
+
+TEST_SETUP(RenderQueue) {
+  size_t size = 32 << 20;
+  arena_buf = malloc(size);
+  frame_arena = arena_create(arena_buf, size);
+}
+
+TEST_TEAR_DOWN(RenderQueue) {
+  job_system_shutdown();
+  free(arena_buf);
+}
+
+static u64 rng_state;
+static u64 rand_u64(void) {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static void assert_sorted_and_stable(const render_queue* q) {
+  for (u32 i = 1; i < q->count; i++) {
+    TEST_ASSERT_TRUE(q->keys[i - 1] <= q->keys[i]);
+    // items were pushed in ascending order so equal keys must keep it
+    if (q->keys[i - 1] == q->keys[i]) TEST_ASSERT_TRUE(q->items[i - 1] < q->items[i]);
+  }
+}
+
+// sorts keys built by `mask`ing random values and checks every item comes back once with its own key
+static void sort_masked(u64 mask, u32 count) {
+  render_queue q = render_queue_create(&frame_arena, count);
+  u64* original = arena_alloc(&frame_arena, sizeof(u64) * count);
+  for (u32 i = 0; i < count; i++) {
+    original[i] = rand_u64() & mask;
+    render_queue_push(&q, original[i], i);
+  }
+  render_queue_sort(&q, &frame_arena);
+  assert_sorted_and_stable(&q);
+  for (u32 i = 0; i < count; i++) TEST_ASSERT_EQUAL_UINT64(original[q.items[i]], q.keys[i]);
+}
+
+TEST(RenderQueue, EqualKeysKeepTheirOrder) {
+  rng_state = 1;
+  sort_masked(0x0300000000000003ull, 1000);  // lots of duplicates
+}
+
+TEST(RenderQueue, ConstantBytesAreSkipped) {
+  rng_state = 2;
+  sort_masked(0, 100);                       // every pass skipped, nothing moves
+  sort_masked(0xFF00000000000000ull, 1000);  // one pass, so the result has to be copied back
+  sort_masked(0x0000FF00000000FFull, 1000);  // two passes, the result is already in place
+  sort_masked(0xFFFFFFFFFFFFFFFFull, 1000);
+}
+
+TEST(RenderQueue, ParallelSortMatchesSerial) {
+  rng_state = 3;
+  render_queue serial = render_queue_create(&frame_arena, LARGE_QUEUE);
+  render_queue parallel = render_queue_create(&frame_arena, LARGE_QUEUE);
+  for (u32 i = 0; i < LARGE_QUEUE; i++) {
+    // some fully random keys among many that share their low bytes
+    u64 key = i % 7 == 0 ? rand_u64() : rand_u64() & 0xFFFF000000FF0000ull;
+    render_queue_push(&serial, key, i);
+    render_queue_push(&parallel, key, i);
+  }
+
+  render_queue_sort(&serial, &frame_arena);
+  job_system_init(4);
+  render_queue_sort(&parallel, &frame_arena);
+
+  assert_sorted_and_stable(&parallel);
+  TEST_ASSERT_EQUAL_UINT64_ARRAY(serial.keys, parallel.keys, LARGE_QUEUE);
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(serial.items, parallel.items, LARGE_QUEUE);
+}
+
+TEST(RenderQueue, OpaqueBeforeTransparentAndDepthOrder) {
+  u64 near_opaque = sort_key_opaque(0, 0, 1, 1, 0, 0.1f), far_opaque = sort_key_opaque(0, 0, 1, 1, 0, 0.9f);
+  u64 near_transparent = sort_key_transparent(0, 0, 1, 1, 0, 0.1f);
+  u64 far_transparent = sort_key_transparent(0, 0, 1, 1, 0, 0.9f);
+  TEST_ASSERT_TRUE(near_opaque < far_opaque);            // front to back
+  TEST_ASSERT_TRUE(far_transparent < near_transparent);  // back to front
+  TEST_ASSERT_TRUE(far_opaque < far_transparent);
+  TEST_ASSERT_TRUE(sort_key_transparent(0, 5, 5, 5, 7, 1.0f) < sort_key_opaque(1, 0, 0, 0, 0, 0.0f));  // views first
+}
+
+TEST(RenderQueue, LevelsOfDetailOfAMeshStayTogether) {
+  // the same mesh at two levels of detail, interleaved by depth
+  render_ent ents[6];
+  u32 visible[6];
+  for (u32 i = 0; i < 6; i++) {
+    ents[i] = (render_ent){ .mesh = { 3 }, .material = { 1 }, .lod = i % 2 };
+    ents[i].affine = mat4_translation(vec3(0, 0, -(f32)(i + 1)));
+    visible[i] = i;
+  }
+  cull_result result = { .visible_indices = visible, .n_visible = 6 };
+  camera cam = { .position = VEC3_ZERO, .forwards = vec3(0, 0, -1), .up = VEC3_Y };
+  render_queue q = render_queue_create(&frame_arena, 6);
+  render_queue_push_ents(&q, ents, &result, 0, cam, 0.0f, 10.0f);
+  render_queue_sort(&q, &frame_arena);
+
+  draw_batch_list list = render_queue_build_batches(&q, ents, NULL, &frame_arena);
+  TEST_ASSERT_EQUAL_UINT32(2, list.batch_count);
+  TEST_ASSERT_EQUAL_UINT32(0, list.batches[0].lod);
+  TEST_ASSERT_EQUAL_UINT32(1, list.batches[1].lod);
+  // still front to back within each level
+  TEST_ASSERT_EQUAL_UINT32_ARRAY(((u32[]){ 0, 2, 4, 1, 3, 5 }), q.items, 6);
+}
@@ -0,0 +1,11 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(RenderWorld) {
+  RUN_TEST_CASE(RenderWorld, SceneEditsOnlyReachTheRenderSideWhenApplied);
+  RUN_TEST_CASE(RenderWorld, RemovedProxiesDisappearFromCulling);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(RenderWorld); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,105 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+static u8 arena_buf[1 << 16];
+static arena frame_arena;
+static render_world world;
+static scene_tree tree;
+static render_proxy node_proxies[8];  // indexed by scene_node.raw
+
+TEST_GROUP(RenderWorld);
+
+TEST_SETUP(RenderWorld) {
+  frame_arena = arena_create(arena_buf, sizeof(arena_buf));
+  world = render_world_create(4);
+  tree = scene_tree_create(8);
+}
+
+TEST_TEAR_DOWN(RenderWorld) {
+  render_world_destroy(&world);
+  scene_tree_destroy(&tree);
+}
+
+static render_ent unit_box_at(f32 x, f32 y, f32 z) {
+  return (render_ent){ .affine = mat4_translation(vec3(x, y, z)),
+                       .bounding_box = { .min = vec3(-1, -1, -1), .max = vec3(1, 1, 1) },
+                       .flags = REND_ENT_VISIBLE };
+}
+
+static transform translation(f32 x, f32 y, f32 z) { return transform_create(vec3(x, y, z), quat_ident(), VEC3_ONES); }
+
+static f32 proxy_center_z(render_proxy proxy) { return world.bounds.center_z[world.proxy_to_dense[proxy.raw]]; }
+
+/** @brief what a frame does to bring the render side up to date with the scene */
+static void sync_scene() {
+  scene_tree_propagate(&tree);
+  render_world_apply_scene_changes(&world, &tree, node_proxies, 8);
+  render_world_update(&world);
+}
+
+TEST(RenderWorld, SceneEditsOnlyReachTheRenderSideWhenApplied) {
+  scene_node a = scene_tree_add(&tree, SCENE_NODE_NONE, translation(0, 0, -10));
+  scene_node b = scene_tree_add(&tree, SCENE_NODE_NONE, translation(5, 0, -10));
+  node_proxies[a.raw] = render_world_add(&world, unit_box_at(0, 0, 0));
+  node_proxies[b.raw] = render_world_add(&world, unit_box_at(0, 0, 0));
+  sync_scene();
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -10, proxy_center_z(node_proxies[a.raw]));
+  mat4 synced = render_world_get(&world, node_proxies[a.raw])->affine;
+
+  // the render world holds its own copy, so neither the edit nor propagating it touches that
+  scene_tree_set_local(&tree, a, translation(0, 0, -50));
+  scene_tree_propagate(&tree);
+  TEST_ASSERT_EQUAL_MEMORY(&synced, &render_world_get(&world, node_proxies[a.raw])->affine, sizeof(mat4));
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -10, proxy_center_z(node_proxies[a.raw]));
+
+  render_world_apply_scene_changes(&world, &tree, node_proxies, 8);
+  render_world_update(&world);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -50, proxy_center_z(node_proxies[a.raw]));
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -10, proxy_center_z(node_proxies[b.raw]));
+
+  // and it lives on after the scene lets go of the node
+  scene_tree_remove(&tree, b);
+  sync_scene();
+  TEST_ASSERT_TRUE(render_world_contains(&world, node_proxies[b.raw]));
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 5, render_world_get(&world, node_proxies[b.raw])->affine.data[12]);
+}
+
+TEST(RenderWorld, RemovedProxiesDisappearFromCulling) {
+  render_proxy proxies[3];
+  for (u32 i = 0; i < 3; i++) proxies[i] = render_world_add(&world, unit_box_at(3.0f * i, 0, -10));
+  render_world_update(&world);
+
+  // still on the dirty list when it goes
+  render_world_set_transform(&world, proxies[1], mat4_translation(vec3(3, 0, -20)));
+  render_world_remove(&world, proxies[1]);
+  render_world_update(&world);
+  TEST_ASSERT_FALSE(render_world_contains(&world, proxies[1]));
+  TEST_ASSERT_EQUAL_UINT32(2, world.count);
+  TEST_ASSERT_EQUAL_UINT32(2, world.bounds.count);
+
+  // the last proxy was swapped into the hole along with its bounds
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 6, render_world_get(&world, proxies[2])->affine.data[12]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, 6, world.bounds.center_x[world.proxy_to_dense[proxies[2].raw]]);
+
+  cull_view view = { .frustum = frustum_from_view_proj(mat4_perspective(PI / 2.0f, 1.0f, 1.0f, 100.0f)) };
+  cull_result result;
+  frustum_cull(&world.bounds, &view, 1, &frame_arena, &result);
+  TEST_ASSERT_EQUAL_UINT32(2, result.n_visible);
+  for (u32 v = 0; v < result.n_visible; v++) {
+    f32 x = world.ents[result.visible_indices[v]].affine.data[12];
+    TEST_ASSERT_TRUE(x == 0 || x == 6);
+  }
+
+  // a scene node still pointing at the removed proxy is skipped
+  scene_node node = scene_tree_add(&tree, SCENE_NODE_NONE, translation(0, 0, -30));
+  node_proxies[node.raw] = proxies[1];
+  sync_scene();
+  TEST_ASSERT_EQUAL_UINT32(2, world.count);
+
+  // its handle is recycled for the next proxy
+  render_proxy fresh = render_world_add(&world, unit_box_at(0, 0, -40));
+  TEST_ASSERT_EQUAL_UINT32(proxies[1].raw, fresh.raw);
+  render_world_update(&world);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, -40, proxy_center_z(fresh));
+}
@@ -0,0 +1,15 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(SceneTree) {
+  RUN_TEST_CASE(SceneTree, PropagatesParentTransforms);
+  RUN_TEST_CASE(SceneTree, RemovingANodeRemovesItsSubtree);
+  RUN_TEST_CASE(SceneTree, ReparentingUnderALaterNodeKeepsParentsFirst);
+  RUN_TEST_CASE(SceneTree, HandlesSurviveCompaction);
+  RUN_TEST_CASE(SceneTree, OnlyEditedSubtreesChange);
+  RUN_TEST_CASE(SceneTree, FewEditsInALargeTreeLeaveOtherSubtreesAlone);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(SceneTree); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
@@ -0,0 +1,191 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+static scene_tree tree;
+
+TEST_GROUP(SceneTree);
+
+TEST_SETUP(SceneTree) { tree = scene_tree_create(16); }
+
+TEST_TEAR_DOWN(SceneTree) {
+  scene_tree_destroy(&tree);
+  job_system_shutdown();
+}
+
+static transform translation(f32 x, f32 y, f32 z) { return transform_create(vec3(x, y, z), quat_ident(), VEC3_ONES); }
+
+static void assert_world_position(scene_node node, f32 x, f32 y, f32 z) {
+  mat4 world = scene_tree_world(&tree, node);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, x, world.data[12]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, y, world.data[13]);
+  TEST_ASSERT_FLOAT_WITHIN(1e-5f, z, world.data[14]);
+}
+
+TEST(SceneTree, PropagatesParentTransforms) {
+  scene_node root = scene_tree_add(&tree, SCENE_NODE_NONE, translation(1, 0, 0));
+  scene_node child = scene_tree_add(&tree, root, translation(0, 2, 0));
+  scene_node grandchild = scene_tree_add(&tree, child, translation(0, 0, 3));
+  scene_tree_propagate(&tree);
+  assert_world_position(grandchild, 1, 2, 3);
+
+  // moving the root drags the whole subtree along
+  scene_tree_set_local(&tree, root, translation(5, 0, 0));
+  scene_tree_propagate(&tree);
+  assert_world_position(child, 5, 2, 0);
+  assert_world_position(grandchild, 5, 2, 3);
+}
+
+TEST(SceneTree, RemovingANodeRemovesItsSubtree) {
+  scene_node root = scene_tree_add(&tree, SCENE_NODE_NONE, translation(1, 0, 0));
+  scene_node child = scene_tree_add(&tree, root, translation(0, 1, 0));
+  scene_node other = scene_tree_add(&tree, SCENE_NODE_NONE, translation(0, 0, 1));
+  scene_tree_remove(&tree, root);
+  TEST_ASSERT_FALSE(scene_tree_contains(&tree, root));
+
+  scene_tree_propagate(&tree);
+  TEST_ASSERT_FALSE(scene_tree_contains(&tree, child));
+  TEST_ASSERT_TRUE(scene_tree_contains(&tree, other));
+  TEST_ASSERT_EQUAL_UINT32(1, tree.count);
+  assert_world_position(other, 0, 0, 1);
+}
+
+TEST(SceneTree, ReparentingUnderALaterNodeKeepsParentsFirst) {
+  scene_node a = scene_tree_add(&tree, SCENE_NODE_NONE, translation(1, 0, 0));
+  scene_node a_child = scene_tree_add(&tree, a, translation(0, 1, 0));
+  scene_node b = scene_tree_add(&tree, SCENE_NODE_NONE, translation(0, 0, 10));
+  scene_tree_set_parent(&tree, a, b);
+  scene_tree_propagate(&tree);
+
+  TEST_ASSERT_EQUAL_UINT32(b.raw, scene_tree_parent(&tree, a).raw);
+  TEST_ASSERT_EQUAL_UINT32(a.raw, scene_tree_parent(&tree, a_child).raw);
+  for (u32 i = 0; i < tree.count; i++) {
+    TEST_ASSERT_TRUE(tree.parents[i] == SCENE_NO_PARENT || tree.parents[i] < i);
+  }
+  assert_world_position(a_child, 1, 1, 10);
+}
+
+TEST(SceneTree, HandlesSurviveCompaction) {
+  scene_node nodes[64];
+  for (u32 i = 0; i < 64; i++) {
+    scene_node parent = i % 4 == 0 ? SCENE_NODE_NONE : nodes[i - 1];
+    nodes[i] = scene_tree_add(&tree, parent, translation(1, 0, 0));
+  }
+  // drop every other chain of four
+  for (u32 i = 0; i < 64; i += 8) scene_tree_remove(&tree, nodes[i]);
+  scene_tree_propagate(&tree);
+  TEST_ASSERT_EQUAL_UINT32(32, tree.count);
+
+  for (u32 i = 0; i < 64; i++) {
+    bool removed = (i / 4) % 2 == 0;
+    TEST_ASSERT_EQUAL(!removed, scene_tree_contains(&tree, nodes[i]));
+    if (!removed) assert_world_position(nodes[i], (f32)(i % 4 + 1), 0, 0);
+  }
+
+  // freed handles get reused
+  scene_node fresh = scene_tree_add(&tree, nodes[4], translation(0, 1, 0));
+  TEST_ASSERT_TRUE(fresh.raw < 64);
+  scene_tree_propagate(&tree);
+  assert_world_position(fresh, 1, 1, 0);
+}
+
+static bool changed_contains(scene_node node) {
+  for (u32 i = 0; i < tree.changed_count; i++) {
+    if (tree.changed[i].raw == node.raw) return true;
+  }
+  return false;
+}
+
+TEST(SceneTree, OnlyEditedSubtreesChange) {
+  scene_node a = scene_tree_add(&tree, SCENE_NODE_NONE, translation(1, 0, 0));
+  scene_node a_child = scene_tree_add(&tree, a, translation(0, 1, 0));
+  scene_node b = scene_tree_add(&tree, SCENE_NODE_NONE, translation(0, 0, 1));
+  scene_node b_child = scene_tree_add(&tree, b, translation(0, 1, 0));
+  scene_tree_propagate(&tree);
+  TEST_ASSERT_EQUAL_UINT32(4, tree.changed_count);
+
+  scene_tree_propagate(&tree);
+  TEST_ASSERT_EQUAL_UINT32(0, tree.changed_count);
+
+  // editing a child and its parent still visits the child once
+  scene_tree_set_local(&tree, b_child, translation(0, 2, 0));
+  scene_tree_set_local(&tree, b, translation(0, 0, 2));
+  scene_tree_propagate(&tree);
+  TEST_ASSERT_EQUAL_UINT32(2, tree.changed_count);
+  TEST_ASSERT_TRUE(changed_contains(b));
+  TEST_ASSERT_TRUE(changed_contains(b_child));
+  TEST_ASSERT_FALSE(changed_contains(a));
+  TEST_ASSERT_FALSE(changed_contains(a_child));
+  assert_world_position(b_child, 0, 2, 2);
+  assert_world_position(a_child, 1, 1, 0);
+}
+
+// 8 roots with three levels of 8 children below each: 4680 nodes
+#define FANOUT 8
+#define LARGE_TREE_NODES (FANOUT + FANOUT * FANOUT + FANOUT * FANOUT * FANOUT + FANOUT * FANOUT * FANOUT * FANOUT)
+
+static scene_node roots[FANOUT], kids[FANOUT][FANOUT], grandkids[FANOUT][FANOUT][FANOUT];
+static scene_node leaves[FANOUT][FANOUT][FANOUT][FANOUT];
+static mat4 world_before[LARGE_TREE_NODES];
+
+static void build_large_tree() {
+  for (u32 r = 0; r < FANOUT; r++) {
+    roots[r] = scene_tree_add(&tree, SCENE_NODE_NONE, translation(100.0f * r, 0, 0));
+    for (u32 c = 0; c < FANOUT; c++) {
+      kids[r][c] = scene_tree_add(&tree, roots[r], translation(0, c + 1, 0));
+      for (u32 g = 0; g < FANOUT; g++) {
+        grandkids[r][c][g] = scene_tree_add(&tree, kids[r][c], translation(0, 0, g + 1));
+        for (u32 l = 0; l < FANOUT; l++) {
+          leaves[r][c][g][l] = scene_tree_add(&tree, grandkids[r][c][g], translation(1, 0, 0));
+        }
+      }
+    }
+  }
+}
+
+static void assert_world_unchanged(scene_node node) {
+  mat4 world = scene_tree_world(&tree, node);
+  TEST_ASSERT_EQUAL_MEMORY(&world_before[node.raw], &world, sizeof(mat4));
+}
+
+TEST(SceneTree, FewEditsInALargeTreeLeaveOtherSubtreesAlone) {
+  TEST_ASSERT_TRUE(job_system_init(4));
+  build_large_tree();
+  TEST_ASSERT_EQUAL_UINT32(LARGE_TREE_NODES, tree.count);
+  scene_tree_propagate(&tree);
+  for (u32 i = 0; i < LARGE_TREE_NODES; i++) world_before[i] = scene_tree_world(&tree, (scene_node){ i });
+
+  // few enough edits to walk only the dirty subtrees, and a single dirty root has to be split across workers
+  scene_tree_set_local(&tree, roots[2], translation(500, 0, 0));
+  scene_tree_set_local(&tree, grandkids[2][3][4], translation(0, 0, 50));  // already below an edit
+  scene_tree_set_local(&tree, kids[6][1], translation(0, 40, 0));
+  TEST_ASSERT_TRUE(tree.dirty_count * 8 < tree.count);
+  scene_tree_propagate(&tree);
+
+  // every node below an edit once: root 2's whole subtree and kid 1 of root 6 with its descendants
+  const u32 subtree_of_kid = 1 + FANOUT + FANOUT * FANOUT;
+  TEST_ASSERT_EQUAL_UINT32(1 + FANOUT * subtree_of_kid + subtree_of_kid, tree.changed_count);
+
+  for (u32 r = 0; r < FANOUT; r++) {
+    bool root_edited = r == 2;
+    f32 x = root_edited ? 500 : 100.0f * r;
+    if (root_edited) assert_world_position(roots[r], x, 0, 0);
+    else assert_world_unchanged(roots[r]);
+    for (u32 c = 0; c < FANOUT; c++) {
+      bool kid_edited = r == 6 && c == 1;
+      f32 y = kid_edited ? 40 : c + 1;
+      bool moved = root_edited || kid_edited;
+      if (moved) assert_world_position(kids[r][c], x, y, 0);
+      else assert_world_unchanged(kids[r][c]);
+      for (u32 g = 0; g < FANOUT; g++) {
+        f32 z = root_edited && c == 3 && g == 4 ? 50 : g + 1;
+        if (moved) assert_world_position(grandkids[r][c][g], x, y, z);
+        else assert_world_unchanged(grandkids[r][c][g]);
+        for (u32 l = 0; l < FANOUT; l++) {
+          if (moved) assert_world_position(leaves[r][c][g][l], x + 1, y, z);
+          else assert_world_unchanged(leaves[r][c][g][l]);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,13 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(UploadQueue) {
+  RUN_TEST_CASE(UploadQueue, UploadsCompleteWhenTheirBatchDoes);
+  RUN_TEST_CASE(UploadQueue, UploadsThatDontFitTheEndOfTheRingWrapToTheStart);
+  RUN_TEST_CASE(UploadQueue, AFullRingRefusesUploadsUntilABatchRetires);
+  RUN_TEST_CASE(UploadQueue, BatchesRetireInSubmissionOrder);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(UploadQueue); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
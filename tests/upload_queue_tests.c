@@ -0,0 +1,171 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// Buffers live in host memory and submitted copies wait until a test decides the GPU has finished them, at which
+// point they are carried out and the completion callback runs
+
+#define MAX_FAKE_BUFFERS 4
+static u8* fake_buffers[MAX_FAKE_BUFFERS];
+
+buf_handle ral_buffer_create(u64 size, const void* data) {
+  for (u32 i = 0; i < MAX_FAKE_BUFFERS; i++) {
+    if (fake_buffers[i]) continue;
+    fake_buffers[i] = calloc(1, size);
+    if (data) memcpy(fake_buffers[i], data, size);
+    return (buf_handle){ .raw = i + 1 };
+  }
+  TEST_FAIL_MESSAGE("out of fake buffers");
+  return (buf_handle){ 0 };
+}
+void* ral_buffer_mapped(buf_handle handle) { return fake_buffers[handle.raw - 1]; }
+void ral_buffer_destroy(buf_handle handle) {
+  free(fake_buffers[handle.raw - 1]);
+  fake_buffers[handle.raw - 1] = NULL;
+}
+
+#define MAX_SUBMISSIONS 32
+#define MAX_SUBMITTED_COPIES 8
+
+typedef struct submission {
+  buf_handle staging;
+  gpu_copy_region regions[MAX_SUBMITTED_COPIES];
+  u32 count;
+  gpu_copies_done_fn done;
+  void* user_data;
+  u64 batch_id;
+  bool finished;
+} submission;
+
+static submission submissions[MAX_SUBMISSIONS];
+static u32 submission_count;
+
+void ral_submit_copies(buf_handle staging, const gpu_copy_region* regions, u32 count, gpu_copies_done_fn done,
+                       void* user_data, u64 batch_id) {
+  TEST_ASSERT_TRUE(submission_count < MAX_SUBMISSIONS && count <= MAX_SUBMITTED_COPIES);
+  submission* s = &submissions[submission_count++];
+  *s = (submission){ .staging = staging, .count = count, .done = done, .user_data = user_data, .batch_id = batch_id };
+  memcpy(s->regions, regions, sizeof(gpu_copy_region) * count);
+}
+
+/** @brief the GPU reads staging memory when it runs the copies, so anything overwritten before then shows up here */
+static void gpu_finish(u32 i) {
+  submission* s = &submissions[i];
+  TEST_ASSERT_FALSE(s->finished);
+  for (u32 r = 0; r < s->count; r++) {
+    const gpu_copy_region* region = &s->regions[r];
+    if (region->kind != COPY_BUFFER_TO_BUFFER) continue;
+    const u8* src = fake_buffers[s->staging.raw - 1] + region->src_offset;
+    memcpy(fake_buffers[region->dst_buf.raw - 1] + region->dst_offset, src, region->size);
+  }
+  s->finished = true;
+  s->done(s->user_data, s->batch_id);
+}
+
+static upload_queue queue;
+static buf_handle dst;
+static u8 data[4][200];
+
+TEST_GROUP(UploadQueue);
+
+TEST_SETUP(UploadQueue) {
+  submission_count = 0;
+  queue = upload_queue_create(256, 0);
+  dst = ral_buffer_create(1024, NULL);
+  for (u32 i = 0; i < 4; i++) memset(data[i], 'a' + i, sizeof(data[i]));
+}
+
+TEST_TEAR_DOWN(UploadQueue) {
+  upload_queue_destroy(&queue);
+  ral_buffer_destroy(dst);
+}
+
+TEST(UploadQueue, UploadsCompleteWhenTheirBatchDoes) {
+  upload_ticket a = upload_queue_buffer(&queue, dst, 0, data[0], 100);
+  upload_ticket b = upload_queue_buffer(&queue, dst, 100, data[1], 50);
+  TEST_ASSERT_TRUE(a != 0 && b == a + 1);
+  TEST_ASSERT_EQUAL_UINT32(2, upload_queue_flush(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1, submission_count);
+  TEST_ASSERT_EQUAL_UINT32(2, submissions[0].count);
+
+  upload_queue_poll(&queue);
+  TEST_ASSERT_FALSE(upload_queue_is_complete(&queue, a));
+
+  gpu_finish(0);
+  TEST_ASSERT_FALSE(upload_queue_is_complete(&queue, b));  // nothing is noticed until the next poll
+  upload_queue_poll(&queue);
+  TEST_ASSERT_TRUE(upload_queue_is_complete(&queue, a));
+  TEST_ASSERT_TRUE(upload_queue_is_complete(&queue, b));
+  TEST_ASSERT_EQUAL_MEMORY(data[0], fake_buffers[dst.raw - 1], 100);
+  TEST_ASSERT_EQUAL_MEMORY(data[1], fake_buffers[dst.raw - 1] + 100, 50);
+  TEST_ASSERT_FALSE(upload_queue_is_complete(&queue, 0));
+}
+
+TEST(UploadQueue, UploadsThatDontFitTheEndOfTheRingWrapToTheStart) {
+  upload_queue_buffer(&queue, dst, 0, data[0], 100);
+  upload_queue_buffer(&queue, dst, 100, data[1], 100);
+  upload_queue_flush(&queue);
+  TEST_ASSERT_EQUAL_UINT64(0, submissions[0].regions[0].src_offset);
+  TEST_ASSERT_EQUAL_UINT64(112, submissions[0].regions[1].src_offset);  // aligned to 16 bytes
+  gpu_finish(0);
+
+  // 224 + 100 runs past the 256 byte ring so it starts over at 0, which the first batch has released
+  TEST_ASSERT_TRUE(upload_queue_buffer(&queue, dst, 200, data[2], 100) != 0);
+  upload_queue_flush(&queue);
+  TEST_ASSERT_EQUAL_UINT64(0, submissions[1].regions[0].src_offset);
+  gpu_finish(1);
+  TEST_ASSERT_EQUAL_MEMORY(data[2], fake_buffers[dst.raw - 1] + 200, 100);
+}
+
+TEST(UploadQueue, AFullRingRefusesUploadsUntilABatchRetires) {
+  upload_ticket first = upload_queue_buffer(&queue, dst, 0, data[0], 200);
+  upload_queue_flush(&queue);
+
+  // the GPU hasn't read the first upload yet so its staging space can't be reused
+  TEST_ASSERT_EQUAL_UINT64(0, upload_queue_buffer(&queue, dst, 200, data[1], 100));
+  TEST_ASSERT_EQUAL_UINT32(0, upload_queue_flush(&queue));
+
+  gpu_finish(0);
+  upload_ticket second = upload_queue_buffer(&queue, dst, 200, data[1], 100);
+  TEST_ASSERT_TRUE(second != 0);
+  TEST_ASSERT_TRUE(upload_queue_is_complete(&queue, first));
+  upload_queue_flush(&queue);
+  gpu_finish(1);
+  upload_queue_poll(&queue);
+  TEST_ASSERT_TRUE(upload_queue_is_complete(&queue, second));
+  TEST_ASSERT_EQUAL_MEMORY(data[0], fake_buffers[dst.raw - 1], 200);
+  TEST_ASSERT_EQUAL_MEMORY(data[1], fake_buffers[dst.raw - 1] + 200, 100);
+
+  // bigger than the whole ring never fits
+  TEST_ASSERT_EQUAL_UINT64(0, upload_queue_buffer(&queue, dst, 0, data[0], 257));
+}
+
+TEST(UploadQueue, BatchesRetireInSubmissionOrder) {
+  upload_queue_destroy(&queue);
+  queue = upload_queue_create(256, 48);
+
+  upload_ticket tickets[3];
+  for (u32 i = 0; i < 3; i++) tickets[i] = upload_queue_buffer(&queue, dst, i * 40, data[i], 40);
+  // the budget only lets one 40 byte copy through per flush
+  TEST_ASSERT_EQUAL_UINT32(1, upload_queue_flush(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1, upload_queue_flush(&queue));
+  TEST_ASSERT_EQUAL_UINT32(1, upload_queue_flush(&queue));
+  TEST_ASSERT_EQUAL_UINT32(3, submission_count);
+
+  // the second batch finishing first doesn't retire anything past the first one
+  gpu_finish(1);
+  upload_queue_poll(&queue);
+  TEST_ASSERT_FALSE(upload_queue_is_complete(&queue, tickets[0]));
+  TEST_ASSERT_FALSE(upload_queue_is_complete(&queue, tickets[1]));
+
+  gpu_finish(0);
+  upload_queue_poll(&queue);
+  TEST_ASSERT_TRUE(upload_queue_is_complete(&queue, tickets[1]));
+  TEST_ASSERT_FALSE(upload_queue_is_complete(&queue, tickets[2]));
+  TEST_ASSERT_EQUAL_UINT32(1, queue.batch_count);
+
+  gpu_finish(2);
+  upload_queue_poll(&queue);
+  TEST_ASSERT_TRUE(upload_queue_is_complete(&queue, tickets[2]));
+  TEST_ASSERT_EQUAL_UINT64(queue.head, queue.tail);
+}
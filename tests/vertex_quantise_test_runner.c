@@ -0,0 +1,15 @@
+#include "unity.h"
+#include "unity_fixture.h"
+
+TEST_GROUP_RUNNER(VertexQuantise) {
+  RUN_TEST_CASE(VertexQuantise, StaticVerticesShrinkToAThird);
+  RUN_TEST_CASE(VertexQuantise, PositionsStayWithinAStepOfTheOriginal);
+  RUN_TEST_CASE(VertexQuantise, DirectionsSurviveOctahedralEncoding);
+  RUN_TEST_CASE(VertexQuantise, LowPrecisionDirectionsStayClose);
+  RUN_TEST_CASE(VertexQuantise, TexCoordsBecomeHalfFloats);
+  RUN_TEST_CASE(VertexQuantise, WeightsStillSumToOne);
+}
+
+static void RunAllTests(void) { RUN_TEST_GROUP(VertexQuantise); }
+
+int main(int argc, const char* argv[]) { return UnityMain(argc, argv, RunAllTests); }
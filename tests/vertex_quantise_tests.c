@@ -0,0 +1,177 @@
+#include <celeritas.h>
+#include "unity.h"
+#include "unity_fixture.h"
+
+// `geo_quantise` frees and replaces the geometry's vertex data so it has to come from the system allocator rather
+// than Unity's leak-checking one
+#undef malloc
+#undef free
+
+#define SKINNED_VERTS 37  // not a multiple of the SIMD width so the tail block gets exercised
+
+typedef struct skinned_vert {
+  vec3 pos;
+  vec3 normal;
+  vec4 tangent;
+  vec2 uv;
+  u32 joints[4];
+  f32 weights[4];
+} skinned_vert;
+
+static geometry skinned;
+static u32 seed;
+
+TEST_GROUP(VertexQuantise);
+
+static f32 random_signed(void) {
+  seed = seed * 1664525u + 1013904223u;
+  return (f32)(seed >> 8) / 8388608.0f - 1.0f;
+}
+
+static vec3 random_direction(void) {
+  vec3 d;
+  do d = vec3(random_signed(), random_signed(), random_signed());
+  while (vec3_len(d) < 0.01f);
+  return vec3_normalise(d);
+}
+
+TEST_SETUP(VertexQuantise) {
+  seed = 777;
+  skinned_vert* verts = malloc(sizeof(skinned_vert) * SKINNED_VERTS);
+  for (u32 v = 0; v < SKINNED_VERTS; v++) {
+    vec3 t = random_direction();
+    verts[v] = (skinned_vert){
+      .pos = vec3(random_signed() * 10.0f, random_signed() * 2.0f + 5.0f, random_signed() * 0.5f),
+      .normal = random_direction(),
+      .tangent = vec4(t.x, t.y, t.z, v % 2 ? -1.0f : 1.0f),
+      .uv = { random_signed() * 4.0f, random_signed() },
+      .joints = { v % 200, (v * 7) % 256, 0, 255 },
+      .weights = { 0.6f, 0.3f, 0.1f * (f32)(v % 3), 0.0f },
+    };
+  }
+  skinned = (geometry){
+    .vertex_format = { .label = "Skinned",
+                       .attributes = { ATTR_F32x3, ATTR_F32x3, ATTR_F32x4, ATTR_F32x2, ATTR_U32x4, ATTR_F32x4 },
+                       .attribute_count = 6 },
+    .vertex_data = verts,
+    .vertex_count = SKINNED_VERTS,
+  };
+}
+
+TEST_TEAR_DOWN(VertexQuantise) { free(skinned.vertex_data); }
+
+static const vertex_quantise_desc skinned_desc = {
+  .semantics = { VERTEX_SEMANTIC_POSITION, VERTEX_SEMANTIC_NORMAL, VERTEX_SEMANTIC_TANGENT, VERTEX_SEMANTIC_TEX_COORD,
+                 VERTEX_SEMANTIC_JOINTS, VERTEX_SEMANTIC_WEIGHTS },
+};
+
+/** @brief the packed layout `skinned_desc` produces */
+typedef struct packed_vert {
+  u16 pos[4];
+  i16 normal[2];
+  i16 tangent[2];
+  u16 uv[2];
+  u8 joints[4];
+  u8 weights[4];
+} packed_vert;
+
+TEST(VertexQuantise, StaticVerticesShrinkToAThird) {
+  geometry cube = geo_cuboid(1, 1, 1);
+  vertex_quantise_desc desc = static_3d_quantise_desc();
+  geo_quantise(&cube, &desc);
+
+  TEST_ASSERT_EQUAL_UINT32(16, vertex_desc_stride(&cube.vertex_format));
+  TEST_ASSERT_EQUAL_INT(ATTR_U16x4_NORM, cube.vertex_format.attributes[0]);
+  TEST_ASSERT_EQUAL_INT(ATTR_I16x2_NORM, cube.vertex_format.attributes[1]);
+  TEST_ASSERT_EQUAL_INT(ATTR_F16x2, cube.vertex_format.attributes[2]);
+  free(cube.vertex_data);
+}
+
+TEST(VertexQuantise, PositionsStayWithinAStepOfTheOriginal) {
+  const skinned_vert* original = skinned.vertex_data;
+  skinned_vert before[SKINNED_VERTS];
+  memcpy(before, original, sizeof(before));
+  geo_quantise(&skinned, &skinned_desc);
+
+  TEST_ASSERT_EQUAL_UINT32(sizeof(packed_vert), vertex_desc_stride(&skinned.vertex_format));
+  const packed_vert* packed = skinned.vertex_data;
+  vec3 step = vec3_mult(skinned.position_scale, 1.0f / 65535.0f);
+  for (u32 v = 0; v < SKINNED_VERTS; v++) {
+    vec3 q = vec3(packed[v].pos[0], packed[v].pos[1], packed[v].pos[2]);
+    vec3 p = vec3_add(skinned.position_offset, vec3(q.x * step.x, q.y * step.y, q.z * step.z));
+    TEST_ASSERT_FLOAT_WITHIN(step.x, before[v].pos.x, p.x);
+    TEST_ASSERT_FLOAT_WITHIN(step.y, before[v].pos.y, p.y);
+    TEST_ASSERT_FLOAT_WITHIN(step.z, before[v].pos.z, p.z);
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, packed[v].pos[3]);
+  }
+}
+
+TEST(VertexQuantise, DirectionsSurviveOctahedralEncoding) {
+  skinned_vert before[SKINNED_VERTS];
+  memcpy(before, skinned.vertex_data, sizeof(before));
+  geo_quantise(&skinned, &skinned_desc);
+
+  const packed_vert* packed = skinned.vertex_data;
+  for (u32 v = 0; v < SKINNED_VERTS; v++) {
+    vec3 n = oct_decode(packed[v].normal[0] / 32767.0f, packed[v].normal[1] / 32767.0f);
+    TEST_ASSERT_TRUE(vec3_dot(n, before[v].normal) > 0.99999f);
+
+    // the bitangent sign rides on the second component, whose magnitude was remapped to [0, 1]
+    f32 ty = packed[v].tangent[1] / 32767.0f;
+    vec3 t = oct_decode(packed[v].tangent[0] / 32767.0f, fabsf(ty) * 2.0f - 1.0f);
+    TEST_ASSERT_TRUE(vec3_dot(t, vec3(before[v].tangent.x, before[v].tangent.y, before[v].tangent.z)) > 0.9999f);
+    TEST_ASSERT_EQUAL_FLOAT(before[v].tangent.w, ty < 0.0f ? -1.0f : 1.0f);
+  }
+}
+
+TEST(VertexQuantise, LowPrecisionDirectionsStayClose) {
+  vec3 normals[SKINNED_VERTS];
+  for (u32 v = 0; v < SKINNED_VERTS; v++) normals[v] = ((skinned_vert*)skinned.vertex_data)[v].normal;
+  vertex_quantise_desc desc = skinned_desc;
+  desc.low_precision_directions = true;
+  geo_quantise(&skinned, &desc);
+
+  // 8 + 2 + 2 + 4 + 4 + 4 bytes, padded to keep vertices 4 byte aligned
+  TEST_ASSERT_EQUAL_UINT32(24, vertex_desc_stride(&skinned.vertex_format));
+  const u8* packed = skinned.vertex_data;
+  for (u32 v = 0; v < SKINNED_VERTS; v++) {
+    i8 oct[2];
+    memcpy(oct, packed + v * 24 + 8, sizeof(oct));
+    vec3 n = oct_decode(oct[0] / 127.0f, oct[1] / 127.0f);
+    TEST_ASSERT_TRUE(vec3_dot(n, normals[v]) > 0.999f);
+  }
+}
+
+TEST(VertexQuantise, TexCoordsBecomeHalfFloats) {
+  f32 values[8] = { 0.0f, 1.0f, -2.25f, 0.333333f, 1e-6f, 65504.0f, 100000.0f, -0.0f };
+  for (u32 i = 0; i < 4; i++) ((skinned_vert*)skinned.vertex_data)[i].uv = (vec2){ values[i * 2], values[i * 2 + 1] };
+  geo_quantise(&skinned, &skinned_desc);
+
+  const packed_vert* packed = skinned.vertex_data;
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, f16_to_f32(packed[0].uv[0]));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, f16_to_f32(packed[0].uv[1]));
+  TEST_ASSERT_EQUAL_FLOAT(-2.25f, f16_to_f32(packed[1].uv[0]));
+  TEST_ASSERT_FLOAT_WITHIN(0.0002f, 0.333333f, f16_to_f32(packed[1].uv[1]));
+  TEST_ASSERT_FLOAT_WITHIN(6e-8f, 1e-6f, f16_to_f32(packed[2].uv[0]));  // a subnormal half
+  TEST_ASSERT_EQUAL_FLOAT(65504.0f, f16_to_f32(packed[2].uv[1]));
+  TEST_ASSERT_EQUAL_UINT16(0x7C00, packed[3].uv[0]);  // too big, rounds to infinity
+  TEST_ASSERT_EQUAL_UINT16(0x8000, packed[3].uv[1]);
+}
+
+TEST(VertexQuantise, WeightsStillSumToOne) {
+  skinned_vert before[SKINNED_VERTS];
+  memcpy(before, skinned.vertex_data, sizeof(before));
+  geo_quantise(&skinned, &skinned_desc);
+
+  const packed_vert* packed = skinned.vertex_data;
+  for (u32 v = 0; v < SKINNED_VERTS; v++) {
+    u32 total = 0;
+    f32 sum = before[v].weights[0] + before[v].weights[1] + before[v].weights[2] + before[v].weights[3];
+    for (u32 c = 0; c < 4; c++) {
+      total += packed[v].weights[c];
+      TEST_ASSERT_FLOAT_WITHIN(1.5f / 255.0f, before[v].weights[c] / sum, packed[v].weights[c] / 255.0f);
+      TEST_ASSERT_EQUAL_UINT8(before[v].joints[c], packed[v].joints[c]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(255, total);
+  }
+}